@@ -1,4 +1,16 @@
 #include "WinProgramUpdater.h"
+#include "db_connection.h"
+#include "db_meta.h"
+#include "db_schema.h"
+#include "icon_atlas.h"
+#include "icon_fetch.h"
+#include "icon_store.h"
+#include "installed_sync.h"
+#include "catalog.h"
+#include "catalog_snapshot.h"
+#include "catalog_changes.h"
+#include "winget_index.h"
+#include "tag_correlation.h"
 #include <windows.h>
 #include <shlobj.h>
 #include <sqlite3.h>
@@ -6,135 +18,99 @@
 #include <fstream>
 #include <sstream>
 #include <regex>
+#include <cassert>
 #include <chrono>
 #include <iomanip>
 #include <ctime>
 #include <algorithm>
 #include <unordered_set>
+#include <atomic>
+#include <memory>
 
 WinProgramUpdater::WinProgramUpdater(const std::wstring& dbPath)
-    : db_(nullptr), searchDb_(nullptr), dbPath_(dbPath) {
-    // Set search database path in same directory as main database
-    size_t lastSlash = dbPath.find_last_of(L"\\/");
-    if (lastSlash != std::wstring::npos) {
-        searchDbPath_ = dbPath.substr(0, lastSlash + 1) + L"WinProgramsSearch.db";
-    } else {
-        searchDbPath_ = L"WinProgramsSearch.db";
-    }
+    : db_(nullptr), dbPath_(dbPath),
+      categoryIdsLoaded_(false), batchSize_(DEFAULT_BATCH_SIZE), timeBudgetMinutes_(0),
+      deadline_(std::chrono::steady_clock::time_point::max()) {
     InitializeTagPatterns();
 }
 
 WinProgramUpdater::~WinProgramUpdater() {
     CloseDatabase();
-    CloseSearchDatabase();
+}
+
+void WinProgramUpdater::SetBatchSize(int rows) {
+    batchSize_ = rows > 0 ? rows : DEFAULT_BATCH_SIZE;
+}
+
+void WinProgramUpdater::SetFetchOptions(const FetchPipelineOptions& options) {
+    fetchOptions_ = options;
+    if (fetchOptions_.workers < 1) fetchOptions_.workers = 1;
+}
+
+void WinProgramUpdater::SetWingetIndexPath(const std::wstring& path) {
+    wingetIndexPath_ = path;
+}
+
+void WinProgramUpdater::SetTimeBudget(int minutes) {
+    timeBudgetMinutes_ = minutes > 0 ? minutes : 0;
+}
+
+bool WinProgramUpdater::OutOfTime() const {
+    return std::chrono::steady_clock::now() >= deadline_;
 }
 
 void WinProgramUpdater::InitializeTagPatterns() {
-    // Technology/Hardware
-    tagPatterns_["USB"] = "usb";
-    tagPatterns_["Bluetooth"] = "bluetooth";
-    tagPatterns_["WiFi|Wi-Fi"] = "wifi";
-    tagPatterns_["HDMI"] = "hdmi";
-    tagPatterns_["GPU"] = "gpu";
-    tagPatterns_["CPU"] = "cpu";
-    
-    // Application types
-    tagPatterns_["Browser"] = "browser";
-    tagPatterns_["Client"] = "client";
-    tagPatterns_["Server"] = "server";
-    tagPatterns_["Manager"] = "manager";
-    tagPatterns_["Viewer"] = "viewer";
-    tagPatterns_["Editor"] = "editor";
-    tagPatterns_["Player"] = "player";
-    tagPatterns_["Launcher"] = "launcher";
-    tagPatterns_["Download"] = "download";
-    
-    // Functions
-    tagPatterns_["Emulator"] = "emulator";
-    tagPatterns_["Driver"] = "driver";
-    tagPatterns_["Manual"] = "manual";
-    tagPatterns_["Toolkit"] = "toolkit";
-    tagPatterns_["SDK"] = "development";
-    tagPatterns_["CLI|Command.?Line"] = "cli";
-    tagPatterns_["Mock"] = "testing";
-    tagPatterns_["Test"] = "testing";
-    tagPatterns_["Debug"] = "development";
-    tagPatterns_["Simulator"] = "emulator";
-    
-    // File formats/protocols
-    tagPatterns_["INI"] = "configuration";
-    tagPatterns_["JSON"] = "data";
-    tagPatterns_["XML"] = "data";
-    tagPatterns_["YAML"] = "configuration";
-    tagPatterns_["CSV"] = "data";
-    tagPatterns_["SQL"] = "database";
-    tagPatterns_["HTML"] = "web";
-    tagPatterns_["FTP"] = "network";
-    tagPatterns_["HTTP"] = "web";
-    tagPatterns_["ODBC"] = "database";
-    tagPatterns_["API"] = "development";
-    
-    // Media
-    tagPatterns_["Video"] = "video";
-    tagPatterns_["Audio"] = "audio";
-    tagPatterns_["Image"] = "graphics";
-    tagPatterns_["Photo"] = "graphics";
-    tagPatterns_["Music"] = "audio";
-    tagPatterns_["PDF"] = "document";
-    
-    // Categories
-    tagPatterns_["Game"] = "gaming";
-    tagPatterns_["Utility"] = "utilities";
-    tagPatterns_["Security"] = "security";
-    tagPatterns_["Password"] = "security";
-    tagPatterns_["Recovery"] = "utilities";
-    tagPatterns_["Backup"] = "backup";
-    tagPatterns_["Chocolatey"] = "package-manager";
-    tagPatterns_["Winget"] = "winget";
+    tagPatterns_ = NameTagPatterns();
+    
+    // Compile the whole table once; ExtractTagsFromText scans each string a single time
+    for (const auto& pattern : tagPatterns_) {
+        if (tagMatcher_.Add(pattern.first, (int)tagPatternTags_.size())) {
+            tagPatternTags_.push_back(pattern.second);
+        } else {
+            // Syntax outside the matcher's subset (tag_matcher.h); tag_matcher_test
+            // checks the table, so this only trips on an untested edit
+            assert(!"tag pattern outside the TagMatcher subset");
+#ifdef _CONSOLE
+            std::wcerr << L"Ignoring unsupported tag pattern: " << StringToWString(pattern.first) << std::endl;
+#endif
+        }
+    }
+    tagMatcher_.Build();
 }
 
 bool WinProgramUpdater::OpenDatabase() {
     std::string dbPathUtf8 = WStringToString(dbPath_);
-    int rc = sqlite3_open(dbPathUtf8.c_str(), &db_);
+    int rc = OpenCatalogDatabase(dbPathUtf8, &db_, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
     if (rc != SQLITE_OK) {
         CloseDatabase();
         return false;
     }
     
+    // Tables and indexes of the current schema version (also creates installed_apps)
+    if (!MigrateCatalogSchema(db_)) {
+        CloseDatabase();
+        return false;
+    }
+    
+    statements_.Reset(db_);
     return true;
 }
 
 void WinProgramUpdater::CloseDatabase() {
+    // Cached statements must be finalized before the connection can close
+    statements_.Reset(nullptr);
+    journal_.Close();
+    categoryIds_.clear();
+    categoryIdsLoaded_ = false;
+    
     if (db_) {
+        // Fold the run's WAL back into the database file while the GUI may be reading
+        CheckpointCatalog(db_);
         sqlite3_close(db_);
         db_ = nullptr;
     }
 }
 
-bool WinProgramUpdater::OpenSearchDatabase() {
-    std::string dbPathUtf8 = WStringToString(searchDbPath_);
-    int rc = sqlite3_open(dbPathUtf8.c_str(), &searchDb_);
-    if (rc != SQLITE_OK) {
-        CloseSearchDatabase();
-        return false;
-    }
-    
-    // Create table if not exists
-    const char* createTable = 
-        "CREATE TABLE IF NOT EXISTS search_results ("
-        "package_id TEXT PRIMARY KEY COLLATE NOCASE"
-        ");";
-    
-    return ExecuteSQLSearch(createTable);
-}
-
-void WinProgramUpdater::CloseSearchDatabase() {
-    if (searchDb_) {
-        sqlite3_close(searchDb_);
-        searchDb_ = nullptr;
-    }
-}
-
 bool WinProgramUpdater::ExecuteSQL(const std::string& sql) {
     char* errMsg = nullptr;
     int rc = sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &errMsg);
@@ -147,18 +123,6 @@ bool WinProgramUpdater::ExecuteSQL(const std::string& sql) {
     return true;
 }
 
-bool WinProgramUpdater::ExecuteSQLSearch(const std::string& sql) {
-    char* errMsg = nullptr;
-    int rc = sqlite3_exec(searchDb_, sql.c_str(), nullptr, nullptr, &errMsg);
-    if (rc != SQLITE_OK) {
-        if (errMsg) {
-            sqlite3_free(errMsg);
-        }
-        return false;
-    }
-    return true;
-}
-
 std::vector<std::string> WinProgramUpdater::QueryPackageIds() {
     std::vector<std::string> ids;
     sqlite3_stmt* stmt;
@@ -180,58 +144,93 @@ bool WinProgramUpdater::HasTags(const std::string& packageId) {
     int dbId = GetPackageDbId(packageId);
     if (dbId <= 0) return false;
     
-    std::string sql = "SELECT COUNT(*) FROM app_categories WHERE app_id = " + std::to_string(dbId) + ";";
-    sqlite3_stmt* stmt;
-    int count = 0;
+    sqlite3_stmt* stmt = statements_.Get("SELECT 1 FROM app_categories WHERE app_id = ? LIMIT 1;");
+    if (!stmt) return false;
     
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            count = sqlite3_column_int(stmt, 0);
-        }
-        sqlite3_finalize(stmt);
-    }
-    return count > 0;
+    sqlite3_bind_int(stmt, 1, dbId);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_reset(stmt);
+    return found;
 }
 
 int WinProgramUpdater::GetPackageDbId(const std::string& packageId) {
-    std::string sql = "SELECT id FROM apps WHERE package_id = ? COLLATE NOCASE;";
-    sqlite3_stmt* stmt;
+    sqlite3_stmt* stmt = statements_.Get("SELECT id FROM apps WHERE package_id = ? COLLATE NOCASE;");
     int id = -1;
     
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+    if (stmt) {
         sqlite3_bind_text(stmt, 1, packageId.c_str(), -1, SQLITE_STATIC);
         if (sqlite3_step(stmt) == SQLITE_ROW) {
             id = sqlite3_column_int(stmt, 0);
         }
-        sqlite3_finalize(stmt);
+        sqlite3_reset(stmt);
     }
     return id;
 }
 
-int WinProgramUpdater::GetCategoryId(const std::string& category) {
-    std::string sql = "SELECT id FROM categories WHERE category_name = ? COLLATE NOCASE;";
-    sqlite3_stmt* stmt;
-    int id = -1;
+// Package ids and category names compare with COLLATE NOCASE, which only folds ASCII
+static std::string AsciiLower(const std::string& text) {
+    std::string key = text;
+    for (char& c : key) {
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    }
+    return key;
+}
+
+void WinProgramUpdater::LoadCategoryIds() {
+    categoryIds_.clear();
+    categoryIdsLoaded_ = true;
     
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
-        sqlite3_bind_text(stmt, 1, category.c_str(), -1, SQLITE_STATIC);
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            id = sqlite3_column_int(stmt, 0);
+    sqlite3_stmt* stmt;
+    const char* sql = "SELECT id, category_name FROM categories ORDER BY id;";
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char* name = sqlite3_column_text(stmt, 1);
+            if (name) {
+                // First (lowest) id wins, matching what the NOCASE lookup used to return
+                categoryIds_.emplace(AsciiLower(reinterpret_cast<const char*>(name)), sqlite3_column_int(stmt, 0));
+            }
         }
         sqlite3_finalize(stmt);
     }
+}
+
+int WinProgramUpdater::GetCategoryId(const std::string& category) {
+    if (!categoryIdsLoaded_) {
+        LoadCategoryIds();
+    }
+    
+    std::string key = AsciiLower(category);
+    auto it = categoryIds_.find(key);
+    if (it != categoryIds_.end()) {
+        return it->second;
+    }
     
     // Create if doesn't exist
+    int id = -1;
+    sqlite3_stmt* stmt = statements_.Get("INSERT INTO categories (category_name) VALUES (?);");
+    if (stmt) {
+        sqlite3_bind_text(stmt, 1, category.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_DONE) {
+            id = static_cast<int>(sqlite3_last_insert_rowid(db_));
+        }
+        sqlite3_reset(stmt);
+    }
+    
+    // Someone else may have added it since the map was loaded
     if (id == -1) {
-        std::string insertSql = "INSERT INTO categories (category_name) VALUES (?);";
-        if (sqlite3_prepare_v2(db_, insertSql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+        stmt = statements_.Get("SELECT id FROM categories WHERE category_name = ? COLLATE NOCASE;");
+        if (stmt) {
             sqlite3_bind_text(stmt, 1, category.c_str(), -1, SQLITE_STATIC);
-            if (sqlite3_step(stmt) == SQLITE_DONE) {
-                id = static_cast<int>(sqlite3_last_insert_rowid(db_));
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                id = sqlite3_column_int(stmt, 0);
             }
-            sqlite3_finalize(stmt);
+            sqlite3_reset(stmt);
         }
     }
+    
+    if (id > 0) {
+        categoryIds_.emplace(key, id);
+    }
     return id;
 }
 
@@ -242,41 +241,69 @@ void WinProgramUpdater::AddPackage(const PackageInfo& pkg) {
         return;
     }
     
-    std::string sql = "INSERT OR REPLACE INTO apps (package_id, name, version, publisher, moniker, "
-                      "description, homepage, license, author, copyright, "
-                      "license_url, privacy_url, icon_data, icon_type) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
+    sqlite3_stmt* stmt = statements_.Get(
+        "INSERT OR REPLACE INTO apps (package_id, name, version, publisher, moniker, "
+        "description, homepage, license, author, copyright, "
+        "license_url, privacy_url) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);");
+    if (!stmt) return;
+    
+    sqlite3_bind_text(stmt, 1, pkg.packageId.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, pkg.name.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, pkg.version.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, pkg.publisher.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, pkg.moniker.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, pkg.description.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 7, pkg.homepage.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 8, pkg.license.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 9, pkg.author.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 10, pkg.copyright.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 11, pkg.licenseUrl.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 12, pkg.privacyUrl.c_str(), -1, SQLITE_STATIC);
+    
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        sqlite3_reset(stmt);
+        return;
+    }
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
-        sqlite3_bind_text(stmt, 1, pkg.packageId.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, pkg.name.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, pkg.version.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 4, pkg.publisher.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 5, pkg.moniker.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 6, pkg.description.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 7, pkg.homepage.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 8, pkg.license.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 9, pkg.author.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 10, pkg.copyright.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 11, pkg.licenseUrl.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 12, pkg.privacyUrl.c_str(), -1, SQLITE_STATIC);
-        
-        if (!pkg.iconData.empty()) {
-            sqlite3_bind_blob(stmt, 13, pkg.iconData.data(), pkg.iconData.size(), SQLITE_STATIC);
-            sqlite3_bind_text(stmt, 14, pkg.iconType.c_str(), -1, SQLITE_STATIC);
-        } else {
-            sqlite3_bind_null(stmt, 13);
-            sqlite3_bind_null(stmt, 14);
-        }
-        
-        sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
+    // Add tags (the new row's id saves a lookup per tag)
+    int dbId = static_cast<int>(sqlite3_last_insert_rowid(db_));
+    for (const auto& tag : pkg.tags) {
+        AddTagById(dbId, tag);
+    }
+}
+
+bool WinProgramUpdater::UpdatePackageDetails(const PackageInfo& pkg) {
+    // Fill in what the source index does not carry (or refresh a changed package),
+    // keeping the row (and its id, and so its tags) in place
+    sqlite3_stmt* stmt = statements_.Get(
+        "UPDATE apps SET publisher = ?, description = ?, homepage = ?, license = ?, author = ?, "
+        "copyright = ?, license_url = ?, privacy_url = ?, "
+        "name = COALESCE(NULLIF(?, ''), name), version = COALESCE(NULLIF(?, ''), version), "
+        "moniker = COALESCE(NULLIF(?, ''), moniker) "
+        "WHERE package_id = ? COLLATE NOCASE;");
+    if (!stmt) return false;
+    
+    sqlite3_bind_text(stmt, 1, pkg.publisher.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, pkg.description.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, pkg.homepage.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, pkg.license.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, pkg.author.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, pkg.copyright.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 7, pkg.licenseUrl.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 8, pkg.privacyUrl.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 9, pkg.name.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 10, pkg.version.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 11, pkg.moniker.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 12, pkg.packageId.c_str(), -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) != SQLITE_DONE || sqlite3_changes(db_) == 0) {
+        sqlite3_reset(stmt);
+        return false;
     }
     
-    // Add tags
     for (const auto& tag : pkg.tags) {
         AddTag(pkg.packageId, tag);
     }
+    return true;
 }
 
 void WinProgramUpdater::RemovePackage(const std::string& packageId) {
@@ -284,33 +311,69 @@ void WinProgramUpdater::RemovePackage(const std::string& packageId) {
     if (dbId <= 0) return;
     
     // Remove tags first
-    ExecuteSQL("DELETE FROM app_categories WHERE app_id = " + std::to_string(dbId) + ";");
+    sqlite3_stmt* stmt = statements_.Get("DELETE FROM app_categories WHERE app_id = ?;");
+    if (stmt) {
+        sqlite3_bind_int(stmt, 1, dbId);
+        sqlite3_step(stmt);
+    }
     // Remove package
-    ExecuteSQL("DELETE FROM apps WHERE id = " + std::to_string(dbId) + ";");
+    stmt = statements_.Get("DELETE FROM apps WHERE id = ?;");
+    if (stmt) {
+        sqlite3_bind_int(stmt, 1, dbId);
+        sqlite3_step(stmt);
+    }
 }
 
 void WinProgramUpdater::AddTag(const std::string& packageId, const std::string& tag) {
     int dbId = GetPackageDbId(packageId);
     if (dbId <= 0) return;
     
+    AddTagById(dbId, tag);
+}
+
+bool WinProgramUpdater::AddTagById(int appId, const std::string& tag) {
     int categoryId = GetCategoryId(tag);
-    if (categoryId <= 0) return;
+    if (categoryId <= 0) return false;
     
-    std::string sql = "INSERT OR IGNORE INTO app_categories (app_id, category_id) VALUES (?, ?);";
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
-        sqlite3_bind_int(stmt, 1, dbId);
-        sqlite3_bind_int(stmt, 2, categoryId);
-        sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
-    }
+    sqlite3_stmt* stmt = statements_.Get("INSERT OR IGNORE INTO app_categories (app_id, category_id) VALUES (?, ?);");
+    if (!stmt) return false;
+    
+    sqlite3_bind_int(stmt, 1, appId);
+    sqlite3_bind_int(stmt, 2, categoryId);
+    return sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(db_) > 0;
 }
 
 std::string WinProgramUpdater::ExecuteWingetCommand(const std::string& command) {
-    // Use temp file to avoid pipe buffering issues with winget
+    std::string tempFile = RunWingetCommand(command);
+    if (tempFile.empty()) {
+        return "";
+    }
+    
+    // Read output from temp file
+    std::string result;
+    std::ifstream file(tempFile, std::ios::binary);
+    if (file.is_open()) {
+        std::string line;
+        while (std::getline(file, line)) {
+            result += line + "\n";
+        }
+        file.close();
+    }
+    
+    // Clean up temp file
+    DeleteFileA(tempFile.c_str());
+    
+    return result;
+}
+
+std::string WinProgramUpdater::RunWingetCommand(const std::string& command) {
+    // Use temp file to avoid pipe buffering issues with winget.
+    // Runs on several fetch workers at once, so the name must be unique per call.
+    static std::atomic<unsigned> callCounter(0);
     char tempPath[MAX_PATH];
     GetTempPathA(MAX_PATH, tempPath);
-    std::string tempFile = std::string(tempPath) + "winget_output_" + std::to_string(GetTickCount()) + ".txt";
+    std::string tempFile = std::string(tempPath) + "winget_output_" + std::to_string(GetCurrentProcessId()) + "_" +
+                           std::to_string(GetCurrentThreadId()) + "_" + std::to_string(callCounter++) + ".txt";
     
     // Redirect winget output to temp file using cmd.exe
     std::string fullCmd = "cmd.exe /c \"winget " + command + " --accept-source-agreements --disable-interactivity > \"" + tempFile + "\" 2>&1\"";
@@ -335,32 +398,170 @@ std::string WinProgramUpdater::ExecuteWingetCommand(const std::string& command)
             DeleteFileA(tempFile.c_str());
             return "";
         }
-        
-        // Give file system a moment to flush
-        Sleep(100);
     } else {
         return "";
     }
     
-    // Read output from temp file
-    std::string result;
-    std::ifstream file(tempFile, std::ios::binary);
-    if (file.is_open()) {
-        std::string line;
-        while (std::getline(file, line)) {
-            result += line + "\n";
+    return tempFile;
+}
+
+bool WinProgramUpdater::RunWingetStreaming(const std::string& command, const std::function<void(const char*, size_t)>& onOutput) {
+    // Read winget's combined stdout/stderr from a pipe and hand each chunk on as
+    // it arrives, so the caller can parse while winget is still listing. The
+    // pipe is drained continuously; it never fills and stalls winget.
+    SECURITY_ATTRIBUTES sa = {};
+    sa.nLength = sizeof(sa);
+    sa.bInheritHandle = TRUE;
+    HANDLE readPipe = nullptr, writePipe = nullptr;
+    if (!CreatePipe(&readPipe, &writePipe, &sa, 0)) {
+        return false;
+    }
+    SetHandleInformation(readPipe, HANDLE_FLAG_INHERIT, 0);
+    
+    std::string fullCmd = "winget " + command + " --accept-source-agreements --disable-interactivity";
+    
+    STARTUPINFOA si = {};
+    si.cb = sizeof(STARTUPINFOA);
+    si.dwFlags = STARTF_USESHOWWINDOW | STARTF_USESTDHANDLES;
+    si.wShowWindow = SW_HIDE;
+    si.hStdInput = nullptr;
+    si.hStdOutput = writePipe;
+    si.hStdError = writePipe;
+    
+    PROCESS_INFORMATION pi = {};
+    BOOL started = CreateProcessA(nullptr, const_cast<char*>(fullCmd.c_str()), nullptr, nullptr,
+                                  TRUE, CREATE_NO_WINDOW, nullptr, nullptr, &si, &pi);
+    // Our copy of the write end must go, or ReadFile never sees end-of-file
+    CloseHandle(writePipe);
+    if (!started) {
+        CloseHandle(readPipe);
+        return false;
+    }
+    
+    // Same 2 minute limit as RunWingetCommand, for regional latency
+    const ULONGLONG waitUntil = GetTickCount64() + 120000;
+    bool timedOut = false;
+    char buffer[65536];
+    for (;;) {
+        DWORD available = 0;
+        if (!PeekNamedPipe(readPipe, nullptr, 0, nullptr, &available, nullptr)) {
+            break;  // Broken pipe: winget exited and everything has been read
         }
-        file.close();
+        if (available == 0) {
+            if (GetTickCount64() > waitUntil) {
+                timedOut = true;
+                break;
+            }
+            Sleep(20);
+            continue;
+        }
+        DWORD bytesRead = 0;
+        if (!ReadFile(readPipe, buffer, sizeof(buffer), &bytesRead, nullptr) || bytesRead == 0) {
+            break;
+        }
+        onOutput(buffer, bytesRead);
     }
     
-    // Clean up temp file
-    DeleteFileA(tempFile.c_str());
+    if (timedOut) {
+        TerminateProcess(pi.hProcess, 1);
+    }
+    WaitForSingleObject(pi.hProcess, 5000);
+    CloseHandle(readPipe);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    return !timedOut;
+}
+
+std::string WinProgramUpdater::FindWingetIndex() {
+    // 1. Explicit --winget-index
+    if (!wingetIndexPath_.empty()) {
+        if (GetFileAttributesW(wingetIndexPath_.c_str()) != INVALID_FILE_ATTRIBUTES) {
+            return WStringToString(wingetIndexPath_);
+        }
+#ifdef _CONSOLE
+        std::wcout << L"winget index not found: " << wingetIndexPath_ << std::endl;
+#endif
+        return "";
+    }
     
-    return result;
+    // 2. A copy next to the database (Public\index.db extracted from source.msix)
+    std::string companion = GetCompanionFilePath(WINGET_INDEX_FILENAME);
+    if (GetFileAttributesW(StringToWString(companion).c_str()) != INVALID_FILE_ATTRIBUTES) {
+        return companion;
+    }
+    
+    // 3. The index winget itself uses. WindowsApps is often not listable, so this may find nothing.
+    wchar_t pattern[MAX_PATH];
+    if (ExpandEnvironmentStringsW(L"%ProgramFiles%\\WindowsApps\\Microsoft.Winget.Source_*", pattern, MAX_PATH) == 0) {
+        return "";
+    }
+    std::wstring baseDir = pattern;
+    baseDir = baseDir.substr(0, baseDir.find_last_of(L'\\') + 1);
+    
+    std::wstring newest;
+    WIN32_FIND_DATAW findData;
+    HANDLE find = FindFirstFileW(pattern, &findData);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && newest < findData.cFileName) {
+                newest = findData.cFileName;
+            }
+        } while (FindNextFileW(find, &findData));
+        FindClose(find);
+    }
+    if (!newest.empty()) {
+        std::wstring index = baseDir + newest + L"\\Public\\index.db";
+        if (GetFileAttributesW(index.c_str()) != INVALID_FILE_ATTRIBUTES) {
+            return WStringToString(index);
+        }
+    }
+    return "";
+}
+
+std::string WinProgramUpdater::GetSourceFileKey(const std::string& path) {
+    // Path, size and modification time: enough to tell that winget replaced the index
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(StringToWString(path).c_str(), GetFileExInfoStandard, &data)) {
+        return "";
+    }
+    unsigned long long size = ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    unsigned long long modified = ((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) |
+                                  data.ftLastWriteTime.dwLowDateTime;
+    return "index " + path + " " + std::to_string(size) + " " + std::to_string(modified);
+}
+
+bool WinProgramUpdater::ImportFromWingetIndex(const std::vector<WingetIndexPackage>& packages, UpdateStats& stats,
+                                              std::vector<std::string>& addedPackages,
+                                              std::vector<std::string>& changedPackages) {
+    WingetIndexDiff diff;
+    if (!ImportWingetIndex(db_, packages, diff)) {
+#ifdef _CONSOLE
+        std::wcout << L"Index import failed, falling back to winget search" << std::endl;
+#endif
+        return false;
+    }
+    
+    // The importer created categories on its own statements
+    categoryIds_.clear();
+    categoryIdsLoaded_ = false;
+    
+    stats.packagesAdded += (int)diff.added.size();
+    stats.packagesRemoved += (int)diff.removed.size();
+    stats.tagsFromWinget += diff.tagsAdded;
+    
+#ifdef _CONSOLE
+    std::wcout << L"Index holds " << packages.size() << L" packages: "
+               << diff.added.size() << L" added, " << diff.changed.size() << L" changed, "
+               << diff.removed.size() << L" removed, " << diff.tagsAdded << L" tags added" << std::endl;
+#endif
+    
+    addedPackages = std::move(diff.added);
+    changedPackages = std::move(diff.changed);
+    return true;
 }
 
-std::vector<std::string> WinProgramUpdater::GetWingetPackages() {
-    std::vector<std::string> packages;
+std::vector<SearchResult> WinProgramUpdater::GetWingetPackages() {
+    std::vector<SearchResult> packages;
     std::string output = ExecuteWingetCommand("search \"\" --source winget");
     
 #ifdef _CONSOLE
@@ -421,7 +622,13 @@ std::vector<std::string> WinProgramUpdater::GetWingetPackages() {
             if (std::regex_match(packageId, idRegex)) {
                 // Additional check: ensure it's not pure numeric (like version numbers)
                 if (packageId.find_first_not_of("0123456789.-") != std::string::npos) {
-                    packages.push_back(packageId);
+                    // Third column is the version; winget ellipsizes values that do not fit
+                    SearchResult result;
+                    result.packageId = packageId;
+                    if (columns.size() >= 3 && columns[2].find("\xE2\x80\xA6") == std::string::npos) {
+                        result.version = columns[2];
+                    }
+                    packages.push_back(std::move(result));
 #ifdef _CONSOLE
                     // Show first few IDs for verification
                     if (packages.size() <= 5) {
@@ -436,162 +643,134 @@ std::vector<std::string> WinProgramUpdater::GetWingetPackages() {
     return packages;
 }
 
-void WinProgramUpdater::PopulateSearchDatabase() {
-    // Keep existing search database and update with new packages
-    // (Do not delete - preserve for future use)
-    
-#ifdef _CONSOLE
-    std::wcout << L"Querying winget search..." << std::endl;
-#endif
-    
-    // Get all packages from winget
-    auto packages = GetWingetPackages();
-    
-#ifdef _CONSOLE
-    std::wcout << L"Found " << packages.size() << L" packages from winget" << std::endl;
-    std::wcout << L"Populating search database..." << std::endl;
-#endif
-    
-    // Insert all packages into search database
+void WinProgramUpdater::DiffSearchResults(const std::vector<SearchResult>& packages,
+                                          std::vector<std::string>& newPackages,
+                                          std::vector<std::string>& changedPackages,
+                                          std::vector<int>& missingAppIds) {
+    // Search results and catalog are both sorted by lowercased id (package ids
+    // compare case-insensitively) and merged in one pass
+    struct CatalogEntry {
+        std::string key;
+        std::string packageId;
+        std::string version;
+        int id;
+    };
+    std::vector<CatalogEntry> catalog;
     sqlite3_stmt* stmt;
-    const char* sql = "INSERT OR IGNORE INTO search_results (package_id) VALUES (?);";
-    
-    for (const auto& pkg : packages) {
-        if (IsNumericOnly(pkg)) continue;
-        
-        if (sqlite3_prepare_v2(searchDb_, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, pkg.c_str(), -1, SQLITE_STATIC);
-            sqlite3_step(stmt);
-            sqlite3_finalize(stmt);
+    if (sqlite3_prepare_v2(db_, "SELECT id, package_id, version FROM apps;", -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char* packageId = sqlite3_column_text(stmt, 1);
+            const unsigned char* version = sqlite3_column_text(stmt, 2);
+            if (!packageId) continue;
+            CatalogEntry entry;
+            entry.packageId = reinterpret_cast<const char*>(packageId);
+            entry.key = AsciiLower(entry.packageId);
+            entry.version = version ? reinterpret_cast<const char*>(version) : "";
+            entry.id = sqlite3_column_int(stmt, 0);
+            catalog.push_back(std::move(entry));
         }
+        sqlite3_finalize(stmt);
     }
-    
-#ifdef _CONSOLE
-    // Count what we actually inserted
-    sqlite3_stmt* countStmt;
-    int count = 0;
-    if (sqlite3_prepare_v2(searchDb_, "SELECT COUNT(*) FROM search_results;", -1, &countStmt, nullptr) == SQLITE_OK) {
-        if (sqlite3_step(countStmt) == SQLITE_ROW) {
-            count = sqlite3_column_int(countStmt, 0);
+    std::sort(catalog.begin(), catalog.end(),
+              [](const CatalogEntry& a, const CatalogEntry& b) { return a.key < b.key; });
+    
+    std::vector<std::pair<std::string, size_t>> incoming;
+    incoming.reserve(packages.size());
+    for (size_t i = 0; i < packages.size(); i++) {
+        if (IsNumericOnly(packages[i].packageId)) continue;
+        incoming.emplace_back(AsciiLower(packages[i].packageId), i);
+    }
+    std::sort(incoming.begin(), incoming.end());
+    incoming.erase(std::unique(incoming.begin(), incoming.end(),
+                               [](const auto& a, const auto& b) { return a.first == b.first; }),
+                   incoming.end());
+    
+    // A failed or truncated search must not empty the catalog (same rule as the index import)
+    bool allowRemoval = incoming.size() * 2 >= catalog.size();
+    
+    size_t i = 0, j = 0;
+    while (i < incoming.size() || j < catalog.size()) {
+        int order = i == incoming.size() ? 1 : j == catalog.size() ? -1 : incoming[i].first.compare(catalog[j].key);
+        if (order < 0) {
+            newPackages.push_back(packages[incoming[i].second].packageId);
+            i++;
+        } else if (order > 0) {
+            if (allowRemoval) missingAppIds.push_back(catalog[j].id);
+            j++;
+        } else {
+            // winget search ellipsizes long versions; those are not compared
+            const std::string& version = packages[incoming[i].second].version;
+            if (!version.empty() && version != catalog[j].version) {
+                changedPackages.push_back(catalog[j].packageId);
+            }
+            i++;
+            j++;
         }
-        sqlite3_finalize(countStmt);
     }
-    std::wcout << L"Search database populated with " << count << L" packages" << std::endl;
-#endif
 }
 
-std::vector<std::string> WinProgramUpdater::GetNewPackages() {
-    std::vector<std::string> newPackages;
+std::vector<std::string> WinProgramUpdater::GetMissingInstalledPackages() {
+    std::vector<std::string> missingPackages;
     
-    // Find packages in search DB but not in main DB
-    const char* sql = 
-        "SELECT package_id FROM search_results "
-        "WHERE package_id NOT IN (SELECT package_id FROM apps);";
+    // Installed packages (as of the last sync) that the catalog does not have
+    const char* sql =
+        "SELECT i.package_id FROM installed_apps i "
+        "WHERE NOT EXISTS (SELECT 1 FROM apps a WHERE a.package_id = i.package_id COLLATE NOCASE);";
     
     sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(searchDb_, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) == SQLITE_OK) {
         while (sqlite3_step(stmt) == SQLITE_ROW) {
             const unsigned char* text = sqlite3_column_text(stmt, 0);
-            if (text) {
-                newPackages.push_back(reinterpret_cast<const char*>(text));
+            if (text && !IsNumericOnly(reinterpret_cast<const char*>(text))) {
+                missingPackages.push_back(reinterpret_cast<const char*>(text));
             }
         }
         sqlite3_finalize(stmt);
     }
     
-    return newPackages;
+    return missingPackages;
 }
 
-std::vector<std::string> WinProgramUpdater::GetDeletedPackages() {
-    std::vector<std::string> deletedPackages;
-    
-    // Step 3.1: Run comprehensive winget search to get ALL available packages
-    std::string searchOutput = ExecuteWingetCommand("search .");
-    
-    // Step 3.2: Parse all package IDs from the comprehensive search
-    std::unordered_set<std::string> availablePackageIds;
-    std::istringstream stream(searchOutput);
-    std::string line;
-    bool inResultsSection = false;
-    
-    while (std::getline(stream, line)) {
-        // Skip until we find the header line with "Name" and "Id"
-        if (!inResultsSection) {
-            if (line.find("Name") != std::string::npos && line.find("Id") != std::string::npos) {
-                inResultsSection = true;
-                std::getline(stream, line); // Skip the separator line (dashes)
-            }
-            continue;
-        }
-        
-        // Skip empty lines and progress indicators
-        if (line.empty() || line.length() <= 2) continue;
-        if (line.find_first_not_of(" \t\r\n-\\/|") == std::string::npos) continue;
-        
-        // Parse line using right-to-left tokenization
-        // Format: Name [spaces] Id [spaces] Version [spaces] Source
-        std::vector<std::string> tokens;
-        std::string token;
-        bool inToken = false;
-        
-        // Right-to-left parsing
-        for (int i = line.length() - 1; i >= 0; i--) {
-            char c = line[i];
-            if (c == ' ' || c == '\t') {
-                if (inToken) {
-                    std::reverse(token.begin(), token.end());
-                    tokens.push_back(token);
-                    token.clear();
-                    inToken = false;
-                    if (tokens.size() >= 3) break; // Got Source, Version, and Id
-                }
-            } else {
-                token += c;
-                inToken = true;
-            }
-        }
-        
-        // Package ID is the 3rd token from the right (Source, Version, Id)
-        if (tokens.size() >= 3) {
-            std::string packageId = tokens[2]; // 0=Source, 1=Version, 2=Id
-            if (!packageId.empty()) {
-                availablePackageIds.insert(packageId);
-            }
-        }
+int WinProgramUpdater::RemoveDeletedPackages(const std::vector<int>& missingAppIds) {
+    // Packages missing from winget search are removed unless installed. Runs in the
+    // caller's transaction; returns the number removed, or -1.
+    if (missingAppIds.empty()) return 0;
+    
+    if (!ExecuteSQL("CREATE TEMP TABLE IF NOT EXISTS deleted_packages (id INTEGER PRIMARY KEY);"
+                    "DELETE FROM temp.deleted_packages;")) {
+        return -1;
     }
-    
-    // Step 3.3: Find packages in DB that are NOT available AND NOT installed
-    const char* sql = 
-        "SELECT package_id FROM apps "
-        "WHERE package_id NOT IN (SELECT package_id FROM installed_apps);";
-    
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            const unsigned char* text = sqlite3_column_text(stmt, 0);
-            if (text) {
-                std::string packageId = reinterpret_cast<const char*>(text);
-                // Only mark for deletion if NOT in comprehensive available list
-                if (availablePackageIds.find(packageId) == availablePackageIds.end()) {
-                    deletedPackages.push_back(packageId);
-                }
-            }
-        }
-        sqlite3_finalize(stmt);
+    sqlite3_stmt* stmt = statements_.Get(
+        "INSERT INTO temp.deleted_packages SELECT a.id FROM apps a WHERE a.id = ? "
+        "AND NOT EXISTS (SELECT 1 FROM installed_apps i WHERE i.package_id = a.package_id COLLATE NOCASE);");
+    if (!stmt) return -1;
+    
+    int removed = 0;
+    for (int appId : missingAppIds) {
+        sqlite3_bind_int(stmt, 1, appId);
+        int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) return -1;
+        removed += sqlite3_changes(db_);
     }
     
-    return deletedPackages;
+    // Tags first; the tag_stats triggers see every removed link
+    const char* removeSql =
+        "DELETE FROM app_categories WHERE app_id IN (SELECT id FROM temp.deleted_packages);"
+        "DELETE FROM apps WHERE id IN (SELECT id FROM temp.deleted_packages);"
+        "DELETE FROM temp.deleted_packages;";
+    return ExecuteSQL(removeSql) ? removed : -1;
 }
 
-PackageInfo WinProgramUpdater::GetPackageInfo(const std::string& packageId, int attempt) {
+PackageInfo WinProgramUpdater::GetPackageInfo(const std::string& packageId) {
     PackageInfo info;
     info.packageId = packageId;
     
+    // Backoff only holds up this worker, the others keep fetching
     std::string output = ExecuteWingetCommand("show \"" + packageId + "\"");
-    
-    if (output.empty() && attempt < MAX_RETRIES) {
-        Sleep(1000 * attempt);  // Exponential backoff
-        return GetPackageInfo(packageId, attempt + 1);
+    for (int attempt = 1; output.empty() && attempt < MAX_RETRIES; attempt++) {
+        Sleep(1000 * attempt);
+        output = ExecuteWingetCommand("show \"" + packageId + "\"");
     }
     
     std::istringstream stream(output);
@@ -659,144 +838,22 @@ PackageInfo WinProgramUpdater::GetPackageInfo(const std::string& packageId, int
         }
     }
     
-    // Fetch icon from homepage if available
-    if (!info.homepage.empty()) {
-        FetchIconFromHomepage(info.homepage, info.iconData, info.iconType);
-    }
-    
     return info;
 }
 
-void WinProgramUpdater::FetchIconFromHomepage(const std::string& homepage, std::vector<unsigned char>& iconData, std::string& iconType) {
-    if (homepage.empty()) return;
-    
-    // Use PowerShell to fetch the homepage HTML, find icon URL, and download it
-    std::string psScript = 
-        "$url = '" + homepage + "'; "
-        "try { "
-        "$response = Invoke-WebRequest -Uri $url -TimeoutSec 5 -UseBasicParsing -ErrorAction Stop; "
-        "$html = $response.Content; "
-        
-        // Look for various icon patterns
-        "if ($html -match '<link[^>]*rel=[\"''](?:icon|shortcut icon)[\"''][^>]*href=[\"'']([^\"'']+)[\"'']') { "
-        "  $icon = $Matches[1]; "
-        "} elseif ($html -match '<link[^>]*href=[\"'']([^\"'']+)[\"''][^>]*rel=[\"''](?:icon|shortcut icon)[\"'']') { "
-        "  $icon = $Matches[1]; "
-        "} else { "
-        "  $icon = '/favicon.ico'; "
-        "} "
-        
-        // Convert relative URL to absolute
-        "if ($icon -notmatch '^https?://') { "
-        "  $uri = [System.Uri]$url; "
-        "  if ($icon -match '^//') { "
-        "    $icon = $uri.Scheme + ':' + $icon; "
-        "  } elseif ($icon -match '^/') { "
-        "    $icon = $uri.Scheme + '://' + $uri.Host + $icon; "
-        "  } else { "
-        "    $icon = $uri.Scheme + '://' + $uri.Host + '/' + $icon; "
-        "  } "
-        "} "
-        
-        // Download the icon
-        "try { "
-        "  $iconResponse = Invoke-WebRequest -Uri $icon -TimeoutSec 5 -UseBasicParsing -ErrorAction Stop; "
-        "  $tempFile = [System.IO.Path]::GetTempFileName(); "
-        "  [System.IO.File]::WriteAllBytes($tempFile, $iconResponse.Content); "
-        "  Write-Output $tempFile; "
-        "  Write-Output $icon; "
-        "} catch { Write-Output ''; } "
-        "} catch { Write-Output ''; }";
-    
-    std::string command = "powershell -NoProfile -Command \"" + psScript + "\"";
-    
-    SECURITY_ATTRIBUTES sa = {sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE};
-    HANDLE hRead, hWrite;
-    if (!CreatePipe(&hRead, &hWrite, &sa, 0)) {
-        return;
-    }
-    
-    STARTUPINFOA si = {};
-    si.cb = sizeof(STARTUPINFOA);
-    si.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
-    si.hStdOutput = hWrite;
-    si.hStdError = hWrite;
-    si.wShowWindow = SW_HIDE;
-    
-    PROCESS_INFORMATION pi;
-    if (!CreateProcessA(nullptr, const_cast<char*>(command.c_str()), 
-                        nullptr, nullptr, TRUE, 0, nullptr, nullptr, &si, &pi)) {
-        CloseHandle(hRead);
-        CloseHandle(hWrite);
-        return;
-    }
-    
-    CloseHandle(hWrite);
-    
-    std::string output;
-    char buffer[4096];
-    DWORD bytesRead;
-    while (ReadFile(hRead, buffer, sizeof(buffer) - 1, &bytesRead, nullptr) && bytesRead > 0) {
-        buffer[bytesRead] = '\0';
-        output += buffer;
-    }
-    
-    WaitForSingleObject(pi.hProcess, 15000); // 15 second timeout
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
-    CloseHandle(hRead);
-    
-    // Parse output: first line is temp file path, second line is icon URL
-    std::istringstream stream(output);
-    std::string tempFile, iconUrl;
-    std::getline(stream, tempFile);
-    std::getline(stream, iconUrl);
-    
-    tempFile = Trim(tempFile);
-    iconUrl = Trim(iconUrl);
-    
-    if (!tempFile.empty() && !iconUrl.empty()) {
-        // Read the icon file
-        std::ifstream file(tempFile, std::ios::binary | std::ios::ate);
-        if (file.is_open()) {
-            std::streamsize size = file.tellg();
-            file.seekg(0, std::ios::beg);
-            
-            iconData.resize(size);
-            if (file.read(reinterpret_cast<char*>(iconData.data()), size)) {
-                // Determine icon type from URL
-                if (iconUrl.find(".png") != std::string::npos) {
-                    iconType = "png";
-                } else if (iconUrl.find(".jpg") != std::string::npos || iconUrl.find(".jpeg") != std::string::npos) {
-                    iconType = "jpg";
-                } else {
-                    iconType = "ico";
-                }
-            }
-            file.close();
-        }
-        
-        // Clean up temp file
-        DeleteFileA(tempFile.c_str());
-    }
-}
-
 std::vector<std::string> WinProgramUpdater::ExtractTagsFromText(const std::string& name,
                                                                   const std::string& packageId,
-                                                                  const std::string& moniker) {
-    std::vector<std::string> tags;
+                                                                  const std::string& moniker) const {
+    std::vector<char> hits(tagPatternTags_.size(), 0);
+    tagMatcher_.Match(name, hits);
+    tagMatcher_.Match(packageId, hits);
+    tagMatcher_.Match(moniker, hits);
     
-    for (const auto& pattern : tagPatterns_) {
-        std::regex re(pattern.first, std::regex_constants::icase);
-        
-        if (std::regex_search(name, re) || 
-            std::regex_search(packageId, re) ||
-            (!moniker.empty() && std::regex_search(moniker, re))) {
-            
-            // Avoid duplicates
-            if (std::find(tags.begin(), tags.end(), pattern.second) == tags.end()) {
-                tags.push_back(pattern.second);
-            }
+    std::vector<std::string> tags;
+    for (size_t i = 0; i < tagPatternTags_.size(); i++) {
+        // Avoid duplicates
+        if (hits[i] && std::find(tags.begin(), tags.end(), tagPatternTags_[i]) == tags.end()) {
+            tags.push_back(tagPatternTags_[i]);
         }
     }
     
@@ -804,107 +861,78 @@ std::vector<std::string> WinProgramUpdater::ExtractTagsFromText(const std::strin
 }
 
 bool WinProgramUpdater::IsNumericOnly(const std::string& packageId) {
-    return std::regex_match(packageId, std::regex("^[0-9.]+$"));
+    return !packageId.empty() &&
+           std::all_of(packageId.begin(), packageId.end(), [](char c) { return (c >= '0' && c <= '9') || c == '.'; });
 }
 
 void WinProgramUpdater::ApplyNameBasedInference(UpdateStats& stats) {
+    struct Candidate {
+        int id;
+        std::string packageId;
+        std::string name;
+        std::string moniker;
+    };
+    std::vector<Candidate> candidates;
+    
+    // Read first: the inserts below change the set this query walks
     sqlite3_stmt* stmt;
-    const char* sql = "SELECT id, package_id, name, moniker FROM apps "
-                      "WHERE id NOT IN (SELECT DISTINCT app_id FROM app_categories);";
+    const char* sql = "SELECT a.id, a.package_id, a.name, a.moniker FROM apps a "
+                      "WHERE NOT EXISTS (SELECT 1 FROM app_categories ac WHERE ac.app_id = a.id);";
     
     if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) == SQLITE_OK) {
         while (sqlite3_step(stmt) == SQLITE_ROW) {
-            std::string packageId = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-            std::string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-            std::string moniker = sqlite3_column_text(stmt, 3) ? 
-                                  reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3)) : "";
-            
-            auto tags = ExtractTagsFromText(name, packageId, moniker);
-            for (const auto& tag : tags) {
-                AddTag(packageId, tag);
-                stats.tagsFromInference++;
-            }
+            Candidate c;
+            c.id = sqlite3_column_int(stmt, 0);
+            c.packageId = sqlite3_column_text(stmt, 1) ? reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)) : "";
+            c.name = sqlite3_column_text(stmt, 2) ? reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)) : "";
+            c.moniker = sqlite3_column_text(stmt, 3) ? 
+                        reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3)) : "";
+            candidates.push_back(std::move(c));
         }
         sqlite3_finalize(stmt);
     }
+    
+    // Match on all cores, then write everything from this thread
+    std::vector<std::vector<std::string>> inferred(candidates.size());
+    ParallelFor(candidates.size(), 0, [&](size_t i) {
+        inferred[i] = ExtractTagsFromText(candidates[i].name, candidates[i].packageId, candidates[i].moniker);
+    });
+    
+    BatchWriter batch(db_, batchSize_);
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const Candidate& c = candidates[i];
+        for (const auto& tag : inferred[i]) {
+            AddTagById(c.id, tag);
+            stats.tagsFromInference++;
+            batch.Row();
+        }
+    }
+    batch.Finish();
 }
 
 void WinProgramUpdater::ApplyCorrelationAnalysis(UpdateStats& stats) {
-    // Build co-occurrence matrix
-    std::map<std::string, std::map<std::string, int>> coOccurrence;
-    std::map<std::string, int> tagCounts;
-    
-    sqlite3_stmt* stmt;
-    const char* sql = "SELECT app_id FROM app_categories GROUP BY app_id HAVING COUNT(*) > 1;";
-    
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            int appId = sqlite3_column_int(stmt, 0);
-            
-            // Get all tags for this app
-            std::vector<std::string> appTags;
-            sqlite3_stmt* tagStmt;
-            std::string tagSql = "SELECT c.category_name FROM categories c "
-                                "JOIN app_categories ac ON c.id = ac.category_id "
-                                "WHERE ac.app_id = " + std::to_string(appId) + ";";
-            
-            if (sqlite3_prepare_v2(db_, tagSql.c_str(), -1, &tagStmt, nullptr) == SQLITE_OK) {
-                while (sqlite3_step(tagStmt) == SQLITE_ROW) {
-                    std::string tag = reinterpret_cast<const char*>(sqlite3_column_text(tagStmt, 0));
-                    appTags.push_back(tag);
-                    tagCounts[tag]++;
-                }
-                sqlite3_finalize(tagStmt);
-            }
-            
-            // Build co-occurrence for each pair
-            for (size_t i = 0; i < appTags.size(); i++) {
-                for (size_t j = 0; j < appTags.size(); j++) {
-                    if (i != j) {
-                        coOccurrence[appTags[i]][appTags[j]]++;
-                    }
-                }
-            }
+    // Apply correlation rules (66.67% threshold, min 6 samples)
+    CorrelationOptions options;
+    
+    if (!EnsureTagStats(db_, 0)) {
+        // No stored statistics: count co-occurrence from scratch
+        TagCooccurrence counts;
+        if (!CountTagCooccurrence(db_, 0, counts)) return;
+        int added = ApplyCorrelationRules(db_, SelectCorrelationRules(counts, options));
+        if (added > 0) {
+            stats.tagsFromCorrelation += added;
         }
-        sqlite3_finalize(stmt);
+        return;
     }
     
-    // Apply correlation rules (66.67% threshold, min 6 samples)
-    const double CORRELATION_THRESHOLD = 0.6667;
-    const int MIN_SAMPLES = 6;
-    
-    for (const auto& source : coOccurrence) {
-        if (tagCounts[source.first] < MIN_SAMPLES) continue;
-        
-        for (const auto& target : source.second) {
-            double correlation = static_cast<double>(target.second) / tagCounts[source.first];
-            
-            if (correlation >= CORRELATION_THRESHOLD) {
-                // Apply inference rule: packages with source tag should have target tag
-                std::string applySql = 
-                    "INSERT OR IGNORE INTO app_categories (app_id, category_id) "
-                    "SELECT ac.app_id, (SELECT id FROM categories WHERE category_name = ?) "
-                    "FROM app_categories ac "
-                    "JOIN categories c ON ac.category_id = c.id "
-                    "WHERE c.category_name = ? "
-                    "AND ac.app_id NOT IN ("
-                    "  SELECT app_id FROM app_categories "
-                    "  WHERE category_id = (SELECT id FROM categories WHERE category_name = ?)"
-                    ");";
-                
-                sqlite3_stmt* applyStmt;
-                if (sqlite3_prepare_v2(db_, applySql.c_str(), -1, &applyStmt, nullptr) == SQLITE_OK) {
-                    sqlite3_bind_text(applyStmt, 1, target.first.c_str(), -1, SQLITE_STATIC);
-                    sqlite3_bind_text(applyStmt, 2, source.first.c_str(), -1, SQLITE_STATIC);
-                    sqlite3_bind_text(applyStmt, 3, target.first.c_str(), -1, SQLITE_STATIC);
-                    
-                    if (sqlite3_step(applyStmt) == SQLITE_DONE) {
-                        stats.tagsFromCorrelation += sqlite3_changes(db_);
-                    }
-                    sqlite3_finalize(applyStmt);
-                }
-            }
-        }
+    // Only tags whose counts moved since the last run are re-evaluated, once per
+    // run like the full count above. The links added here dirty their tags again,
+    // so rules they enable are applied by the next run, not chained in this one.
+    std::vector<CorrelationRule> rules = SelectDirtyCorrelationRules(db_, options);
+    ClearTagStatsDirty(db_);
+    int added = ApplyCorrelationRules(db_, rules);
+    if (added > 0) {
+        stats.tagsFromCorrelation += added;
     }
 }
 
@@ -912,191 +940,399 @@ void WinProgramUpdater::TagUncategorized(UpdateStats& stats) {
     int categoryId = GetCategoryId("uncategorized");
     
     std::string sql = "INSERT INTO app_categories (app_id, category_id) "
-                      "SELECT id, " + std::to_string(categoryId) + " "
-                      "FROM apps WHERE id NOT IN (SELECT DISTINCT app_id FROM app_categories);";
+                      "SELECT a.id, " + std::to_string(categoryId) + " FROM apps a "
+                      "WHERE NOT EXISTS (SELECT 1 FROM app_categories ac WHERE ac.app_id = a.id);";
     
     if (ExecuteSQL(sql)) {
         stats.uncategorized = sqlite3_changes(db_);
     }
 }
 
-bool WinProgramUpdater::UpdateDatabase(UpdateStats& stats) {
-    auto startTime = std::chrono::high_resolution_clock::now();
-    
-    // Clear search cache to ensure fresh data
+static void ReportFetchProgress(const FetchProgress& progress) {
 #ifdef _CONSOLE
-    std::wcout << L"Clearing search cache..." << std::endl;
+    std::wostringstream line;
+    line << std::fixed << std::setprecision(1) << progress.ItemsPerMinute();
+    std::wcout << L"  [" << progress.completed << L"/" << progress.total << L"] "
+               << line.str() << L" packages/min, " << progress.failed << L" failed" << std::endl;
+#else
+    (void)progress;
 #endif
-    DeleteFileW(L"WinProgramsSearch.db");
+}
+
+// FNV-1a over the sorted "id version" lines of the source, seeded with its key
+static uint64_t HashSourceListing(const std::string& sourceKey, std::vector<std::string>& lines) {
+    std::sort(lines.begin(), lines.end());
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const std::string& text) {
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        hash ^= 0xFF;  // Separator
+        hash *= 1099511628211ull;
+    };
+    add(sourceKey);
+    for (const std::string& line : lines) add(line);
+    return hash;
+}
+
+// Stages recorded in the update journal
+static const char* STAGE_SOURCE = "source";        // Step 1 (input: index file or run)
+static const char* STAGE_DETAILS = "details";      // Step 2 items
+static const char* STAGE_REFRESH = "refresh";      // Step 2 items: version changed
+static const char* STAGE_INSTALLED = "installed";  // Step 2.5
+static const char* STAGE_DELETED = "deleted";      // Step 3
+static const char* STAGE_TAGS = "tags";            // Step 4 items
+static const char* UPDATE_RUN_KEY = "update_run";  // catalog_meta: number of completed runs
+static const char* SOURCE_FINGERPRINT_KEY = "source_fingerprint";  // catalog_meta: source of the last completed run
+
+// Skipped when the source is unchanged since the last completed run (see UpdateStats::skippedStages)
+static const char* const NO_CHANGE_SKIPPED_STAGES[] = {
+    "details", "refresh", "installed", "deleted", "tags", "icons",
+    "inference", "correlation", "uncategorized", "atlas"
+};
+
+bool WinProgramUpdater::UpdateDatabase(UpdateStats& stats) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    deadline_ = timeBudgetMinutes_ > 0
+        ? std::chrono::steady_clock::now() + std::chrono::minutes(timeBudgetMinutes_)
+        : std::chrono::steady_clock::time_point::max();
     
     if (!OpenDatabase()) {
         return false;
     }
     
-    if (!OpenSearchDatabase()) {
+    if (!journal_.Open(db_)) {
         CloseDatabase();
         return false;
     }
     
-    // Step 1: Populate search database with winget search results
+    // The change log keeps the previous run's changes for a GUI that was closed
+    // or busy while it ran (catalog_changes.h)
+    PruneCatalogChanges(db_);
+    
+    // Stages finished by an interrupted run are skipped until the run completes
+    int64_t completedRuns = 0;
+    GetCatalogMeta(db_, UPDATE_RUN_KEY, completedRuns);
+    std::string runKey = "run " + std::to_string(completedRuns + 1);
+    
+    FetchPipelineOptions stageFetchOptions = fetchOptions_;
+    stageFetchOptions.deadline = deadline_;
+    
+    // Step 1: Import the winget source index, or read winget search results (kept
+    // in memory) when no index is available
 #ifdef _CONSOLE
     std::wcout << L"\n=== Step 1: Query winget ===" << std::endl;
     auto stepStart = std::chrono::high_resolution_clock::now();
 #endif
-    PopulateSearchDatabase();
-    
-#ifdef _CONSOLE
-    auto stepEnd = std::chrono::high_resolution_clock::now();
-    auto stepDuration = std::chrono::duration_cast<std::chrono::seconds>(stepEnd - stepStart).count();
-    std::wcout << L"   Time: " << stepDuration << L" seconds" << std::endl;
-#endif
-    
-    // Attach search database to main database for SQL comparisons
+    std::string indexPath = FindWingetIndex();
+    std::vector<WingetIndexPackage> indexPackages;
+    bool usedIndex = !indexPath.empty();
+    if (usedIndex) {
 #ifdef _CONSOLE
-    std::wcout << L"Attaching search database..." << std::endl;
+        std::wcout << L"Reading winget source index: " << StringToWString(indexPath) << std::endl;
 #endif
-    // Use relative filename since working directory is set to executable location
-    std::string attachSql = "ATTACH DATABASE 'WinProgramsSearch.db' AS search_db;";
-    if (!ExecuteSQL(attachSql)) {
+        usedIndex = ReadWingetIndex(indexPath, indexPackages);
 #ifdef _CONSOLE
-        std::wcout << L"Failed to attach search database" << std::endl;
-        std::wcout << L"SQL: " << StringToWString(attachSql) << std::endl;
+        if (!usedIndex) std::wcout << L"Could not read the index, falling back to winget search" << std::endl;
 #endif
-        CloseSearchDatabase();
-        CloseDatabase();
-        return false;
     }
+    std::string sourceKey = usedIndex ? GetSourceFileKey(indexPath) : runKey;
+    bool sourceDone = !sourceKey.empty() && journal_.StageDone(STAGE_SOURCE, sourceKey);
     
-    // Step 2: Find new packages (in search but not in main)
+    // A run resuming its own winget search has nothing to compare (and does not search again)
+    std::vector<SearchResult> searchResults;
+    if (!usedIndex && !sourceDone) {
 #ifdef _CONSOLE
-    std::wcout << L"\n=== Step 2: Find new packages ===" << std::endl;
+        std::wcout << (indexPath.empty() ? L"No winget source index found, querying winget search..."
+                                         : L"Querying winget search...") << std::endl;
 #endif
+        searchResults = GetWingetPackages();
+#ifdef _CONSOLE
+        std::wcout << L"Found " << searchResults.size() << L" packages from winget" << std::endl;
+#endif
+    }
     
-    auto newPackages = GetNewPackages();
+    // Fingerprint of what the source lists: the index file's key, or "search",
+    // plus every package id and version (an empty search is a winget failure)
+    uint64_t sourceFingerprint = 0;
+    if (usedIndex || !searchResults.empty()) {
+        std::vector<std::string> listing;
+        listing.reserve(usedIndex ? indexPackages.size() : searchResults.size());
+        for (const auto& pkg : indexPackages) listing.push_back(pkg.packageId + " " + pkg.version);
+        for (const auto& pkg : searchResults) listing.push_back(pkg.packageId + " " + pkg.version);
+        sourceFingerprint = HashSourceListing(usedIndex ? sourceKey : "search", listing);
+    }
     
+    // Nothing changed since the last completed run and no work is left over: only
+    // the installed apps can have changed
+    int64_t lastFingerprint = 0;
+    bool noChange = sourceFingerprint != 0 && GetCatalogMeta(db_, SOURCE_FINGERPRINT_KEY, lastFingerprint) &&
+                    (uint64_t)lastFingerprint == sourceFingerprint &&
+                    journal_.UnfinishedItems(STAGE_DETAILS, MAX_ITEM_ATTEMPTS) == 0 &&
+                    journal_.UnfinishedItems(STAGE_REFRESH, MAX_ITEM_ATTEMPTS) == 0 &&
+                    journal_.UnfinishedItems(STAGE_TAGS, MAX_ITEM_ATTEMPTS) == 0;
+    if (noChange) {
 #ifdef _CONSOLE
-    std::wcout << L"Found " << newPackages.size() << L" new packages" << std::endl;
+        std::wcout << L"Source unchanged since the last completed run, only syncing installed apps" << std::endl;
 #endif
+        stats.skippedStages.assign(std::begin(NO_CHANGE_SKIPPED_STAGES), std::end(NO_CHANGE_SKIPPED_STAGES));
+        
+        CatalogFingerprint before;
+        ReadCatalogFingerprint(db_, before);
+        SyncInstalledAppsStep(stats);
+        
+        // The snapshot records the installed set; the atlas does not depend on it
+        CatalogFingerprint after;
+        if (ReadCatalogFingerprint(db_, after) && after != before) {
+            WriteSnapshot();
+        }
+        
+        CloseDatabase();
+        FinishRun(stats, startTime);
+        return true;
+    }
     
-    // Add new packages
-    for (const auto& packageId : newPackages) {
+    std::vector<std::string> indexAddedPackages;
+    std::vector<std::string> indexChangedPackages;
+    bool sourceBusy = false;
+    if (sourceDone) {
 #ifdef _CONSOLE
-        std::wcout << L"  Processing: " << StringToWString(packageId) << L"..." << std::flush;
+        std::wcout << L"Source unchanged since the last completed step 1, skipping" << std::endl;
 #endif
-        PackageInfo info = GetPackageInfo(packageId);
-        if (!info.name.empty()) {
-            AddPackage(info);
-            stats.packagesAdded++;
-            stats.tagsFromWinget += info.tags.size();
+    } else if (usedIndex) {
+        // The packages to fetch are journaled in the same transaction as the import.
+        // If another writer holds the database past the busy timeout, step 1 is left
+        // for the next run: nothing is marked done and the run is not fingerprinted.
+        bool imported = false;
+        if (!ExecuteSQL("BEGIN IMMEDIATE;")) {
+            sourceBusy = true;
+            sourceFingerprint = 0;
 #ifdef _CONSOLE
-            std::wcout << L" ✓ Added (" << info.tags.size() << L" tags)" << std::endl;
+            std::wcout << L"Database busy, the index import is left for the next run" << std::endl;
 #endif
         } else {
+            UpdateStats statsBefore = stats;
+            imported = ImportFromWingetIndex(indexPackages, stats, indexAddedPackages, indexChangedPackages);
+            bool journaled = imported &&
+                             journal_.AddItems(STAGE_DETAILS, indexAddedPackages) >= 0 &&
+                             journal_.AddItems(STAGE_REFRESH, indexChangedPackages) >= 0 &&
+                             journal_.MarkStageDone(STAGE_SOURCE, sourceKey);
+            if (!journaled || !ExecuteSQL("COMMIT;")) {
+                ExecuteSQL("ROLLBACK;");
+                if (imported) {
+#ifdef _CONSOLE
+                    std::wcout << L"Could not journal the index import, rolled back" << std::endl;
+#endif
+                    imported = false;
+                    stats = statsBefore;
+                    indexAddedPackages.clear();
+                    indexChangedPackages.clear();
+                    categoryIds_.clear();
+                    categoryIdsLoaded_ = false;
+                }
+            }
+        }
+        
+        if (!imported && !sourceBusy) {
+            // The index was read but could not be imported; this run is not fingerprinted
+            usedIndex = false;
+            sourceKey = runKey;
+            sourceFingerprint = 0;
+#ifdef _CONSOLE
+            std::wcout << L"Querying winget search..." << std::endl;
+#endif
+            searchResults = GetWingetPackages();
 #ifdef _CONSOLE
-            std::wcout << L" ✗ Skipped (no info)" << std::endl;
+            std::wcout << L"Found " << searchResults.size() << L" packages from winget" << std::endl;
 #endif
         }
     }
     
-    // Step 2.5: Add installed packages that are missing from main database
 #ifdef _CONSOLE
-    std::wcout << L"\n=== Step 2.5: Add missing installed packages ===" << std::endl;
+    auto stepEnd = std::chrono::high_resolution_clock::now();
+    auto stepDuration = std::chrono::duration_cast<std::chrono::seconds>(stepEnd - stepStart).count();
+    std::wcout << L"   Time: " << stepDuration << L" seconds" << std::endl;
 #endif
     
-    // Use PowerShell script to add missing installed packages
-    // This avoids pipe buffering issues with winget show
-    char exePath[MAX_PATH];
-    GetModuleFileNameA(nullptr, exePath, MAX_PATH);
-    std::string exeDir = std::string(exePath);
-    size_t lastSlash = exeDir.find_last_of("\\/");
-    if (lastSlash != std::string::npos) {
-        exeDir = exeDir.substr(0, lastSlash);
+    // Steps 2.5 and 3 work on the package ids from step 1 and on installed_apps, so
+    // they run here as SQL in the same transaction as the journaling of step 2's work.
+    // The block commits or rolls back as a whole, stage marks included; if the
+    // database stays busy, the steps are left for the next run.
+    bool installedDone = journal_.StageDone(STAGE_INSTALLED, runKey);
+    bool deletedDone = journal_.StageDone(STAGE_DELETED, runKey);
+    std::vector<int> missingAppIds;
+    bool stagesBegun = ExecuteSQL("BEGIN IMMEDIATE;");
+    bool stagesOk = stagesBegun;
+    int removed = 0;
+#ifdef _CONSOLE
+    if (!stagesBegun) {
+        std::wcout << L"Database busy, steps 2.5 and 3 are left for the next run" << std::endl;
     }
-    
-    std::string scriptPath = exeDir + "\\scripts\\add_missing_installed_packages.ps1";
-    std::wstring wDbPath = dbPath_;
-    std::string dbPathUtf8;
-    int size = WideCharToMultiByte(CP_UTF8, 0, wDbPath.c_str(), -1, nullptr, 0, nullptr, nullptr);
-    if (size > 0) {
-        dbPathUtf8.resize(size - 1);
-        WideCharToMultiByte(CP_UTF8, 0, wDbPath.c_str(), -1, &dbPathUtf8[0], size, nullptr, nullptr);
+#endif
+    if (stagesBegun && !sourceDone && !sourceBusy && !usedIndex) {
+        std::vector<std::string> newPackages;
+        std::vector<std::string> changedPackages;
+        DiffSearchResults(searchResults, newPackages, changedPackages, missingAppIds);
+        stagesOk = journal_.AddItems(STAGE_DETAILS, newPackages) >= 0 &&
+                   journal_.AddItems(STAGE_REFRESH, changedPackages) >= 0 &&
+                   journal_.MarkStageDone(STAGE_SOURCE, sourceKey);
+#ifdef _CONSOLE
+        std::wcout << newPackages.size() << L" new, " << changedPackages.size() << L" changed, "
+                   << missingAppIds.size() << L" no longer in winget" << std::endl;
+#endif
     }
     
-    std::string psCommand = "powershell.exe -ExecutionPolicy Bypass -NoProfile -File \"" + 
-                           scriptPath + "\" -DatabasePath \"" + dbPathUtf8 + "\"";
-    
-    STARTUPINFOA si = {};
-    si.cb = sizeof(STARTUPINFOA);
-    si.dwFlags = STARTF_USESHOWWINDOW;
-    si.wShowWindow = SW_HIDE;
-    
-    PROCESS_INFORMATION pi = {};
+    // Step 2.5: Installed packages missing from the main database are fetched with
+    // the new packages in step 2
+#ifdef _CONSOLE
+    std::wcout << L"\n=== Step 2.5: Add missing installed packages ===" << std::endl;
+#endif
+    if (installedDone) {
+#ifdef _CONSOLE
+        std::wcout << L"Skipped (already done in this run)" << std::endl;
+#endif
+    } else if (stagesOk) {
+        std::vector<std::string> missingPackages = GetMissingInstalledPackages();
+        stagesOk = journal_.AddItems(STAGE_DETAILS, missingPackages) >= 0 &&
+                   journal_.MarkStageDone(STAGE_INSTALLED, runKey);
+#ifdef _CONSOLE
+        std::wcout << L"Found " << missingPackages.size() << L" installed packages missing from the database" << std::endl;
+#endif
+    }
     
-    if (CreateProcessA(nullptr, const_cast<char*>(psCommand.c_str()), nullptr, nullptr,
-                       FALSE, CREATE_NO_WINDOW, nullptr, nullptr, &si, &pi)) {
-        // Wait up to 5 minutes for script to complete
-        WaitForSingleObject(pi.hProcess, 300000);
-        
-        DWORD exitCode = 0;
-        GetExitCodeProcess(pi.hProcess, &exitCode);
-        
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
-        
+    // Step 3: Remove packages that are NOT available AND NOT installed. The index
+    // import removes them itself; otherwise they are the catalog rows the step 1
+    // merge did not find in winget search.
+#ifdef _CONSOLE
+    std::wcout << L"\n=== Step 3: Find deleted packages ===" << std::endl;
+#endif
+    if (deletedDone) {
+#ifdef _CONSOLE
+        std::wcout << L"Skipped (already done in this run)" << std::endl;
+#endif
+    } else if (sourceBusy) {
+#ifdef _CONSOLE
+        std::wcout << L"Skipped (waits for step 1)" << std::endl;
+#endif
+    } else if (stagesOk && usedIndex) {
+        stagesOk = journal_.MarkStageDone(STAGE_DELETED, runKey);
+#ifdef _CONSOLE
+        std::wcout << L"Handled by the index import" << std::endl;
+#endif
+    } else if (stagesOk) {
+        removed = RemoveDeletedPackages(missingAppIds);
+        stagesOk = removed >= 0 && journal_.MarkStageDone(STAGE_DELETED, runKey);
 #ifdef _CONSOLE
-        if (exitCode == 0) {
-            std::wcout << L"Script completed successfully" << std::endl;
+        if (removed >= 0) {
+            std::wcout << L"Removed " << removed << L" packages (not in winget, not installed)" << std::endl;
         } else {
-            std::wcout << L"Script exited with code: " << exitCode << std::endl;
+            std::wcout << L"Failed to remove deleted packages" << std::endl;
         }
 #endif
+    }
+    
+    if (stagesOk && ExecuteSQL("COMMIT;")) {
+        stats.packagesRemoved += std::max(removed, 0);
     } else {
+        // Whatever was not committed runs again next time, so the source must not
+        // look unchanged then
+        sourceFingerprint = 0;
+        if (stagesBegun) {
+            ExecuteSQL("ROLLBACK;");
 #ifdef _CONSOLE
-        std::wcout << L"Failed to execute script" << std::endl;
+            std::wcout << L"Steps 2.5 and 3 failed and were rolled back, they run again next time" << std::endl;
 #endif
+        }
     }
     
-    // Step 3: Find and remove deleted packages (comprehensive check)
-    // Run "winget search ." to get ALL available packages, then safely delete
-    // packages that are NOT available AND NOT installed
+    // Step 2: Fetch details for new packages (journaled, so an interrupted run's
+    // leftovers come first)
 #ifdef _CONSOLE
-    std::wcout << L"\n=== Step 3: Find deleted packages (comprehensive) ===" << std::endl;
+    std::wcout << L"\n=== Step 2: Find new packages ===" << std::endl;
 #endif
     
-    // Use PowerShell script for comprehensive check via "winget search ."
-    // This ensures we only delete packages that are truly gone from winget
-    std::string checkScript = exeDir + "\\scripts\\check_deleted_packages.ps1";
-    std::string checkCommand = "powershell.exe -ExecutionPolicy Bypass -NoProfile -File \"" + 
-                               checkScript + "\" -DatabasePath \"" + dbPathUtf8 + "\"";
-    
-    STARTUPINFOA checkSi = {};
-    PROCESS_INFORMATION checkPi = {};
-    checkSi.cb = sizeof(checkSi);
-    checkSi.dwFlags = STARTF_USESHOWWINDOW;
-    checkSi.wShowWindow = SW_HIDE;
-    
-    if (CreateProcessA(nullptr, const_cast<char*>(checkCommand.c_str()), nullptr, nullptr, 
-                       FALSE, CREATE_NO_WINDOW, nullptr, nullptr, &checkSi, &checkPi)) {
-        WaitForSingleObject(checkPi.hProcess, 600000); // 10 minute timeout for comprehensive search
-        
-        DWORD checkExitCode = 0;
-        GetExitCodeProcess(checkPi.hProcess, &checkExitCode);
-        
-        CloseHandle(checkPi.hProcess);
-        CloseHandle(checkPi.hThread);
-        
+    // With the index the new rows already exist; winget show only adds the details
+    // (publisher, description, homepage, icon) the index does not carry
+    auto newPackages = journal_.StartItems(STAGE_DETAILS, MAX_ITEM_ATTEMPTS);
+    
 #ifdef _CONSOLE
-        if (checkExitCode == 0) {
-            std::wcout << L"Cleanup completed successfully" << std::endl;
-        } else {
-            std::wcout << L"Cleanup script exited with code: " << checkExitCode << std::endl;
-        }
+    std::wcout << L"Found " << newPackages.size() << L" new packages" << std::endl;
 #endif
+    
+    // Add new packages: winget show runs on the fetch workers, this thread does all writes
+    BatchWriter newPackageBatch(db_, batchSize_);
+    FetchPipelineOptions newPackageOptions = stageFetchOptions;
+    newPackageOptions.idle = [&]() { newPackageBatch.Idle(); };
+    FetchProgress newProgress = RunFetchPipeline<PackageInfo>(newPackages,
+        [this](const std::string& packageId, PackageInfo& info) {
+            info = GetPackageInfo(packageId);
+            return !info.name.empty();
+        },
+        [&](const std::string& packageId, PackageInfo& info, bool ok) {
+            if (ok && GetPackageDbId(packageId) > 0) {
+                // Row from the index (or an earlier run): fill in the details
+                ok = UpdatePackageDetails(info);
+            } else if (ok) {
+                AddPackage(info);
+                stats.packagesAdded++;
+                stats.tagsFromWinget += info.tags.size();
+            }
+            journal_.FinishItem(STAGE_DETAILS, packageId, ok);
+            newPackageBatch.Row();
+#ifdef _CONSOLE
+            if (ok) {
+                std::wcout << L"  ✓ Added " << StringToWString(packageId) << L" (" << info.tags.size() << L" tags)" << std::endl;
+            } else {
+                std::wcout << L"  ✗ Skipped " << StringToWString(packageId) << L" (no info)" << std::endl;
+            }
+#endif
+        },
+        ReportFetchProgress, newPackageOptions);
+    stats.fetchFailures += (int)newProgress.failed;
+    if (newProgress.completed == newProgress.total) {
+        journal_.PurgeDoneItems(STAGE_DETAILS);
     } else {
+        journal_.ReleaseItems(STAGE_DETAILS);
+    }
+    
+    // Packages with a new version: metadata and tags are refetched and updated in
+    // place (their icon is revalidated in step 4.5), the rest of the catalog is left alone
+    auto changedPackages = journal_.StartItems(STAGE_REFRESH, MAX_ITEM_ATTEMPTS);
+    std::vector<std::string> refreshedPackages;
 #ifdef _CONSOLE
-        std::wcout << L"Failed to execute cleanup script" << std::endl;
+    std::wcout << L"Found " << changedPackages.size() << L" packages with a new version" << std::endl;
 #endif
+    FetchProgress refreshProgress = RunFetchPipeline<PackageInfo>(changedPackages,
+        [this](const std::string& packageId, PackageInfo& info) {
+            info = GetPackageInfo(packageId);
+            return !info.name.empty();
+        },
+        [&](const std::string& packageId, PackageInfo& info, bool ok) {
+            ok = ok && UpdatePackageDetails(info);
+            journal_.FinishItem(STAGE_REFRESH, packageId, ok);
+            if (ok) {
+                refreshedPackages.push_back(packageId);
+                stats.packagesUpdated++;
+                stats.tagsFromWinget += info.tags.size();
+            }
+            newPackageBatch.Row();
+#ifdef _CONSOLE
+            if (ok) {
+                std::wcout << L"  ~ Updated " << StringToWString(packageId) << L" to " << StringToWString(info.version) << std::endl;
+            } else {
+                std::wcout << L"  ✗ Skipped " << StringToWString(packageId) << L" (no info)" << std::endl;
+            }
+#endif
+        },
+        ReportFetchProgress, newPackageOptions);
+    stats.fetchFailures += (int)refreshProgress.failed;
+    if (refreshProgress.completed == refreshProgress.total) {
+        journal_.PurgeDoneItems(STAGE_REFRESH);
+    } else {
+        journal_.ReleaseItems(STAGE_REFRESH);
     }
+    newPackageBatch.Finish();
     
     // Step 4: Update tags for packages with zero tags (only if not yet checked)
 #ifdef _CONSOLE
@@ -1104,7 +1340,8 @@ bool WinProgramUpdater::UpdateDatabase(UpdateStats& stats) {
 #endif
     
     sqlite3_stmt* stmt;
-    const char* sql = "SELECT package_id FROM apps WHERE tags_updated = 0 AND id NOT IN (SELECT DISTINCT app_id FROM app_categories);";
+    const char* sql = "SELECT package_id FROM apps a WHERE tags_updated = 0 "
+                      "AND NOT EXISTS (SELECT 1 FROM app_categories ac WHERE ac.app_id = a.id);";
     
     if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) == SQLITE_OK) {
         std::vector<std::string> zeroTagPackages;
@@ -1112,82 +1349,197 @@ bool WinProgramUpdater::UpdateDatabase(UpdateStats& stats) {
             zeroTagPackages.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
         }
         sqlite3_finalize(stmt);
+        journal_.AddItems(STAGE_TAGS, zeroTagPackages);
+    }
+    
+    {
+        std::vector<std::string> zeroTagPackages = journal_.StartItems(STAGE_TAGS, MAX_ITEM_ATTEMPTS);
         
 #ifdef _CONSOLE
         std::wcout << L"Found " << zeroTagPackages.size() << L" packages with zero tags (not yet checked)" << std::endl;
 #endif
         
-        for (const auto& packageId : zeroTagPackages) {
+        BatchWriter tagBatch(db_, batchSize_);
+        FetchPipelineOptions tagOptions = stageFetchOptions;
+        tagOptions.idle = [&]() { tagBatch.Idle(); };
+        FetchProgress tagProgress = RunFetchPipeline<PackageInfo>(zeroTagPackages,
+            [this](const std::string& packageId, PackageInfo& info) {
+                info = GetPackageInfo(packageId);
+                return !info.name.empty();
+            },
+            [&](const std::string& packageId, PackageInfo& info, bool ok) {
+                journal_.FinishItem(STAGE_TAGS, packageId, ok);
+                int addedTags = 0;
+                for (const auto& tag : info.tags) {
+                    AddTag(packageId, tag);
+                    stats.tagsFromWinget++;
+                    addedTags++;
+                }
+                
+                // Mark this package as checked (whether tags were found or not)
+                sqlite3_stmt* updateStmt = statements_.Get("UPDATE apps SET tags_updated = 1 WHERE package_id = ?;");
+                if (updateStmt) {
+                    sqlite3_bind_text(updateStmt, 1, packageId.c_str(), -1, SQLITE_STATIC);
+                    sqlite3_step(updateStmt);
+                }
+                tagBatch.Row();
+                
 #ifdef _CONSOLE
-            std::wcout << L"  Updating tags for: " << StringToWString(packageId) << L"..." << std::flush;
+                if (addedTags > 0) {
+                    std::wcout << L"  ✓ " << StringToWString(packageId) << L": added " << addedTags << L" tags" << std::endl;
+                } else {
+                    std::wcout << L"  " << StringToWString(packageId) << L": no tags found" << std::endl;
+                }
 #endif
-            PackageInfo info = GetPackageInfo(packageId);
-            int addedTags = 0;
-            for (const auto& tag : info.tags) {
-                AddTag(packageId, tag);
-                stats.tagsFromWinget++;
-                addedTags++;
-            }
-            
-            // Mark this package as checked (whether tags were found or not)
-            std::string updateSql = "UPDATE apps SET tags_updated = 1 WHERE package_id = ?;";
-            sqlite3_stmt* updateStmt;
-            if (sqlite3_prepare_v2(db_, updateSql.c_str(), -1, &updateStmt, nullptr) == SQLITE_OK) {
-                sqlite3_bind_text(updateStmt, 1, packageId.c_str(), -1, SQLITE_STATIC);
-                sqlite3_step(updateStmt);
-                sqlite3_finalize(updateStmt);
-            }
-            
+            },
+            ReportFetchProgress, tagOptions);
+        stats.fetchFailures += (int)tagProgress.failed;
+        if (tagProgress.completed == tagProgress.total) {
+            journal_.PurgeDoneItems(STAGE_TAGS);
+        } else {
+            journal_.ReleaseItems(STAGE_TAGS);
+        }
+    }
+    
+    // Step 4.5: Fetch icons for packages without one and revalidate those of the
+    // refreshed packages. Homepages are fetched concurrently, once each.
 #ifdef _CONSOLE
-            if (addedTags > 0) {
-                std::wcout << L" ✓ Added " << addedTags << L" tags" << std::endl;
-            } else {
-                std::wcout << L" (no tags found)" << std::endl;
-            }
+    std::wcout << L"\n=== Step 4.5: Fetch icons ===" << std::endl;
 #endif
+    {
+        std::unique_ptr<HttpTransport> transport = CreateHttpTransport(ICON_FETCH_TIMEOUT_MS, ICON_FETCH_USER_AGENT);
+        IconFetcherOptions iconOptions;
+        if (fetchOptions_.workers > 0) iconOptions.workers = fetchOptions_.workers;
+        iconOptions.deadline = deadline_;
+        IconFetchStats iconStats;
+        if (FetchCatalogIcons(db_, *transport, refreshedPackages, iconOptions, iconStats, ReportFetchProgress)) {
+            stats.iconsFetched = (int)iconStats.fetched;
+            stats.iconsRevalidated = (int)iconStats.notModified;
         }
+#ifdef _CONSOLE
+        std::wcout << L"   " << iconStats.fetched << L" fetched, " << iconStats.notModified << L" not modified, "
+                   << iconStats.reused << L" reused, " << iconStats.noIcon << L" without icon, "
+                   << iconStats.hostFailed << L" unreachable, " << iconStats.skipped << L" skipped" << std::endl;
+#endif
+    }
+    
+    // Packages whose winget tags are still missing would be tagged by inference or
+    // as uncategorized below, so those steps wait until the backlog is done. Failed
+    // fetches are retried next run but do not hold the run back (0 = untried only).
+    stats.backlog = journal_.UnfinishedItems(STAGE_DETAILS, 0) + journal_.UnfinishedItems(STAGE_REFRESH, 0) +
+                    journal_.UnfinishedItems(STAGE_TAGS, 0);
+    bool runComplete = stats.backlog == 0 && journal_.StageDone(STAGE_INSTALLED, runKey) &&
+                       journal_.StageDone(STAGE_DELETED, runKey);
+#ifdef _CONSOLE
+    if (stats.backlog > 0) {
+        std::wcout << L"\n" << stats.backlog << L" packages left for the next run (time budget)" << std::endl;
     }
+#endif
     
-    // Step 5: Apply inference
+    if (runComplete) {
+        // Step 5: Apply inference
+#ifdef _CONSOLE
+        std::wcout << L"\n=== Step 5: Apply name-based inference ===" << std::endl;
+#endif
+        ApplyNameBasedInference(stats);
+        
+        // Step 6: Apply correlation
+#ifdef _CONSOLE
+        std::wcout << L"\n=== Step 6: Apply correlation analysis ===" << std::endl;
+#endif
+        ApplyCorrelationAnalysis(stats);
+        
+        // Step 7: Tag uncategorized
 #ifdef _CONSOLE
-    std::wcout << L"\n=== Step 5: Apply name-based inference ===" << std::endl;
+        std::wcout << L"\n=== Step 7: Tag uncategorized ===" << std::endl;
 #endif
-    ApplyNameBasedInference(stats);
+        TagUncategorized(stats);
+        
+        // The next run starts from step 1 again, and skips it if the source stays the same
+        SetCatalogMeta(db_, UPDATE_RUN_KEY, completedRuns + 1);
+        if (sourceFingerprint != 0) {
+            SetCatalogMeta(db_, SOURCE_FINGERPRINT_KEY, (int64_t)sourceFingerprint);
+        }
+    }
+    
+    SyncInstalledAppsStep(stats);
     
-    // Step 6: Apply correlation
+    stats.tagsAdded = stats.tagsFromWinget + stats.tagsFromInference + stats.tagsFromCorrelation;
+    
+    // Step 9: Stamp a new content version and write the files derived from it
+#ifdef _CONSOLE
+    std::wcout << L"\n=== Step 9: Build icon atlas and catalog snapshot ===" << std::endl;
+#endif
+    // Icons the build scripts wrote inline move to the icon store, and icons no
+    // package refers to any more are dropped. If the database is busy both wait
+    // for the next run; neither may run outside the transaction.
+    bool iconsBegun = ExecuteSQL("BEGIN IMMEDIATE;");
+    int movedIcons = iconsBegun ? MoveInlineIcons(db_) : -1;
+    int prunedIcons = movedIcons >= 0 ? PruneUnusedIcons(db_) : -1;
+    if (iconsBegun && (prunedIcons < 0 || !ExecuteSQL("COMMIT;"))) {
+        ExecuteSQL("ROLLBACK;");
+        prunedIcons = -1;
+    }
 #ifdef _CONSOLE
-    std::wcout << L"\n=== Step 6: Apply correlation analysis ===" << std::endl;
+    if (prunedIcons < 0) {
+        std::wcout << L"   Icon store maintenance " << (iconsBegun ? L"failed" : L"skipped, database busy") << std::endl;
+    } else if (movedIcons > 0 || prunedIcons > 0) {
+        std::wcout << L"   Icon store: " << movedIcons << L" moved, " << prunedIcons << L" unused removed" << std::endl;
+    }
 #endif
-    ApplyCorrelationAnalysis(stats);
     
-    // Step 7: Tag uncategorized
+    uint64_t contentVersion = BumpContentVersion(db_);
+    int atlasIcons = contentVersion ? BuildIconAtlas(db_, GetCompanionFilePath(ICON_ATLAS_FILENAME), contentVersion) : -1;
+    
 #ifdef _CONSOLE
-    std::wcout << L"\n=== Step 7: Tag uncategorized ===" << std::endl;
+    if (atlasIcons >= 0) {
+        std::wcout << L"   Wrote " << atlasIcons << L" icons (content version " << contentVersion << L")" << std::endl;
+    } else {
+        std::wcout << L"   Failed to build icon atlas" << std::endl;
+    }
+#else
+    (void)atlasIcons;
 #endif
-    TagUncategorized(stats);
+    WriteSnapshot();
     
+    CloseDatabase();
+    FinishRun(stats, startTime);
+    return true;
+}
+
+void WinProgramUpdater::SyncInstalledAppsStep(UpdateStats& stats) {
     // Step 8: Sync installed apps
 #ifdef _CONSOLE
     std::wcout << L"\n=== Step 8: Sync installed apps ===" << std::endl;
 #endif
-    if (SyncInstalledApps()) {
+    InstalledSyncResult result;
+    if (SyncInstalledApps(result)) {
+        stats.installedAdded = (int)result.added.size();
+        stats.installedRemoved = (int)result.removed.size();
 #ifdef _CONSOLE
-        std::wcout << L"   Installed apps synced successfully" << std::endl;
+        std::wcout << L"   Installed apps synced: " << result.added.size() << L" added, " << result.removed.size()
+                   << L" removed, " << result.changed.size() << L" changed version" << std::endl;
 #endif
     } else {
 #ifdef _CONSOLE
         std::wcout << L"   Failed to sync installed apps" << std::endl;
 #endif
     }
-    
-    stats.tagsAdded = stats.tagsFromWinget + stats.tagsFromInference + stats.tagsFromCorrelation;
-    
-    // Detach search database
-    ExecuteSQL("DETACH DATABASE search_db;");
-    
-    CloseSearchDatabase();
-    CloseDatabase();
-    
+}
+
+bool WinProgramUpdater::WriteSnapshot() {
+    // Snapshot of the GUI catalog so the next WinProgramManager start skips the full load
+    Catalog catalog;
+    CatalogFingerprint fingerprint;
+    bool snapshotWritten = ReadCatalogFingerprint(db_, fingerprint) && catalog.Load(db_) &&
+                           WriteCatalogSnapshot(catalog, GetCompanionFilePath(CATALOG_SNAPSHOT_FILENAME), fingerprint);
+#ifdef _CONSOLE
+    std::wcout << (snapshotWritten ? L"   Wrote catalog snapshot" : L"   Failed to write catalog snapshot") << std::endl;
+#endif
+    return snapshotWritten;
+}
+
+void WinProgramUpdater::FinishRun(UpdateStats& stats, std::chrono::high_resolution_clock::time_point startTime) {
     // Calculate elapsed time
     auto endTime = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::seconds>(endTime - startTime).count();
@@ -1209,8 +1561,14 @@ bool WinProgramUpdater::UpdateDatabase(UpdateStats& stats) {
     
     // Write permanent log
     WriteAppDataLog(stats, durationStr.str());
-    
-    return true;
+}
+
+std::string WinProgramUpdater::GetCompanionFilePath(const char* fileName) {
+    // Files derived from the database live next to it
+    std::string dbPathUtf8 = WStringToString(dbPath_);
+    size_t lastSlash = dbPathUtf8.find_last_of("\\/");
+    std::string dir = lastSlash != std::string::npos ? dbPathUtf8.substr(0, lastSlash + 1) : std::string();
+    return dir + fileName;
 }
 
 std::string WinProgramUpdater::GetAppDataLogPath() {
@@ -1268,8 +1626,27 @@ void WinProgramUpdater::WriteAppDataLog(const UpdateStats& stats, const std::str
              << "+" << stats.packagesAdded << " added, \n"
              << "-" << stats.packagesRemoved << " removed, \n"
              << "~" << stats.packagesUpdated << " updated, \n"
-             << stats.tagsFromInference + stats.tagsFromCorrelation << " tags inferred\n"
-             << "Time update took: " << duration << "\n\n";
+             << stats.tagsFromInference + stats.tagsFromCorrelation << " tags inferred\n";
+    if (stats.fetchFailures > 0) {
+        newEntry << stats.fetchFailures << " package fetches failed\n";
+    }
+    if (stats.iconsFetched > 0 || stats.iconsRevalidated > 0) {
+        newEntry << stats.iconsFetched << " icons fetched, " << stats.iconsRevalidated << " unchanged\n";
+    }
+    if (stats.backlog > 0) {
+        newEntry << stats.backlog << " packages left for the next run\n";
+    }
+    if (stats.installedAdded > 0 || stats.installedRemoved > 0) {
+        newEntry << "Installed: +" << stats.installedAdded << " -" << stats.installedRemoved << "\n";
+    }
+    if (!stats.skippedStages.empty()) {
+        newEntry << "Source unchanged, skipped:";
+        for (size_t i = 0; i < stats.skippedStages.size(); i++) {
+            newEntry << (i ? ", " : " ") << stats.skippedStages[i];
+        }
+        newEntry << "\n";
+    }
+    newEntry << "Time update took: " << duration << "\n\n";
     
     // Write new entry at top (prepend)
     std::ofstream outFile(logPath, std::ios::trunc);
@@ -1365,25 +1742,10 @@ std::string WinProgramUpdater::WStringToString(const std::wstring& wstr) {
     return result;
 }
 
-bool WinProgramUpdater::SyncInstalledApps() {
+bool WinProgramUpdater::SyncInstalledApps(InstalledSyncResult& result) {
+    result = InstalledSyncResult();
     if (!db_) return false;
     
-    // Create installed_apps table if it doesn't exist
-    const char* createTableSql = 
-        "CREATE TABLE IF NOT EXISTS installed_apps ("
-        "    package_id TEXT PRIMARY KEY,"
-        "    installed_date TEXT,"
-        "    last_seen TEXT,"
-        "    installed_version TEXT,"
-        "    source TEXT,"
-        "    FOREIGN KEY (package_id) REFERENCES apps(package_id)"
-        ");"
-        "CREATE INDEX IF NOT EXISTS idx_installed_last_seen ON installed_apps(last_seen);";
-    
-    if (!ExecuteSQL(createTableSql)) {
-        return false;
-    }
-    
     // Get current timestamp
     auto now = std::chrono::system_clock::now();
     auto time_t_now = std::chrono::system_clock::to_time_t(now);
@@ -1392,132 +1754,18 @@ bool WinProgramUpdater::SyncInstalledApps() {
     char timestamp[32];
     std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tm_now);
     
-    // Execute winget list to get installed packages
-    std::string output = ExecuteWingetCommand("list");
-    if (output.empty()) {
+    // Parse winget list output as it arrives on the pipe, without holding it in memory
+    WingetListParser parser;
+    if (!RunWingetStreaming("list", [&parser](const char* data, size_t size) { parser.Feed(data, size); })) {
         return false;
     }
+    parser.Finish();
     
-    // Parse winget list output
-    // Format: Name  Id  Version  Available  Source
-    // Parse from right to left: rightmost is Source (or Version if no Source), then Version, then Id
-    std::istringstream stream(output);
-    std::string line;
-    bool pastHeader = false;
-    
-    std::vector<std::tuple<std::string, std::string, std::string>> installedPackages; // (id, version, source)
-    
-    while (std::getline(stream, line)) {
-        // Skip empty or very short lines
-        if (line.length() < 10) continue;
-        
-        // Skip header line
-        if (line.find("Name") != std::string::npos && line.find("Id") != std::string::npos) {
-            pastHeader = true;
-            continue;
-        }
-        
-        // Skip separator line (dashes)
-        if (line.find("---") != std::string::npos) {
-            pastHeader = true;
-            continue;
-        }
-        
-        if (!pastHeader) continue;
-        
-        // Split line into tokens by whitespace
-        std::vector<std::string> tokens;
-        std::istringstream tokenStream(line);
-        std::string token;
-        while (tokenStream >> token) {
-            tokens.push_back(token);
-        }
-        
-        // Need at least 2 tokens (Name and Id)
-        if (tokens.size() < 2) continue;
-        
-        // Parse from right to left
-        // If rightmost token contains at least one digit, skip this line (malformed)
-        std::string rightmost = tokens.back();
-        bool hasDigit = false;
-        for (char c : rightmost) {
-            if (std::isdigit(c)) {
-                hasDigit = true;
-                break;
-            }
-        }
-        if (hasDigit) continue;
-        
-        // Extract fields from right to left
-        std::string source, version, id;
-        
-        if (tokens.size() >= 3) {
-            source = tokens[tokens.size() - 1];  // Rightmost
-            version = tokens[tokens.size() - 2]; // Second from right
-            id = tokens[tokens.size() - 3];      // Third from right (ID)
-        } else if (tokens.size() == 2) {
-            // No source column
-            version = tokens[tokens.size() - 1];
-            id = tokens[tokens.size() - 2];
-        }
-        
-        // Validate ID (should contain at least one dot or backslash for package IDs)
-        if (id.empty() || (id.find('.') == std::string::npos && id.find('\\') == std::string::npos)) continue;
-        
-        installedPackages.push_back(std::make_tuple(id, version, source));
-    }
-    
-    // Update database with installed packages
 #ifdef _CONSOLE
-    std::wcout << L"   Found " << installedPackages.size() << L" installed packages" << std::endl;
+    std::wcout << L"   Found " << parser.Packages().size() << L" installed packages" << std::endl;
 #endif
     
-    for (const auto& pkg : installedPackages) {
-        std::string id = std::get<0>(pkg);
-        std::string version = std::get<1>(pkg);
-        std::string source = std::get<2>(pkg);
-        
-        // Check if already exists
-        std::string checkSql = "SELECT installed_date FROM installed_apps WHERE package_id = ?;";
-        sqlite3_stmt* stmt;
-        std::string installedDate = timestamp;
-        
-        if (sqlite3_prepare_v2(db_, checkSql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, id.c_str(), -1, SQLITE_STATIC);
-            if (sqlite3_step(stmt) == SQLITE_ROW) {
-                // Package exists, keep original install date
-                const unsigned char* date = sqlite3_column_text(stmt, 0);
-                if (date) {
-                    installedDate = reinterpret_cast<const char*>(date);
-                }
-            }
-            sqlite3_finalize(stmt);
-        }
-        
-        // Insert or update
-        std::string upsertSql = 
-            "INSERT OR REPLACE INTO installed_apps (package_id, installed_date, last_seen, installed_version, source) "
-            "VALUES (?, ?, ?, ?, ?);";
-        
-        if (sqlite3_prepare_v2(db_, upsertSql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, id.c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt, 2, installedDate.c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt, 3, timestamp, -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt, 4, version.c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt, 5, source.c_str(), -1, SQLITE_STATIC);
-            sqlite3_step(stmt);
-            sqlite3_finalize(stmt);
-        }
-    }
-    
-    // Remove packages that are no longer installed (not seen in this sync)
-    std::string deleteSql = "DELETE FROM installed_apps WHERE last_seen != ?;";
-    sqlite3_stmt* deleteStmt;
-    if (sqlite3_prepare_v2(db_, deleteSql.c_str(), -1, &deleteStmt, nullptr) == SQLITE_OK) {
-        sqlite3_bind_text(deleteStmt, 1, timestamp, -1, SQLITE_STATIC);
-        sqlite3_step(deleteStmt);
-        sqlite3_finalize(deleteStmt);
-    }
-    
-    return true;
+    // One transaction: new rows, changed versions, last_seen, and the packages
+    // that were uninstalled
+    return ApplyInstalledPackages(db_, parser.Packages(), timestamp, result);
 }
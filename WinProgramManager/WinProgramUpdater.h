@@ -1,12 +1,22 @@
 #pragma once
 #include <string>
+#include <chrono>
 #include <vector>
 #include <map>
 #include <memory>
+#include <functional>
+#include <unordered_map>
+#include "sql_batch.h"
+#include "fetch_pipeline.h"
+#include "tag_matcher.h"
+#include "update_journal.h"
 
 // Forward declaration for SQLite
 typedef struct sqlite3 sqlite3;
 
+struct WingetIndexPackage;
+struct InstalledSyncResult;
+
 struct PackageInfo {
     std::string packageId;
     std::string name;
@@ -22,20 +32,31 @@ struct PackageInfo {
     std::string licenseUrl;
     std::string privacyUrl;
     std::string packageUrl;
-    std::vector<unsigned char> iconData;
-    std::string iconType;
     std::vector<std::string> tags;
 };
 
+// One row of winget search output
+struct SearchResult {
+    std::string packageId;
+    std::string version;
+};
+
 struct UpdateStats {
     int packagesAdded = 0;
     int packagesRemoved = 0;
-    int packagesUpdated = 0;
+    int packagesUpdated = 0;      // Version changed, details refetched in place
     int tagsAdded = 0;
     int tagsFromWinget = 0;
     int tagsFromInference = 0;
     int tagsFromCorrelation = 0;
     int uncategorized = 0;
+    int fetchFailures = 0;
+    int iconsFetched = 0;         // New or changed homepage icons
+    int iconsRevalidated = 0;     // Known icons the server confirmed unchanged
+    int installedAdded = 0;       // installed_apps rows added / removed by the sync
+    int installedRemoved = 0;
+    int backlog = 0;              // Packages left for the next run (time budget)
+    std::vector<std::string> skippedStages;   // Source unchanged: stages this run did not run
     double elapsedSeconds = 0.0;
 };
 
@@ -50,33 +71,52 @@ public:
     // Logging
     void WriteAppDataLog(const UpdateStats& stats, const std::string& duration);
 
-    // Installed apps sync
-    bool SyncInstalledApps();
+    // Installed apps sync (winget list diffed against installed_apps)
+    bool SyncInstalledApps(InstalledSyncResult& result);
+
+    // Rows written per transaction (default DEFAULT_BATCH_SIZE)
+    void SetBatchSize(int rows);
+
+    // Worker count and rate limit for winget show / icon fetches
+    void SetFetchOptions(const FetchPipelineOptions& options);
+
+    // winget source index to import instead of running winget search (see FindWingetIndex)
+    void SetWingetIndexPath(const std::wstring& path);
+
+    // Stop starting new work after this many minutes (0 = no limit). Unfinished
+    // work stays in the journal and the next run continues it.
+    void SetTimeBudget(int minutes);
 
 private:
     // Database operations
     bool OpenDatabase();
     void CloseDatabase();
-    bool OpenSearchDatabase();
-    void CloseSearchDatabase();
     bool ExecuteSQL(const std::string& sql);
-    bool ExecuteSQLSearch(const std::string& sql);
     std::vector<std::string> QueryPackageIds();
     bool HasTags(const std::string& packageId);
     void AddPackage(const PackageInfo& pkg);
+    bool UpdatePackageDetails(const PackageInfo& pkg);
     void RemovePackage(const std::string& packageId);
     void AddTag(const std::string& packageId, const std::string& tag);
+    bool AddTagById(int appId, const std::string& tag);
     int GetCategoryId(const std::string& category);
     int GetPackageDbId(const std::string& packageId);
+    void LoadCategoryIds();
 
     // Winget operations
-    void PopulateSearchDatabase();
-    std::vector<std::string> GetNewPackages();
-    std::vector<std::string> GetDeletedPackages();
-    std::vector<std::string> GetWingetPackages();
-    PackageInfo GetPackageInfo(const std::string& packageId, int attempt = 1);
+    std::string FindWingetIndex();
+    bool ImportFromWingetIndex(const std::vector<WingetIndexPackage>& packages, UpdateStats& stats,
+                               std::vector<std::string>& addedPackages, std::vector<std::string>& changedPackages);
+    std::string GetSourceFileKey(const std::string& path);
+    void DiffSearchResults(const std::vector<SearchResult>& packages, std::vector<std::string>& newPackages,
+                           std::vector<std::string>& changedPackages, std::vector<int>& missingAppIds);
+    std::vector<std::string> GetMissingInstalledPackages();
+    int RemoveDeletedPackages(const std::vector<int>& missingAppIds);
+    std::vector<SearchResult> GetWingetPackages();
+    PackageInfo GetPackageInfo(const std::string& packageId);  // Thread-safe, runs on fetch workers
     std::string ExecuteWingetCommand(const std::string& command);
-    void FetchIconFromHomepage(const std::string& homepage, std::vector<unsigned char>& iconData, std::string& iconType);
+    std::string RunWingetCommand(const std::string& command);  // Output file path ("" on failure); caller deletes it
+    bool RunWingetStreaming(const std::string& command, const std::function<void(const char*, size_t)>& onOutput);  // false on failure or timeout
 
     // Tag inference
     void ApplyNameBasedInference(UpdateStats& stats);
@@ -84,28 +124,46 @@ private:
     void TagUncategorized(UpdateStats& stats);
     std::vector<std::string> ExtractTagsFromText(const std::string& name, 
                                                    const std::string& packageId,
-                                                   const std::string& moniker);
+                                                   const std::string& moniker) const;  // Thread-safe
 
     // Utility functions
-    bool IsNumericOnly(const std::string& packageId);
+    static bool IsNumericOnly(const std::string& packageId);
     std::string Trim(const std::string& str);
     std::wstring StringToWString(const std::string& str);
     std::string WStringToString(const std::wstring& wstr);
     std::string GetAppDataPath();
     std::string GetAppDataLogPath();
+    std::string GetCompanionFilePath(const char* fileName);
     void PruneAppDataLog();
+    bool OutOfTime() const;
+
+    // Steps shared by full and no-change runs
+    void SyncInstalledAppsStep(UpdateStats& stats);
+    bool WriteSnapshot();
+    void FinishRun(UpdateStats& stats, std::chrono::high_resolution_clock::time_point startTime);
 
     // Tag pattern mappings
     void InitializeTagPatterns();
     std::map<std::string, std::string> tagPatterns_;
+    TagMatcher tagMatcher_;                               // tagPatterns_ compiled; values index tagPatternTags_
+    std::vector<std::string> tagPatternTags_;             // Tag of each pattern, in tagPatterns_ order
 
     // Database
     sqlite3* db_;
-    sqlite3* searchDb_;
     std::wstring dbPath_;
-    std::wstring searchDbPath_;
+    StatementCache statements_;                           // Prepared statements on db_
+    std::unordered_map<std::string, int> categoryIds_;    // Lowercased name -> categories.id
+    bool categoryIdsLoaded_;
+    int batchSize_;
+    FetchPipelineOptions fetchOptions_;
+    std::wstring wingetIndexPath_;
+    UpdateJournal journal_;
+    int timeBudgetMinutes_;
+    std::chrono::steady_clock::time_point deadline_;
 
     // Constants
     static constexpr int MAX_RETRIES = 3;
     static constexpr int LOG_RETENTION_DAYS = 90;
+    static constexpr int DEFAULT_BATCH_SIZE = 500;
+    static constexpr int MAX_ITEM_ATTEMPTS = 3;      // Runs that may fail to fetch one package
 };
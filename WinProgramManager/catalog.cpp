@@ -0,0 +1,443 @@
+#include "catalog.h"
+#include "catalog_changes.h"
+#include "db_connection.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+static std::string_view ColumnText(sqlite3_stmt* stmt, int column) {
+    const char* text = (const char*)sqlite3_column_text(stmt, column);
+    if (!text) return std::string_view();
+    return std::string_view(text, (size_t)sqlite3_column_bytes(stmt, column));
+}
+
+std::string NormalizeCategoryName(std::string_view name) {
+    const char* whitespace = " \t\r\n";
+    size_t first = name.find_first_not_of(whitespace);
+    if (first == std::string_view::npos) return std::string();
+    size_t last = name.find_last_not_of(whitespace);
+    std::string result(name.substr(first, last - first + 1));
+
+    unsigned char c0 = (unsigned char)result[0];
+    if (c0 >= 'a' && c0 <= 'z') {
+        result[0] = (char)(c0 - 'a' + 'A');
+    } else if (c0 == 0xC3 && result.size() > 1) {
+        // U+00E0..U+00FE (except U+00F7) are the lowercase Latin-1 letters
+        unsigned char c1 = (unsigned char)result[1];
+        if (c1 >= 0xA0 && c1 <= 0xBE && c1 != 0xB7) result[1] = (char)(c1 - 0x20);
+    }
+    return result;
+}
+
+ArenaString Catalog::Store(std::string_view text) {
+    ArenaString s;
+    s.offset = (uint32_t)arena_.size();
+    s.length = (uint32_t)text.size();
+    arena_.append(text.data(), text.size());
+    return s;
+}
+
+void Catalog::Clear() {
+    arena_.clear();
+    arena_.shrink_to_fit();
+    apps_.clear();
+    apps_.shrink_to_fit();
+    indexById_.clear();
+    indexById_.shrink_to_fit();
+    publishers_.clear();
+    publishers_.shrink_to_fit();
+    categoryNames_.clear();
+    categoryNames_.shrink_to_fit();
+    appCategoryLinks_.clear();
+    appCategoryLinks_.shrink_to_fit();
+    categoryAppStart_.clear();
+    categoryAppStart_.shrink_to_fit();
+    categoryAppLinks_.clear();
+    categoryAppLinks_.shrink_to_fit();
+    installed_.clear();
+    installed_.shrink_to_fit();
+}
+
+// Category links as read from the database, before they are matched to apps
+struct Catalog::CategoryLinkRows {
+    std::vector<std::string> names;                   // Display names, distinct
+    std::vector<std::pair<uint32_t, int>> links;      // (index into names, app id)
+};
+
+bool Catalog::ReadApps(sqlite3* db) {
+    // Icons live in the icons table (icon_hash); rows written by the build scripts
+    // still carry them inline until the next updater run. Databases that could not be
+    // migrated yet have no icon_hash column.
+    sqlite3_stmt* stmt;
+    const char* sql = "SELECT id, package_id, name, version, publisher, homepage, "
+                      "icon_hash IS NOT NULL OR icon_data IS NOT NULL "
+                      "FROM apps WHERE name IS NOT NULL AND TRIM(name) != '' ORDER BY name;";
+    const char* legacySql = "SELECT id, package_id, name, version, publisher, homepage, icon_data IS NOT NULL "
+                            "FROM apps WHERE name IS NOT NULL AND TRIM(name) != '' ORDER BY name;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK &&
+        sqlite3_prepare_v2(db, legacySql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+
+    // Interning tables only live for the duration of the load
+    std::unordered_map<std::string, uint32_t> publisherIndex;
+    publishers_.push_back(ArenaString());
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        CatalogApp app;
+        app.id = sqlite3_column_int(stmt, 0);
+        app.packageId = Store(ColumnText(stmt, 1));
+        app.name = Store(ColumnText(stmt, 2));
+        app.version = Store(ColumnText(stmt, 3));
+        app.homepage = Store(ColumnText(stmt, 5));
+        app.hasIcon = sqlite3_column_int(stmt, 6) != 0;
+
+        std::string_view publisher = ColumnText(stmt, 4);
+        if (!publisher.empty()) {
+            auto result = publisherIndex.emplace(std::string(publisher), (uint32_t)publishers_.size());
+            if (result.second) publishers_.push_back(Store(publisher));
+            app.publisher = result.first->second;
+        }
+
+        if (app.id >= 0) {
+            if ((size_t)app.id >= indexById_.size()) indexById_.resize((size_t)app.id + 1, -1);
+            indexById_[app.id] = (int32_t)apps_.size();
+        }
+        apps_.push_back(app);
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+// Raw names that normalise to the same display name are merged; categories
+// without a display name are left out
+static bool ReadCategoryLinks(sqlite3* db, std::vector<std::string>& names,
+                              std::vector<std::pair<uint32_t, int>>& links) {
+    sqlite3_stmt* stmt;
+    const char* sql = "SELECT c.id, c.category_name, ac.app_id FROM categories c "
+                      "JOIN app_categories ac ON c.id = ac.category_id;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+
+    std::unordered_map<int, int> categoryById;               // categories.id -> name index (-1 = skip)
+    std::unordered_map<std::string, uint32_t> categoryByName;
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int categoryId = sqlite3_column_int(stmt, 0);
+        auto it = categoryById.find(categoryId);
+        if (it == categoryById.end()) {
+            std::string name = NormalizeCategoryName(ColumnText(stmt, 1));
+            int local = -1;
+            if (!name.empty()) {
+                auto result = categoryByName.emplace(name, (uint32_t)names.size());
+                if (result.second) names.push_back(name);
+                local = (int)result.first->second;
+            }
+            it = categoryById.emplace(categoryId, local).first;
+        }
+        if (it->second < 0) continue;
+
+        links.emplace_back((uint32_t)it->second, sqlite3_column_int(stmt, 2));
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+static bool ReadInstalledIds(sqlite3* db, std::vector<std::string>& packageIds) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT package_id FROM installed_apps;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) packageIds.emplace_back(ColumnText(stmt, 0));
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+void Catalog::BuildCategories(const CategoryLinkRows& rows) {
+    // Match links to loaded apps; categories left without apps are dropped
+    std::vector<std::pair<uint32_t, uint32_t>> links;        // (category, app index)
+    links.reserve(rows.links.size());
+    std::vector<char> used(rows.names.size(), 0);
+    for (const auto& row : rows.links) {
+        int appIndex = FindApp(row.second);
+        if (appIndex < 0) continue;
+        links.emplace_back(row.first, (uint32_t)appIndex);
+        used[row.first] = 1;
+    }
+
+    // Sort categories by display name and store them in the arena
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < rows.names.size(); i++) {
+        if (used[i]) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(),
+              [&rows](uint32_t a, uint32_t b) { return rows.names[a] < rows.names[b]; });
+    std::vector<uint32_t> rank(rows.names.size());
+    categoryNames_.reserve(order.size());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        rank[order[i]] = i;
+        categoryNames_.push_back(Store(rows.names[order[i]]));
+    }
+    for (auto& link : links) link.first = rank[link.first];
+
+    // Category -> apps, apps in name order
+    std::sort(links.begin(), links.end());
+    links.erase(std::unique(links.begin(), links.end()), links.end());
+
+    categoryAppStart_.assign(categoryNames_.size() + 1, 0);
+    categoryAppLinks_.reserve(links.size());
+    for (const auto& link : links) {
+        categoryAppStart_[link.first + 1]++;
+        categoryAppLinks_.push_back(link.second);
+    }
+    for (size_t i = 1; i < categoryAppStart_.size(); i++) categoryAppStart_[i] += categoryAppStart_[i - 1];
+
+    // App -> categories (counting sort keeps categories in name order per app)
+    for (const auto& link : links) apps_[link.second].categoryCount++;
+    uint32_t offset = 0;
+    for (auto& app : apps_) {
+        app.firstCategory = offset;
+        offset += app.categoryCount;
+    }
+    appCategoryLinks_.resize(links.size());
+    std::vector<uint32_t> fill(apps_.size(), 0);
+    for (const auto& link : links) {
+        CatalogApp& app = apps_[link.second];
+        appCategoryLinks_[app.firstCategory + fill[link.second]++] = link.first;
+    }
+
+    arena_.shrink_to_fit();
+    apps_.shrink_to_fit();
+    publishers_.shrink_to_fit();
+}
+
+void Catalog::SetInstalled(const std::vector<std::string>& packageIds) {
+    installed_.assign((apps_.size() + 7) / 8, 0);
+    if (apps_.empty()) return;
+
+    std::unordered_map<std::string_view, uint32_t> indexByPackage;
+    indexByPackage.reserve(apps_.size());
+    for (uint32_t i = 0; i < apps_.size(); i++) indexByPackage.emplace(Text(apps_[i].packageId), i);
+
+    for (const std::string& packageId : packageIds) {
+        auto it = indexByPackage.find(packageId);
+        if (it != indexByPackage.end()) installed_[it->second >> 3] |= (uint8_t)(1u << (it->second & 7));
+    }
+}
+
+bool Catalog::Load(sqlite3* db) {
+    Clear();
+    if (!db) return false;
+
+    CategoryLinkRows rows;
+    if (!ReadApps(db) || !ReadCategoryLinks(db, rows.names, rows.links)) {
+        return false;
+    }
+    BuildCategories(rows);
+
+    LoadInstalled(db);
+    return true;
+}
+
+// Tries before LoadConcurrent gives up on a database that keeps changing
+static const int LOAD_CONCURRENT_ATTEMPTS = 3;
+
+// Run read on its own read-only connection inside a read transaction. seq is the
+// change log position the connection saw (catalog_changes.h).
+template <typename Read>
+static void ReadOnConnection(const std::string& dbPath, Read read, bool& ok, int64_t& seq) {
+    ok = false;
+    sqlite3* db = nullptr;
+    if (OpenCatalogDatabase(dbPath, &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE) == SQLITE_OK) {
+        CatalogReadSnapshot snapshot(db);
+        if (snapshot.Active()) {
+            seq = GetLastChangeSeq(db);
+            ok = read(db);
+        }
+    }
+    sqlite3_close(db);
+}
+
+bool Catalog::LoadConcurrent(const std::string& dbPath, int64_t& changeSeq) {
+    for (int attempt = 0; attempt < LOAD_CONCURRENT_ATTEMPTS; attempt++) {
+        Clear();
+
+        // Apps on this thread, links and installed ids on their own threads
+        CategoryLinkRows rows;
+        std::vector<std::string> installed;
+        bool ok[3];
+        int64_t seq[3] = {};
+        std::thread linkThread([&]() {
+            ReadOnConnection(dbPath, [&rows](sqlite3* db) { return ReadCategoryLinks(db, rows.names, rows.links); },
+                             ok[1], seq[1]);
+        });
+        std::thread installedThread([&]() {
+            ReadOnConnection(dbPath, [&installed](sqlite3* db) { return ReadInstalledIds(db, installed); },
+                             ok[2], seq[2]);
+        });
+        ReadOnConnection(dbPath, [this](sqlite3* db) { return ReadApps(db); }, ok[0], seq[0]);
+        linkThread.join();
+        installedThread.join();
+
+        if (!ok[0] || !ok[1] || !ok[2]) break;
+
+        // A commit between the connections' snapshots: their results do not fit together
+        if (seq[0] != seq[1] || seq[0] != seq[2]) continue;
+
+        BuildCategories(rows);
+        SetInstalled(installed);
+        changeSeq = seq[0];
+        return true;
+    }
+    Clear();
+    return false;
+}
+
+void Catalog::LoadInstalled(sqlite3* db) {
+    std::vector<std::string> packageIds;
+    if (db) ReadInstalledIds(db, packageIds);
+    SetInstalled(packageIds);
+}
+
+bool Catalog::UpdateApps(sqlite3* db, const std::vector<int>& appIds) {
+    if (!db) return false;
+
+    sqlite3_stmt* stmt;
+    const char* sql = "SELECT package_id, name, version, publisher, homepage, "
+                      "icon_hash IS NOT NULL OR icon_data IS NOT NULL FROM apps WHERE id = ?;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+
+    // Read everything first: nothing is patched if any change is structural
+    struct Patch {
+        uint32_t index;
+        std::string version;
+        std::string publisher;
+        std::string homepage;
+        bool hasIcon;
+    };
+    std::vector<Patch> patches;
+    bool structural = false;
+    for (int appId : appIds) {
+        int index = FindApp(appId);
+        sqlite3_bind_int(stmt, 1, appId);
+        bool found = sqlite3_step(stmt) == SQLITE_ROW;
+        std::string_view name = found ? ColumnText(stmt, 1) : std::string_view();
+        bool named = name.find_first_not_of(' ') != std::string_view::npos;
+        if (index < 0) {
+            structural = named;   // A new app (unnamed rows are not loaded)
+        } else if (!found || Text(apps_[index].name) != name || Text(apps_[index].packageId) != ColumnText(stmt, 0)) {
+            structural = true;
+        } else {
+            Patch patch;
+            patch.index = (uint32_t)index;
+            patch.version = std::string(ColumnText(stmt, 2));
+            patch.publisher = std::string(ColumnText(stmt, 3));
+            patch.homepage = std::string(ColumnText(stmt, 4));
+            patch.hasIcon = sqlite3_column_int(stmt, 5) != 0;
+            patches.push_back(std::move(patch));
+        }
+        sqlite3_reset(stmt);
+        if (structural) break;
+    }
+    sqlite3_finalize(stmt);
+    if (structural) return false;
+
+    // Changed strings are appended to the arena; the old bytes stay until the next Load
+    for (const Patch& patch : patches) {
+        CatalogApp& app = apps_[patch.index];
+        if (Text(app.version) != patch.version) app.version = Store(patch.version);
+        if (Text(app.homepage) != patch.homepage) app.homepage = Store(patch.homepage);
+        if (Publisher(app) != patch.publisher) {
+            auto it = std::find_if(publishers_.begin(), publishers_.end(),
+                [this, &patch](const ArenaString& s) { return Text(s) == patch.publisher; });
+            if (patch.publisher.empty()) {
+                app.publisher = 0;
+            } else if (it != publishers_.end()) {
+                app.publisher = (uint32_t)(it - publishers_.begin());
+            } else {
+                app.publisher = (uint32_t)publishers_.size();
+                publishers_.push_back(Store(patch.publisher));
+            }
+        }
+        app.hasIcon = patch.hasIcon;
+    }
+    return true;
+}
+
+void Catalog::UpdateInstalled(sqlite3* db, const std::vector<std::string>& packageIds, std::vector<uint32_t>& changed) {
+    if (!db || apps_.empty() || packageIds.empty()) return;
+
+    std::unordered_map<std::string_view, uint32_t> indexByPackage;
+    indexByPackage.reserve(apps_.size());
+    for (uint32_t i = 0; i < apps_.size(); i++) indexByPackage.emplace(Text(apps_[i].packageId), i);
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM installed_apps WHERE package_id = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return;
+    }
+    for (const std::string& packageId : packageIds) {
+        auto it = indexByPackage.find(packageId);
+        if (it == indexByPackage.end()) continue;
+
+        sqlite3_bind_text(stmt, 1, packageId.c_str(), (int)packageId.size(), SQLITE_STATIC);
+        bool installed = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_reset(stmt);
+
+        uint32_t index = it->second;
+        uint8_t bit = (uint8_t)(1u << (index & 7));
+        if (installed != IsInstalled(index)) {
+            installed_[index >> 3] ^= bit;
+            changed.push_back(index);
+        }
+    }
+    sqlite3_finalize(stmt);
+}
+
+size_t Catalog::InstalledCount() const {
+    size_t count = 0;
+    for (uint8_t bits : installed_) {
+        for (; bits; bits &= (uint8_t)(bits - 1)) count++;
+    }
+    return count;
+}
+
+int Catalog::FindApp(int appId) const {
+    if (appId < 0 || (size_t)appId >= indexById_.size()) return -1;
+    return indexById_[appId];
+}
+
+IndexRange Catalog::AppCategories(const CatalogApp& app) const {
+    IndexRange range;
+    range.first = appCategoryLinks_.data() + app.firstCategory;
+    range.last = range.first + app.categoryCount;
+    return range;
+}
+
+int Catalog::FindCategory(std::string_view name) const {
+    auto it = std::lower_bound(categoryNames_.begin(), categoryNames_.end(), name,
+        [this](const ArenaString& s, std::string_view value) { return Text(s) < value; });
+    if (it == categoryNames_.end() || Text(*it) != name) return -1;
+    return (int)(it - categoryNames_.begin());
+}
+
+IndexRange Catalog::CategoryApps(uint32_t category) const {
+    IndexRange range;
+    range.first = categoryAppLinks_.data() + categoryAppStart_[category];
+    range.last = categoryAppLinks_.data() + categoryAppStart_[category + 1];
+    return range;
+}
+
+size_t Catalog::MemoryUsage() const {
+    return sizeof(*this) +
+           arena_.capacity() +
+           apps_.capacity() * sizeof(CatalogApp) +
+           indexById_.capacity() * sizeof(int32_t) +
+           publishers_.capacity() * sizeof(ArenaString) +
+           categoryNames_.capacity() * sizeof(ArenaString) +
+           (appCategoryLinks_.capacity() + categoryAppStart_.capacity() + categoryAppLinks_.capacity()) * sizeof(uint32_t) +
+           installed_.capacity();
+}
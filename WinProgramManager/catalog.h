@@ -0,0 +1,119 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+// Compact in-memory copy of the app catalog used by the GUI.
+// Every string is stored once, as UTF-8, in a single arena. Publishers and
+// categories are interned, and app <-> category links are flat index arrays.
+// UTF-16 is only produced by the GUI for the rows it actually displays.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+struct CatalogFingerprint;  // catalog_snapshot.h
+
+// Location of a string inside the catalog arena
+struct ArenaString {
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+struct CatalogApp {
+    int32_t id = 0;
+    ArenaString packageId;
+    ArenaString name;
+    ArenaString version;
+    ArenaString homepage;
+    uint32_t publisher = 0;       // Interned publisher index (0 = no publisher)
+    uint32_t firstCategory = 0;   // First entry in the app -> category links
+    uint16_t categoryCount = 0;
+    bool hasIcon = false;         // Icon blob present - decoded by icon_cache
+};
+
+// Contiguous run of indices (app indices or category indices)
+struct IndexRange {
+    const uint32_t* first = nullptr;
+    const uint32_t* last = nullptr;
+
+    const uint32_t* begin() const { return first; }
+    const uint32_t* end() const { return last; }
+    size_t size() const { return (size_t)(last - first); }
+    bool empty() const { return first == last; }
+};
+
+class Catalog {
+public:
+    // Load all named apps (ordered by name), their categories and installed state
+    bool Load(sqlite3* db);
+
+    // Same as Load, with apps, category links and installed ids each read on its
+    // own read-only connection to dbPath at the same time. changeSeq is the
+    // change log position the result reflects. Returns false if the database
+    // could not be read, or kept changing between the connections' snapshots.
+    bool LoadConcurrent(const std::string& dbPath, int64_t& changeSeq);
+    void Clear();
+
+    // Re-read installed_apps (after winget installs/uninstalls)
+    void LoadInstalled(sqlite3* db);
+
+    // Re-read the given apps (catalog_changes.h) and patch their version,
+    // publisher, homepage and icon flag in place; indices stay valid. Returns
+    // false without changing anything if an app was added, removed or renamed
+    // (its place in name order moves), which needs a full Load.
+    bool UpdateApps(sqlite3* db, const std::vector<int>& appIds);
+
+    // Re-read the installed state of the given packages. Appends the indices of
+    // apps whose state changed to changed.
+    void UpdateInstalled(sqlite3* db, const std::vector<std::string>& packageIds, std::vector<uint32_t>& changed);
+
+    // Apps - indices are stable until the next Load and follow name order
+    size_t AppCount() const { return apps_.size(); }
+    const CatalogApp& App(size_t index) const { return apps_[index]; }
+    int FindApp(int appId) const;
+
+    std::string_view Text(ArenaString s) const { return std::string_view(arena_.data() + s.offset, s.length); }
+    std::string_view Publisher(const CatalogApp& app) const { return Text(publishers_[app.publisher]); }
+    IndexRange AppCategories(const CatalogApp& app) const;
+    bool IsInstalled(size_t index) const { return (installed_[index >> 3] >> (index & 7)) & 1; }
+    size_t InstalledCount() const;
+
+    // Categories - sorted by display name (trimmed, first letter capitalised)
+    size_t CategoryCount() const { return categoryNames_.size(); }
+    std::string_view CategoryName(uint32_t category) const { return Text(categoryNames_[category]); }
+    int FindCategory(std::string_view name) const;
+    IndexRange CategoryApps(uint32_t category) const;
+
+    // Approximate resident size in bytes
+    size_t MemoryUsage() const;
+
+private:
+    friend bool WriteCatalogSnapshot(const Catalog& catalog, const std::string& path, const CatalogFingerprint& fingerprint);
+    friend bool ReadCatalogSnapshot(Catalog& catalog, const std::string& path, const CatalogFingerprint& fingerprint);
+
+    struct CategoryLinkRows;
+
+    ArenaString Store(std::string_view text);
+    bool ReadApps(sqlite3* db);
+    void BuildCategories(const CategoryLinkRows& rows);
+    void SetInstalled(const std::vector<std::string>& packageIds);
+
+    std::string arena_;
+    std::vector<CatalogApp> apps_;
+    std::vector<int32_t> indexById_;          // App id -> app index (-1 if not loaded)
+    std::vector<ArenaString> publishers_;     // Index 0 is the empty publisher
+    std::vector<ArenaString> categoryNames_;
+    std::vector<uint32_t> appCategoryLinks_;  // Category indices, grouped per app
+    std::vector<uint32_t> categoryAppStart_;  // CategoryCount() + 1 offsets into categoryAppLinks_
+    std::vector<uint32_t> categoryAppLinks_;  // App indices, grouped per category
+    std::vector<uint8_t> installed_;          // One bit per app index
+};
+
+// Trim whitespace and capitalise the first letter (ASCII and Latin-1 letters)
+std::string NormalizeCategoryName(std::string_view name);
+
+#endif // CATALOG_H
@@ -0,0 +1,117 @@
+#include "catalog_changes.h"
+#include "db_meta.h"
+#include <sqlite3.h>
+#include <algorithm>
+
+// Last seq when the previous updater run started (everything up to it is pruned
+// when the next run starts)
+static const char* CHANGE_LOG_RUN_START_KEY = "change_log_run_start";
+
+// Only the columns the GUI shows count as an app change; the updater rewrites
+// the rest (processed_at, tags_updated, descriptions) on every refresh.
+static const char* CHANGE_LOG_SQL =
+    "CREATE TABLE IF NOT EXISTS catalog_changes ("
+    "seq INTEGER PRIMARY KEY AUTOINCREMENT, "
+    "kind INTEGER NOT NULL, "
+    "app_id INTEGER, "
+    "package_id TEXT"
+    ");"
+    "CREATE TRIGGER IF NOT EXISTS catalog_changes_app_added AFTER INSERT ON apps "
+    "BEGIN INSERT INTO catalog_changes (kind, app_id) VALUES (1, NEW.id); END;"
+    "CREATE TRIGGER IF NOT EXISTS catalog_changes_app_removed AFTER DELETE ON apps "
+    "BEGIN INSERT INTO catalog_changes (kind, app_id) VALUES (1, OLD.id); END;"
+    "CREATE TRIGGER IF NOT EXISTS catalog_changes_app_updated "
+    "AFTER UPDATE OF package_id, name, version, publisher, homepage, icon_hash, icon_data ON apps "
+    "WHEN OLD.package_id IS NOT NEW.package_id OR OLD.name IS NOT NEW.name OR "
+    "     OLD.version IS NOT NEW.version OR OLD.publisher IS NOT NEW.publisher OR "
+    "     OLD.homepage IS NOT NEW.homepage OR OLD.icon_hash IS NOT NEW.icon_hash OR "
+    "     OLD.icon_data IS NOT NEW.icon_data "
+    "BEGIN INSERT INTO catalog_changes (kind, app_id) VALUES (1, NEW.id); END;"
+    "CREATE TRIGGER IF NOT EXISTS catalog_changes_link_added AFTER INSERT ON app_categories "
+    "BEGIN INSERT INTO catalog_changes (kind, app_id) VALUES (2, NEW.app_id); END;"
+    "CREATE TRIGGER IF NOT EXISTS catalog_changes_link_removed AFTER DELETE ON app_categories "
+    "BEGIN INSERT INTO catalog_changes (kind, app_id) VALUES (2, OLD.app_id); END;"
+    "CREATE TRIGGER IF NOT EXISTS catalog_changes_installed_added AFTER INSERT ON installed_apps "
+    "BEGIN INSERT INTO catalog_changes (kind, package_id) VALUES (3, NEW.package_id); END;"
+    "CREATE TRIGGER IF NOT EXISTS catalog_changes_installed_removed AFTER DELETE ON installed_apps "
+    "BEGIN INSERT INTO catalog_changes (kind, package_id) VALUES (3, OLD.package_id); END;";
+
+bool CreateCatalogChangeLog(sqlite3* db) {
+    return sqlite3_exec(db, CHANGE_LOG_SQL, nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+int64_t GetLastChangeSeq(sqlite3* db) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT seq FROM sqlite_sequence WHERE name = 'catalog_changes';",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        return 0;
+    }
+    int64_t seq = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+    return seq;
+}
+
+template <typename T>
+static void SortUnique(std::vector<T>& values) {
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+}
+
+bool ReadCatalogChanges(sqlite3* db, int64_t afterSeq, CatalogChanges& changes) {
+    changes = CatalogChanges();
+    changes.lastSeq = afterSeq;
+
+    // The oldest change still logged; pruned changes cannot be replayed
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT MIN(seq) FROM catalog_changes;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    int64_t firstSeq = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL
+                           ? sqlite3_column_int64(stmt, 0)
+                           : GetLastChangeSeq(db) + 1;
+    sqlite3_finalize(stmt);
+    changes.complete = afterSeq + 1 >= firstSeq;
+
+    if (sqlite3_prepare_v2(db, "SELECT seq, kind, app_id, package_id FROM catalog_changes WHERE seq > ? ORDER BY seq;",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_int64(stmt, 1, afterSeq);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        changes.lastSeq = sqlite3_column_int64(stmt, 0);
+        switch (sqlite3_column_int(stmt, 1)) {
+            case CATALOG_CHANGE_APP:
+                changes.appIds.push_back(sqlite3_column_int(stmt, 2));
+                break;
+            case CATALOG_CHANGE_LINK:
+                changes.linkAppIds.push_back(sqlite3_column_int(stmt, 2));
+                break;
+            case CATALOG_CHANGE_INSTALLED: {
+                const char* packageId = (const char*)sqlite3_column_text(stmt, 3);
+                if (packageId) changes.installedIds.emplace_back(packageId, (size_t)sqlite3_column_bytes(stmt, 3));
+                break;
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    SortUnique(changes.appIds);
+    SortUnique(changes.linkAppIds);
+    SortUnique(changes.installedIds);
+    return true;
+}
+
+bool PruneCatalogChanges(sqlite3* db) {
+    int64_t previousRunStart = 0;
+    GetCatalogMeta(db, CHANGE_LOG_RUN_START_KEY, previousRunStart);
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "DELETE FROM catalog_changes WHERE seq <= ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_int64(stmt, 1, previousRunStart);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+
+    return ok && SetCatalogMeta(db, CHANGE_LOG_RUN_START_KEY, GetLastChangeSeq(db));
+}
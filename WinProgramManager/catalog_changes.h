@@ -0,0 +1,47 @@
+#ifndef CATALOG_CHANGES_H
+#define CATALOG_CHANGES_H
+
+// Change log of the rows the GUI keeps in memory. Triggers on apps,
+// app_categories and installed_apps append one catalog_changes row per changed
+// row, whichever program writes it, so a running GUI can apply what an updater
+// run changed without reloading the catalog. The log is numbered by seq; a
+// reader remembers the last seq it applied and asks for everything after it.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+enum CatalogChangeKind {
+    CATALOG_CHANGE_APP = 1,         // apps row inserted, deleted or displayed fields updated (app_id)
+    CATALOG_CHANGE_LINK = 2,        // app_categories row inserted or deleted (app_id)
+    CATALOG_CHANGE_INSTALLED = 3    // installed_apps row inserted or deleted (package_id)
+};
+
+// Create the catalog_changes table and its triggers (schema migration 6)
+bool CreateCatalogChangeLog(sqlite3* db);
+
+// Seq of the newest change (0 if nothing was ever logged)
+int64_t GetLastChangeSeq(sqlite3* db);
+
+struct CatalogChanges {
+    std::vector<int> appIds;                 // Sorted, distinct
+    std::vector<int> linkAppIds;             // Sorted, distinct
+    std::vector<std::string> installedIds;   // Sorted, distinct package ids
+    int64_t lastSeq = 0;
+    bool complete = true;                    // False if changes after the given seq were pruned
+
+    bool Empty() const { return appIds.empty() && linkAppIds.empty() && installedIds.empty(); }
+};
+
+// Changes logged after afterSeq. Returns false if the log could not be read
+// (databases older than schema version 6).
+bool ReadCatalogChanges(sqlite3* db, int64_t afterSeq, CatalogChanges& changes);
+
+// Drop the changes of the runs before the previous one. Called at the start of
+// an updater run, so a GUI that missed at most one run can still catch up.
+bool PruneCatalogChanges(sqlite3* db);
+
+#endif // CATALOG_CHANGES_H
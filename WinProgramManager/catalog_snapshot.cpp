@@ -0,0 +1,257 @@
+#include "catalog_snapshot.h"
+#include "catalog.h"
+#include "catalog_changes.h"
+#include "db_meta.h"
+#include "mapped_file.h"
+#include <sqlite3.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+static const char CATALOG_SNAPSHOT_MAGIC[4] = {'W', 'P', 'C', 'S'};
+
+enum SnapshotSectionId {
+    SECTION_ARENA,
+    SECTION_APPS,
+    SECTION_INDEX_BY_ID,
+    SECTION_PUBLISHERS,
+    SECTION_CATEGORY_NAMES,
+    SECTION_APP_CATEGORY_LINKS,
+    SECTION_CATEGORY_APP_START,
+    SECTION_CATEGORY_APP_LINKS,
+    SECTION_INSTALLED,
+    SECTION_COUNT
+};
+
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t count;  // Number of elements, not bytes
+};
+
+struct CatalogSnapshotHeader {
+    char magic[4];                // "WPCS"
+    uint32_t formatVersion;
+    uint32_t appRecordSize;       // sizeof(CatalogApp) of the writer
+    uint32_t sectionCount;
+    CatalogFingerprint fingerprint;
+    uint64_t fileSize;
+    SnapshotSection sections[SECTION_COUNT];
+};
+
+static_assert(std::is_trivially_copyable<CatalogApp>::value, "CatalogApp must be trivially copyable");
+static_assert(std::is_trivially_copyable<CatalogFingerprint>::value, "CatalogFingerprint must be trivially copyable");
+
+bool CatalogFingerprint::operator==(const CatalogFingerprint& other) const {
+    return contentVersion == other.contentVersion &&
+           userVersion == other.userVersion &&
+           appCount == other.appCount &&
+           maxAppId == other.maxAppId &&
+           categoryCount == other.categoryCount &&
+           linkCount == other.linkCount &&
+           installedHash == other.installedHash &&
+           changeSeq == other.changeSeq;
+}
+
+static bool QueryInt64(sqlite3* db, const char* sql, int64_t& first, int64_t* second = nullptr) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    bool ok = sqlite3_step(stmt) == SQLITE_ROW;
+    if (ok) {
+        first = sqlite3_column_int64(stmt, 0);
+        if (second) *second = sqlite3_column_int64(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+bool ReadCatalogFingerprint(sqlite3* db, CatalogFingerprint& fingerprint) {
+    fingerprint = CatalogFingerprint();
+    if (!db) return false;
+
+    fingerprint.contentVersion = GetContentVersion(db);
+    if (!QueryInt64(db, "PRAGMA user_version;", fingerprint.userVersion)) return false;
+    if (!QueryInt64(db, "SELECT COUNT(*), IFNULL(MAX(id), 0) FROM apps;", fingerprint.appCount, &fingerprint.maxAppId)) {
+        return false;
+    }
+    if (!QueryInt64(db, "SELECT COUNT(*) FROM categories;", fingerprint.categoryCount)) return false;
+    if (!QueryInt64(db, "SELECT COUNT(*) FROM app_categories;", fingerprint.linkCount)) return false;
+
+    // installed_apps is small; hash its ids so installs/uninstalls invalidate the snapshot
+    uint64_t hash = 14695981039346656037ull;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT package_id FROM installed_apps ORDER BY package_id;", -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char* text = sqlite3_column_text(stmt, 0);
+            int length = sqlite3_column_bytes(stmt, 0);
+            for (int i = 0; i < length; i++) {
+                hash ^= text[i];
+                hash *= 1099511628211ull;
+            }
+            hash ^= 0xFF;  // Separator
+            hash *= 1099511628211ull;
+        }
+        sqlite3_finalize(stmt);
+    }
+    fingerprint.installedHash = hash;
+    fingerprint.changeSeq = GetLastChangeSeq(db);
+    return true;
+}
+
+static uint64_t AlignTo16(uint64_t value) {
+    return (value + 15) & ~(uint64_t)15;
+}
+
+bool WriteCatalogSnapshot(const Catalog& catalog, const std::string& path, const CatalogFingerprint& fingerprint) {
+    struct Blob {
+        const void* data;
+        uint64_t count;
+        size_t elementSize;
+    };
+    const Blob blobs[SECTION_COUNT] = {
+        {catalog.arena_.data(), catalog.arena_.size(), 1},
+        {catalog.apps_.data(), catalog.apps_.size(), sizeof(CatalogApp)},
+        {catalog.indexById_.data(), catalog.indexById_.size(), sizeof(int32_t)},
+        {catalog.publishers_.data(), catalog.publishers_.size(), sizeof(ArenaString)},
+        {catalog.categoryNames_.data(), catalog.categoryNames_.size(), sizeof(ArenaString)},
+        {catalog.appCategoryLinks_.data(), catalog.appCategoryLinks_.size(), sizeof(uint32_t)},
+        {catalog.categoryAppStart_.data(), catalog.categoryAppStart_.size(), sizeof(uint32_t)},
+        {catalog.categoryAppLinks_.data(), catalog.categoryAppLinks_.size(), sizeof(uint32_t)},
+        {catalog.installed_.data(), catalog.installed_.size(), 1},
+    };
+
+    CatalogSnapshotHeader header = {};
+    std::memcpy(header.magic, CATALOG_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.formatVersion = CATALOG_SNAPSHOT_FORMAT_VERSION;
+    header.appRecordSize = sizeof(CatalogApp);
+    header.sectionCount = SECTION_COUNT;
+    header.fingerprint = fingerprint;
+
+    uint64_t offset = AlignTo16(sizeof(CatalogSnapshotHeader));
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        header.sections[i].offset = offset;
+        header.sections[i].count = blobs[i].count;
+        offset = AlignTo16(offset + blobs[i].count * blobs[i].elementSize);
+    }
+    header.fileSize = offset;
+
+    std::filesystem::path finalPath = std::filesystem::u8path(path);
+    std::filesystem::path tempPath = finalPath;
+    tempPath += ".tmp";
+
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+
+        static const char padding[16] = {0};
+        out.write((const char*)&header, sizeof(header));
+        for (int i = 0; i < SECTION_COUNT; i++) {
+            uint64_t pos = (uint64_t)out.tellp();
+            if (header.sections[i].offset > pos) {
+                out.write(padding, (std::streamsize)(header.sections[i].offset - pos));
+            }
+            if (blobs[i].count) {
+                out.write((const char*)blobs[i].data, (std::streamsize)(blobs[i].count * blobs[i].elementSize));
+            }
+        }
+        uint64_t pos = (uint64_t)out.tellp();
+        if (header.fileSize > pos) out.write(padding, (std::streamsize)(header.fileSize - pos));
+
+        if (!out) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, finalPath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+// Copy one section into a vector after checking it lies inside the file
+template <typename T>
+static bool ReadSection(const MappedFile& file, const SnapshotSection& section, std::vector<T>& out) {
+    uint64_t bytes = section.count * sizeof(T);
+    if (section.count > file.Size() || section.offset > file.Size() || bytes > file.Size() - section.offset) {
+        return false;
+    }
+    const T* first = (const T*)(file.Data() + section.offset);
+    out.assign(first, first + section.count);
+    return true;
+}
+
+static bool ReadSection(const MappedFile& file, const SnapshotSection& section, std::string& out) {
+    if (section.offset > file.Size() || section.count > file.Size() - section.offset) return false;
+    out.assign((const char*)file.Data() + section.offset, (size_t)section.count);
+    return true;
+}
+
+bool ReadCatalogSnapshot(Catalog& catalog, const std::string& path, const CatalogFingerprint& fingerprint) {
+    MappedFile file;
+    if (!file.Open(path) || file.Size() < sizeof(CatalogSnapshotHeader)) return false;
+
+    CatalogSnapshotHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.magic, CATALOG_SNAPSHOT_MAGIC, 4) != 0 ||
+        header.formatVersion != CATALOG_SNAPSHOT_FORMAT_VERSION ||
+        header.appRecordSize != sizeof(CatalogApp) ||
+        header.sectionCount != SECTION_COUNT ||
+        header.fileSize != file.Size() ||
+        header.fingerprint != fingerprint) {
+        return false;
+    }
+
+    Catalog loaded;
+    const SnapshotSection* s = header.sections;
+    if (!ReadSection(file, s[SECTION_ARENA], loaded.arena_) ||
+        !ReadSection(file, s[SECTION_APPS], loaded.apps_) ||
+        !ReadSection(file, s[SECTION_INDEX_BY_ID], loaded.indexById_) ||
+        !ReadSection(file, s[SECTION_PUBLISHERS], loaded.publishers_) ||
+        !ReadSection(file, s[SECTION_CATEGORY_NAMES], loaded.categoryNames_) ||
+        !ReadSection(file, s[SECTION_APP_CATEGORY_LINKS], loaded.appCategoryLinks_) ||
+        !ReadSection(file, s[SECTION_CATEGORY_APP_START], loaded.categoryAppStart_) ||
+        !ReadSection(file, s[SECTION_CATEGORY_APP_LINKS], loaded.categoryAppLinks_) ||
+        !ReadSection(file, s[SECTION_INSTALLED], loaded.installed_)) {
+        return false;
+    }
+
+    // Structural checks so a damaged file can never index out of bounds
+    size_t appCount = loaded.apps_.size();
+    size_t categoryCount = loaded.categoryNames_.size();
+    auto validString = [&loaded](const ArenaString& str) {
+        return str.offset <= loaded.arena_.size() && str.length <= loaded.arena_.size() - str.offset;
+    };
+
+    if (loaded.publishers_.empty() ||
+        loaded.categoryAppStart_.size() != categoryCount + 1 ||
+        loaded.categoryAppStart_.back() != loaded.categoryAppLinks_.size() ||
+        loaded.installed_.size() != (appCount + 7) / 8) {
+        return false;
+    }
+    for (size_t i = 1; i < loaded.categoryAppStart_.size(); i++) {
+        if (loaded.categoryAppStart_[i] < loaded.categoryAppStart_[i - 1]) return false;
+    }
+    for (const auto& str : loaded.publishers_) if (!validString(str)) return false;
+    for (const auto& str : loaded.categoryNames_) if (!validString(str)) return false;
+    for (const auto& app : loaded.apps_) {
+        if (!validString(app.packageId) || !validString(app.name) || !validString(app.version) ||
+            !validString(app.homepage) || app.publisher >= loaded.publishers_.size() ||
+            (uint64_t)app.firstCategory + app.categoryCount > loaded.appCategoryLinks_.size()) {
+            return false;
+        }
+    }
+    for (uint32_t category : loaded.appCategoryLinks_) if (category >= categoryCount) return false;
+    for (uint32_t appIndex : loaded.categoryAppLinks_) if (appIndex >= appCount) return false;
+    for (int32_t appIndex : loaded.indexById_) if (appIndex >= (int32_t)appCount) return false;
+
+    catalog = std::move(loaded);
+    return true;
+}
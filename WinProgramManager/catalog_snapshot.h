@@ -0,0 +1,49 @@
+#ifndef CATALOG_SNAPSHOT_H
+#define CATALOG_SNAPSHOT_H
+
+// Binary snapshot of a loaded Catalog, memory-mapped on warm starts so the GUI
+// can skip the SQLite queries and string processing of Catalog::Load.
+//
+// File layout (little-endian):
+//   CatalogSnapshotHeader
+//   one section per Catalog array, 16-byte aligned, described by the header
+//
+// A snapshot is only used when its fingerprint matches the database.
+
+#include <cstdint>
+#include <string>
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+class Catalog;
+
+#define CATALOG_SNAPSHOT_FILENAME "WinProgramManager.catalog"
+#define CATALOG_SNAPSHOT_FORMAT_VERSION 2
+
+// Cheap summary of the database state. Every field comes from an index,
+// the rowid or a small table, so reading it costs a few milliseconds.
+struct CatalogFingerprint {
+    uint64_t contentVersion = 0;   // catalog_meta content_version (bumped by the updater)
+    int64_t userVersion = 0;       // PRAGMA user_version (schema version)
+    int64_t appCount = 0;
+    int64_t maxAppId = 0;
+    int64_t categoryCount = 0;
+    int64_t linkCount = 0;         // app_categories rows
+    uint64_t installedHash = 0;    // Hash of the sorted installed package ids
+    int64_t changeSeq = 0;         // Newest catalog_changes seq (in-place edits of shown fields)
+
+    bool operator==(const CatalogFingerprint& other) const;
+    bool operator!=(const CatalogFingerprint& other) const { return !(*this == other); }
+};
+
+bool ReadCatalogFingerprint(sqlite3* db, CatalogFingerprint& fingerprint);
+
+// Write the catalog to path (UTF-8) via a temporary file that is moved into place
+bool WriteCatalogSnapshot(const Catalog& catalog, const std::string& path, const CatalogFingerprint& fingerprint);
+
+// Replace catalog with the snapshot at path. Returns false (catalog untouched)
+// if the file is missing, malformed or was written for another fingerprint.
+bool ReadCatalogSnapshot(Catalog& catalog, const std::string& path, const CatalogFingerprint& fingerprint);
+
+#endif // CATALOG_SNAPSHOT_H
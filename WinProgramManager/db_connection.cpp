@@ -0,0 +1,52 @@
+#include "db_connection.h"
+#include "db_schema.h"
+#include <sqlite3.h>
+#include <chrono>
+#include <thread>
+
+// Retry delays: doubling from 1 ms, then BUSY_MAX_DELAY_MS per retry until the
+// total reaches CATALOG_BUSY_TIMEOUT_MS
+static const int BUSY_BACKOFF_STEPS = 7;      // 1, 2, 4 ... 64 ms
+static const int BUSY_MAX_DELAY_MS = 100;
+
+static int CatalogBusyHandler(void*, int retries) {
+    int delay, waited;
+    if (retries < BUSY_BACKOFF_STEPS) {
+        delay = 1 << retries;
+        waited = delay - 1;
+    } else {
+        delay = BUSY_MAX_DELAY_MS;
+        waited = (1 << BUSY_BACKOFF_STEPS) - 1 + (retries - BUSY_BACKOFF_STEPS) * BUSY_MAX_DELAY_MS;
+    }
+    if (waited >= CATALOG_BUSY_TIMEOUT_MS) return 0;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+    return 1;
+}
+
+int OpenCatalogDatabase(const std::string& path, sqlite3** db, int flags) {
+    int rc = sqlite3_open_v2(path.c_str(), db, flags, nullptr);
+    if (rc != SQLITE_OK) return rc;
+
+    sqlite3_busy_handler(*db, CatalogBusyHandler, nullptr);
+    ConfigureCatalogConnection(*db);
+    return SQLITE_OK;
+}
+
+CatalogReadSnapshot::CatalogReadSnapshot(sqlite3* db) : db_(db) {
+    if (!db_ || !sqlite3_get_autocommit(db_)) return;
+
+    // A deferred transaction takes its snapshot at the first read, so read now
+    active_ = sqlite3_exec(db_, "BEGIN; SELECT 1 FROM sqlite_master LIMIT 1;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    if (!active_ && !sqlite3_get_autocommit(db_)) {
+        sqlite3_exec(db_, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+}
+
+CatalogReadSnapshot::~CatalogReadSnapshot() {
+    if (active_) sqlite3_exec(db_, "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+bool CheckpointCatalog(sqlite3* db) {
+    return db && sqlite3_wal_checkpoint_v2(db, nullptr, SQLITE_CHECKPOINT_TRUNCATE, nullptr, nullptr) == SQLITE_OK;
+}
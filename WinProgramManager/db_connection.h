@@ -0,0 +1,45 @@
+#ifndef DB_CONNECTION_H
+#define DB_CONNECTION_H
+
+// Connections to WinProgramManager.db. The GUI keeps its connection open while
+// the scheduled updater writes to the same file, so every program opens it the
+// same way: WAL (readers and the writer do not block each other) and a busy
+// handler that retries a locked database with a bounded backoff instead of
+// failing with SQLITE_BUSY at once.
+
+#include <string>
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+// Longest a statement waits for a lock before it fails with SQLITE_BUSY
+#define CATALOG_BUSY_TIMEOUT_MS 10000
+
+// Open the catalog like sqlite3_open_v2 (same flags and result), then configure
+// it (ConfigureCatalogConnection) and install the busy handler. On failure *db
+// may still be set for sqlite3_errmsg and must be closed.
+int OpenCatalogDatabase(const std::string& path, sqlite3** db, int flags);
+
+// Read transaction for a bulk load: every query while it is alive sees the
+// database as it was when it was created, whatever the updater commits
+// meanwhile. Does nothing inside an already open transaction.
+class CatalogReadSnapshot {
+public:
+    explicit CatalogReadSnapshot(sqlite3* db);
+    ~CatalogReadSnapshot();
+    CatalogReadSnapshot(const CatalogReadSnapshot&) = delete;
+    CatalogReadSnapshot& operator=(const CatalogReadSnapshot&) = delete;
+
+    bool Active() const { return active_; }
+
+private:
+    sqlite3* db_;
+    bool active_ = false;
+};
+
+// Copy the WAL into the database file and truncate it (end of an updater run).
+// Returns false if a reader kept part of it from being copied; that part is
+// copied by the next checkpoint.
+bool CheckpointCatalog(sqlite3* db);
+
+#endif // DB_CONNECTION_H
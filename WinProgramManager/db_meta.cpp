@@ -0,0 +1,55 @@
+#include "db_meta.h"
+#include <sqlite3.h>
+
+static const char* CONTENT_VERSION_KEY = "content_version";
+
+bool EnsureCatalogMeta(sqlite3* db) {
+    const char* sql =
+        "CREATE TABLE IF NOT EXISTS catalog_meta ("
+        "key TEXT PRIMARY KEY, "
+        "value INTEGER NOT NULL"
+        ");";
+    return sqlite3_exec(db, sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+bool GetCatalogMeta(sqlite3* db, const char* key, int64_t& value) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT value FROM catalog_meta WHERE key = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+
+    bool found = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        value = sqlite3_column_int64(stmt, 0);
+        found = true;
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+bool SetCatalogMeta(sqlite3* db, const char* key, int64_t value) {
+    if (!EnsureCatalogMeta(db)) return false;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO catalog_meta (key, value) VALUES (?, ?);",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, value);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+uint64_t GetContentVersion(sqlite3* db) {
+    int64_t value = 0;
+    if (!GetCatalogMeta(db, CONTENT_VERSION_KEY, value) || value < 0) return 0;
+    return (uint64_t)value;
+}
+
+uint64_t BumpContentVersion(sqlite3* db) {
+    uint64_t version = GetContentVersion(db) + 1;
+    return SetCatalogMeta(db, CONTENT_VERSION_KEY, (int64_t)version) ? version : 0;
+}
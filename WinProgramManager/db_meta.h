@@ -0,0 +1,24 @@
+#ifndef DB_META_H
+#define DB_META_H
+
+// Catalog metadata (catalog_meta key/value table) shared by the updater and the GUI
+
+#include <cstdint>
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+// Create the catalog_meta table if it does not exist
+bool EnsureCatalogMeta(sqlite3* db);
+
+// Read/write an integer value. GetCatalogMeta returns false if the key (or table) is missing.
+bool GetCatalogMeta(sqlite3* db, const char* key, int64_t& value);
+bool SetCatalogMeta(sqlite3* db, const char* key, int64_t value);
+
+// Content version of the catalog. Bumped at the end of every updater run so that
+// derived files (icon atlas, snapshots) can tell whether they are stale.
+// Returns 0 for databases that have never been stamped.
+uint64_t GetContentVersion(sqlite3* db);
+uint64_t BumpContentVersion(sqlite3* db);
+
+#endif // DB_META_H
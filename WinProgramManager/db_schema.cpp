@@ -0,0 +1,243 @@
+#include "db_schema.h"
+#include "catalog_changes.h"
+#include "db_meta.h"
+#include "icon_store.h"
+#include <sqlite3.h>
+#include <cstring>
+
+static bool HasColumn(sqlite3* db, const char* table, const char* column) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM pragma_table_info(?) WHERE name = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, column, -1, SQLITE_STATIC);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+static bool Exec(sqlite3* db, const char* sql) {
+    return sqlite3_exec(db, sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Migrations
+// ---------------------------------------------------------------------------
+
+// 1: the tables of build_everything.ps1 and sync_installed_apps.ps1, for databases
+// that do not have them yet
+static bool MigrateBaseTables(sqlite3* db) {
+    const char* sql =
+        "CREATE TABLE IF NOT EXISTS apps ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+        "package_id TEXT UNIQUE NOT NULL, "
+        "name TEXT, version TEXT, publisher TEXT, description TEXT, homepage TEXT, "
+        "publisher_url TEXT, publisher_support_url TEXT, author TEXT, license TEXT, "
+        "license_url TEXT, privacy_url TEXT, copyright TEXT, copyright_url TEXT, "
+        "release_notes_url TEXT, moniker TEXT, release_date TEXT, icon_data BLOB, icon_type TEXT, "
+        "processed_at DATETIME DEFAULT CURRENT_TIMESTAMP);"
+        "CREATE TABLE IF NOT EXISTS categories ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT, category_name TEXT UNIQUE NOT NULL);"
+        "CREATE TABLE IF NOT EXISTS app_categories ("
+        "app_id INTEGER, category_id INTEGER, PRIMARY KEY (app_id, category_id));"
+        "CREATE TABLE IF NOT EXISTS installed_apps ("
+        "package_id TEXT PRIMARY KEY, installed_date TEXT, last_seen TEXT, "
+        "installed_version TEXT, source TEXT, "
+        "FOREIGN KEY (package_id) REFERENCES apps(package_id));"
+        "CREATE INDEX IF NOT EXISTS idx_package_id ON apps(package_id);"
+        "CREATE INDEX IF NOT EXISTS idx_installed_last_seen ON installed_apps(last_seen);";
+    return Exec(db, sql) && EnsureCatalogMeta(db);
+}
+
+// 2: indexes for the per-package and per-tag queries, and the updater's
+// tags_updated flag. Package ids and tag names are looked up with COLLATE NOCASE,
+// which the BINARY UNIQUE indexes cannot serve.
+static bool MigrateHotQueryIndexes(sqlite3* db) {
+    if (!HasColumn(db, "apps", "tags_updated") &&
+        !Exec(db, "ALTER TABLE apps ADD COLUMN tags_updated INTEGER NOT NULL DEFAULT 0;")) {
+        return false;
+    }
+    const char* sql =
+        "CREATE INDEX IF NOT EXISTS idx_apps_package_id_nocase ON apps(package_id COLLATE NOCASE);"
+        "CREATE INDEX IF NOT EXISTS idx_apps_tags_updated ON apps(tags_updated);"
+        "CREATE INDEX IF NOT EXISTS idx_categories_name_nocase ON categories(category_name COLLATE NOCASE);"
+        "CREATE INDEX IF NOT EXISTS idx_app_categories_category ON app_categories(category_id, app_id);"
+        "CREATE INDEX IF NOT EXISTS idx_installed_package_id_nocase ON installed_apps(package_id COLLATE NOCASE);";
+    return Exec(db, sql);
+}
+
+// 3: icon blobs move out of apps into the content-addressed icons table
+// (icon_store.h); apps keeps a reference
+static bool MigrateIconStore(sqlite3* db) {
+    if (!HasColumn(db, "apps", "icon_hash") && !Exec(db, "ALTER TABLE apps ADD COLUMN icon_hash BLOB;")) {
+        return false;
+    }
+    const char* sql =
+        "CREATE TABLE IF NOT EXISTS icons ("
+        "hash BLOB PRIMARY KEY, type TEXT, width INTEGER, height INTEGER, data BLOB NOT NULL);"
+        "CREATE INDEX IF NOT EXISTS idx_apps_icon_hash ON apps(icon_hash);";
+    return Exec(db, sql) && MoveInlineIcons(db) >= 0;
+}
+
+// 4: stored icons are re-encoded as normalized 16/32 px PNG frames (icon_image.h)
+// and anything that is not an image is dropped
+static bool MigrateNormalizedIcons(sqlite3* db) {
+    return NormalizeStoredIcons(db) >= 0;
+}
+
+// 5: where each homepage's icon came from, with its HTTP validators, and hosts
+// that did not answer (icon_fetch.h)
+static bool MigrateIconSources(sqlite3* db) {
+    const char* sql =
+        "CREATE TABLE IF NOT EXISTS icon_sources ("
+        "homepage TEXT PRIMARY KEY, icon_url TEXT, etag TEXT, last_modified TEXT, icon_hash BLOB, "
+        "checked INTEGER NOT NULL DEFAULT 0);"
+        "CREATE TABLE IF NOT EXISTS icon_host_failures (host TEXT PRIMARY KEY, failed INTEGER NOT NULL);"
+        "CREATE INDEX IF NOT EXISTS idx_apps_homepage ON apps(homepage);";
+    return Exec(db, sql);
+}
+
+// 6: change log of the rows the GUI keeps in memory (catalog_changes.h)
+static bool MigrateChangeLog(sqlite3* db) {
+    return CreateCatalogChangeLog(db);
+}
+
+struct SchemaMigration {
+    int version;
+    bool (*apply)(sqlite3* db);
+    bool compact;               // VACUUM afterwards (the migration freed many pages)
+};
+
+static const SchemaMigration MIGRATIONS[] = {
+    {1, MigrateBaseTables, false},
+    {2, MigrateHotQueryIndexes, false},
+    {3, MigrateIconStore, true},
+    {4, MigrateNormalizedIcons, true},
+    {5, MigrateIconSources, false},
+    {6, MigrateChangeLog, false},
+};
+
+static_assert(sizeof(MIGRATIONS) / sizeof(MIGRATIONS[0]) == CATALOG_SCHEMA_VERSION,
+              "one migration per schema version");
+
+void ConfigureCatalogConnection(sqlite3* db) {
+    // WAL lets the GUI read while the updater writes; NORMAL sync is safe with WAL.
+    // journal_mode fails harmlessly on read-only connections.
+    Exec(db, "PRAGMA journal_mode = WAL;"
+             "PRAGMA synchronous = NORMAL;"
+             "PRAGMA mmap_size = 268435456;"
+             "PRAGMA cache_size = -32768;"
+             "PRAGMA temp_store = MEMORY;");
+}
+
+int GetCatalogSchemaVersion(sqlite3* db) {
+    sqlite3_stmt* stmt;
+    int version = -1;
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) version = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return version;
+}
+
+bool MigrateCatalogSchema(sqlite3* db) {
+    int version = GetCatalogSchemaVersion(db);
+    if (version < 0) return false;
+
+    bool compact = false;
+    for (const SchemaMigration& migration : MIGRATIONS) {
+        if (migration.version <= version) continue;
+
+        if (!Exec(db, "BEGIN IMMEDIATE;")) return false;
+        std::string setVersion = "PRAGMA user_version = " + std::to_string(migration.version) + ";";
+        if (!migration.apply(db) || !Exec(db, setVersion.c_str()) || !Exec(db, "COMMIT;")) {
+            Exec(db, "ROLLBACK;");
+            return false;
+        }
+        version = migration.version;
+        compact = compact || migration.compact;
+    }
+
+    // Outside any transaction; a reader elsewhere makes it fail, which only costs space
+    if (compact) Exec(db, "VACUUM;");
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Query plan checks
+// ---------------------------------------------------------------------------
+
+struct HotQuery {
+    const char* name;
+    const char* sql;
+    const char* drivingTable;   // Table (as named in the plan) the query is meant to walk
+};
+
+// Same text as the statements in the updater, importer and GUI
+static const HotQuery HOT_QUERIES[] = {
+    {"package by id", "SELECT id FROM apps WHERE package_id = ? COLLATE NOCASE;", nullptr},
+    {"mark package checked", "UPDATE apps SET tags_updated = 1 WHERE package_id = ?;", nullptr},
+    {"category by name", "SELECT id FROM categories WHERE category_name = ? COLLATE NOCASE;", nullptr},
+    {"tags of package", "SELECT 1 FROM app_categories WHERE app_id = ? LIMIT 1;", nullptr},
+    {"packages with tag", "SELECT app_id FROM app_categories WHERE category_id = ?;", nullptr},
+    {"installed by id", "SELECT 1 FROM installed_apps WHERE package_id = ? COLLATE NOCASE;", nullptr},
+    {"packages by homepage", "UPDATE apps SET icon_hash = ? WHERE homepage = ?;", nullptr},
+    {"untagged packages not yet checked",
+     "SELECT package_id FROM apps a WHERE tags_updated = 0 "
+     "AND NOT EXISTS (SELECT 1 FROM app_categories ac WHERE ac.app_id = a.id);", nullptr},
+    {"packages without tags",
+     "SELECT a.id, a.package_id, a.name, a.moniker FROM apps a "
+     "WHERE NOT EXISTS (SELECT 1 FROM app_categories ac WHERE ac.app_id = a.id);", "a"},
+    {"tag uncategorized packages",
+     "INSERT INTO app_categories (app_id, category_id) "
+     "SELECT a.id, 0 FROM apps a "
+     "WHERE NOT EXISTS (SELECT 1 FROM app_categories ac WHERE ac.app_id = a.id);", "a"},
+    {"installed packages missing from the catalog",
+     "SELECT i.package_id FROM installed_apps i "
+     "WHERE NOT EXISTS (SELECT 1 FROM apps a WHERE a.package_id = i.package_id COLLATE NOCASE);", "i"},
+};
+
+// "SCAN apps", "SCAN TABLE apps USING ...", "SCAN a" -> the scanned name
+static std::string ScannedTable(const char* detail) {
+    if (std::strncmp(detail, "SCAN ", 5) != 0) return std::string();
+    const char* name = detail + 5;
+    if (std::strncmp(name, "TABLE ", 6) == 0) name += 6;
+    const char* end = std::strchr(name, ' ');
+    return end ? std::string(name, end) : std::string(name);
+}
+
+bool CheckHotQueryPlans(sqlite3* db, std::vector<QueryPlanCheck>& checks) {
+    checks.clear();
+    bool allIndexed = true;
+
+    for (const HotQuery& query : HOT_QUERIES) {
+        QueryPlanCheck check;
+        check.name = query.name;
+
+        std::string explain = std::string("EXPLAIN QUERY PLAN ") + query.sql;
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, explain.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+            check.usesIndex = true;
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                const char* detail = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+                if (!detail) continue;
+                check.plan += detail;
+                check.plan += '\n';
+
+                std::string scanned = ScannedTable(detail);
+                if (!scanned.empty() && scanned != "CONSTANT" &&
+                    !(query.drivingTable && scanned == query.drivingTable)) {
+                    check.usesIndex = false;
+                }
+            }
+            sqlite3_finalize(stmt);
+        } else {
+            check.plan = sqlite3_errmsg(db);
+        }
+
+        allIndexed = allIndexed && check.usesIndex;
+        checks.push_back(std::move(check));
+    }
+    return allIndexed;
+}
@@ -0,0 +1,39 @@
+#ifndef DB_SCHEMA_H
+#define DB_SCHEMA_H
+
+// Schema of WinProgramManager.db, versioned with PRAGMA user_version.
+// The PowerShell build scripts each created their own variant of the tables; the
+// migrations bring any of them (version 0) to the current schema. The updater, the
+// importer and the GUI run them when they open the database.
+
+#include <string>
+#include <vector>
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+#define CATALOG_SCHEMA_VERSION 6
+
+// WAL journal, memory-mapped reads and a larger page cache for this connection
+void ConfigureCatalogConnection(sqlite3* db);
+
+// Apply the migrations above the database's user_version, each in its own
+// transaction. A database from a newer build is left alone. Returns false if a
+// migration failed (the database stays at the last version that succeeded).
+bool MigrateCatalogSchema(sqlite3* db);
+
+int GetCatalogSchemaVersion(sqlite3* db);
+
+// EXPLAIN QUERY PLAN of one of the queries the updater and the GUI run per package
+// or per tag
+struct QueryPlanCheck {
+    const char* name;
+    std::string plan;        // Plan details, one step per line
+    bool usesIndex = false;  // No full scan except of the query's driving table
+};
+
+// Check every hot query against the current schema. Returns false if any of
+// them scans a table (or fails to prepare).
+bool CheckHotQueryPlans(sqlite3* db, std::vector<QueryPlanCheck>& checks);
+
+#endif // DB_SCHEMA_H
@@ -0,0 +1,35 @@
+#include "fetch_pipeline.h"
+
+double FetchProgress::ItemsPerMinute() const {
+    if (elapsedSeconds <= 0.0) return 0.0;
+    return completed * 60.0 / elapsedSeconds;
+}
+
+RateLimiter::RateLimiter(double perSecond, int burst)
+    : perSecond_(perSecond),
+      capacity_(burst > 0 ? burst : 1),
+      tokens_(burst > 0 ? burst : 1),
+      last_(std::chrono::steady_clock::now()) {
+}
+
+void RateLimiter::Acquire() {
+    if (perSecond_ <= 0.0) return;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        auto now = std::chrono::steady_clock::now();
+        tokens_ = std::min(capacity_, tokens_ + std::chrono::duration<double>(now - last_).count() * perSecond_);
+        last_ = now;
+
+        if (tokens_ >= 1.0) {
+            tokens_ -= 1.0;
+            return;
+        }
+
+        // Sleep until one token has accumulated; other workers may take it first
+        auto wait = std::chrono::duration<double>((1.0 - tokens_) / perSecond_);
+        lock.unlock();
+        std::this_thread::sleep_for(wait);
+        lock.lock();
+    }
+}
@@ -0,0 +1,219 @@
+#ifndef FETCH_PIPELINE_H
+#define FETCH_PIPELINE_H
+
+// Concurrent fetch -> single writer pipeline used by the updater.
+// Worker threads run a slow fetch (winget show, HTTP) for each id, paced by a shared
+// token bucket, and hand results to the calling thread through a bounded queue.
+// The calling thread is the only writer, so it can keep sole ownership of the
+// SQLite connection and batch its writes.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct FetchPipelineOptions {
+    int workers = 4;                  // Concurrent fetches
+    double requestsPerSecond = 4.0;   // Shared by all workers (<= 0 = unlimited)
+    int burst = 4;                    // Requests allowed back to back after an idle period
+    size_t queueCapacity = 64;        // Finished results waiting for the writer
+    int progressIntervalMs = 2000;    // Minimum time between progress callbacks
+    std::chrono::steady_clock::time_point deadline =   // No new fetches start after this
+        std::chrono::steady_clock::time_point::max();
+    std::function<void()> idle;       // Optional: runs on the calling thread while no result comes
+    int idleIntervalMs = 250;         // Time without a result between idle() calls
+};
+
+struct FetchProgress {
+    size_t total = 0;
+    size_t completed = 0;
+    size_t succeeded = 0;
+    size_t failed = 0;
+    double elapsedSeconds = 0.0;
+
+    double ItemsPerMinute() const;
+};
+
+// Token bucket shared between threads
+class RateLimiter {
+public:
+    RateLimiter(double perSecond, int burst);
+
+    // Blocks until the next request may start
+    void Acquire();
+
+private:
+    std::mutex mutex_;
+    double perSecond_;
+    double capacity_;
+    double tokens_;
+    std::chrono::steady_clock::time_point last_;
+};
+
+// Fixed-capacity FIFO. Push blocks while full, Pop blocks while empty.
+// After Close() pushes fail and pops drain what is left.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+
+    bool Push(T&& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    // Pop that gives up after timeout (timedOut set) instead of waiting for an item
+    bool Pop(T& item, std::chrono::milliseconds timeout, bool& timedOut) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        timedOut = !notEmpty_.wait_for(lock, timeout, [this] { return closed_ || !items_.empty(); });
+        if (timedOut || items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+    std::deque<T> items_;
+    size_t capacity_;
+    bool closed_ = false;
+};
+
+// Fetch every id on options.workers threads and pass each result to write() on the
+// calling thread, in completion order. fetch() returns false on failure; write() still
+// sees failed items (ok = false). progress() (optional) and options.idle run on the
+// calling thread.
+// Past options.deadline the remaining ids are left alone (completed < total).
+template <typename Result>
+FetchProgress RunFetchPipeline(const std::vector<std::string>& ids,
+                               const std::function<bool(const std::string& id, Result& result)>& fetch,
+                               const std::function<void(const std::string& id, Result& result, bool ok)>& write,
+                               const std::function<void(const FetchProgress& progress)>& progress,
+                               const FetchPipelineOptions& options) {
+    FetchProgress state;
+    state.total = ids.size();
+    if (ids.empty()) return state;
+
+    struct Item {
+        size_t index = 0;
+        Result value;
+        bool ok = false;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    RateLimiter limiter(options.requestsPerSecond, options.burst);
+    BoundedQueue<Item> queue(options.queueCapacity);
+    std::atomic<size_t> next(0);
+
+    size_t workerCount = (size_t)std::max(1, options.workers);
+    workerCount = std::min(workerCount, ids.size());
+    std::atomic<size_t> running(workerCount);
+
+    std::vector<std::thread> workers;
+    workers.reserve(workerCount);
+    for (size_t w = 0; w < workerCount; w++) {
+        workers.emplace_back([&]() {
+            for (;;) {
+                if (std::chrono::steady_clock::now() >= options.deadline) break;
+                size_t index = next++;
+                if (index >= ids.size()) break;
+
+                limiter.Acquire();
+                Item item;
+                item.index = index;
+                item.ok = fetch(ids[index], item.value);
+                if (!queue.Push(std::move(item))) break;
+            }
+            // The last worker out lets the writer drain the queue and stop
+            if (--running == 0) queue.Close();
+        });
+    }
+
+    auto lastReport = start;
+    Item item;
+    for (;;) {
+        bool timedOut = false;
+        bool popped = options.idle ? queue.Pop(item, std::chrono::milliseconds(options.idleIntervalMs), timedOut)
+                                   : queue.Pop(item);
+        if (timedOut) {
+            options.idle();
+            continue;
+        }
+        if (!popped) break;
+
+        write(ids[item.index], item.value, item.ok);
+        state.completed++;
+        if (item.ok) {
+            state.succeeded++;
+        } else {
+            state.failed++;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (progress && (state.completed == state.total ||
+                         now - lastReport >= std::chrono::milliseconds(options.progressIntervalMs))) {
+            state.elapsedSeconds = std::chrono::duration<double>(now - start).count();
+            progress(state);
+            lastReport = now;
+        }
+    }
+
+    queue.Close();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    state.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return state;
+}
+
+// Run fn(i) for every i in [0, count) on up to `threads` threads (0 = all cores),
+// including the calling thread. For CPU-bound work that needs no rate limit.
+template <typename Fn>
+void ParallelFor(size_t count, int threads, Fn fn) {
+    size_t workerCount = threads > 0 ? (size_t)threads : (size_t)std::max(1u, std::thread::hardware_concurrency());
+    workerCount = std::min(workerCount, count);
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t i = next++; i < count; i = next++) fn(i);
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t w = 1; w < workerCount; w++) workers.emplace_back(work);
+    work();
+    for (auto& worker : workers) worker.join();
+}
+
+#endif // FETCH_PIPELINE_H
@@ -0,0 +1,591 @@
+#include "http_transport.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winhttp.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+static std::string ToLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return text;
+}
+
+static std::string TrimSpace(const std::string& text) {
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) return std::string();
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(start, end - start + 1);
+}
+
+// ---------------------------------------------------------------------------
+// URLs
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// scheme://authority/path?query#fragment, split without validation
+struct UrlSplit {
+    std::string scheme;
+    std::string authority;
+    std::string path;
+    std::string query;       // Including '?'
+    bool hasAuthority = false;
+};
+
+bool HasScheme(const std::string& url) {
+    size_t colon = url.find(':');
+    if (colon == 0 || colon == std::string::npos || !std::isalpha((unsigned char)url[0])) return false;
+    for (size_t i = 0; i < colon; i++) {
+        char c = url[i];
+        if (!std::isalnum((unsigned char)c) && c != '+' && c != '-' && c != '.') return false;
+    }
+    return true;
+}
+
+UrlSplit SplitUrl(std::string url) {
+    UrlSplit split;
+    url = url.substr(0, url.find('#'));
+    if (HasScheme(url)) {
+        size_t colon = url.find(':');
+        split.scheme = ToLower(url.substr(0, colon));
+        url = url.substr(colon + 1);
+    }
+    if (url.compare(0, 2, "//") == 0) {
+        size_t end = url.find_first_of("/?", 2);
+        split.authority = url.substr(2, end == std::string::npos ? std::string::npos : end - 2);
+        split.hasAuthority = true;
+        url = end == std::string::npos ? std::string() : url.substr(end);
+    }
+    size_t query = url.find('?');
+    split.path = url.substr(0, query);
+    if (query != std::string::npos) split.query = url.substr(query);
+    return split;
+}
+
+std::string RemoveDotSegments(const std::string& path) {
+    std::vector<std::string> segments;
+    size_t pos = path.empty() || path[0] != '/' ? 0 : 1;
+    while (pos <= path.size()) {
+        size_t slash = path.find('/', pos);
+        std::string segment = path.substr(pos, slash == std::string::npos ? std::string::npos : slash - pos);
+        bool last = slash == std::string::npos;
+        if (segment == "..") {
+            if (!segments.empty()) segments.pop_back();
+            if (last) segments.push_back(std::string());
+        } else if (segment == ".") {
+            if (last) segments.push_back(std::string());
+        } else {
+            segments.push_back(segment);
+        }
+        if (last) break;
+        pos = slash + 1;
+    }
+    std::string result;
+    for (const auto& segment : segments) result += "/" + segment;
+    return result.empty() ? "/" : result;
+}
+
+}  // namespace
+
+std::string UrlParts::Authority() const {
+    bool defaultPort = port == (scheme == "https" ? 443 : 80);
+    std::string name = host.find(':') != std::string::npos ? "[" + host + "]" : host;
+    return defaultPort ? name : name + ":" + std::to_string(port);
+}
+
+bool ParseUrl(const std::string& url, UrlParts& parts) {
+    UrlSplit split = SplitUrl(TrimSpace(url));
+    if ((split.scheme != "http" && split.scheme != "https") || !split.hasAuthority) return false;
+
+    std::string authority = split.authority.substr(split.authority.rfind('@') + 1);  // Drop user info
+    std::string port;
+    if (!authority.empty() && authority[0] == '[') {
+        size_t close = authority.find(']');
+        if (close == std::string::npos) return false;
+        parts.host = authority.substr(1, close - 1);
+        if (close + 1 < authority.size() && authority[close + 1] == ':') port = authority.substr(close + 2);
+    } else {
+        size_t colon = authority.find(':');
+        parts.host = authority.substr(0, colon);
+        if (colon != std::string::npos) port = authority.substr(colon + 1);
+    }
+    if (parts.host.empty()) return false;
+
+    parts.scheme = split.scheme;
+    parts.host = ToLower(parts.host);
+    parts.port = split.scheme == "https" ? 443 : 80;
+    if (!port.empty()) {
+        if (port.find_first_not_of("0123456789") != std::string::npos || port.size() > 5) return false;
+        parts.port = std::atoi(port.c_str());
+        if (parts.port <= 0 || parts.port > 65535) return false;
+    }
+    parts.path = (split.path.empty() ? "/" : split.path) + split.query;
+    return true;
+}
+
+std::string ResolveUrl(const std::string& base, const std::string& reference) {
+    std::string ref = TrimSpace(reference);
+    if (HasScheme(ref)) return ref;
+
+    UrlSplit baseSplit = SplitUrl(base);
+    std::string origin = baseSplit.scheme + "://" + baseSplit.authority;
+    if (ref.compare(0, 2, "//") == 0) return baseSplit.scheme + ":" + ref;
+
+    UrlSplit refSplit = SplitUrl(ref);
+    if (refSplit.path.empty()) {
+        return origin + RemoveDotSegments(baseSplit.path) + (refSplit.query.empty() ? baseSplit.query : refSplit.query);
+    }
+    if (refSplit.path[0] == '/') return origin + RemoveDotSegments(refSplit.path) + refSplit.query;
+
+    // Relative path: replaces the last segment of the base path
+    std::string directory = baseSplit.path.substr(0, baseSplit.path.rfind('/') + 1);
+    if (directory.empty()) directory = "/";
+    return origin + RemoveDotSegments(directory + refSplit.path) + refSplit.query;
+}
+
+#ifdef _WIN32
+
+// ---------------------------------------------------------------------------
+// WinHTTP
+// ---------------------------------------------------------------------------
+
+namespace {
+
+std::wstring Utf8ToWide(const std::string& text) {
+    int len = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), -1, nullptr, 0);
+    std::wstring wide(len > 0 ? len - 1 : 0, L'\0');
+    if (len > 1) MultiByteToWideChar(CP_UTF8, 0, text.c_str(), -1, &wide[0], len);
+    return wide;
+}
+
+std::string WideToUtf8(const std::wstring& wide) {
+    int len = WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    std::string text(len > 0 ? len - 1 : 0, '\0');
+    if (len > 1) WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, &text[0], len, nullptr, nullptr);
+    return text;
+}
+
+std::string QueryHeader(HINTERNET request, DWORD info) {
+    DWORD size = 0;
+    WinHttpQueryHeaders(request, info, WINHTTP_HEADER_NAME_BY_INDEX, WINHTTP_NO_OUTPUT_BUFFER, &size,
+                        WINHTTP_NO_HEADER_INDEX);
+    if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || size == 0) return std::string();
+    std::wstring value(size / sizeof(wchar_t), L'\0');
+    if (!WinHttpQueryHeaders(request, info, WINHTTP_HEADER_NAME_BY_INDEX, &value[0], &size,
+                             WINHTTP_NO_HEADER_INDEX)) {
+        return std::string();
+    }
+    value.resize(size / sizeof(wchar_t));
+    return WideToUtf8(value);
+}
+
+// WinHTTP pools the sockets of a session per server; the connect handles are
+// kept per host so each request reuses them.
+class WinHttpTransport : public HttpTransport {
+public:
+    WinHttpTransport(int timeoutMs, const std::string& userAgent) {
+        session_ = WinHttpOpen(Utf8ToWide(userAgent).c_str(), WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                               WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+        if (session_) WinHttpSetTimeouts(session_, timeoutMs, timeoutMs, timeoutMs, timeoutMs);
+    }
+
+    ~WinHttpTransport() override {
+        for (auto& connection : connections_) WinHttpCloseHandle(connection.second);
+        if (session_) WinHttpCloseHandle(session_);
+    }
+
+    bool Get(const std::string& url, const HttpHeaders& headers, HttpResponse& response,
+             const std::function<bool(const char* data, size_t size)>& onData) override {
+        response = HttpResponse();
+        UrlParts parts;
+        if (!session_ || !ParseUrl(url, parts)) return false;
+        HINTERNET connection = Connection(parts);
+        if (!connection) return false;
+
+        HINTERNET request = WinHttpOpenRequest(connection, L"GET", Utf8ToWide(parts.path).c_str(), nullptr,
+                                               WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+                                               parts.scheme == "https" ? WINHTTP_FLAG_SECURE : 0);
+        if (!request) return false;
+
+        std::wstring extraHeaders;
+        for (const auto& header : headers) extraHeaders += Utf8ToWide(header.first + ": " + header.second + "\r\n");
+        bool sent = WinHttpSendRequest(request, extraHeaders.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : extraHeaders.c_str(),
+                                       (DWORD)-1L, WINHTTP_NO_REQUEST_DATA, 0, 0, 0) &&
+                    WinHttpReceiveResponse(request, nullptr);
+        if (!sent) {
+            WinHttpCloseHandle(request);
+            return false;
+        }
+
+        DWORD status = 0;
+        DWORD size = sizeof(status);
+        WinHttpQueryHeaders(request, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX,
+                            &status, &size, WINHTTP_NO_HEADER_INDEX);
+        response.status = (int)status;
+        response.contentType = QueryHeader(request, WINHTTP_QUERY_CONTENT_TYPE);
+        response.etag = QueryHeader(request, WINHTTP_QUERY_ETAG);
+        response.lastModified = QueryHeader(request, WINHTTP_QUERY_LAST_MODIFIED);
+
+        // Redirects are followed by WinHTTP; the option holds where they ended
+        DWORD urlSize = 0;
+        WinHttpQueryOption(request, WINHTTP_OPTION_URL, nullptr, &urlSize);
+        std::wstring finalUrl(urlSize / sizeof(wchar_t), L'\0');
+        if (urlSize > 0 && WinHttpQueryOption(request, WINHTTP_OPTION_URL, &finalUrl[0], &urlSize)) {
+            finalUrl.resize(wcsnlen(finalUrl.c_str(), finalUrl.size()));
+            response.finalUrl = WideToUtf8(finalUrl);
+        } else {
+            response.finalUrl = url;
+        }
+
+        char buffer[16384];
+        DWORD read = 0;
+        while (WinHttpReadData(request, buffer, sizeof(buffer), &read) && read > 0) {
+            if (!onData(buffer, read)) break;
+        }
+        WinHttpCloseHandle(request);
+        return true;
+    }
+
+    bool SupportsScheme(const std::string& scheme) const override {
+        return scheme == "http" || scheme == "https";
+    }
+
+private:
+    HINTERNET Connection(const UrlParts& parts) {
+        std::string key = parts.scheme + "://" + parts.host + ":" + std::to_string(parts.port);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = connections_.find(key);
+        if (found != connections_.end()) return found->second;
+        HINTERNET connection = WinHttpConnect(session_, Utf8ToWide(parts.host).c_str(), (INTERNET_PORT)parts.port, 0);
+        if (connection) connections_[key] = connection;
+        return connection;
+    }
+
+    HINTERNET session_ = nullptr;
+    std::mutex mutex_;
+    std::map<std::string, HINTERNET> connections_;
+};
+
+}  // namespace
+
+std::unique_ptr<HttpTransport> CreateHttpTransport(int timeoutMs, const std::string& userAgent) {
+    return std::unique_ptr<HttpTransport>(new WinHttpTransport(timeoutMs, userAgent));
+}
+
+#else
+
+// ---------------------------------------------------------------------------
+// Sockets (plain http only)
+// ---------------------------------------------------------------------------
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static const int MAX_REDIRECTS = 5;
+static const size_t MAX_IDLE_PER_HOST = 4;   // Kept-alive connections per host
+
+static bool IsRedirect(int status) {
+    return status == 301 || status == 302 || status == 303 || status == 307 || status == 308;
+}
+
+namespace {
+
+// Buffered reads from a connected socket
+class SocketReader {
+public:
+    explicit SocketReader(int fd) : fd_(fd) {}
+
+    bool ReadLine(std::string& line) {
+        for (;;) {
+            size_t eol = buffer_.find('\n', pos_);
+            if (eol != std::string::npos) {
+                line = buffer_.substr(pos_, eol - pos_);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                pos_ = eol + 1;
+                return true;
+            }
+            if (buffer_.size() - pos_ > 64 * 1024 || !Fill()) return false;  // Header line too long
+        }
+    }
+
+    // Pass exactly length bytes to sink (or skip them when stopped)
+    bool Read(size_t length, const std::function<bool(const char*, size_t)>& sink, bool& stopped) {
+        while (length > 0) {
+            if (pos_ == buffer_.size() && !Fill()) return false;
+            size_t take = std::min(length, buffer_.size() - pos_);
+            if (!stopped && !sink(buffer_.data() + pos_, take)) stopped = true;
+            pos_ += take;
+            length -= take;
+            if (stopped) return false;
+        }
+        return true;
+    }
+
+    // Pass everything up to the end of the stream to sink
+    void ReadToEnd(const std::function<bool(const char*, size_t)>& sink) {
+        do {
+            if (pos_ < buffer_.size() && !sink(buffer_.data() + pos_, buffer_.size() - pos_)) return;
+            pos_ = buffer_.size();
+        } while (Fill());
+    }
+
+    bool Drained() const { return pos_ == buffer_.size(); }
+
+private:
+    bool Fill() {
+        if (pos_ == buffer_.size()) {
+            buffer_.clear();
+            pos_ = 0;
+        }
+        char chunk[16384];
+        ssize_t received = recv(fd_, chunk, sizeof(chunk), 0);
+        if (received <= 0) return false;
+        buffer_.append(chunk, (size_t)received);
+        return true;
+    }
+
+    int fd_;
+    std::string buffer_;
+    size_t pos_ = 0;
+};
+
+class SocketTransport : public HttpTransport {
+public:
+    SocketTransport(int timeoutMs, const std::string& userAgent) : timeoutMs_(timeoutMs), userAgent_(userAgent) {}
+
+    ~SocketTransport() override {
+        for (auto& host : idle_) {
+            for (int fd : host.second) close(fd);
+        }
+    }
+
+    bool Get(const std::string& url, const HttpHeaders& headers, HttpResponse& response,
+             const std::function<bool(const char* data, size_t size)>& onData) override {
+        response = HttpResponse();
+        std::string current = url;
+        for (int redirects = 0; redirects <= MAX_REDIRECTS; redirects++) {
+            UrlParts parts;
+            if (!ParseUrl(current, parts) || parts.scheme != "http") return false;
+            std::string location;
+            int status = Exchange(parts, headers, response, location, onData);
+            if (status == 0) return false;
+            if (!IsRedirect(status) || location.empty()) {
+                response.finalUrl = current;
+                return true;
+            }
+            current = ResolveUrl(current, location);
+        }
+        return false;  // Redirect loop
+    }
+
+    bool SupportsScheme(const std::string& scheme) const override {
+        return scheme == "http";
+    }
+
+private:
+    // One request/response on a pooled or new connection. Returns the status,
+    // or 0 without a response. A redirect's body is discarded.
+    int Exchange(const UrlParts& parts, const HttpHeaders& headers, HttpResponse& response, std::string& location,
+                 const std::function<bool(const char*, size_t)>& onData) {
+        std::string request = "GET " + parts.path + " HTTP/1.1\r\nHost: " + parts.Authority() +
+                              "\r\nUser-Agent: " + userAgent_ + "\r\nAccept: */*\r\nConnection: keep-alive\r\n";
+        for (const auto& header : headers) request += header.first + ": " + header.second + "\r\n";
+        request += "\r\n";
+
+        std::string key = parts.Authority();
+        for (int attempt = 0; attempt < 2; attempt++) {
+            // A kept-alive connection may have been closed by the server meanwhile;
+            // then the request is retried once on a new one
+            int fd = TakeIdle(key);
+            bool reused = fd >= 0;
+            if (!reused) fd = Connect(parts.host, parts.port);
+            if (fd < 0) return 0;
+
+            SocketReader reader(fd);
+            std::string line;
+            if (!SendAll(fd, request) || !reader.ReadLine(line)) {
+                close(fd);
+                if (reused) continue;
+                return 0;
+            }
+
+            // Status line, then headers up to the empty line
+            int status = 0;
+            size_t space = line.find(' ');
+            if (line.compare(0, 5, "HTTP/") == 0 && space != std::string::npos) {
+                status = std::atoi(line.c_str() + space + 1);
+            }
+            bool chunked = false, closeAfter = line.compare(0, 8, "HTTP/1.0") == 0;
+            long long contentLength = -1;
+            std::string contentType, etag, lastModified;
+            location.clear();
+            bool headersOk = status > 0;
+            while (headersOk && (headersOk = reader.ReadLine(line)) && !line.empty()) {
+                size_t colon = line.find(':');
+                if (colon == std::string::npos) continue;
+                std::string name = ToLower(TrimSpace(line.substr(0, colon)));
+                std::string value = TrimSpace(line.substr(colon + 1));
+                if (name == "content-length") {
+                    contentLength = std::atoll(value.c_str());
+                } else if (name == "transfer-encoding") {
+                    chunked = ToLower(value).find("chunked") != std::string::npos;
+                } else if (name == "connection") {
+                    std::string lower = ToLower(value);
+                    if (lower.find("close") != std::string::npos) closeAfter = true;
+                    if (lower.find("keep-alive") != std::string::npos) closeAfter = false;
+                } else if (name == "location") {
+                    location = value;
+                } else if (name == "content-type") {
+                    contentType = value;
+                } else if (name == "etag") {
+                    etag = value;
+                } else if (name == "last-modified") {
+                    lastModified = value;
+                }
+            }
+            if (!headersOk) {
+                close(fd);
+                return 0;
+            }
+
+            bool redirect = IsRedirect(status) && !location.empty();
+            if (!redirect) {
+                response.status = status;
+                response.contentType = contentType;
+                response.etag = etag;
+                response.lastModified = lastModified;
+            }
+            auto discard = [](const char*, size_t) { return true; };
+            const std::function<bool(const char*, size_t)>& sink = redirect ? discard : onData;
+
+            bool complete;
+            bool stopped = false;
+            if (status < 200 || status == 204 || status == 304) {
+                complete = true;  // No body
+            } else if (chunked) {
+                complete = ReadChunked(reader, sink, stopped);
+            } else if (contentLength >= 0) {
+                complete = reader.Read((size_t)contentLength, sink, stopped);
+            } else {
+                reader.ReadToEnd(sink);
+                complete = false;  // Delimited by the close
+            }
+
+            if (complete && !closeAfter && reader.Drained()) {
+                ReturnIdle(key, fd);
+            } else {
+                close(fd);
+            }
+            return status;
+        }
+        return 0;
+    }
+
+    static bool ReadChunked(SocketReader& reader, const std::function<bool(const char*, size_t)>& sink, bool& stopped) {
+        std::string line;
+        for (;;) {
+            if (!reader.ReadLine(line)) return false;
+            size_t size = (size_t)std::strtoull(line.c_str(), nullptr, 16);
+            if (size == 0) break;
+            if (!reader.Read(size, sink, stopped) || !reader.ReadLine(line)) return false;
+        }
+        // Trailer fields up to the empty line
+        while (reader.ReadLine(line)) {
+            if (line.empty()) return true;
+        }
+        return false;
+    }
+
+    bool SendAll(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += (size_t)n;
+        }
+        return true;
+    }
+
+    int Connect(const std::string& host, int port) {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) return -1;
+
+        int fd = -1;
+        for (addrinfo* address = addresses; address; address = address->ai_next) {
+            fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (fd < 0) continue;
+
+            // Non-blocking connect, so the timeout applies to it too
+            int flags = fcntl(fd, F_GETFL, 0);
+            fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+            int rc = connect(fd, address->ai_addr, address->ai_addrlen);
+            if (rc != 0 && errno == EINPROGRESS) {
+                pollfd pfd = {fd, POLLOUT, 0};
+                int error = 0;
+                socklen_t length = sizeof(error);
+                rc = poll(&pfd, 1, timeoutMs_) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 &&
+                             error == 0 ? 0 : -1;
+            }
+            if (rc == 0) {
+                fcntl(fd, F_SETFL, flags);
+                timeval timeout = {timeoutMs_ / 1000, (timeoutMs_ % 1000) * 1000};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                break;
+            }
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(addresses);
+        return fd;
+    }
+
+    int TakeIdle(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = idle_.find(key);
+        if (found == idle_.end() || found->second.empty()) return -1;
+        int fd = found->second.back();
+        found->second.pop_back();
+        return fd;
+    }
+
+    void ReturnIdle(const std::string& key, int fd) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<int>& pool = idle_[key];
+        if (pool.size() < MAX_IDLE_PER_HOST) {
+            pool.push_back(fd);
+        } else {
+            close(fd);
+        }
+    }
+
+    int timeoutMs_;
+    std::string userAgent_;
+    std::mutex mutex_;
+    std::map<std::string, std::vector<int>> idle_;   // host:port -> kept-alive connections
+};
+
+}  // namespace
+
+std::unique_ptr<HttpTransport> CreateHttpTransport(int timeoutMs, const std::string& userAgent) {
+    return std::unique_ptr<HttpTransport>(new SocketTransport(timeoutMs, userAgent));
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef HTTP_TRANSPORT_H
+#define HTTP_TRANSPORT_H
+
+// Minimal HTTP GET client used by the icon fetcher. WinHTTP on Windows (http and
+// https); elsewhere plain http over sockets, which is enough to run the fetcher
+// against a local stand-in server. Both keep connections open per host and reuse
+// them for the next request to the same host.
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Pieces of an http or https URL. path includes the query; host is lowercase.
+struct UrlParts {
+    std::string scheme;
+    std::string host;
+    int port = 0;
+    std::string path;
+
+    // host, or host:port for a port other than the scheme's default
+    std::string Authority() const;
+};
+
+// Split an absolute http(s) URL. Returns false for other schemes and malformed URLs.
+bool ParseUrl(const std::string& url, UrlParts& parts);
+
+// Resolve a (possibly relative) reference against an absolute base URL (RFC 3986)
+std::string ResolveUrl(const std::string& base, const std::string& reference);
+
+struct HttpResponse {
+    int status = 0;              // 0 = no response (DNS, connect, TLS or timeout failure)
+    std::string finalUrl;        // After redirects
+    std::string contentType;
+    std::string etag;
+    std::string lastModified;
+};
+
+typedef std::vector<std::pair<std::string, std::string>> HttpHeaders;
+
+class HttpTransport {
+public:
+    virtual ~HttpTransport() {}
+
+    // GET url, following redirects, and pass the body to onData as it arrives.
+    // onData returns false to stop reading (the connection is then not reused).
+    // Returns false if no response arrived. Safe to call from several threads.
+    virtual bool Get(const std::string& url, const HttpHeaders& headers, HttpResponse& response,
+                     const std::function<bool(const char* data, size_t size)>& onData) = 0;
+
+    // "http" or "https"
+    virtual bool SupportsScheme(const std::string& scheme) const = 0;
+};
+
+// The platform's transport. timeoutMs applies to connecting and to each read.
+std::unique_ptr<HttpTransport> CreateHttpTransport(int timeoutMs, const std::string& userAgent);
+
+#endif // HTTP_TRANSPORT_H
@@ -0,0 +1,190 @@
+#include "icon_atlas.h"
+#include "icon_image.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+static const char ICON_ATLAS_MAGIC[4] = {'W', 'P', 'I', 'A'};
+
+static uint64_t AlignTo16(uint64_t value) {
+    return (value + 15) & ~(uint64_t)15;
+}
+
+int BuildIconAtlas(sqlite3* db, const std::string& path, uint64_t contentVersion) {
+    // Icons are content-addressed, so each distinct hash is read and decoded once
+    const char* sql = "SELECT id, icon_hash FROM apps WHERE icon_hash IS NOT NULL ORDER BY id;";
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_stmt* iconStmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, "SELECT data FROM icons WHERE hash = ?;", -1, &iconStmt, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    const size_t smallBytes = ICON_ATLAS_SMALL_SIZE * ICON_ATLAS_SMALL_SIZE * 4;
+    const size_t largeBytes = ICON_ATLAS_LARGE_SIZE * ICON_ATLAS_LARGE_SIZE * 4;
+
+    std::vector<IconAtlasEntry> entries;
+    std::vector<uint8_t> smallPixels;
+    std::vector<uint8_t> largePixels;
+    std::unordered_map<std::string, uint32_t> slotByHash;
+    std::unordered_set<std::string> undecodable;
+    uint32_t iconCount = 0;
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int appId = sqlite3_column_int(stmt, 0);
+        const char* hashBytes = (const char*)sqlite3_column_blob(stmt, 1);
+        std::string hash(hashBytes ? hashBytes : "", (size_t)sqlite3_column_bytes(stmt, 1));
+        auto it = slotByHash.find(hash);
+        if (it != slotByHash.end()) {
+            entries.push_back({appId, it->second});
+            continue;
+        }
+        if (undecodable.count(hash)) continue;
+
+        DecodedImage image;
+        sqlite3_reset(iconStmt);
+        sqlite3_bind_blob(iconStmt, 1, hash.data(), (int)hash.size(), SQLITE_STATIC);
+        bool decoded = sqlite3_step(iconStmt) == SQLITE_ROW &&
+                       DecodeImage((const uint8_t*)sqlite3_column_blob(iconStmt, 0),
+                                   (size_t)sqlite3_column_bytes(iconStmt, 0), ICON_ATLAS_LARGE_SIZE, image);
+        if (!decoded) {
+            undecodable.insert(hash);
+            continue;
+        }
+
+        smallPixels.resize(smallPixels.size() + smallBytes);
+        largePixels.resize(largePixels.size() + largeBytes);
+        RenderPremultipliedBgra(image, ICON_ATLAS_SMALL_SIZE, smallPixels.data() + (size_t)iconCount * smallBytes);
+        RenderPremultipliedBgra(image, ICON_ATLAS_LARGE_SIZE, largePixels.data() + (size_t)iconCount * largeBytes);
+
+        slotByHash[hash] = iconCount;
+        entries.push_back({appId, iconCount});
+        iconCount++;
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_finalize(iconStmt);
+
+    // Rows come back ordered by id, but keep the lookup invariant explicit
+    std::sort(entries.begin(), entries.end(),
+              [](const IconAtlasEntry& a, const IconAtlasEntry& b) { return a.appId < b.appId; });
+
+    IconAtlasHeader header = {};
+    std::memcpy(header.magic, ICON_ATLAS_MAGIC, sizeof(header.magic));
+    header.formatVersion = ICON_ATLAS_FORMAT_VERSION;
+    header.contentVersion = contentVersion;
+    header.iconCount = iconCount;
+    header.entryCount = (uint32_t)entries.size();
+    header.smallSize = ICON_ATLAS_SMALL_SIZE;
+    header.largeSize = ICON_ATLAS_LARGE_SIZE;
+    header.entriesOffset = AlignTo16(sizeof(IconAtlasHeader));
+    header.smallOffset = AlignTo16(header.entriesOffset + entries.size() * sizeof(IconAtlasEntry));
+    header.largeOffset = AlignTo16(header.smallOffset + smallPixels.size());
+    header.fileSize = header.largeOffset + largePixels.size();
+
+    std::filesystem::path finalPath = std::filesystem::u8path(path);
+    std::filesystem::path tempPath = finalPath;
+    tempPath += ".tmp";
+
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) return -1;
+
+        auto writeAt = [&out](uint64_t offset, const void* data, size_t size) {
+            static const char padding[16] = {0};
+            uint64_t pos = (uint64_t)out.tellp();
+            if (offset > pos) out.write(padding, (std::streamsize)(offset - pos));
+            if (size) out.write((const char*)data, (std::streamsize)size);
+        };
+
+        writeAt(0, &header, sizeof(header));
+        writeAt(header.entriesOffset, entries.data(), entries.size() * sizeof(IconAtlasEntry));
+        writeAt(header.smallOffset, smallPixels.data(), smallPixels.size());
+        writeAt(header.largeOffset, largePixels.data(), largePixels.size());
+        if (!out) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tempPath, ec);
+            return -1;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, finalPath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return -1;
+    }
+    return (int)iconCount;
+}
+
+bool IconAtlas::Open(const std::string& path) {
+    Close();
+    if (!file_.Open(path)) return false;
+
+    const uint8_t* data = file_.Data();
+    size_t size = file_.Size();
+    if (size < sizeof(IconAtlasHeader)) {
+        Close();
+        return false;
+    }
+
+    const IconAtlasHeader* header = (const IconAtlasHeader*)data;
+    uint64_t smallBytes = (uint64_t)header->smallSize * header->smallSize * 4;
+    uint64_t largeBytes = (uint64_t)header->largeSize * header->largeSize * 4;
+
+    bool valid = std::memcmp(header->magic, ICON_ATLAS_MAGIC, 4) == 0 &&
+                 header->formatVersion == ICON_ATLAS_FORMAT_VERSION &&
+                 header->fileSize == size &&
+                 header->smallSize > 0 && header->smallSize <= 256 &&
+                 header->largeSize > 0 && header->largeSize <= 256 &&
+                 header->entriesOffset % alignof(IconAtlasEntry) == 0 &&
+                 header->entriesOffset + (uint64_t)header->entryCount * sizeof(IconAtlasEntry) <= size &&
+                 header->smallOffset + (uint64_t)header->iconCount * smallBytes <= size &&
+                 header->largeOffset + (uint64_t)header->iconCount * largeBytes <= size;
+
+    // FindSlot's binary search needs strictly increasing app ids, and every slot
+    // must have pixels
+    const IconAtlasEntry* entries = (const IconAtlasEntry*)(data + header->entriesOffset);
+    for (uint32_t i = 0; valid && i < header->entryCount; i++) {
+        valid = entries[i].slot < header->iconCount && (i == 0 || entries[i - 1].appId < entries[i].appId);
+    }
+    if (!valid) {
+        Close();
+        return false;
+    }
+
+    header_ = header;
+    entries_ = entries;
+    return true;
+}
+
+void IconAtlas::Close() {
+    file_.Close();
+    header_ = nullptr;
+    entries_ = nullptr;
+}
+
+int IconAtlas::FindSlot(int appId) const {
+    if (!header_) return -1;
+    const IconAtlasEntry* end = entries_ + header_->entryCount;
+    const IconAtlasEntry* it = std::lower_bound(entries_, end, appId,
+        [](const IconAtlasEntry& e, int id) { return e.appId < id; });
+    if (it == end || it->appId != appId || it->slot >= header_->iconCount) return -1;
+    return (int)it->slot;
+}
+
+const uint8_t* IconAtlas::SmallPixels(uint32_t slot) const {
+    if (!header_ || slot >= header_->iconCount) return nullptr;
+    return file_.Data() + header_->smallOffset + (uint64_t)slot * header_->smallSize * header_->smallSize * 4;
+}
+
+const uint8_t* IconAtlas::LargePixels(uint32_t slot) const {
+    if (!header_ || slot >= header_->iconCount) return nullptr;
+    return file_.Data() + header_->largeOffset + (uint64_t)slot * header_->largeSize * header_->largeSize * 4;
+}
@@ -0,0 +1,83 @@
+#ifndef ICON_ATLAS_H
+#define ICON_ATLAS_H
+
+// Pre-rendered icon atlas written by the updater and memory-mapped by the GUI.
+//
+// File layout (little-endian):
+//   IconAtlasHeader
+//   IconAtlasEntry[entryCount]          sorted by appId
+//   small pixels [iconCount][small*small] premultiplied BGRA, top-down
+//   large pixels [iconCount][large*large] premultiplied BGRA, top-down
+//
+// Apps referring to the same stored icon share a slot. The header carries the
+// catalog content version (see db_meta.h) so a stale atlas can be ignored.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "mapped_file.h"
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+#define ICON_ATLAS_FILENAME "WinProgramManager.icons"
+#define ICON_ATLAS_FORMAT_VERSION 1
+#define ICON_ATLAS_SMALL_SIZE 16
+#define ICON_ATLAS_LARGE_SIZE 32
+
+struct IconAtlasHeader {
+    char magic[4];              // "WPIA"
+    uint32_t formatVersion;
+    uint64_t contentVersion;
+    uint32_t iconCount;         // Number of distinct icon slots
+    uint32_t entryCount;        // Number of app id -> slot entries
+    uint32_t smallSize;
+    uint32_t largeSize;
+    uint64_t entriesOffset;
+    uint64_t smallOffset;
+    uint64_t largeOffset;
+    uint64_t fileSize;
+};
+static_assert(sizeof(IconAtlasHeader) == 64, "IconAtlasHeader layout changed");
+
+struct IconAtlasEntry {
+    int32_t appId;
+    uint32_t slot;
+};
+
+// Decode every icon referenced from apps (icon_store.h), once per distinct icon,
+// and write the atlas to path (UTF-8).
+// The file is written to a temporary name and then moved into place.
+// Returns the number of distinct icons written, or -1 on failure.
+int BuildIconAtlas(sqlite3* db, const std::string& path, uint64_t contentVersion);
+
+class IconAtlas {
+public:
+    // Map and validate an atlas file (offsets, sizes, sorted entries, slots in
+    // range). Returns false if missing or malformed.
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return header_ != nullptr; }
+    uint64_t ContentVersion() const { return header_ ? header_->contentVersion : 0; }
+    uint32_t IconCount() const { return header_ ? header_->iconCount : 0; }
+    uint32_t EntryCount() const { return header_ ? header_->entryCount : 0; }
+    int SmallSize() const { return header_ ? (int)header_->smallSize : 0; }
+    int LargeSize() const { return header_ ? (int)header_->largeSize : 0; }
+
+    const IconAtlasEntry* Entries() const { return entries_; }
+
+    // Slot for an app, or -1 if the app has no icon in the atlas
+    int FindSlot(int appId) const;
+
+    // Pixels of one slot (size * size * 4 bytes, premultiplied BGRA)
+    const uint8_t* SmallPixels(uint32_t slot) const;
+    const uint8_t* LargePixels(uint32_t slot) const;
+
+private:
+    MappedFile file_;
+    const IconAtlasHeader* header_ = nullptr;
+    const IconAtlasEntry* entries_ = nullptr;
+};
+
+#endif // ICON_ATLAS_H
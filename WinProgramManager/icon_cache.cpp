@@ -0,0 +1,318 @@
+#include "icon_cache.h"
+#include "icon_atlas.h"
+#include "db_connection.h"
+#include <shlwapi.h>
+#include <sqlite3.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cstring>
+
+// Maximum number of pending decode requests. When the user scrolls quickly the
+// oldest requests (rows no longer visible) are dropped first.
+static const size_t MAX_PENDING_DECODES = 256;
+
+// Shared with decoder threads (guarded by g_queueMutex)
+static std::mutex g_queueMutex;
+static std::condition_variable g_queueCv;
+static std::deque<int> g_decodeQueue;        // Newest request at the back
+static std::unordered_set<int> g_queuedApps;  // Queued or being decoded
+static std::atomic<bool> g_stopDecoders(false);
+
+static std::vector<std::thread> g_decoderThreads;
+static HIMAGELIST g_iconImageList = NULL;
+static HWND g_iconNotifyWnd = NULL;
+static std::string g_iconDbPath;
+
+// UI thread only: icons from the atlas, pinned at ImageList slots
+// g_atlasFirstSlot .. g_atlasFirstSlot + atlas icon count - 1
+static std::vector<IconAtlasEntry> g_atlasEntries;  // Sorted by appId
+static int g_atlasFirstSlot = 1;
+
+// UI thread only: LRU of decoded icons, front = most recently used.
+// LRU slots start right after the atlas range.
+static std::list<std::pair<int, int>> g_lru;  // (appId, slot)
+static std::unordered_map<int, std::list<std::pair<int, int>>::iterator> g_slotByApp;
+static std::unordered_set<int> g_undecodableApps;
+static int g_firstLruSlot = 1;
+static int g_nextFreeSlot = 1;
+
+static void DecoderThread() {
+    sqlite3* db = nullptr;
+    if (OpenCatalogDatabase(g_iconDbPath, &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX) != SQLITE_OK) {
+        sqlite3_close(db);
+        return;
+    }
+
+    // The icon from the icon store, else the inline blob of not yet migrated rows
+    // (or databases)
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT COALESCE(i.data, a.icon_data) FROM apps a "
+                               "LEFT JOIN icons i ON i.hash = a.icon_hash WHERE a.id = ?;",
+                           -1, &stmt, nullptr) != SQLITE_OK &&
+        sqlite3_prepare_v2(db, "SELECT icon_data FROM apps WHERE id = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_close(db);
+        return;
+    }
+
+    while (true) {
+        int appId;
+        {
+            std::unique_lock<std::mutex> lock(g_queueMutex);
+            g_queueCv.wait(lock, [] { return g_stopDecoders || !g_decodeQueue.empty(); });
+            if (g_stopDecoders) break;
+            // Serve the newest request first - it is the row the user is looking at
+            appId = g_decodeQueue.back();
+            g_decodeQueue.pop_back();
+        }
+
+        HICON hIcon = NULL;
+        sqlite3_bind_int(stmt, 1, appId);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) == SQLITE_BLOB) {
+            const void* blobData = sqlite3_column_blob(stmt, 0);
+            int blobSize = sqlite3_column_bytes(stmt, 0);
+            hIcon = LoadIconFromMemory((const unsigned char*)blobData, blobSize);
+        }
+        sqlite3_reset(stmt);
+
+        // Ownership of the icon passes to the UI thread once posted
+        if (g_stopDecoders || !PostMessageW(g_iconNotifyWnd, WM_APP_ICON_DECODED, (WPARAM)appId, (LPARAM)hIcon)) {
+            if (hIcon) DestroyIcon(hIcon);
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+}
+
+// Add every atlas icon to the ImageList with a single ImageList_Add of one
+// wide 32bpp DIB (one cell per icon, 16px icon centred in the cell).
+// Returns false if the atlas is missing, stale or cannot be loaded.
+static bool LoadAtlasIntoImageList(const std::string& atlasPath, uint64_t contentVersion) {
+    IconAtlas atlas;
+    if (contentVersion == 0 || !atlas.Open(atlasPath)) return false;
+    if (atlas.ContentVersion() != contentVersion || atlas.IconCount() == 0) return false;
+
+    int cellWidth = 0, cellHeight = 0;
+    ImageList_GetIconSize(g_iconImageList, &cellWidth, &cellHeight);
+    int iconSize = atlas.SmallSize();
+    if (iconSize > cellWidth || iconSize > cellHeight) return false;
+
+    int count = (int)atlas.IconCount();
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = cellWidth * count;
+    bmi.bmiHeader.biHeight = -cellHeight;  // Top-down
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    void* bits = nullptr;
+    HBITMAP hBitmap = CreateDIBSection(NULL, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+    if (!hBitmap || !bits) return false;
+
+    // Fully transparent background, then blit each icon into its cell
+    size_t stride = (size_t)cellWidth * count * 4;
+    memset(bits, 0, stride * cellHeight);
+    int offsetX = (cellWidth - iconSize) / 2;
+    int offsetY = (cellHeight - iconSize) / 2;
+    for (int slot = 0; slot < count; slot++) {
+        const uint8_t* src = atlas.SmallPixels((uint32_t)slot);
+        for (int y = 0; y < iconSize; y++) {
+            uint8_t* dst = (uint8_t*)bits + (size_t)(y + offsetY) * stride + ((size_t)slot * cellWidth + offsetX) * 4;
+            memcpy(dst, src + (size_t)y * iconSize * 4, (size_t)iconSize * 4);
+        }
+    }
+
+    int firstSlot = ImageList_Add(g_iconImageList, hBitmap, NULL);
+    DeleteObject(hBitmap);
+    if (firstSlot < 0) return false;
+
+    g_atlasEntries.assign(atlas.Entries(), atlas.Entries() + atlas.EntryCount());
+    g_atlasFirstSlot = firstSlot;
+    g_firstLruSlot = firstSlot + count;
+    g_nextFreeSlot = g_firstLruSlot;
+    return true;
+}
+
+void InitIconCache(HIMAGELIST imageList, const std::wstring& dbPath, uint64_t contentVersion, HWND notifyWnd) {
+    ShutdownIconCache();
+
+    g_iconImageList = imageList;
+    g_iconNotifyWnd = notifyWnd;
+
+    int size = WideCharToMultiByte(CP_UTF8, 0, dbPath.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    g_iconDbPath.assign(size > 0 ? size - 1 : 0, '\0');
+    if (size > 1) {
+        WideCharToMultiByte(CP_UTF8, 0, dbPath.c_str(), -1, &g_iconDbPath[0], size, nullptr, nullptr);
+    }
+
+    // The atlas lives next to the database
+    std::string atlasPath = g_iconDbPath;
+    size_t lastSlash = atlasPath.find_last_of("\\/");
+    atlasPath = (lastSlash != std::string::npos ? atlasPath.substr(0, lastSlash + 1) : std::string()) + ICON_ATLAS_FILENAME;
+    LoadAtlasIntoImageList(atlasPath, contentVersion);
+
+    g_stopDecoders = false;
+    for (int i = 0; i < ICON_DECODER_THREADS; i++) {
+        g_decoderThreads.emplace_back(DecoderThread);
+    }
+}
+
+void ShutdownIconCache() {
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        g_stopDecoders = true;
+        g_decodeQueue.clear();
+        g_queuedApps.clear();
+    }
+    g_queueCv.notify_all();
+
+    for (auto& t : g_decoderThreads) {
+        if (t.joinable()) t.join();
+    }
+    g_decoderThreads.clear();
+
+    // Icons posted but not handled yet are still owned by their messages
+    if (g_iconNotifyWnd) {
+        MSG msg;
+        while (PeekMessageW(&msg, g_iconNotifyWnd, WM_APP_ICON_DECODED, WM_APP_ICON_DECODED, PM_REMOVE)) {
+            if (msg.lParam) DestroyIcon((HICON)msg.lParam);
+        }
+    }
+
+    g_atlasEntries.clear();
+    g_atlasFirstSlot = 1;
+    g_lru.clear();
+    g_slotByApp.clear();
+    g_undecodableApps.clear();
+    g_firstLruSlot = 1;
+    g_nextFreeSlot = 1;
+}
+
+int GetAppIconIndex(int appId, bool hasIcon) {
+    if (!hasIcon || !g_iconImageList) return 0;
+
+    auto atlasIt = std::lower_bound(g_atlasEntries.begin(), g_atlasEntries.end(), appId,
+        [](const IconAtlasEntry& e, int id) { return e.appId < id; });
+    if (atlasIt != g_atlasEntries.end() && atlasIt->appId == appId) {
+        return g_atlasFirstSlot + (int)atlasIt->slot;
+    }
+
+    auto it = g_slotByApp.find(appId);
+    if (it != g_slotByApp.end()) {
+        // Mark as most recently used
+        g_lru.splice(g_lru.begin(), g_lru, it->second);
+        return it->second->second;
+    }
+
+    if (g_undecodableApps.count(appId)) return 0;
+
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        if (g_stopDecoders || !g_queuedApps.insert(appId).second) return 0;
+
+        g_decodeQueue.push_back(appId);
+        if (g_decodeQueue.size() > MAX_PENDING_DECODES) {
+            g_queuedApps.erase(g_decodeQueue.front());
+            g_decodeQueue.pop_front();
+        }
+    }
+    g_queueCv.notify_one();
+
+    return 0;  // Placeholder until the decode completes
+}
+
+void InvalidateAppIcons(const std::vector<int>& appIds) {
+    for (int appId : appIds) {
+        // The atlas slot stays in the ImageList but is no longer looked up
+        auto atlasIt = std::lower_bound(g_atlasEntries.begin(), g_atlasEntries.end(), appId,
+            [](const IconAtlasEntry& e, int id) { return e.appId < id; });
+        if (atlasIt != g_atlasEntries.end() && atlasIt->appId == appId) g_atlasEntries.erase(atlasIt);
+
+        // Move the LRU slot to the back so it is reused first
+        auto it = g_slotByApp.find(appId);
+        if (it != g_slotByApp.end()) {
+            g_lru.splice(g_lru.end(), g_lru, it->second);
+            g_lru.back().first = -1;
+            g_slotByApp.erase(it);
+        }
+        g_undecodableApps.erase(appId);
+    }
+}
+
+int OnIconDecoded(WPARAM wParam, LPARAM lParam) {
+    int appId = (int)wParam;
+    HICON hIcon = (HICON)lParam;
+
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        g_queuedApps.erase(appId);
+    }
+
+    if (!hIcon) {
+        g_undecodableApps.insert(appId);
+        return -1;
+    }
+
+    if (!g_iconImageList || g_slotByApp.count(appId)) {
+        DestroyIcon(hIcon);
+        return -1;
+    }
+
+    int slot;
+    if (g_nextFreeSlot < g_firstLruSlot + ICON_CACHE_CAPACITY) {
+        slot = ImageList_AddIcon(g_iconImageList, hIcon);
+        if (slot >= 0) g_nextFreeSlot = slot + 1;
+    } else {
+        // Evict the least recently used icon and reuse its slot
+        auto& victim = g_lru.back();
+        slot = victim.second;
+        g_slotByApp.erase(victim.first);
+        g_lru.pop_back();
+        slot = ImageList_ReplaceIcon(g_iconImageList, slot, hIcon);
+    }
+    DestroyIcon(hIcon);
+
+    if (slot <= 0) return -1;
+
+    g_lru.emplace_front(appId, slot);
+    g_slotByApp[appId] = g_lru.begin();
+    return appId;
+}
+
+HICON LoadIconFromMemory(const unsigned char* data, int size) {
+    if (!data || size <= 0) return NULL;
+
+    // Check if it's an ICO file (starts with 0x00 0x00 0x01 0x00)
+    if (size >= 4 && data[0] == 0x00 && data[1] == 0x00 && data[2] == 0x01 && data[3] == 0x00) {
+        // Try to load as ICO
+        int offset = LookupIconIdFromDirectoryEx((PBYTE)data, TRUE, 16, 16, LR_DEFAULTCOLOR);
+        if (offset != 0 && offset < size) {
+            HICON hIcon = CreateIconFromResourceEx((PBYTE)data + offset, size - offset,
+                                                   TRUE, 0x00030000, 16, 16, LR_DEFAULTCOLOR);
+            if (hIcon) return hIcon;
+        }
+    }
+
+    // Check if it's a PNG file (starts with 0x89 'P' 'N' 'G')
+    if (size >= 8 && data[0] == 0x89 && data[1] == 0x50 && data[2] == 0x4E && data[3] == 0x47) {
+        // Try to load as PNG using IStream
+        IStream* pStream = SHCreateMemStream(data, size);
+        if (pStream) {
+            // For now, we'll skip PNG support and return NULL
+            // TODO: Implement PNG to HICON conversion using GDI+
+            pStream->Release();
+        }
+    }
+
+    // Return NULL if format not supported
+    return NULL;
+}
@@ -0,0 +1,45 @@
+#ifndef ICON_CACHE_H
+#define ICON_CACHE_H
+
+#include <windows.h>
+#include <commctrl.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Posted to the notify window when a background decode finishes.
+// wParam = app id, lParam = HICON (may be NULL if the blob could not be decoded).
+#define WM_APP_ICON_DECODED (WM_APP + 10)
+
+// Number of ImageList slots kept for decoded icons (slot 0 is the placeholder)
+#define ICON_CACHE_CAPACITY 512
+
+// Number of background decoder threads
+#define ICON_DECODER_THREADS 2
+
+// Start the decoder pool. Index 0 of imageList must already hold the placeholder icon.
+// If the icon atlas next to dbPath matches contentVersion its icons are added to
+// imageList in one operation and stay resident; other icons are decoded on demand
+// by threads that open their own read-only connection to dbPath.
+void InitIconCache(HIMAGELIST imageList, const std::wstring& dbPath, uint64_t contentVersion, HWND notifyWnd);
+
+// Stop the decoder threads, free the icons they posted that were not handled
+// yet and forget all cached slots. Call on the thread that owns notifyWnd.
+void ShutdownIconCache();
+
+// Get the ImageList index for an app. Returns 0 (placeholder) and queues a
+// background decode if the icon is not resident yet.
+int GetAppIconIndex(int appId, bool hasIcon);
+
+// Handle WM_APP_ICON_DECODED on the UI thread. Stores the icon in an LRU slot
+// and returns the app id whose rows need repainting (or -1 if nothing changed).
+int OnIconDecoded(WPARAM wParam, LPARAM lParam);
+
+// Forget the cached icons of apps whose icon changed in the database (UI thread).
+// Their atlas icons are no longer used; the next GetAppIconIndex decodes again.
+void InvalidateAppIcons(const std::vector<int>& appIds);
+
+// Decode an ICO blob into a 16x16 HICON (caller must DestroyIcon)
+HICON LoadIconFromMemory(const unsigned char* data, int size);
+
+#endif // ICON_CACHE_H
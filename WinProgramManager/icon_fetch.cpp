@@ -0,0 +1,502 @@
+#include "icon_fetch.h"
+#include "icon_image.h"
+#include "sql_batch.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <ctime>
+
+static const size_t MAX_TAG_LENGTH = 4096;      // Longer tags are cut (they are not icon links)
+static const int HOST_RETRY_DAYS = 3;           // A host that failed is skipped this long
+static const int NO_ICON_RETRY_DAYS = 30;       // A homepage without an icon is retried after this
+static const int ICON_BATCH_SIZE = 200;
+
+static std::string Lower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return text;
+}
+
+static bool EndsWith(const std::string& text, const char* suffix) {
+    size_t length = std::char_traits<char>::length(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// <link> scanning
+// ---------------------------------------------------------------------------
+
+// The few character references that turn up in href and rel values
+static std::string DecodeEntities(const std::string& value) {
+    if (value.find('&') == std::string::npos) return value;
+    static const struct {
+        const char* name;
+        char c;
+    } named[] = {{"amp;", '&'}, {"quot;", '"'}, {"apos;", '\''}, {"lt;", '<'}, {"gt;", '>'}};
+
+    std::string out;
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] != '&') {
+            out += value[i];
+            continue;
+        }
+        bool decoded = false;
+        for (const auto& entity : named) {
+            size_t length = std::char_traits<char>::length(entity.name);
+            if (value.compare(i + 1, length, entity.name) == 0) {
+                out += entity.c;
+                i += length;
+                decoded = true;
+                break;
+            }
+        }
+        size_t semicolon = value.find(';', i);
+        if (!decoded && i + 1 < value.size() && value[i + 1] == '#' && semicolon != std::string::npos) {
+            bool hex = i + 2 < value.size() && (value[i + 2] == 'x' || value[i + 2] == 'X');
+            long code = std::strtol(value.c_str() + i + (hex ? 3 : 2), nullptr, hex ? 16 : 10);
+            if (code > 0 && code < 128) {
+                out += (char)code;
+                i = semicolon;
+                decoded = true;
+            }
+        }
+        if (!decoded) out += '&';
+    }
+    return out;
+}
+
+// name -> value of the attributes after the tag name (names lowercase)
+static std::unordered_map<std::string, std::string> ParseAttributes(const std::string& tag, size_t pos) {
+    std::unordered_map<std::string, std::string> attributes;
+    auto isSpace = [](char c) { return std::isspace((unsigned char)c) != 0; };
+    while (pos < tag.size()) {
+        while (pos < tag.size() && (isSpace(tag[pos]) || tag[pos] == '/')) pos++;
+        size_t nameStart = pos;
+        while (pos < tag.size() && !isSpace(tag[pos]) && tag[pos] != '=' && tag[pos] != '/') pos++;
+        std::string name = Lower(tag.substr(nameStart, pos - nameStart));
+        while (pos < tag.size() && isSpace(tag[pos])) pos++;
+
+        std::string value;
+        if (pos < tag.size() && tag[pos] == '=') {
+            pos++;
+            while (pos < tag.size() && isSpace(tag[pos])) pos++;
+            if (pos < tag.size() && (tag[pos] == '"' || tag[pos] == '\'')) {
+                size_t close = tag.find(tag[pos], pos + 1);
+                if (close == std::string::npos) close = tag.size();
+                value = tag.substr(pos + 1, close - pos - 1);
+                pos = close + 1;
+            } else {
+                size_t valueStart = pos;
+                while (pos < tag.size() && !isSpace(tag[pos])) pos++;
+                value = tag.substr(valueStart, pos - valueStart);
+            }
+        }
+        if (!name.empty() && !attributes.count(name)) attributes[name] = DecodeEntities(value);
+    }
+    return attributes;
+}
+
+void IconLinkScanner::Feed(const char* data, size_t size) {
+    for (size_t i = 0; i < size && !done_; i++) {
+        char c = data[i];
+        switch (state_) {
+            case State::Text:
+                if (c == '<') {
+                    state_ = State::Tag;
+                    tag_.clear();
+                    quote_ = 0;
+                }
+                break;
+
+            case State::Tag:
+                if (tag_.empty() && !std::isalpha((unsigned char)c) && c != '/' && c != '!') {
+                    state_ = State::Text;  // A lone '<' in text
+                    break;
+                }
+                if (quote_) {
+                    if (c == quote_) quote_ = 0;
+                } else if (c == '"' || c == '\'') {
+                    quote_ = c;
+                } else if (c == '>') {
+                    HandleTag();
+                    if (state_ == State::Tag) state_ = State::Text;
+                    break;
+                }
+                if (tag_.size() < MAX_TAG_LENGTH) tag_ += c;
+                if (tag_ == "!--") {
+                    state_ = State::Comment;
+                    tail_.clear();
+                }
+                break;
+
+            case State::Comment:
+                tail_ += c;
+                if (tail_.size() > 3) tail_.erase(0, tail_.size() - 3);
+                if (tail_ == "-->") state_ = State::Text;
+                break;
+
+            case State::RawText:
+                // Script and style bodies may contain "<link" in strings; only
+                // their closing tag ends them
+                tail_ += (char)std::tolower((unsigned char)c);
+                if (tail_.size() > rawEnd_.size()) tail_.erase(0, tail_.size() - rawEnd_.size());
+                if (tail_ == rawEnd_) {
+                    state_ = State::Tag;
+                    tag_ = rawEnd_.substr(1);
+                    quote_ = 0;
+                }
+                break;
+        }
+    }
+}
+
+void IconLinkScanner::HandleTag() {
+    bool closing = !tag_.empty() && tag_[0] == '/';
+    size_t nameStart = closing ? 1 : 0;
+    size_t nameEnd = nameStart;
+    while (nameEnd < tag_.size() && !std::isspace((unsigned char)tag_[nameEnd]) && tag_[nameEnd] != '/') nameEnd++;
+    std::string name = Lower(tag_.substr(nameStart, nameEnd - nameStart));
+
+    if (closing) {
+        if (name == "head") done_ = true;
+        return;
+    }
+    if (name == "body") {
+        done_ = true;
+    } else if ((name == "script" || name == "style") && tag_.back() != '/') {
+        state_ = State::RawText;
+        rawEnd_ = "</" + name;
+        tail_.clear();
+    } else if (name == "base") {
+        if (baseHref_.empty()) baseHref_ = ParseAttributes(tag_, nameEnd)["href"];
+    } else if (name == "link") {
+        auto attributes = ParseAttributes(tag_, nameEnd);
+        bool icon = false, touchIcon = false;
+        std::string rel = Lower(attributes["rel"]);
+        size_t pos = 0;
+        while (pos < rel.size()) {
+            size_t end = rel.find_first_of(" \t\r\n", pos);
+            if (end == std::string::npos) end = rel.size();
+            std::string token = rel.substr(pos, end - pos);
+            icon = icon || token == "icon";
+            touchIcon = touchIcon || token == "apple-touch-icon" || token == "apple-touch-icon-precomposed";
+            pos = end + 1;
+        }
+        const std::string& href = attributes["href"];
+        if ((!icon && !touchIcon) || href.empty()) return;
+
+        // SVG (and inline data) cannot be decoded
+        std::string type = Lower(attributes["type"]);
+        std::string path = Lower(href.substr(0, href.find_first_of("?#")));
+        if (type == "image/svg+xml" || EndsWith(path, ".svg") || Lower(href.substr(0, 5)) == "data:") return;
+
+        int size = 0;
+        const std::string& sizes = attributes["sizes"];
+        for (size_t p = 0; p < sizes.size();) {
+            if (std::isdigit((unsigned char)sizes[p])) {
+                char* end = nullptr;
+                size = std::max(size, (int)std::strtol(sizes.c_str() + p, &end, 10));
+                p = end - sizes.c_str();
+                size_t next = sizes.find_first_of(" \t", p);  // Skip the height
+                p = next == std::string::npos ? sizes.size() : next;
+            } else {
+                p++;
+            }
+        }
+        if (size == 0 && touchIcon) size = 180;
+
+        // Nearest at or above the large list icon first; unsized favicons are
+        // usually multi-size ICOs, so they come right after an exact match
+        const int target = NORMALIZED_ICON_SIZES[1];
+        int distance = size == 0 ? target / 2 : size >= target ? size - target : (target - size) * 4;
+        bool decodable = type.find("png") != std::string::npos || type.find("icon") != std::string::npos ||
+                         EndsWith(path, ".png") || EndsWith(path, ".ico");
+        Link link;
+        link.href = href;
+        link.rank = (decodable ? 0 : 10000) + distance;
+        links_.push_back(link);
+    }
+}
+
+std::vector<std::string> IconLinkScanner::IconUrls(const std::string& pageUrl) const {
+    std::vector<Link> links = links_;
+    std::stable_sort(links.begin(), links.end(), [](const Link& a, const Link& b) { return a.rank < b.rank; });
+
+    std::string base = baseHref_.empty() ? pageUrl : ResolveUrl(pageUrl, baseHref_);
+    std::vector<std::string> urls;
+    for (const Link& link : links) {
+        std::string url = ResolveUrl(base, link.href);
+        if (std::find(urls.begin(), urls.end(), url) == urls.end()) urls.push_back(url);
+    }
+    return urls;
+}
+
+// ---------------------------------------------------------------------------
+// Fetching
+// ---------------------------------------------------------------------------
+
+IconFetcher::IconFetcher(HttpTransport& transport, const IconFetcherOptions& options)
+    : transport_(transport), options_(options) {}
+
+void IconFetcher::SkipHost(const std::string& host) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    skippedHosts_.insert(host);
+}
+
+std::vector<std::string> IconFetcher::FailedHosts() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::vector<std::string>(failedHosts_.begin(), failedHosts_.end());
+}
+
+bool IconFetcher::IsHostSkipped(const std::string& host) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return skippedHosts_.count(host) > 0 || failedHosts_.count(host) > 0;
+}
+
+void IconFetcher::MarkHostFailed(const std::string& host) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    failedHosts_.insert(host);
+}
+
+bool IconFetcher::GetBounded(const std::string& url, const HttpHeaders& headers, HttpResponse& response,
+                             std::vector<uint8_t>& body, size_t maxBytes) {
+    body.clear();
+    bool tooLarge = false;
+    bool answered = transport_.Get(url, headers, response, [&](const char* data, size_t size) {
+        if (body.size() + size > maxBytes) {
+            tooLarge = true;
+            return false;
+        }
+        body.insert(body.end(), data, data + size);
+        return true;
+    });
+    if (tooLarge) body.clear();
+    return answered;
+}
+
+std::shared_ptr<IconFetcher::Download> IconFetcher::DownloadIcon(const std::string& url) {
+    std::shared_ptr<Download> download;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::shared_ptr<Download>& slot = downloads_[url];
+        if (!slot) slot = std::make_shared<Download>();
+        download = slot;
+    }
+
+    // Homepages linking the same icon wait for the first download instead of
+    // repeating it
+    std::call_once(download->once, [&]() {
+        HttpResponse response;
+        std::vector<uint8_t> body;
+        if (!GetBounded(url, HttpHeaders(), response, body, options_.maxIconBytes)) {
+            UrlParts parts;
+            if (ParseUrl(url, parts)) MarkHostFailed(parts.Authority());
+            return;
+        }
+        download->etag = response.etag;
+        download->lastModified = response.lastModified;
+        download->image = response.status == 200 && NormalizeIcon(body.data(), body.size(), download->icon);
+    });
+    return download;
+}
+
+IconFetchResult IconFetcher::Fetch(const std::string& homepage, const IconSource* known) {
+    IconFetchResult result;
+    UrlParts parts;
+    if (!ParseUrl(homepage, parts)) return result;
+    if (IsHostSkipped(parts.Authority())) {
+        result.status = IconFetchResult::HostFailed;
+        return result;
+    }
+
+    // A known icon is revalidated; only a changed or vanished one means rediscovery
+    if (known && !known->iconUrl.empty() && !known->iconHash.empty()) {
+        HttpHeaders headers;
+        if (!known->etag.empty()) headers.emplace_back("If-None-Match", known->etag);
+        if (!known->lastModified.empty()) headers.emplace_back("If-Modified-Since", known->lastModified);
+        HttpResponse response;
+        std::vector<uint8_t> body;
+        if (GetBounded(known->iconUrl, headers, response, body, options_.maxIconBytes)) {
+            if (response.status == 304) {
+                result.status = IconFetchResult::NotModified;
+                result.source = *known;
+                if (!response.etag.empty()) result.source.etag = response.etag;
+                if (!response.lastModified.empty()) result.source.lastModified = response.lastModified;
+                return result;
+            }
+            if (response.status == 200 && NormalizeIcon(body.data(), body.size(), result.icon)) {
+                result.status = IconFetchResult::Fetched;
+                result.source.iconUrl = known->iconUrl;
+                result.source.etag = response.etag;
+                result.source.lastModified = response.lastModified;
+                return result;
+            }
+        }
+    }
+
+    // Discovery: stream the homepage through the scanner until </head>
+    IconLinkScanner scanner;
+    HttpResponse page;
+    size_t pageBytes = 0;
+    bool answered = transport_.Get(homepage, HttpHeaders(), page, [&](const char* data, size_t size) {
+        scanner.Feed(data, size);
+        pageBytes += size;
+        return !scanner.Done() && pageBytes < options_.maxPageBytes;
+    });
+    if (!answered || page.status >= 500) {
+        // A server error is retried another day too, but only a host that does
+        // not answer at all is skipped for its other homepages
+        if (!answered) MarkHostFailed(parts.Authority());
+        result.status = IconFetchResult::HostFailed;
+        return result;
+    }
+
+    std::string pageUrl = page.finalUrl.empty() ? homepage : page.finalUrl;
+    std::vector<std::string> candidates;
+    if (page.status >= 200 && page.status < 300) candidates = scanner.IconUrls(pageUrl);
+    std::string favicon = ResolveUrl(pageUrl, "/favicon.ico");
+    if (std::find(candidates.begin(), candidates.end(), favicon) == candidates.end()) candidates.push_back(favicon);
+
+    for (const std::string& url : candidates) {
+        UrlParts iconParts;
+        if (!ParseUrl(url, iconParts) || !transport_.SupportsScheme(iconParts.scheme) ||
+            IsHostSkipped(iconParts.Authority())) {
+            continue;
+        }
+        std::shared_ptr<Download> download = DownloadIcon(url);
+        if (!download->image) continue;
+        result.status = IconFetchResult::Fetched;
+        result.icon = download->icon;
+        result.source.iconUrl = url;
+        result.source.etag = download->etag;
+        result.source.lastModified = download->lastModified;
+        return result;
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Catalog
+// ---------------------------------------------------------------------------
+
+bool FetchCatalogIcons(sqlite3* db, HttpTransport& transport, const std::vector<std::string>& revalidate,
+                       const IconFetcherOptions& options, IconFetchStats& stats,
+                       const std::function<void(const FetchProgress& progress)>& progress) {
+    stats = IconFetchStats();
+    int64_t now = (int64_t)std::time(nullptr);
+
+    std::unordered_map<std::string, IconSource> sources;
+    std::vector<std::string> failedHosts;
+    if (!LoadIconSources(db, sources) ||
+        !LoadFailedIconHosts(db, now - HOST_RETRY_DAYS * 86400LL, failedHosts)) {
+        return false;
+    }
+
+    // Apps sharing a homepage whose icon is known get it without a fetch
+    const char* reuseSql =
+        "UPDATE apps SET icon_hash = (SELECT s.icon_hash FROM icon_sources s WHERE s.homepage = apps.homepage) "
+        "WHERE icon_hash IS NULL AND icon_data IS NULL AND homepage IN "
+        "(SELECT s.homepage FROM icon_sources s JOIN icons i ON i.hash = s.icon_hash);";
+    if (sqlite3_exec(db, reuseSql, nullptr, nullptr, nullptr) != SQLITE_OK) return false;
+    stats.reused = (size_t)sqlite3_changes(db);
+
+    // Homepages of apps still without an icon that were never tried, were tried a
+    // while ago, or lost their icon; then those of the refetched packages
+    std::vector<std::string> homepages;
+    std::unordered_set<std::string> seen;
+    const char* candidatesSql =
+        "SELECT DISTINCT a.homepage FROM apps a LEFT JOIN icon_sources s ON s.homepage = a.homepage "
+        "WHERE a.homepage <> '' AND a.icon_hash IS NULL AND a.icon_data IS NULL "
+        "AND (s.homepage IS NULL OR s.checked < ? OR s.icon_hash IS NOT NULL);";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, candidatesSql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+    sqlite3_bind_int64(stmt, 1, now - NO_ICON_RETRY_DAYS * 86400LL);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        std::string homepage = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        if (seen.insert(homepage).second) homepages.push_back(homepage);
+    }
+    sqlite3_finalize(stmt);
+
+    if (sqlite3_prepare_v2(db, "SELECT homepage FROM apps WHERE package_id = ? COLLATE NOCASE;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    for (const std::string& packageId : revalidate) {
+        sqlite3_bind_text(stmt, 1, packageId.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0)) {
+            std::string homepage = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            if (!homepage.empty() && seen.insert(homepage).second) homepages.push_back(homepage);
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    // Hosts that failed recently are left for a later run, and so are URLs the
+    // transport cannot fetch (https off Windows)
+    IconFetcher fetcher(transport, options);
+    std::unordered_set<std::string> skippedHosts(failedHosts.begin(), failedHosts.end());
+    for (const std::string& host : failedHosts) fetcher.SkipHost(host);
+    homepages.erase(std::remove_if(homepages.begin(), homepages.end(), [&](const std::string& homepage) {
+        UrlParts parts;
+        if (!ParseUrl(homepage, parts)) return false;  // Recorded as having no icon
+        bool skip = !transport.SupportsScheme(parts.scheme) || skippedHosts.count(parts.Authority()) > 0;
+        if (skip) stats.skipped++;
+        return skip;
+    }), homepages.end());
+    stats.homepages = homepages.size();
+
+    sqlite3_stmt* assign = nullptr;
+    if (sqlite3_prepare_v2(db, "UPDATE apps SET icon_hash = ? WHERE homepage = ?;", -1, &assign, nullptr) != SQLITE_OK) {
+        return false;
+    }
+
+    // Many hosts, so no shared rate limit; each host sees a handful of requests
+    FetchPipelineOptions pipelineOptions;
+    pipelineOptions.workers = options.workers;
+    pipelineOptions.requestsPerSecond = 0;
+    pipelineOptions.deadline = options.deadline;
+
+    BatchWriter batch(db, ICON_BATCH_SIZE);
+    pipelineOptions.idle = [&]() { batch.Idle(); };
+    stats.progress = RunFetchPipeline<IconFetchResult>(homepages,
+        [&](const std::string& homepage, IconFetchResult& result) {
+            auto known = sources.find(homepage);
+            result = fetcher.Fetch(homepage, known != sources.end() ? &known->second : nullptr);
+            return result.status != IconFetchResult::HostFailed;
+        },
+        [&](const std::string& homepage, IconFetchResult& result, bool) {
+            switch (result.status) {
+                case IconFetchResult::Fetched:
+                    stats.fetched++;
+                    if (!StoreIcon(db, result.icon, NORMALIZED_ICON_TYPE, result.source.iconHash)) return;
+                    break;
+                case IconFetchResult::NotModified:
+                    stats.notModified++;
+                    break;
+                case IconFetchResult::NoIcon:
+                    stats.noIcon++;
+                    result.source = IconSource();
+                    break;
+                case IconFetchResult::HostFailed:
+                    stats.hostFailed++;
+                    return;
+            }
+            result.source.checked = now;
+            SaveIconSource(db, homepage, result.source);
+
+            // Every app with this homepage shares the icon
+            if (!result.source.iconHash.empty()) {
+                sqlite3_reset(assign);
+                sqlite3_bind_blob(assign, 1, result.source.iconHash.data(), (int)result.source.iconHash.size(),
+                                  SQLITE_STATIC);
+                sqlite3_bind_text(assign, 2, homepage.c_str(), -1, SQLITE_STATIC);
+                sqlite3_step(assign);
+            }
+            batch.Row();
+        },
+        progress, pipelineOptions);
+    sqlite3_finalize(assign);
+
+    for (const std::string& host : fetcher.FailedHosts()) SaveFailedIconHost(db, host, now);
+    batch.Finish();
+    return true;
+}
@@ -0,0 +1,145 @@
+#ifndef ICON_FETCH_H
+#define ICON_FETCH_H
+
+// Icon discovery for package homepages. The homepage's <link rel="icon"> tags are
+// read while the page streams in (the download stops at </head>), with
+// /favicon.ico as the fallback, and the first candidate that decodes is stored
+// normalized (icon_image.h).
+//
+// Fetches run concurrently through the fetch pipeline. A homepage is fetched once
+// however many packages share it, an icon URL once however many homepages link to
+// it, and a host that does not answer is skipped for the rest of the run and for
+// a few days after. Later runs revalidate a known icon with If-None-Match /
+// If-Modified-Since instead of rediscovering it.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "fetch_pipeline.h"
+#include "http_transport.h"
+#include "icon_store.h"
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+// Transport settings for the icon fetch (see CreateHttpTransport)
+#define ICON_FETCH_TIMEOUT_MS 10000
+#define ICON_FETCH_USER_AGENT "Mozilla/5.0 (compatible; WinProgramManager)"
+
+// Collects the icon links of an HTML page fed to it in arbitrary pieces. Tags,
+// comments and <script>/<style> bodies may span pieces.
+class IconLinkScanner {
+public:
+    void Feed(const char* data, size_t size);
+
+    // Reached <body> or </head>: no more icon links to come
+    bool Done() const { return done_; }
+
+    // Icon URLs, best first (sizes nearest the list's large icon, PNG and ICO
+    // before other types), resolved against pageUrl or the page's <base href>
+    std::vector<std::string> IconUrls(const std::string& pageUrl) const;
+
+private:
+    struct Link {
+        std::string href;
+        int rank = 0;            // Lower is better
+    };
+
+    enum class State { Text, Tag, Comment, RawText };
+
+    void HandleTag();
+
+    State state_ = State::Text;
+    std::string tag_;            // Current tag, between '<' and '>'
+    char quote_ = 0;             // Quote open inside the tag
+    std::string rawEnd_;         // "</script" or "</style" while in RawText
+    std::string tail_;           // Last characters seen in Comment / RawText
+    std::string baseHref_;
+    std::vector<Link> links_;
+    bool done_ = false;
+};
+
+struct IconFetcherOptions {
+    int workers = 8;                    // Concurrent homepages
+    size_t maxPageBytes = 256 * 1024;   // Scanned for <link> tags before giving up
+    size_t maxIconBytes = 1024 * 1024;
+    std::chrono::steady_clock::time_point deadline =   // No new fetches start after this
+        std::chrono::steady_clock::time_point::max();
+};
+
+struct IconFetchResult {
+    enum Status {
+        NoIcon,          // The site answered but has no usable icon
+        Fetched,         // New or changed icon in `icon`
+        NotModified,     // The known icon is still current
+        HostFailed       // No answer (or a server error); try again another day
+    };
+    Status status = NoIcon;
+    IconSource source;              // Icon URL and validators (Fetched, NotModified)
+    std::vector<uint8_t> icon;      // Normalized (Fetched)
+};
+
+class IconFetcher {
+public:
+    explicit IconFetcher(HttpTransport& transport, const IconFetcherOptions& options = IconFetcherOptions());
+
+    // Treat the host (UrlParts::Authority) as failed, from an earlier run
+    void SkipHost(const std::string& host);
+
+    // Fetch the icon of one homepage. known is what an earlier run found there
+    // (nullptr if nothing); its icon URL is revalidated first. Thread-safe.
+    IconFetchResult Fetch(const std::string& homepage, const IconSource* known);
+
+    // Hosts that failed during this fetcher's lifetime
+    std::vector<std::string> FailedHosts() const;
+
+private:
+    struct Download {
+        std::once_flag once;
+        bool image = false;
+        std::vector<uint8_t> icon;       // Normalized
+        std::string etag;
+        std::string lastModified;
+    };
+
+    std::shared_ptr<Download> DownloadIcon(const std::string& url);
+    bool GetBounded(const std::string& url, const HttpHeaders& headers, HttpResponse& response,
+                    std::vector<uint8_t>& body, size_t maxBytes);
+    bool IsHostSkipped(const std::string& host) const;
+    void MarkHostFailed(const std::string& host);
+
+    HttpTransport& transport_;
+    IconFetcherOptions options_;
+    mutable std::mutex mutex_;
+    std::unordered_set<std::string> skippedHosts_;    // From earlier runs
+    std::unordered_set<std::string> failedHosts_;     // This run
+    std::unordered_map<std::string, std::shared_ptr<Download>> downloads_;   // By icon URL
+};
+
+struct IconFetchStats {
+    size_t homepages = 0;       // Distinct homepages fetched
+    size_t fetched = 0;
+    size_t notModified = 0;
+    size_t noIcon = 0;
+    size_t hostFailed = 0;
+    size_t skipped = 0;         // Homepages on hosts that failed recently (or not fetchable here)
+    size_t reused = 0;          // Apps given a known icon without a fetch
+    FetchProgress progress;
+};
+
+// Fetch icons for the catalog: apps without an icon whose homepage has not been
+// tried recently, and the apps in `revalidate` (packages refetched this run).
+// Icons, apps.icon_hash and icon_sources are written on the calling thread in
+// batched transactions. Returns false if the database could not be read.
+bool FetchCatalogIcons(sqlite3* db, HttpTransport& transport, const std::vector<std::string>& revalidate,
+                       const IconFetcherOptions& options, IconFetchStats& stats,
+                       const std::function<void(const FetchProgress& progress)>& progress);
+
+#endif // ICON_FETCH_H
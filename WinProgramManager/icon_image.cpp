@@ -0,0 +1,1313 @@
+#include "icon_image.h"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <utility>
+
+// Upper bounds that keep a hostile or broken download from exhausting memory
+static const uint32_t MAX_IMAGE_DIMENSION = 4096;
+static const uint64_t MAX_IMAGE_PIXELS = 4096ull * 4096ull;
+
+static uint32_t ReadBE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t ReadLE16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ---------------------------------------------------------------------------
+// Inflate (RFC 1950/1951) - just enough for PNG image data
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// Length and distance code bases and extra bits (RFC 1951, 3.2.5)
+const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t DIST_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577};
+const uint8_t DIST_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Order of the code length code lengths in a dynamic block header
+const uint8_t CODELEN_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+struct Huffman {
+    uint16_t counts[16];
+    uint16_t symbols[320];
+};
+
+bool BuildHuffman(Huffman& h, const uint8_t* lengths, int n) {
+    std::memset(h.counts, 0, sizeof(h.counts));
+    for (int i = 0; i < n; i++) h.counts[lengths[i]]++;
+    if (h.counts[0] == n) return true;  // No codes - only valid for an unused distance table
+
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left <<= 1;
+        left -= h.counts[len];
+        if (left < 0) return false;  // Over-subscribed
+    }
+
+    uint16_t offsets[16];
+    offsets[1] = 0;
+    for (int len = 1; len < 15; len++) offsets[len + 1] = offsets[len] + h.counts[len];
+    for (int sym = 0; sym < n; sym++) {
+        if (lengths[sym] != 0) h.symbols[offsets[lengths[sym]]++] = (uint16_t)sym;
+    }
+    return true;
+}
+
+class Inflater {
+public:
+    Inflater(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t maxOut)
+        : in_(data), inSize_(size), out_(out), maxOut_(maxOut) {}
+
+    bool Run() {
+        int last;
+        do {
+            last = Bits(1);
+            int type = Bits(2);
+            if (error_) return false;
+
+            bool ok;
+            switch (type) {
+                case 0: ok = Stored(); break;
+                case 1: ok = Fixed(); break;
+                case 2: ok = Dynamic(); break;
+                default: ok = false; break;
+            }
+            if (!ok) return false;
+        } while (!last);
+        return true;
+    }
+
+private:
+    int Bits(int need) {
+        uint32_t val = bitBuf_;
+        while (bitCount_ < need) {
+            if (pos_ >= inSize_) {
+                error_ = true;
+                return 0;
+            }
+            val |= (uint32_t)in_[pos_++] << bitCount_;
+            bitCount_ += 8;
+        }
+        bitBuf_ = val >> need;
+        bitCount_ -= need;
+        return (int)(val & ((1u << need) - 1));
+    }
+
+    int Decode(const Huffman& h) {
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len < 16; len++) {
+            code |= Bits(1);
+            if (error_) return -1;
+            int count = h.counts[len];
+            if (code - count < first) return h.symbols[index + (code - first)];
+            index += count;
+            first += count;
+            first <<= 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    bool Stored() {
+        bitBuf_ = 0;
+        bitCount_ = 0;
+        if (pos_ + 4 > inSize_) return false;
+        unsigned len = in_[pos_] | (in_[pos_ + 1] << 8);
+        unsigned nlen = in_[pos_ + 2] | (in_[pos_ + 3] << 8);
+        pos_ += 4;
+        if (len != (~nlen & 0xFFFF)) return false;
+        if (pos_ + len > inSize_ || out_.size() + len > maxOut_) return false;
+        out_.insert(out_.end(), in_ + pos_, in_ + pos_ + len);
+        pos_ += len;
+        return true;
+    }
+
+    bool Codes(const Huffman& lencode, const Huffman& distcode) {
+        while (true) {
+            int symbol = Decode(lencode);
+            if (symbol < 0) return false;
+            if (symbol < 256) {
+                if (out_.size() >= maxOut_) return false;
+                out_.push_back((uint8_t)symbol);
+            } else if (symbol == 256) {
+                return true;
+            } else {
+                symbol -= 257;
+                if (symbol >= 29) return false;
+                size_t len = LENGTH_BASE[symbol] + Bits(LENGTH_EXTRA[symbol]);
+                int distSymbol = Decode(distcode);
+                if (distSymbol < 0 || distSymbol >= 30) return false;
+                size_t dist = DIST_BASE[distSymbol] + Bits(DIST_EXTRA[distSymbol]);
+                if (error_ || dist > out_.size() || out_.size() + len > maxOut_) return false;
+                size_t from = out_.size() - dist;
+                for (size_t i = 0; i < len; i++) out_.push_back(out_[from + i]);
+            }
+        }
+    }
+
+    bool Fixed() {
+        uint8_t lengths[288];
+        int sym = 0;
+        for (; sym < 144; sym++) lengths[sym] = 8;
+        for (; sym < 256; sym++) lengths[sym] = 9;
+        for (; sym < 280; sym++) lengths[sym] = 7;
+        for (; sym < 288; sym++) lengths[sym] = 8;
+        Huffman lencode, distcode;
+        BuildHuffman(lencode, lengths, 288);
+        for (sym = 0; sym < 30; sym++) lengths[sym] = 5;
+        BuildHuffman(distcode, lengths, 30);
+        return Codes(lencode, distcode);
+    }
+
+    bool Dynamic() {
+
+        int nlen = Bits(5) + 257;
+        int ndist = Bits(5) + 1;
+        int ncode = Bits(4) + 4;
+        if (error_ || nlen > 286 || ndist > 30) return false;
+
+        uint8_t lengths[320] = {0};
+        for (int i = 0; i < ncode; i++) lengths[CODELEN_ORDER[i]] = (uint8_t)Bits(3);
+        if (error_) return false;
+
+        Huffman lencode, distcode;
+        if (!BuildHuffman(lencode, lengths, 19)) return false;
+
+        int index = 0;
+        while (index < nlen + ndist) {
+            int symbol = Decode(lencode);
+            if (symbol < 0) return false;
+            if (symbol < 16) {
+                lengths[index++] = (uint8_t)symbol;
+                continue;
+            }
+            uint8_t len = 0;
+            int repeat;
+            if (symbol == 16) {
+                if (index == 0) return false;
+                len = lengths[index - 1];
+                repeat = 3 + Bits(2);
+            } else if (symbol == 17) {
+                repeat = 3 + Bits(3);
+            } else {
+                repeat = 11 + Bits(7);
+            }
+            if (error_ || index + repeat > nlen + ndist) return false;
+            while (repeat--) lengths[index++] = len;
+        }
+
+        if (lengths[256] == 0) return false;  // No end-of-block code
+        if (!BuildHuffman(lencode, lengths, nlen)) return false;
+        if (!BuildHuffman(distcode, lengths + nlen, ndist)) return false;
+        return Codes(lencode, distcode);
+    }
+
+    const uint8_t* in_;
+    size_t inSize_;
+    size_t pos_ = 0;
+    uint32_t bitBuf_ = 0;
+    int bitCount_ = 0;
+    bool error_ = false;
+    std::vector<uint8_t>& out_;
+    size_t maxOut_;
+};
+
+bool ZlibDecompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t maxOut) {
+    if (size < 2) return false;
+    uint8_t cmf = data[0];
+    uint8_t flg = data[1];
+    if ((cmf & 0x0F) != 8 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20)) return false;
+    Inflater inflater(data + 2, size - 2, out, maxOut);
+    return inflater.Run();
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// Format detection
+// ---------------------------------------------------------------------------
+
+ImageFormat DetectImageFormat(const uint8_t* data, size_t size) {
+    static const uint8_t pngSignature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    if (!data) return ImageFormat::Unknown;
+    if (size >= 8 && std::memcmp(data, pngSignature, 8) == 0) return ImageFormat::Png;
+    if (size >= 6 && data[0] == 0 && data[1] == 0 && (data[2] == 1 || data[2] == 2) && data[3] == 0 &&
+        ReadLE16(data + 4) > 0) {
+        return ImageFormat::Ico;
+    }
+    return ImageFormat::Unknown;
+}
+
+bool ReadImageSize(const uint8_t* data, size_t size, int& width, int& height) {
+    width = height = 0;
+    switch (DetectImageFormat(data, size)) {
+        case ImageFormat::Png:
+            // Signature, then the IHDR chunk: length, type, width, height
+            if (size < 24 || std::memcmp(data + 12, "IHDR", 4) != 0) return false;
+            width = (int)std::min<uint32_t>(ReadBE32(data + 16), 0x7FFFFFFF);
+            height = (int)std::min<uint32_t>(ReadBE32(data + 20), 0x7FFFFFFF);
+            return width > 0 && height > 0;
+        case ImageFormat::Ico: {
+            uint16_t count = ReadLE16(data + 4);
+            for (uint16_t i = 0; i < count && 6 + (size_t)i * 16 + 16 <= size; i++) {
+                const uint8_t* entry = data + 6 + (size_t)i * 16;
+                int w = entry[0] ? entry[0] : 256;
+                int h = entry[1] ? entry[1] : 256;
+                if (w * h > width * height) {
+                    width = w;
+                    height = h;
+                }
+            }
+            return width > 0;
+        }
+        default:
+            return false;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// PNG
+// ---------------------------------------------------------------------------
+
+static uint8_t Paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = p > a ? p - a : a - p;
+    int pb = p > b ? p - b : b - p;
+    int pc = p > c ? p - c : c - p;
+    if (pa <= pb && pa <= pc) return (uint8_t)a;
+    if (pb <= pc) return (uint8_t)b;
+    return (uint8_t)c;
+}
+
+static bool Unfilter(uint8_t* rows, size_t rowBytes, uint32_t height, size_t bpp) {
+    std::vector<uint8_t> zeroRow(rowBytes, 0);
+    const uint8_t* prev = zeroRow.data();
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* row = rows + y * (rowBytes + 1);
+        uint8_t filter = row[0];
+        uint8_t* cur = row + 1;
+        switch (filter) {
+            case 0:
+                break;
+            case 1:
+                for (size_t i = bpp; i < rowBytes; i++) cur[i] = (uint8_t)(cur[i] + cur[i - bpp]);
+                break;
+            case 2:
+                for (size_t i = 0; i < rowBytes; i++) cur[i] = (uint8_t)(cur[i] + prev[i]);
+                break;
+            case 3:
+                for (size_t i = 0; i < rowBytes; i++) {
+                    int left = i >= bpp ? cur[i - bpp] : 0;
+                    cur[i] = (uint8_t)(cur[i] + ((left + prev[i]) >> 1));
+                }
+                break;
+            case 4:
+                for (size_t i = 0; i < rowBytes; i++) {
+                    int left = i >= bpp ? cur[i - bpp] : 0;
+                    int upLeft = i >= bpp ? prev[i - bpp] : 0;
+                    cur[i] = (uint8_t)(cur[i] + Paeth(left, prev[i], upLeft));
+                }
+                break;
+            default:
+                return false;
+        }
+        prev = cur;
+    }
+    return true;
+}
+
+bool DecodePng(const uint8_t* data, size_t size, DecodedImage& out) {
+    if (DetectImageFormat(data, size) != ImageFormat::Png) return false;
+
+    uint32_t width = 0, height = 0;
+    uint8_t bitDepth = 0, colorType = 0, interlace = 0;
+    bool haveHeader = false;
+    std::vector<uint8_t> idat;
+    uint8_t palette[256][4];
+    int paletteSize = 0;
+    bool haveTrns = false;
+    uint16_t trnsGray = 0, trnsR = 0, trnsG = 0, trnsB = 0;
+
+    for (int i = 0; i < 256; i++) {
+        palette[i][0] = palette[i][1] = palette[i][2] = 0;
+        palette[i][3] = 255;
+    }
+
+    size_t pos = 8;
+    while (pos + 12 <= size) {
+        uint32_t length = ReadBE32(data + pos);
+        const uint8_t* type = data + pos + 4;
+        const uint8_t* chunk = data + pos + 8;
+        if (length > size - pos - 12) return false;
+
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            if (length < 13) return false;
+            width = ReadBE32(chunk);
+            height = ReadBE32(chunk + 4);
+            bitDepth = chunk[8];
+            colorType = chunk[9];
+            if (chunk[10] != 0 || chunk[11] != 0) return false;
+            interlace = chunk[12];
+            haveHeader = true;
+        } else if (std::memcmp(type, "PLTE", 4) == 0) {
+            paletteSize = (int)std::min<uint32_t>(length / 3, 256);
+            for (int i = 0; i < paletteSize; i++) {
+                palette[i][0] = chunk[i * 3];
+                palette[i][1] = chunk[i * 3 + 1];
+                palette[i][2] = chunk[i * 3 + 2];
+            }
+        } else if (std::memcmp(type, "tRNS", 4) == 0) {
+            haveTrns = true;
+            if (colorType == 3) {
+                for (uint32_t i = 0; i < length && i < 256; i++) palette[i][3] = chunk[i];
+            } else if (colorType == 0 && length >= 2) {
+                trnsGray = (uint16_t)((chunk[0] << 8) | chunk[1]);
+            } else if (colorType == 2 && length >= 6) {
+                trnsR = (uint16_t)((chunk[0] << 8) | chunk[1]);
+                trnsG = (uint16_t)((chunk[2] << 8) | chunk[3]);
+                trnsB = (uint16_t)((chunk[4] << 8) | chunk[5]);
+            }
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            idat.insert(idat.end(), chunk, chunk + length);
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        pos += 12 + length;
+    }
+
+    if (!haveHeader || idat.empty()) return false;
+    if (width == 0 || height == 0 || width > MAX_IMAGE_DIMENSION || height > MAX_IMAGE_DIMENSION) return false;
+    if ((uint64_t)width * height > MAX_IMAGE_PIXELS || interlace > 1) return false;
+
+    int channels;
+    switch (colorType) {
+        case 0: channels = 1; break;
+        case 2: channels = 3; break;
+        case 3: channels = 1; break;
+        case 4: channels = 2; break;
+        case 6: channels = 4; break;
+        default: return false;
+    }
+    bool validDepth = (bitDepth == 8) ||
+                      (bitDepth == 16 && colorType != 3) ||
+                      ((bitDepth == 1 || bitDepth == 2 || bitDepth == 4) && (colorType == 0 || colorType == 3));
+    if (!validDepth) return false;
+    if (colorType == 3 && paletteSize == 0) return false;
+
+    const size_t bitsPerPixel = (size_t)channels * bitDepth;
+    const size_t bpp = std::max<size_t>(1, bitsPerPixel / 8);
+
+    // Adam7 pass layout (a single full pass when not interlaced)
+    static const int adam7[7][4] = {
+        {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+    static const int single[1][4] = {{0, 0, 1, 1}};
+    const int (*passes)[4] = interlace ? adam7 : single;
+    int passCount = interlace ? 7 : 1;
+
+    size_t expected = 0;
+    for (int p = 0; p < passCount; p++) {
+        uint32_t pw = (width - passes[p][0] + passes[p][2] - 1) / passes[p][2];
+        uint32_t ph = (height - passes[p][1] + passes[p][3] - 1) / passes[p][3];
+        if (width <= (uint32_t)passes[p][0] || height <= (uint32_t)passes[p][1]) continue;
+        expected += (size_t)ph * (1 + (pw * bitsPerPixel + 7) / 8);
+    }
+
+    std::vector<uint8_t> raw;
+    raw.reserve(expected);
+    if (!ZlibDecompress(idat.data(), idat.size(), raw, expected) || raw.size() < expected) return false;
+
+    out.width = (int)width;
+    out.height = (int)height;
+    out.rgba.assign((size_t)width * height * 4, 0);
+
+    const uint32_t maxSample = (1u << bitDepth) - 1;
+    size_t offset = 0;
+    for (int p = 0; p < passCount; p++) {
+        if (width <= (uint32_t)passes[p][0] || height <= (uint32_t)passes[p][1]) continue;
+        uint32_t pw = (width - passes[p][0] + passes[p][2] - 1) / passes[p][2];
+        uint32_t ph = (height - passes[p][1] + passes[p][3] - 1) / passes[p][3];
+        size_t rowBytes = (pw * bitsPerPixel + 7) / 8;
+        uint8_t* rows = raw.data() + offset;
+        if (!Unfilter(rows, rowBytes, ph, bpp)) return false;
+
+        for (uint32_t y = 0; y < ph; y++) {
+            const uint8_t* row = rows + y * (rowBytes + 1) + 1;
+            for (uint32_t x = 0; x < pw; x++) {
+                uint32_t samples[4] = {0, 0, 0, 0};
+                for (int c = 0; c < channels; c++) {
+                    if (bitDepth == 8) {
+                        samples[c] = row[x * channels + c];
+                    } else if (bitDepth == 16) {
+                        const uint8_t* s = row + (x * channels + c) * 2;
+                        samples[c] = (uint32_t)((s[0] << 8) | s[1]);
+                    } else {
+                        size_t bit = (size_t)x * bitDepth;
+                        samples[c] = (row[bit / 8] >> (8 - bitDepth - (bit % 8))) & maxSample;
+                    }
+                }
+
+                auto to8 = [&](uint32_t v) -> uint8_t {
+                    if (bitDepth == 16) return (uint8_t)(v >> 8);
+                    if (bitDepth == 8) return (uint8_t)v;
+                    return (uint8_t)(v * 255 / maxSample);
+                };
+
+                uint8_t r, g, b, a = 255;
+                switch (colorType) {
+                    case 0:
+                        r = g = b = to8(samples[0]);
+                        if (haveTrns && samples[0] == trnsGray) a = 0;
+                        break;
+                    case 2:
+                        r = to8(samples[0]);
+                        g = to8(samples[1]);
+                        b = to8(samples[2]);
+                        if (haveTrns && samples[0] == trnsR && samples[1] == trnsG && samples[2] == trnsB) a = 0;
+                        break;
+                    case 3: {
+                        uint32_t index = samples[0];
+                        if ((int)index >= paletteSize) return false;
+                        r = palette[index][0];
+                        g = palette[index][1];
+                        b = palette[index][2];
+                        a = palette[index][3];
+                        break;
+                    }
+                    case 4:
+                        r = g = b = to8(samples[0]);
+                        a = to8(samples[1]);
+                        break;
+                    default:
+                        r = to8(samples[0]);
+                        g = to8(samples[1]);
+                        b = to8(samples[2]);
+                        a = to8(samples[3]);
+                        break;
+                }
+
+                size_t px = (size_t)(passes[p][1] + y * passes[p][3]) * width + passes[p][0] + x * passes[p][2];
+                uint8_t* dst = out.rgba.data() + px * 4;
+                dst[0] = r;
+                dst[1] = g;
+                dst[2] = b;
+                dst[3] = a;
+            }
+        }
+        offset += (size_t)ph * (rowBytes + 1);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// ICO
+// ---------------------------------------------------------------------------
+
+static bool DecodeDib(const uint8_t* data, size_t size, DecodedImage& out) {
+    if (size < 40) return false;
+    uint32_t headerSize = ReadLE32(data);
+    if (headerSize < 40 || headerSize > size) return false;
+
+    int32_t width = (int32_t)ReadLE32(data + 4);
+    int32_t fullHeight = (int32_t)ReadLE32(data + 8);
+    uint16_t bitCount = ReadLE16(data + 14);
+    uint32_t compression = ReadLE32(data + 16);
+    uint32_t colorsUsed = ReadLE32(data + 32);
+
+    // Icon DIBs store XOR + AND bitmaps, so the header height is doubled
+    int32_t height = (fullHeight < 0 ? -fullHeight : fullHeight) / 2;
+    if (width <= 0 || height <= 0 || (uint32_t)width > MAX_IMAGE_DIMENSION || (uint32_t)height > MAX_IMAGE_DIMENSION) {
+        return false;
+    }
+    if (compression != 0 && !(compression == 3 && bitCount == 32)) return false;
+    if (bitCount != 1 && bitCount != 4 && bitCount != 8 && bitCount != 24 && bitCount != 32) return false;
+
+    size_t pos = headerSize;
+    if (compression == 3) pos += 12;  // BI_BITFIELDS masks (assumed BGRA order)
+
+    uint8_t palette[256][3];
+    if (bitCount <= 8) {
+        uint32_t colors = colorsUsed ? std::min<uint32_t>(colorsUsed, 256) : (1u << bitCount);
+        if (pos + colors * 4 > size) return false;
+        for (uint32_t i = 0; i < colors; i++) {
+            palette[i][0] = data[pos + i * 4 + 2];
+            palette[i][1] = data[pos + i * 4 + 1];
+            palette[i][2] = data[pos + i * 4];
+        }
+        for (uint32_t i = colors; i < 256; i++) palette[i][0] = palette[i][1] = palette[i][2] = 0;
+        pos += colors * 4;
+    }
+
+    size_t xorStride = (((size_t)width * bitCount + 31) / 32) * 4;
+    size_t andStride = (((size_t)width + 31) / 32) * 4;
+    if (pos + xorStride * height > size) return false;
+    const uint8_t* xorBits = data + pos;
+    const uint8_t* andBits = data + pos + xorStride * height;
+    bool haveMask = pos + xorStride * height + andStride * height <= size;
+    bool bottomUp = fullHeight > 0;
+
+    out.width = width;
+    out.height = height;
+    out.rgba.assign((size_t)width * height * 4, 0);
+
+    bool anyAlpha = false;
+    for (int32_t y = 0; y < height; y++) {
+        int32_t srcRow = bottomUp ? height - 1 - y : y;
+        const uint8_t* row = xorBits + srcRow * xorStride;
+        for (int32_t x = 0; x < width; x++) {
+            uint8_t* dst = out.rgba.data() + ((size_t)y * width + x) * 4;
+            if (bitCount == 32) {
+                dst[0] = row[x * 4 + 2];
+                dst[1] = row[x * 4 + 1];
+                dst[2] = row[x * 4];
+                dst[3] = row[x * 4 + 3];
+                if (dst[3]) anyAlpha = true;
+            } else if (bitCount == 24) {
+                dst[0] = row[x * 3 + 2];
+                dst[1] = row[x * 3 + 1];
+                dst[2] = row[x * 3];
+                dst[3] = 255;
+            } else {
+                size_t bit = (size_t)x * bitCount;
+                uint32_t index = (row[bit / 8] >> (8 - bitCount - (bit % 8))) & ((1u << bitCount) - 1);
+                dst[0] = palette[index][0];
+                dst[1] = palette[index][1];
+                dst[2] = palette[index][2];
+                dst[3] = 255;
+            }
+        }
+    }
+
+    // 32-bit frames carry real alpha; everything else relies on the AND mask
+    if (!(bitCount == 32 && anyAlpha) && haveMask) {
+        for (int32_t y = 0; y < height; y++) {
+            int32_t srcRow = bottomUp ? height - 1 - y : y;
+            const uint8_t* row = andBits + srcRow * andStride;
+            for (int32_t x = 0; x < width; x++) {
+                bool transparent = (row[x / 8] >> (7 - (x % 8))) & 1;
+                out.rgba[((size_t)y * width + x) * 4 + 3] = transparent ? 0 : 255;
+            }
+        }
+    } else if (bitCount == 32 && !anyAlpha) {
+        for (size_t i = 3; i < out.rgba.size(); i += 4) out.rgba[i] = 255;
+    }
+    return true;
+}
+
+bool DecodeIco(const uint8_t* data, size_t size, int preferredSize, DecodedImage& out) {
+    if (DetectImageFormat(data, size) != ImageFormat::Ico) return false;
+
+    struct Frame {
+        int size;
+        int bitCount;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    uint16_t count = ReadLE16(data + 4);
+    std::vector<Frame> frames;
+    for (uint16_t i = 0; i < count; i++) {
+        size_t entry = 6 + (size_t)i * 16;
+        if (entry + 16 > size) break;
+        Frame f;
+        int w = data[entry] ? data[entry] : 256;
+        int h = data[entry + 1] ? data[entry + 1] : 256;
+        f.size = std::max(w, h);
+        f.bitCount = ReadLE16(data + entry + 6);
+        f.length = ReadLE32(data + entry + 8);
+        f.offset = ReadLE32(data + entry + 12);
+        if (f.offset >= size || f.length == 0 || f.length > size - f.offset) continue;
+        frames.push_back(f);
+    }
+    if (frames.empty()) return false;
+
+    // Preference: frames at least as large as requested (smallest first),
+    // then smaller frames (largest first); deeper colour breaks ties.
+    std::sort(frames.begin(), frames.end(), [preferredSize](const Frame& a, const Frame& b) {
+        bool aFits = a.size >= preferredSize;
+        bool bFits = b.size >= preferredSize;
+        if (aFits != bFits) return aFits;
+        if (a.size != b.size) return aFits ? a.size < b.size : a.size > b.size;
+        return a.bitCount > b.bitCount;
+    });
+
+    for (const auto& f : frames) {
+        const uint8_t* frameData = data + f.offset;
+        bool ok = DetectImageFormat(frameData, f.length) == ImageFormat::Png
+                      ? DecodePng(frameData, f.length, out)
+                      : DecodeDib(frameData, f.length, out);
+        if (ok) return true;
+    }
+    return false;
+}
+
+bool DecodeImage(const uint8_t* data, size_t size, int preferredSize, DecodedImage& out) {
+    switch (DetectImageFormat(data, size)) {
+        case ImageFormat::Png: return DecodePng(data, size, out);
+        case ImageFormat::Ico: return DecodeIco(data, size, preferredSize, out);
+        default: return false;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Scaling
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct Tap {
+    int index;
+    float weight;
+};
+
+// Area-coverage weights mapping dstLen output pixels onto srcLen input pixels
+std::vector<std::vector<Tap>> ComputeTaps(int srcLen, int dstLen) {
+    std::vector<std::vector<Tap>> taps(dstLen);
+    float scale = (float)srcLen / dstLen;
+    for (int d = 0; d < dstLen; d++) {
+        float start = d * scale;
+        float end = start + scale;
+        float total = 0.0f;
+        for (int s = (int)start; s < srcLen && s < end; s++) {
+            float w = std::min(end, (float)(s + 1)) - std::max(start, (float)s);
+            if (w <= 0.0f) continue;
+            taps[d].push_back({s, w});
+            total += w;
+        }
+        for (auto& t : taps[d]) t.weight /= total;
+    }
+    return taps;
+}
+
+}  // namespace
+
+// Area-averaged scale into size x size, centred on a transparent background.
+// Writes premultiplied BGRA or straight RGBA.
+static void Render(const DecodedImage& src, int size, bool premultipliedBgra, uint8_t* dst) {
+    std::memset(dst, 0, (size_t)size * size * 4);
+    if (src.width <= 0 || src.height <= 0 || size <= 0) return;
+
+    int dstW = size, dstH = size;
+    if (src.width > src.height) {
+        dstH = std::max(1, (int)((long long)size * src.height / src.width));
+    } else if (src.height > src.width) {
+        dstW = std::max(1, (int)((long long)size * src.width / src.height));
+    }
+    int offsetX = (size - dstW) / 2;
+    int offsetY = (size - dstH) / 2;
+
+    auto xTaps = ComputeTaps(src.width, dstW);
+    auto yTaps = ComputeTaps(src.height, dstH);
+
+    for (int y = 0; y < dstH; y++) {
+        for (int x = 0; x < dstW; x++) {
+            float r = 0, g = 0, b = 0, a = 0;
+            for (const auto& ty : yTaps[y]) {
+                const uint8_t* row = src.rgba.data() + (size_t)ty.index * src.width * 4;
+                for (const auto& tx : xTaps[x]) {
+                    const uint8_t* p = row + (size_t)tx.index * 4;
+                    float w = ty.weight * tx.weight;
+                    float pa = p[3] * w;
+                    r += p[0] * pa;
+                    g += p[1] * pa;
+                    b += p[2] * pa;
+                    a += pa;
+                }
+            }
+            uint8_t* out = dst + ((size_t)(y + offsetY) * size + x + offsetX) * 4;
+            if (premultipliedBgra) {
+                out[0] = (uint8_t)std::min(255.0f, b / 255.0f + 0.5f);
+                out[1] = (uint8_t)std::min(255.0f, g / 255.0f + 0.5f);
+                out[2] = (uint8_t)std::min(255.0f, r / 255.0f + 0.5f);
+            } else if (a > 0.0f) {
+                out[0] = (uint8_t)std::min(255.0f, r / a + 0.5f);
+                out[1] = (uint8_t)std::min(255.0f, g / a + 0.5f);
+                out[2] = (uint8_t)std::min(255.0f, b / a + 0.5f);
+            }
+            out[3] = (uint8_t)std::min(255.0f, a + 0.5f);
+        }
+    }
+}
+
+void RenderPremultipliedBgra(const DecodedImage& src, int size, uint8_t* dst) {
+    Render(src, size, true, dst);
+}
+
+void RenderRgba(const DecodedImage& src, int size, DecodedImage& out) {
+    out.width = out.height = std::max(size, 0);
+    out.rgba.resize((size_t)out.width * out.height * 4);
+    Render(src, out.width, false, out.rgba.data());
+}
+
+// ---------------------------------------------------------------------------
+// Deflate (RFC 1950/1951) - LZ77 with lazy matching, written as one block with
+// its own Huffman codes, the fixed codes or stored, whichever is smallest
+// ---------------------------------------------------------------------------
+
+namespace {
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    // Least significant bit first
+    void Put(uint32_t bits, int count) {
+        bitBuf_ |= bits << bitCount_;
+        bitCount_ += count;
+        while (bitCount_ >= 8) {
+            out_.push_back((uint8_t)bitBuf_);
+            bitBuf_ >>= 8;
+            bitCount_ -= 8;
+        }
+    }
+
+    // Huffman codes go most significant bit first
+    void PutCode(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; i++) reversed |= ((code >> i) & 1) << (length - 1 - i);
+        Put(reversed, length);
+    }
+
+    void Flush() {
+        if (bitCount_ > 0) out_.push_back((uint8_t)bitBuf_);
+        bitBuf_ = 0;
+        bitCount_ = 0;
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint32_t bitBuf_ = 0;
+    int bitCount_ = 0;
+};
+
+const int LITLEN_SYMBOLS = 286;
+const int DIST_SYMBOLS = 30;
+const int CODELEN_SYMBOLS = 19;
+const int END_OF_BLOCK = 256;
+
+// Literal byte (distance 0) or a match of length bytes distance back
+struct Lz77Token {
+    uint16_t length;
+    uint16_t distance;
+};
+
+int LengthCode(int length) {
+    int code = 28;
+    while (LENGTH_BASE[code] > length) code--;
+    return code;
+}
+
+int DistanceCode(int distance) {
+    int code = 29;
+    while (DIST_BASE[code] > distance) code--;
+    return code;
+}
+
+// Greedy LZ77 over hash chains of 3-byte prefixes, with one step of lazy
+// matching: a match is put off by a byte if the next position has a longer one
+std::vector<Lz77Token> FindMatches(const uint8_t* data, size_t size) {
+    const size_t WINDOW = 32768;
+    const size_t MIN_MATCH = 3;
+    const size_t MAX_MATCH = 258;
+    const int MAX_CHAIN = 128;
+    const int HASH_BITS = 15;
+
+    // head holds the latest position per hash, prev the position before it with the same hash
+    std::vector<int> head((size_t)1 << HASH_BITS, -1);
+    std::vector<int> prev(size, -1);
+    auto hashAt = [&](size_t i) {
+        return ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & ((1 << HASH_BITS) - 1);
+    };
+    size_t inserted = 0;  // Positions below this are in the chains
+    auto insertUpTo = [&](size_t end) {
+        for (; inserted < end; inserted++) {
+            if (inserted + MIN_MATCH > size) continue;
+            int h = hashAt(inserted);
+            prev[inserted] = head[h];
+            head[h] = (int)inserted;
+        }
+    };
+    auto longestMatch = [&](size_t pos, size_t& distance) {
+        size_t bestLength = 0;
+        if (pos + MIN_MATCH > size) return bestLength;
+        insertUpTo(pos);
+        size_t maxLength = std::min(MAX_MATCH, size - pos);
+        int candidate = head[hashAt(pos)];
+        for (int chain = 0; candidate >= 0 && chain < MAX_CHAIN && pos - candidate <= WINDOW; chain++) {
+            size_t length = 0;
+            while (length < maxLength && data[candidate + length] == data[pos + length]) length++;
+            if (length > bestLength) {
+                bestLength = length;
+                distance = pos - candidate;
+                if (length == maxLength) break;
+            }
+            candidate = prev[candidate];
+        }
+        return bestLength;
+    };
+
+    std::vector<Lz77Token> tokens;
+    size_t pos = 0;
+    while (pos < size) {
+        size_t distance = 0, nextDistance = 0;
+        size_t length = longestMatch(pos, distance);
+        if (length >= MIN_MATCH && length < MAX_MATCH && longestMatch(pos + 1, nextDistance) > length) {
+            length = 0;  // The literal now, the longer match next
+        }
+        if (length >= MIN_MATCH) {
+            tokens.push_back({(uint16_t)length, (uint16_t)distance});
+            pos += length;
+        } else {
+            tokens.push_back({data[pos], 0});
+            pos++;
+        }
+    }
+    return tokens;
+}
+
+// Huffman code lengths for the given symbol frequencies, none longer than
+// maxLength: the frequencies are halved until the tree is shallow enough
+std::vector<uint8_t> HuffmanLengths(std::vector<uint32_t> freq, int maxLength) {
+    std::vector<uint8_t> lengths(freq.size(), 0);
+    for (;;) {
+        // Leaves first, then each internal node after its two children
+        std::vector<int> symbols, parent;
+        typedef std::pair<uint32_t, int> Node;
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+        for (size_t s = 0; s < freq.size(); s++) {
+            if (!freq[s]) continue;
+            queue.push({freq[s], (int)symbols.size()});
+            symbols.push_back((int)s);
+        }
+        if (symbols.empty()) return lengths;
+        if (symbols.size() == 1) {
+            lengths[symbols[0]] = 1;
+            return lengths;
+        }
+        parent.assign(symbols.size(), -1);
+        while (queue.size() > 1) {
+            Node a = queue.top();
+            queue.pop();
+            Node b = queue.top();
+            queue.pop();
+            int node = (int)parent.size();
+            parent.push_back(-1);
+            parent[a.second] = node;
+            parent[b.second] = node;
+            queue.push({a.first + b.first, node});
+        }
+
+        // The root is the last node; parents come after their children
+        std::vector<int> depth(parent.size(), 0);
+        for (int i = (int)parent.size() - 2; i >= 0; i--) depth[i] = depth[parent[i]] + 1;
+        int longest = 0;
+        for (size_t i = 0; i < symbols.size(); i++) longest = std::max(longest, depth[i]);
+        if (longest <= maxLength) {
+            for (size_t i = 0; i < symbols.size(); i++) lengths[symbols[i]] = (uint8_t)depth[i];
+            return lengths;
+        }
+        for (uint32_t& f : freq) {
+            if (f) f = (f + 1) / 2;
+        }
+    }
+}
+
+// Canonical codes for the lengths (RFC 1951, 3.2.2)
+std::vector<uint16_t> CanonicalCodes(const std::vector<uint8_t>& lengths) {
+    int counts[16] = {};
+    for (uint8_t length : lengths) counts[length]++;
+    counts[0] = 0;
+    uint16_t next[16] = {};
+    uint16_t code = 0;
+    for (int bits = 1; bits < 16; bits++) {
+        code = (uint16_t)((code + counts[bits - 1]) << 1);
+        next[bits] = code;
+    }
+    std::vector<uint16_t> codes(lengths.size(), 0);
+    for (size_t s = 0; s < lengths.size(); s++) {
+        if (lengths[s]) codes[s] = next[lengths[s]]++;
+    }
+    return codes;
+}
+
+struct DeflateCodes {
+    std::vector<uint8_t> litLengths, distLengths;
+    std::vector<uint16_t> litCodes, distCodes;
+
+    void Build() {
+        litCodes = CanonicalCodes(litLengths);
+        distCodes = CanonicalCodes(distLengths);
+    }
+
+    // Bits the tokens (and the end of block) take with these codes
+    uint64_t Cost(const std::vector<Lz77Token>& tokens) const {
+        uint64_t bits = litLengths[END_OF_BLOCK];
+        for (const Lz77Token& token : tokens) {
+            if (token.distance == 0) {
+                bits += litLengths[token.length];
+            } else {
+                int lengthCode = LengthCode(token.length);
+                int distanceCode = DistanceCode(token.distance);
+                bits += litLengths[257 + lengthCode] + LENGTH_EXTRA[lengthCode] + distLengths[distanceCode] +
+                        DIST_EXTRA[distanceCode];
+            }
+        }
+        return bits;
+    }
+
+    void Put(BitWriter& bits, const std::vector<Lz77Token>& tokens) const {
+        for (const Lz77Token& token : tokens) {
+            if (token.distance == 0) {
+                bits.PutCode(litCodes[token.length], litLengths[token.length]);
+                continue;
+            }
+            int code = LengthCode(token.length);
+            bits.PutCode(litCodes[257 + code], litLengths[257 + code]);
+            bits.Put(token.length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+            code = DistanceCode(token.distance);
+            bits.PutCode(distCodes[code], distLengths[code]);
+            bits.Put(token.distance - DIST_BASE[code], DIST_EXTRA[code]);
+        }
+        bits.PutCode(litCodes[END_OF_BLOCK], litLengths[END_OF_BLOCK]);
+    }
+};
+
+DeflateCodes FixedCodes() {
+    DeflateCodes codes;
+    codes.litLengths.assign(288, 8);
+    std::fill(codes.litLengths.begin() + 144, codes.litLengths.begin() + 256, 9);
+    std::fill(codes.litLengths.begin() + 256, codes.litLengths.begin() + 280, 7);
+    codes.distLengths.assign(DIST_SYMBOLS, 5);
+    codes.Build();
+    return codes;
+}
+
+DeflateCodes DynamicCodes(const std::vector<Lz77Token>& tokens) {
+    std::vector<uint32_t> litFreq(LITLEN_SYMBOLS, 0), distFreq(DIST_SYMBOLS, 0);
+    litFreq[END_OF_BLOCK] = 1;
+    for (const Lz77Token& token : tokens) {
+        if (token.distance == 0) {
+            litFreq[token.length]++;
+        } else {
+            litFreq[257 + LengthCode(token.length)]++;
+            distFreq[DistanceCode(token.distance)]++;
+        }
+    }
+    // Some decoders reject a distance code with fewer than two symbols
+    int distUsed = 0;
+    for (uint32_t f : distFreq) distUsed += f ? 1 : 0;
+    for (int s = 0; distUsed < 2; s++) {
+        if (!distFreq[s]) {
+            distFreq[s] = 1;
+            distUsed++;
+        }
+    }
+
+    DeflateCodes codes;
+    codes.litLengths = HuffmanLengths(litFreq, 15);
+    codes.distLengths = HuffmanLengths(distFreq, 15);
+    codes.Build();
+    return codes;
+}
+
+// The dynamic block header: the code lengths of both codes, run-length coded
+// (RFC 1951, 3.2.7) and themselves Huffman coded
+struct DynamicHeader {
+    int hlit = 257, hdist = 1, hclen = 4;
+    std::vector<std::pair<uint8_t, uint8_t>> runs;  // Code length symbol, extra bits value
+    std::vector<uint8_t> lengths;                   // Of the code length code
+    std::vector<uint16_t> codes;
+
+    explicit DynamicHeader(const DeflateCodes& deflate) {
+        hlit = LITLEN_SYMBOLS;
+        while (hlit > 257 && deflate.litLengths[hlit - 1] == 0) hlit--;
+        hdist = DIST_SYMBOLS;
+        while (hdist > 1 && deflate.distLengths[hdist - 1] == 0) hdist--;
+
+        std::vector<uint8_t> all(deflate.litLengths.begin(), deflate.litLengths.begin() + hlit);
+        all.insert(all.end(), deflate.distLengths.begin(), deflate.distLengths.begin() + hdist);
+        for (size_t i = 0; i < all.size();) {
+            uint8_t value = all[i];
+            size_t run = 1;
+            while (i + run < all.size() && all[i + run] == value) run++;
+            i += run;
+            if (value == 0) {
+                while (run >= 11) {
+                    size_t n = std::min<size_t>(run, 138);
+                    runs.push_back({18, (uint8_t)(n - 11)});
+                    run -= n;
+                }
+                if (run >= 3) {
+                    runs.push_back({17, (uint8_t)(run - 3)});
+                    run = 0;
+                }
+            } else {
+                runs.push_back({value, 0});
+                run--;
+                while (run >= 3) {
+                    size_t n = std::min<size_t>(run, 6);
+                    runs.push_back({16, (uint8_t)(n - 3)});
+                    run -= n;
+                }
+            }
+            for (; run > 0; run--) runs.push_back({value, 0});
+        }
+
+        std::vector<uint32_t> freq(CODELEN_SYMBOLS, 0);
+        for (const auto& r : runs) freq[r.first]++;
+        lengths = HuffmanLengths(freq, 7);
+        codes = CanonicalCodes(lengths);
+        hclen = CODELEN_SYMBOLS;
+        while (hclen > 4 && lengths[CODELEN_ORDER[hclen - 1]] == 0) hclen--;
+    }
+
+    static int ExtraBits(uint8_t symbol) { return symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0; }
+
+    uint64_t Cost() const {
+        uint64_t bits = 5 + 5 + 4 + 3 * (uint64_t)hclen;
+        for (const auto& r : runs) bits += lengths[r.first] + ExtraBits(r.first);
+        return bits;
+    }
+
+    void Put(BitWriter& bits) const {
+        bits.Put(hlit - 257, 5);
+        bits.Put(hdist - 1, 5);
+        bits.Put(hclen - 4, 4);
+        for (int i = 0; i < hclen; i++) bits.Put(lengths[CODELEN_ORDER[i]], 3);
+        for (const auto& r : runs) {
+            bits.PutCode(codes[r.first], lengths[r.first]);
+            bits.Put(r.second, ExtraBits(r.first));
+        }
+    }
+};
+
+void PutLE16(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back((uint8_t)value);
+    out.push_back((uint8_t)(value >> 8));
+}
+
+void PutLE32(std::vector<uint8_t>& out, uint32_t value) {
+    PutLE16(out, value & 0xFFFF);
+    PutLE16(out, value >> 16);
+}
+
+void ZlibCompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    out.push_back(0x78);  // Deflate, 32K window
+    out.push_back(0x01);
+
+    std::vector<Lz77Token> tokens = FindMatches(data, size);
+    DeflateCodes fixed = FixedCodes();
+    DeflateCodes dynamic = DynamicCodes(tokens);
+    DynamicHeader header(dynamic);
+    uint64_t fixedBits = 3 + fixed.Cost(tokens);
+    uint64_t dynamicBits = 3 + header.Cost() + dynamic.Cost(tokens);
+
+    // Noise does not compress; store it instead of growing it
+    const size_t STORED_BLOCK = 65535;
+    uint64_t storedBits = 8 * (size + 5 * std::max<size_t>(1, (size + STORED_BLOCK - 1) / STORED_BLOCK));
+    if (storedBits < std::min(fixedBits, dynamicBits)) {
+        size_t offset = 0;
+        do {
+            size_t length = std::min(STORED_BLOCK, size - offset);
+            out.push_back(offset + length == size ? 1 : 0);  // Final flag, type 00
+            PutLE16(out, (uint32_t)length);
+            PutLE16(out, (uint32_t)(~length & 0xFFFF));
+            out.insert(out.end(), data + offset, data + offset + length);
+            offset += length;
+        } while (offset < size);
+    } else {
+        BitWriter bits(out);
+        bits.Put(1, 1);  // Final block
+        if (dynamicBits < fixedBits) {
+            bits.Put(2, 2);
+            header.Put(bits);
+            dynamic.Put(bits, tokens);
+        } else {
+            bits.Put(1, 2);
+            fixed.Put(bits, tokens);
+        }
+        bits.Flush();
+    }
+
+    uint32_t s1 = 1, s2 = 0;
+    for (size_t i = 0; i < size; i++) {
+        s1 = (s1 + data[i]) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+    uint32_t adler = (s2 << 16) | s1;
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back((uint8_t)(adler >> shift));
+}
+
+uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+void PutBE32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back((uint8_t)(value >> shift));
+}
+
+void PutPngChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+    PutBE32(out, (uint32_t)data.size());
+    size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    PutBE32(out, Crc32(0, out.data() + typeStart, out.size() - typeStart));
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// PNG encoding
+// ---------------------------------------------------------------------------
+
+bool EncodePng(const DecodedImage& image, std::vector<uint8_t>& out) {
+    out.clear();
+    if (image.width <= 0 || image.height <= 0 || (uint32_t)image.width > MAX_IMAGE_DIMENSION ||
+        (uint32_t)image.height > MAX_IMAGE_DIMENSION ||
+        image.rgba.size() != (size_t)image.width * image.height * 4) {
+        return false;
+    }
+
+    // Drop the alpha channel when every pixel is opaque
+    bool opaque = true;
+    for (size_t i = 3; i < image.rgba.size() && opaque; i += 4) opaque = image.rgba[i] == 255;
+    size_t bpp = opaque ? 3 : 4;
+    size_t rowBytes = (size_t)image.width * bpp;
+
+    std::vector<uint8_t> pixels;
+    pixels.reserve(rowBytes * image.height);
+    for (size_t i = 0; i < image.rgba.size(); i += 4) {
+        pixels.insert(pixels.end(), &image.rgba[i], &image.rgba[i] + bpp);
+    }
+
+    // Each row takes the filter with the smallest sum of absolute (signed)
+    // residuals, the usual heuristic for what compresses best
+    std::vector<uint8_t> filtered;
+    filtered.reserve((rowBytes + 1) * image.height);
+    std::vector<uint8_t> candidate(rowBytes), best(rowBytes);
+    std::vector<uint8_t> zeroRow(rowBytes, 0);
+    for (int y = 0; y < image.height; y++) {
+        const uint8_t* row = pixels.data() + (size_t)y * rowBytes;
+        const uint8_t* up = y > 0 ? row - rowBytes : zeroRow.data();
+        uint8_t bestFilter = 0;
+        uint64_t bestScore = UINT64_MAX;
+        for (uint8_t filter = 0; filter < 5; filter++) {
+            uint64_t score = 0;
+            for (size_t i = 0; i < rowBytes; i++) {
+                int left = i >= bpp ? row[i - bpp] : 0;
+                int upLeft = i >= bpp ? up[i - bpp] : 0;
+                int predictor = 0;
+                switch (filter) {
+                    case 1: predictor = left; break;
+                    case 2: predictor = up[i]; break;
+                    case 3: predictor = (left + up[i]) / 2; break;
+                    case 4: predictor = Paeth(left, up[i], upLeft); break;
+                }
+                candidate[i] = (uint8_t)(row[i] - predictor);
+                score += (uint64_t)std::abs((int)(int8_t)candidate[i]);
+            }
+            if (score < bestScore) {
+                bestScore = score;
+                bestFilter = filter;
+                best.swap(candidate);
+            }
+        }
+        filtered.push_back(bestFilter);
+        filtered.insert(filtered.end(), best.begin(), best.end());
+    }
+
+    static const uint8_t pngSignature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    out.assign(pngSignature, pngSignature + 8);
+
+    std::vector<uint8_t> header;
+    PutBE32(header, (uint32_t)image.width);
+    PutBE32(header, (uint32_t)image.height);
+    header.push_back(8);                  // Bit depth
+    header.push_back(opaque ? 2 : 6);     // Truecolour, with alpha unless opaque
+    header.push_back(0);                  // Deflate
+    header.push_back(0);                  // Adaptive filtering
+    header.push_back(0);                  // No interlace
+    PutPngChunk(out, "IHDR", header);
+
+    std::vector<uint8_t> compressed;
+    ZlibCompress(filtered.data(), filtered.size(), compressed);
+    PutPngChunk(out, "IDAT", compressed);
+    PutPngChunk(out, "IEND", std::vector<uint8_t>());
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Normalization
+// ---------------------------------------------------------------------------
+
+bool NormalizeIcon(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    out.clear();
+    ImageFormat format = DetectImageFormat(data, size);
+    if (format == ImageFormat::Unknown) return false;
+
+    const size_t frameCount = sizeof(NORMALIZED_ICON_SIZES) / sizeof(NORMALIZED_ICON_SIZES[0]);
+    std::vector<std::vector<uint8_t>> frames(frameCount);
+    DecodedImage source;
+    bool visible = false;
+    for (size_t i = 0; i < frameCount; i++) {
+        int iconSize = NORMALIZED_ICON_SIZES[i];
+        // An ICO gets a frame per size; a PNG has just the one
+        if ((i == 0 || format == ImageFormat::Ico) && !DecodeImage(data, size, iconSize, source)) {
+            return false;
+        }
+        DecodedImage scaled;
+        RenderRgba(source, iconSize, scaled);
+        for (size_t p = 3; p < scaled.rgba.size() && !visible; p += 4) visible = scaled.rgba[p] != 0;
+        if (!EncodePng(scaled, frames[i])) return false;
+    }
+    if (!visible) return false;  // Fully transparent
+
+    // ICONDIR, one ICONDIRENTRY per frame, then the PNG streams
+    PutLE16(out, 0);
+    PutLE16(out, 1);  // Icon
+    PutLE16(out, (uint32_t)frameCount);
+    uint32_t offset = (uint32_t)(6 + 16 * frameCount);
+    for (size_t i = 0; i < frameCount; i++) {
+        out.push_back((uint8_t)NORMALIZED_ICON_SIZES[i]);
+        out.push_back((uint8_t)NORMALIZED_ICON_SIZES[i]);
+        out.push_back(0);  // No palette
+        out.push_back(0);
+        PutLE16(out, 1);   // Planes
+        PutLE16(out, 32);  // Bits per pixel
+        PutLE32(out, (uint32_t)frames[i].size());
+        PutLE32(out, offset);
+        offset += (uint32_t)frames[i].size();
+    }
+    for (const auto& frame : frames) out.insert(out.end(), frame.begin(), frame.end());
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef ICON_IMAGE_H
+#define ICON_IMAGE_H
+
+// Portable icon decoding, scaling and encoding (no Windows dependencies).
+// Used by the updater to normalize and pre-render icons and by the atlas reader tools.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class ImageFormat {
+    Unknown,
+    Png,
+    Ico
+};
+
+// Decoded image in straight (non-premultiplied) RGBA, top-down rows
+struct DecodedImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgba;
+};
+
+// Identify an image by its magic bytes (never by URL extension)
+ImageFormat DetectImageFormat(const uint8_t* data, size_t size);
+
+// Pixel size of a PNG, or of the largest frame of an ICO, from the headers only
+bool ReadImageSize(const uint8_t* data, size_t size, int& width, int& height);
+
+// Decode a PNG file
+bool DecodePng(const uint8_t* data, size_t size, DecodedImage& out);
+
+// Decode an ICO file, picking the frame closest to preferredSize
+// (smallest frame >= preferredSize, otherwise the largest one)
+bool DecodeIco(const uint8_t* data, size_t size, int preferredSize, DecodedImage& out);
+
+// Decode any supported format
+bool DecodeImage(const uint8_t* data, size_t size, int preferredSize, DecodedImage& out);
+
+// Scale to size x size (aspect preserved, centred on transparent background)
+// and write premultiplied BGRA, top-down rows, into dst (size * size * 4 bytes).
+void RenderPremultipliedBgra(const DecodedImage& src, int size, uint8_t* dst);
+
+// Same scaling, into a size x size straight RGBA image
+void RenderRgba(const DecodedImage& src, int size, DecodedImage& out);
+
+// Encode as an 8-bit truecolour PNG (alpha dropped when every pixel is opaque)
+bool EncodePng(const DecodedImage& image, std::vector<uint8_t>& out);
+
+// Frame sizes of a normalized icon: the list's small icon and the large one
+const int NORMALIZED_ICON_SIZES[] = {16, 32};
+
+// Re-encode a downloaded icon as an ICO holding one PNG frame per normalized
+// size, each scaled from the source frame nearest that size. Returns false for
+// anything that is not a decodable PNG or ICO (HTML error pages, JPEGs,
+// truncated files) and for fully transparent images.
+bool NormalizeIcon(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+#endif // ICON_IMAGE_H
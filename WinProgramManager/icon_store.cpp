@@ -0,0 +1,245 @@
+#include "icon_store.h"
+#include "icon_image.h"
+#include "sha256.h"
+#include <algorithm>
+#include <sqlite3.h>
+
+static bool InsertIcon(sqlite3_stmt* insert, const uint8_t* data, size_t size, const char* type,
+                       Sha256::Digest& hash) {
+    hash = Sha256::Hash(data, size);
+    int width = 0, height = 0;
+    ReadImageSize(data, size, width, height);
+
+    sqlite3_reset(insert);
+    sqlite3_bind_blob(insert, 1, hash.data(), (int)hash.size(), SQLITE_STATIC);
+    if (type && *type) {
+        sqlite3_bind_text(insert, 2, type, -1, SQLITE_STATIC);
+    } else {
+        sqlite3_bind_null(insert, 2);
+    }
+    sqlite3_bind_int(insert, 3, width);
+    sqlite3_bind_int(insert, 4, height);
+    sqlite3_bind_blob(insert, 5, data, (int)size, SQLITE_STATIC);
+    return sqlite3_step(insert) == SQLITE_DONE;
+}
+
+static const char* INSERT_ICON_SQL =
+    "INSERT OR IGNORE INTO icons (hash, type, width, height, data) VALUES (?, ?, ?, ?, ?);";
+
+bool StoreIcon(sqlite3* db, const std::vector<unsigned char>& data, const std::string& type,
+               std::vector<unsigned char>& hash) {
+    hash.clear();
+    if (data.empty()) return false;
+
+    sqlite3_stmt* insert;
+    if (sqlite3_prepare_v2(db, INSERT_ICON_SQL, -1, &insert, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    Sha256::Digest digest;
+    bool ok = InsertIcon(insert, data.data(), data.size(), type.c_str(), digest);
+    sqlite3_finalize(insert);
+    if (ok) hash.assign(digest.begin(), digest.end());
+    return ok;
+}
+
+int MoveInlineIcons(sqlite3* db) {
+    // Ids first: the rows are rewritten while they are moved
+    std::vector<int> appIds;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT id FROM apps WHERE icon_data IS NOT NULL;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return -1;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) appIds.push_back(sqlite3_column_int(stmt, 0));
+    sqlite3_finalize(stmt);
+    if (appIds.empty()) return 0;
+
+    sqlite3_stmt* select = nullptr;
+    sqlite3_stmt* insert = nullptr;
+    sqlite3_stmt* update = nullptr;
+    bool ok = sqlite3_prepare_v2(db, "SELECT icon_data FROM apps WHERE id = ?;", -1, &select, nullptr) == SQLITE_OK &&
+              sqlite3_prepare_v2(db, INSERT_ICON_SQL, -1, &insert, nullptr) == SQLITE_OK &&
+              sqlite3_prepare_v2(db, "UPDATE apps SET icon_hash = ?, icon_data = NULL WHERE id = ?;",
+                                 -1, &update, nullptr) == SQLITE_OK;
+
+    int moved = 0;
+    for (size_t i = 0; ok && i < appIds.size(); i++) {
+        sqlite3_reset(select);
+        sqlite3_bind_int(select, 1, appIds[i]);
+        if (sqlite3_step(select) != SQLITE_ROW) continue;
+        const uint8_t* data = (const uint8_t*)sqlite3_column_blob(select, 0);
+        size_t size = (size_t)sqlite3_column_bytes(select, 0);
+
+        // Blobs that are not an image carry no icon; the reference stays NULL
+        std::vector<uint8_t> normalized;
+        Sha256::Digest hash;
+        bool stored = NormalizeIcon(data, size, normalized);
+        if (stored && !InsertIcon(insert, normalized.data(), normalized.size(), NORMALIZED_ICON_TYPE, hash)) {
+            ok = false;
+            break;
+        }
+
+        sqlite3_reset(select);
+        sqlite3_reset(update);
+        if (stored) {
+            sqlite3_bind_blob(update, 1, hash.data(), (int)hash.size(), SQLITE_STATIC);
+        } else {
+            sqlite3_bind_null(update, 1);
+        }
+        sqlite3_bind_int(update, 2, appIds[i]);
+        ok = sqlite3_step(update) == SQLITE_DONE;
+        if (ok && stored) moved++;
+    }
+
+    sqlite3_finalize(select);
+    sqlite3_finalize(insert);
+    sqlite3_finalize(update);
+    return ok ? moved : -1;
+}
+
+int NormalizeStoredIcons(sqlite3* db) {
+    std::vector<std::vector<uint8_t>> hashes;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT hash FROM icons;", -1, &stmt, nullptr) != SQLITE_OK) return -1;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const uint8_t* hash = (const uint8_t*)sqlite3_column_blob(stmt, 0);
+        hashes.emplace_back(hash, hash + sqlite3_column_bytes(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    if (hashes.empty()) return 0;
+
+    sqlite3_stmt* select = nullptr;
+    sqlite3_stmt* insert = nullptr;
+    sqlite3_stmt* repoint = nullptr;
+    sqlite3_stmt* remove = nullptr;
+    bool ok = sqlite3_prepare_v2(db, "SELECT data FROM icons WHERE hash = ?;", -1, &select, nullptr) == SQLITE_OK &&
+              sqlite3_prepare_v2(db, INSERT_ICON_SQL, -1, &insert, nullptr) == SQLITE_OK &&
+              sqlite3_prepare_v2(db, "UPDATE apps SET icon_hash = ? WHERE icon_hash = ?;", -1, &repoint, nullptr) == SQLITE_OK &&
+              sqlite3_prepare_v2(db, "DELETE FROM icons WHERE hash = ?;", -1, &remove, nullptr) == SQLITE_OK;
+
+    int rewritten = 0;
+    for (size_t i = 0; ok && i < hashes.size(); i++) {
+        const std::vector<uint8_t>& oldHash = hashes[i];
+        sqlite3_reset(select);
+        sqlite3_bind_blob(select, 1, oldHash.data(), (int)oldHash.size(), SQLITE_STATIC);
+        if (sqlite3_step(select) != SQLITE_ROW) continue;
+        std::vector<uint8_t> normalized;
+        bool image = NormalizeIcon((const uint8_t*)sqlite3_column_blob(select, 0),
+                                   (size_t)sqlite3_column_bytes(select, 0), normalized);
+        sqlite3_reset(select);
+
+        Sha256::Digest newHash;
+        if (image) {
+            newHash = Sha256::Hash(normalized.data(), normalized.size());
+            if (std::equal(newHash.begin(), newHash.end(), oldHash.begin(), oldHash.end())) continue;
+            if (!InsertIcon(insert, normalized.data(), normalized.size(), NORMALIZED_ICON_TYPE, newHash)) {
+                ok = false;
+                break;
+            }
+        }
+
+        // Apps follow the icon to its new hash, or lose a reference to a non-image
+        sqlite3_reset(repoint);
+        if (image) {
+            sqlite3_bind_blob(repoint, 1, newHash.data(), (int)newHash.size(), SQLITE_STATIC);
+        } else {
+            sqlite3_bind_null(repoint, 1);
+        }
+        sqlite3_bind_blob(repoint, 2, oldHash.data(), (int)oldHash.size(), SQLITE_STATIC);
+        sqlite3_reset(remove);
+        sqlite3_bind_blob(remove, 1, oldHash.data(), (int)oldHash.size(), SQLITE_STATIC);
+        ok = sqlite3_step(repoint) == SQLITE_DONE && sqlite3_step(remove) == SQLITE_DONE;
+        if (ok) rewritten++;
+    }
+
+    sqlite3_finalize(select);
+    sqlite3_finalize(insert);
+    sqlite3_finalize(repoint);
+    sqlite3_finalize(remove);
+    return ok ? rewritten : -1;
+}
+
+int PruneUnusedIcons(sqlite3* db) {
+    const char* sql =
+        "DELETE FROM icons WHERE NOT EXISTS (SELECT 1 FROM apps WHERE apps.icon_hash = icons.hash);";
+    if (sqlite3_exec(db, sql, nullptr, nullptr, nullptr) != SQLITE_OK) return -1;
+    return sqlite3_changes(db);
+}
+
+static std::string ColumnString(sqlite3_stmt* stmt, int column) {
+    const char* text = (const char*)sqlite3_column_text(stmt, column);
+    return text ? text : "";
+}
+
+static void BindOptionalText(sqlite3_stmt* stmt, int index, const std::string& text) {
+    if (text.empty()) {
+        sqlite3_bind_null(stmt, index);
+    } else {
+        sqlite3_bind_text(stmt, index, text.c_str(), -1, SQLITE_STATIC);
+    }
+}
+
+bool LoadIconSources(sqlite3* db, std::unordered_map<std::string, IconSource>& sources) {
+    sources.clear();
+    const char* sql =
+        "SELECT s.homepage, s.icon_url, s.etag, s.last_modified, s.icon_hash, s.checked FROM icon_sources s "
+        "WHERE s.icon_hash IS NULL OR EXISTS (SELECT 1 FROM icons i WHERE i.hash = s.icon_hash);";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        IconSource& source = sources[ColumnString(stmt, 0)];
+        source.iconUrl = ColumnString(stmt, 1);
+        source.etag = ColumnString(stmt, 2);
+        source.lastModified = ColumnString(stmt, 3);
+        const unsigned char* hash = (const unsigned char*)sqlite3_column_blob(stmt, 4);
+        if (hash) source.iconHash.assign(hash, hash + sqlite3_column_bytes(stmt, 4));
+        source.checked = sqlite3_column_int64(stmt, 5);
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool SaveIconSource(sqlite3* db, const std::string& homepage, const IconSource& source) {
+    const char* sql =
+        "INSERT OR REPLACE INTO icon_sources (homepage, icon_url, etag, last_modified, icon_hash, checked) "
+        "VALUES (?, ?, ?, ?, ?, ?);";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+    sqlite3_bind_text(stmt, 1, homepage.c_str(), -1, SQLITE_STATIC);
+    BindOptionalText(stmt, 2, source.iconUrl);
+    BindOptionalText(stmt, 3, source.etag);
+    BindOptionalText(stmt, 4, source.lastModified);
+    if (source.iconHash.empty()) {
+        sqlite3_bind_null(stmt, 5);
+    } else {
+        sqlite3_bind_blob(stmt, 5, source.iconHash.data(), (int)source.iconHash.size(), SQLITE_STATIC);
+    }
+    sqlite3_bind_int64(stmt, 6, source.checked);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+bool LoadFailedIconHosts(sqlite3* db, int64_t since, std::vector<std::string>& hosts) {
+    hosts.clear();
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT host FROM icon_host_failures WHERE failed >= ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_int64(stmt, 1, since);
+    while (sqlite3_step(stmt) == SQLITE_ROW) hosts.push_back(ColumnString(stmt, 0));
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool SaveFailedIconHost(sqlite3* db, const std::string& host, int64_t failed) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO icon_host_failures (host, failed) VALUES (?, ?);",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, host.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, failed);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
@@ -0,0 +1,67 @@
+#ifndef ICON_STORE_H
+#define ICON_STORE_H
+
+// Content-addressed icon storage. Each distinct image is stored once in
+// icons(hash PRIMARY KEY, type, width, height, data), keyed by the SHA-256 of
+// its bytes, and apps.icon_hash refers to it. Keeping the blobs out of apps keeps
+// metadata scans to a few pages, and publishers that share one favicon share
+// one row.
+//
+// Icons are stored normalized (NormalizeIcon in icon_image.h): an ICO of small
+// PNG frames at the list sizes, whatever the site served. Downloads that are not
+// an image are never stored.
+//
+// apps.icon_data is the old inline column. Databases migrate out of it (see
+// db_schema.cpp), but the PowerShell build scripts still write it, so readers
+// fall back to it and the updater moves such rows on every run.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+// Type recorded for normalized icons
+#define NORMALIZED_ICON_TYPE "ico"
+
+// Insert the image unless an identical one is stored, and return its hash
+// (32 bytes). Runs in the caller's transaction. Returns false if data is empty
+// or the insert fails.
+bool StoreIcon(sqlite3* db, const std::vector<unsigned char>& data, const std::string& type,
+               std::vector<unsigned char>& hash);
+
+// Move apps.icon_data blobs into icons, normalized, and clear the column. Blobs
+// that are not an image are dropped. Returns the number of apps moved, or -1 on
+// failure.
+int MoveInlineIcons(sqlite3* db);
+
+// Re-encode stored icons that are not normalized yet and point their apps at
+// the result; icons that are not an image are deleted and their references
+// cleared. Returns the number of icons rewritten or deleted, or -1 on failure.
+int NormalizeStoredIcons(sqlite3* db);
+
+// Delete icons no app refers to any more. Returns the number deleted, or -1.
+int PruneUnusedIcons(sqlite3* db);
+
+// Where a homepage's icon came from (icon_sources), so later runs can revalidate
+// it instead of rediscovering it (see icon_fetch.h)
+struct IconSource {
+    std::string iconUrl;
+    std::string etag;
+    std::string lastModified;
+    std::vector<unsigned char> iconHash;   // Empty: the homepage had no usable icon
+    int64_t checked = 0;                   // Unix time of the last fetch
+};
+
+// Sources by homepage. Sources whose icon has been pruned since are left out.
+bool LoadIconSources(sqlite3* db, std::unordered_map<std::string, IconSource>& sources);
+bool SaveIconSource(sqlite3* db, const std::string& homepage, const IconSource& source);
+
+// Hosts that did not answer at or after `since` (icon_host_failures)
+bool LoadFailedIconHosts(sqlite3* db, int64_t since, std::vector<std::string>& hosts);
+bool SaveFailedIconHost(sqlite3* db, const std::string& host, int64_t failed);
+
+#endif // ICON_STORE_H
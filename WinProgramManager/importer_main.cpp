@@ -0,0 +1,172 @@
+// WinProgramImporter: builds or refreshes WinProgramManager.db from a local clone of
+// the winget-pkgs repository. Intended for build servers: it needs neither winget
+// nor network access, and it also builds on Linux.
+//
+// Usage: WinProgramImporter <winget-pkgs or manifests dir> [--db PATH] [--threads N]
+//        WinProgramImporter --check-plans [--db PATH]
+//        WinProgramImporter --fetch-icons [--db PATH] [--threads N]
+
+#include "manifest_import.h"
+#include "winget_index.h"
+#include "db_connection.h"
+#include "db_meta.h"
+#include "db_schema.h"
+#include "icon_fetch.h"
+#include <sqlite3.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <shellapi.h>
+#endif
+
+// Command line as UTF-8 (the narrow argv on Windows uses the ANSI code page)
+static std::vector<std::string> GetArguments(int argc, char* argv[]) {
+    std::vector<std::string> args;
+#ifdef _WIN32
+    (void)argc;
+    (void)argv;
+    int wargc = 0;
+    LPWSTR* wargv = CommandLineToArgvW(GetCommandLineW(), &wargc);
+    if (!wargv) return args;
+    for (int i = 0; i < wargc; i++) {
+        int size = WideCharToMultiByte(CP_UTF8, 0, wargv[i], -1, nullptr, 0, nullptr, nullptr);
+        std::string arg(size > 0 ? size - 1 : 0, '\0');
+        if (size > 1) WideCharToMultiByte(CP_UTF8, 0, wargv[i], -1, &arg[0], size, nullptr, nullptr);
+        args.push_back(arg);
+    }
+    LocalFree(wargv);
+#else
+    args.assign(argv, argv + argc);
+#endif
+    return args;
+}
+
+// Print the EXPLAIN QUERY PLAN of every hot query; fails if one of them scans a table
+static int CheckQueryPlans(sqlite3* db) {
+    std::vector<QueryPlanCheck> checks;
+    bool ok = CheckHotQueryPlans(db, checks);
+    for (const QueryPlanCheck& check : checks) {
+        std::printf("%s %s\n", check.usesIndex ? "ok  " : "SCAN", check.name);
+        if (!check.usesIndex) std::printf("%s", check.plan.c_str());
+    }
+    std::printf(ok ? "All hot queries use an index (schema version %d)\n"
+                   : "Hot queries without an index (schema version %d)\n", GetCatalogSchemaVersion(db));
+    return ok ? 0 : 1;
+}
+
+// Fetch missing icons from the package homepages (the updater does this on
+// Windows after each run; off Windows only plain http homepages are reachable)
+static int FetchIcons(sqlite3* db, int threads) {
+    std::unique_ptr<HttpTransport> transport = CreateHttpTransport(ICON_FETCH_TIMEOUT_MS, ICON_FETCH_USER_AGENT);
+    IconFetcherOptions options;
+    if (threads > 0) options.workers = threads;
+
+    IconFetchStats stats;
+    bool ok = FetchCatalogIcons(db, *transport, std::vector<std::string>(), options, stats,
+        [](const FetchProgress& progress) {
+            std::printf("  [%zu/%zu] %.1f homepages/min, %zu failed\n", progress.completed, progress.total,
+                        progress.ItemsPerMinute(), progress.failed);
+        });
+    if (!ok) {
+        std::fprintf(stderr, "Icon fetch failed: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    if (stats.fetched > 0 || stats.reused > 0) BumpContentVersion(db);
+    std::printf("Icons: %zu homepages, %zu fetched, %zu not modified, %zu without icon, %zu hosts failed, "
+                "%zu skipped, %zu reused (%.1fs)\n",
+                stats.homepages, stats.fetched, stats.notModified, stats.noIcon, stats.hostFailed, stats.skipped,
+                stats.reused, stats.progress.elapsedSeconds);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args = GetArguments(argc, argv);
+    std::string root;
+    std::string dbPath = "WinProgramManager.db";
+    int threads = 0;
+    bool checkPlans = false;
+    bool fetchIcons = false;
+
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "--db" && i + 1 < args.size()) {
+            dbPath = args[++i];
+        } else if (args[i] == "--threads" && i + 1 < args.size()) {
+            threads = std::atoi(args[++i].c_str());
+        } else if (args[i] == "--check-plans") {
+            checkPlans = true;
+        } else if (args[i] == "--fetch-icons") {
+            fetchIcons = true;
+        } else if (root.empty()) {
+            root = args[i];
+        }
+    }
+
+    if (root.empty() && !checkPlans && !fetchIcons) {
+        std::fprintf(stderr, "Usage: WinProgramImporter <winget-pkgs or manifests dir> [--db PATH] [--threads N]\n"
+                             "       WinProgramImporter --check-plans [--db PATH]\n"
+                             "       WinProgramImporter --fetch-icons [--db PATH] [--threads N]\n");
+        return 2;
+    }
+    
+    // Migrated first, so the plans are checked against the current schema
+    if (checkPlans || fetchIcons) {
+        sqlite3* db = nullptr;
+        if (OpenCatalogDatabase(dbPath, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE) != SQLITE_OK ||
+            !MigrateCatalogSchema(db)) {
+            std::fprintf(stderr, "Cannot open database %s: %s\n", dbPath.c_str(), db ? sqlite3_errmsg(db) : "out of memory");
+            sqlite3_close(db);
+            return 1;
+        }
+        int rc = checkPlans ? CheckQueryPlans(db) : FetchIcons(db, threads);
+        sqlite3_close(db);
+        return rc;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto seconds = [&start]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::vector<ManifestPackage> packages;
+    ManifestScanStats stats;
+    if (!ScanManifestTree(root, threads, packages, stats)) {
+        std::fprintf(stderr, "Not a directory: %s\n", root.c_str());
+        return 1;
+    }
+    std::printf("Scanned %zu version directories: %zu packages, %zu parsed, %zu failed (%.1fs)\n",
+                stats.versionDirs, stats.packages, stats.parsed, stats.failed, seconds());
+
+    if (packages.empty()) {
+        std::fprintf(stderr, "No manifests found under %s\n", root.c_str());
+        return 1;
+    }
+
+    sqlite3* db = nullptr;
+    if (OpenCatalogDatabase(dbPath, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE) != SQLITE_OK ||
+        !MigrateCatalogSchema(db)) {
+        std::fprintf(stderr, "Cannot open database %s: %s\n", dbPath.c_str(), db ? sqlite3_errmsg(db) : "out of memory");
+        sqlite3_close(db);
+        return 1;
+    }
+
+    WingetIndexDiff diff;
+    bool ok = ImportManifestPackages(db, packages, diff);
+    if (ok) {
+        BumpContentVersion(db);
+        std::printf("Imported into %s: %zu added, %zu changed, %zu removed, %d tags linked (%.1fs)\n",
+                    dbPath.c_str(), diff.added.size(), diff.changed.size(), diff.removed.size(),
+                    diff.tagsAdded, seconds());
+    } else {
+        std::fprintf(stderr, "Import failed: %s\n", sqlite3_errmsg(db));
+    }
+
+    CheckpointCatalog(db);
+    sqlite3_close(db);
+    return ok ? 0 : 1;
+}
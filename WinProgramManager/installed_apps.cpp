@@ -1,10 +1,11 @@
 #include "installed_apps.h"
 #include <windows.h>
 #include <set>
+#include <functional>
 
 // Static module-level state
 static bool g_installedFilterActive = false;
-static std::set<std::wstring> g_installedPackageIds;
+static std::set<std::string, std::less<>> g_installedPackageIds;  // UTF-8, same form as the catalog
 
 void InitInstalledApps() {
     g_installedFilterActive = false;
@@ -22,12 +23,7 @@ void LoadInstalledPackageIds(sqlite3* db) {
         while (sqlite3_step(stmt) == SQLITE_ROW) {
             const char* pkgId = (const char*)sqlite3_column_text(stmt, 0);
             if (pkgId) {
-                int wsize = MultiByteToWideChar(CP_UTF8, 0, pkgId, -1, nullptr, 0);
-                if (wsize > 0) {
-                    std::wstring wstr(wsize - 1, L'\0');
-                    MultiByteToWideChar(CP_UTF8, 0, pkgId, -1, &wstr[0], wsize);
-                    g_installedPackageIds.insert(wstr);
-                }
+                g_installedPackageIds.emplace(pkgId, (size_t)sqlite3_column_bytes(stmt, 0));
             }
         }
         sqlite3_finalize(stmt);
@@ -35,7 +31,16 @@ void LoadInstalledPackageIds(sqlite3* db) {
 }
 
 bool IsPackageInstalled(const std::wstring& packageId) {
-    return g_installedPackageIds.count(packageId) > 0;
+    int size = WideCharToMultiByte(CP_UTF8, 0, packageId.c_str(), (int)packageId.size(), nullptr, 0, nullptr, nullptr);
+    std::string utf8(size > 0 ? size : 0, '\0');
+    if (size > 0) {
+        WideCharToMultiByte(CP_UTF8, 0, packageId.c_str(), (int)packageId.size(), &utf8[0], size, nullptr, nullptr);
+    }
+    return IsPackageInstalled(std::string_view(utf8));
+}
+
+bool IsPackageInstalled(std::string_view packageId) {
+    return g_installedPackageIds.find(packageId) != g_installedPackageIds.end();
 }
 
 bool IsInstalledFilterActive() {
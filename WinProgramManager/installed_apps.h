@@ -2,6 +2,7 @@
 #define INSTALLED_APPS_H
 
 #include <string>
+#include <string_view>
 #include "sqlite3/sqlite3.h"
 
 // Initialize the installed apps module
@@ -10,8 +11,9 @@ void InitInstalledApps();
 // Load installed package IDs from database into memory
 void LoadInstalledPackageIds(sqlite3* db);
 
-// Check if a package is installed
+// Check if a package is installed (UTF-16 or UTF-8 package id)
 bool IsPackageInstalled(const std::wstring& packageId);
+bool IsPackageInstalled(std::string_view packageId);
 
 // Get/Set filter active state
 bool IsInstalledFilterActive();
@@ -0,0 +1,253 @@
+#include "installed_sync.h"
+#include <sqlite3.h>
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <utility>
+
+static std::string Trim(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t");
+    if (first == std::string::npos) return std::string();
+    size_t last = text.find_last_not_of(" \t");
+    return text.substr(first, last - first + 1);
+}
+
+static bool HasDigit(const std::string& text) {
+    for (char c : text) {
+        if (std::isdigit((unsigned char)c)) return true;
+    }
+    return false;
+}
+
+// Package ids have a dot (winget) or a backslash (ARP\..., MSIX\...). winget cuts
+// long ids short with "…"; those cannot be matched to anything.
+static bool IsPackageId(const std::string& id) {
+    return !id.empty() && id.find(' ') == std::string::npos && id.find("\xE2\x80\xA6") == std::string::npos &&
+           (id.find('.') != std::string::npos || id.find('\\') != std::string::npos);
+}
+
+// Terminal columns taken by the code point starting at text[i] (East Asian wide
+// characters take two); sets length to its UTF-8 byte count
+static size_t DisplayWidth(const std::string& text, size_t i, size_t& length) {
+    unsigned char lead = (unsigned char)text[i];
+    uint32_t cp = lead;
+    length = 1;
+    if (lead >= 0xF0) {
+        length = 4;
+        cp = lead & 0x07;
+    } else if (lead >= 0xE0) {
+        length = 3;
+        cp = lead & 0x0F;
+    } else if (lead >= 0xC0) {
+        length = 2;
+        cp = lead & 0x1F;
+    }
+    if (i + length > text.size()) {
+        length = 1;
+        return 1;
+    }
+    for (size_t k = 1; k < length; k++) cp = (cp << 6) | ((unsigned char)text[i + k] & 0x3F);
+
+    bool wide = (cp >= 0x1100 && cp <= 0x115F) || (cp >= 0x2E80 && cp <= 0xA4CF) || (cp >= 0xAC00 && cp <= 0xD7A3) ||
+                (cp >= 0xF900 && cp <= 0xFAFF) || (cp >= 0xFE30 && cp <= 0xFE4F) || (cp >= 0xFF00 && cp <= 0xFF60) ||
+                (cp >= 0xFFE0 && cp <= 0xFFE6) || cp >= 0x20000;
+    return wide ? 2 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// winget list parsing
+// ---------------------------------------------------------------------------
+
+void WingetListParser::Feed(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == '\n') {
+            HandleLine(pending_);
+            pending_.clear();
+        } else {
+            pending_ += data[i];
+        }
+    }
+}
+
+void WingetListParser::Finish() {
+    if (!pending_.empty()) HandleLine(pending_);
+    pending_.clear();
+}
+
+void WingetListParser::HandleLine(const std::string& rawLine) {
+    // The progress spinner rewrites the line with '\r'; only the text after the last one counts
+    std::string line = rawLine;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    size_t carriageReturn = line.rfind('\r');
+    if (carriageReturn != std::string::npos) line.erase(0, carriageReturn + 1);
+    if (Trim(line).empty()) return;
+
+    // The dashes under the header: the row before them gives the column positions
+    if (line.find("---") != std::string::npos && line.find_first_not_of("- ") == std::string::npos) {
+        columnStarts_.clear();
+        size_t column = 0;
+        bool inField = false;
+        for (size_t i = 0; i < header_.size();) {
+            size_t length;
+            size_t width = DisplayWidth(header_, i, length);
+            bool space = header_[i] == ' ' || header_[i] == '\t';
+            if (!space && !inField) columnStarts_.push_back(column);
+            inField = !space;
+            column += width;
+            i += length;
+        }
+        pastHeader_ = true;
+        return;
+    }
+    header_ = line;
+    if (!pastHeader_) return;
+
+    InstalledPackage pkg;
+    bool parsed = columnStarts_.size() >= 3 ? ParseColumns(line, pkg) : ParseTokens(line, pkg);
+    if (parsed) packages_.push_back(std::move(pkg));
+}
+
+bool WingetListParser::ParseColumns(const std::string& line, InstalledPackage& pkg) const {
+    // Byte offset of every display column of the line (a wide character spans two)
+    std::vector<size_t> offsets;
+    offsets.reserve(line.size() + 1);
+    for (size_t i = 0; i < line.size();) {
+        size_t length;
+        size_t width = DisplayWidth(line, i, length);
+        for (size_t k = 0; k < width; k++) offsets.push_back(i);
+        i += length;
+    }
+    auto field = [&](size_t index) {
+        auto byteAt = [&](size_t column) { return column < offsets.size() ? offsets[column] : line.size(); };
+        size_t from = byteAt(columnStarts_[index]);
+        size_t to = index + 1 < columnStarts_.size() ? byteAt(columnStarts_[index + 1]) : line.size();
+        return from < to ? Trim(line.substr(from, to - from)) : std::string();
+    };
+
+    // Name, Id, Version, [Available,] Source. The last column is the source only
+    // when it is not a version (there is no Source column when nothing has one).
+    pkg.packageId = field(1);
+    pkg.version = field(2);
+    if (columnStarts_.size() >= 4) {
+        std::string last = field(columnStarts_.size() - 1);
+        if (!HasDigit(last)) pkg.source = last;
+    }
+    return IsPackageId(pkg.packageId) && !pkg.version.empty();
+}
+
+bool WingetListParser::ParseTokens(const std::string& line, InstalledPackage& pkg) {
+    // No usable header: Source, Version and Id read from the right
+    std::vector<std::string> tokens;
+    std::istringstream tokenStream(line);
+    std::string token;
+    while (tokenStream >> token) tokens.push_back(token);
+    if (tokens.size() < 2 || HasDigit(tokens.back())) return false;
+
+    if (tokens.size() >= 3) {
+        pkg.source = tokens[tokens.size() - 1];
+        pkg.version = tokens[tokens.size() - 2];
+        pkg.packageId = tokens[tokens.size() - 3];
+    } else {
+        pkg.version = tokens[1];
+        pkg.packageId = tokens[0];
+    }
+    return IsPackageId(pkg.packageId);
+}
+
+// ---------------------------------------------------------------------------
+// installed_apps diff
+// ---------------------------------------------------------------------------
+
+static std::string ColumnString(sqlite3_stmt* stmt, int column) {
+    const char* text = (const char*)sqlite3_column_text(stmt, column);
+    return text ? std::string(text, (size_t)sqlite3_column_bytes(stmt, column)) : std::string();
+}
+
+static bool RunIds(sqlite3* db, const char* sql, const std::vector<std::string>& ids,
+                   const std::map<std::string, const InstalledPackage*>& listed, const std::string& timestamp) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+    bool ok = true;
+    for (const std::string& id : ids) {
+        auto found = listed.find(id);
+        const InstalledPackage* pkg = found != listed.end() ? found->second : nullptr;
+        int parameters = sqlite3_bind_parameter_count(stmt);
+        sqlite3_bind_text(stmt, 1, id.c_str(), (int)id.size(), SQLITE_STATIC);
+        if (pkg && parameters >= 3) {
+            sqlite3_bind_text(stmt, 2, pkg->version.c_str(), (int)pkg->version.size(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 3, pkg->source.c_str(), (int)pkg->source.size(), SQLITE_STATIC);
+        }
+        if (parameters >= 4) sqlite3_bind_text(stmt, 4, timestamp.c_str(), (int)timestamp.size(), SQLITE_STATIC);
+        ok = sqlite3_step(stmt) == SQLITE_DONE && ok;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+bool ApplyInstalledPackages(sqlite3* db, const std::vector<InstalledPackage>& packages, const std::string& timestamp,
+                            InstalledSyncResult& result) {
+    result = InstalledSyncResult();
+    if (!db || packages.empty()) return false;
+
+    // The listing as a sorted set (the first row of a repeated id wins)
+    std::map<std::string, const InstalledPackage*> listed;
+    for (const InstalledPackage& pkg : packages) listed.emplace(pkg.packageId, &pkg);
+    result.installed = listed.size();
+
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK) return false;
+
+    // Merge the sorted table against the sorted listing
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT package_id, installed_version, source FROM installed_apps;", -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    std::map<std::string, std::pair<std::string, std::string>> current;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        current.emplace(ColumnString(stmt, 0), std::make_pair(ColumnString(stmt, 1), ColumnString(stmt, 2)));
+    }
+    sqlite3_finalize(stmt);
+
+    auto have = current.begin();
+    auto want = listed.begin();
+    while (have != current.end() || want != listed.end()) {
+        if (want == listed.end() || (have != current.end() && have->first < want->first)) {
+            result.removed.push_back(have->first);
+            ++have;
+        } else if (have == current.end() || want->first < have->first) {
+            result.added.push_back(want->first);
+            ++want;
+        } else {
+            if (have->second.first != want->second->version || have->second.second != want->second->source) {
+                result.changed.push_back(want->first);
+            }
+            ++have;
+            ++want;
+        }
+    }
+
+    // ?1 id, ?2 version, ?3 source, ?4 timestamp
+    bool ok = RunIds(db, "DELETE FROM installed_apps WHERE package_id = ?1;", result.removed, listed, timestamp) &&
+              RunIds(db, "UPDATE installed_apps SET installed_version = ?2, source = ?3 WHERE package_id = ?1;",
+                     result.changed, listed, timestamp) &&
+              RunIds(db, "INSERT INTO installed_apps (package_id, installed_version, source, installed_date, last_seen) "
+                         "VALUES (?1, ?2, ?3, ?4, ?4);", result.added, listed, timestamp);
+
+    // Every remaining row was listed
+    if (ok && sqlite3_prepare_v2(db, "UPDATE installed_apps SET last_seen = ?;", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, timestamp.c_str(), (int)timestamp.size(), SQLITE_STATIC);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+    } else {
+        ok = false;
+    }
+
+    if (!ok || sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        result = InstalledSyncResult();
+        return false;
+    }
+    return true;
+}
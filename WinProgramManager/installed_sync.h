@@ -0,0 +1,59 @@
+#ifndef INSTALLED_SYNC_H
+#define INSTALLED_SYNC_H
+
+// Sync of installed_apps with `winget list`. The output is parsed as it is read
+// (column positions come from the header row, so an Available column does not
+// shift the Id and Version), and the result is applied as a diff against the
+// table in one transaction: new ids are inserted, ids still installed get their
+// last_seen (and a changed version or source) updated, and the rest are deleted.
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+struct InstalledPackage {
+    std::string packageId;
+    std::string version;
+    std::string source;      // Empty for packages winget does not know (ARP, MSIX)
+};
+
+// Parses `winget list` output fed in arbitrary pieces
+class WingetListParser {
+public:
+    void Feed(const char* data, size_t size);
+
+    // Parse the last line if it had no newline. Call once after the last Feed.
+    void Finish();
+
+    // Packages in output order (duplicates possible)
+    const std::vector<InstalledPackage>& Packages() const { return packages_; }
+
+private:
+    void HandleLine(const std::string& line);
+    bool ParseColumns(const std::string& line, InstalledPackage& pkg) const;
+    static bool ParseTokens(const std::string& line, InstalledPackage& pkg);
+
+    std::string pending_;                  // Line without its newline yet
+    std::string header_;                   // Row before the dashes (candidate header)
+    std::vector<size_t> columnStarts_;     // Display columns of the header fields
+    bool pastHeader_ = false;
+    std::vector<InstalledPackage> packages_;
+};
+
+struct InstalledSyncResult {
+    std::vector<std::string> added;      // Sorted package ids
+    std::vector<std::string> removed;
+    std::vector<std::string> changed;    // Version or source differs
+    size_t installed = 0;                // Distinct packages in the listing
+};
+
+// Apply the listing to installed_apps in one transaction. timestamp is stored as
+// installed_date of new rows and last_seen of every listed row. An empty listing
+// is treated as a failed winget run and changes nothing (returns false).
+bool ApplyInstalledPackages(sqlite3* db, const std::vector<InstalledPackage>& packages, const std::string& timestamp,
+                            InstalledSyncResult& result);
+
+#endif // INSTALLED_SYNC_H
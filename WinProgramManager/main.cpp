@@ -16,6 +16,13 @@
 #include "resource.h"
 #include "search.h"
 #include "installed_apps.h"
+#include "icon_cache.h"
+#include "db_connection.h"
+#include "db_meta.h"
+#include "db_schema.h"
+#include "catalog.h"
+#include "catalog_snapshot.h"
+#include "catalog_changes.h"
 
 // Control IDs
 #define ID_SEARCH_BTN 1001
@@ -60,6 +67,7 @@ HFONT g_hBoldFont = NULL;  // Bold font for category name
 HIMAGELIST g_hImageList = NULL;
 HIMAGELIST g_hTreeImageList = NULL;
 sqlite3* g_db = NULL;
+std::wstring g_dbPath;
 Locale g_locale;
 std::wstring g_currentLang = L"en_GB";
 
@@ -88,6 +96,22 @@ static std::atomic<bool> g_iconLoadingRunning(false);
 // Global for main window handle
 static HWND g_mainWindow = NULL;
 
+// Live refresh: the change log position the in-memory catalog reflects, and the
+// PRAGMA data_version seen at the last poll (changes when another connection commits)
+#define CATALOG_POLL_TIMER_ID 1
+#define CATALOG_POLL_INTERVAL_MS 5000
+static int64_t g_changeSeq = 0;
+static int64_t g_dataVersion = -1;
+static std::thread g_snapshotWriter;  // Writes the catalog snapshot after a cold load
+
+// Changes that need a full reload (added, removed or renamed apps, category
+// links) are loaded on g_catalogReloader; the finished Catalog comes back in
+// WM_APP_CATALOG_RELOADED (wParam unused, lParam = Catalog*, null on failure)
+#define WM_APP_CATALOG_RELOADED (WM_APP + 11)
+static std::thread g_catalogReloader;
+static bool g_catalogReloading = false;
+static std::atomic<int64_t> g_reloadedSeq(0);  // Change log position of the Catalog in flight
+
 // Loading dialog window procedure
 LRESULT CALLBACK LoadingDialogProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     static HBRUSH hWhiteBrush = (HBRUSH)GetStockObject(WHITE_BRUSH);
@@ -197,30 +221,44 @@ DWORD WINAPI LoadingDialogThread(LPVOID lpParam) {
 int g_splitterPos = 300;  // Initial splitter position
 bool g_draggingSplitter = false;
 std::wstring g_selectedTag = L"All";
-std::map<int, std::vector<unsigned char>> g_iconCache;
 std::vector<std::wstring*> g_tagTextBuffers;  // Persistent storage for TreeView text
 
 // Structures
-struct AppInfo {
-    int id;
-    std::wstring packageId;
-    std::wstring name;
-    std::wstring version;
-    std::wstring publisher;
-    std::wstring homepage;
-    int iconIndex;
-    std::vector<std::wstring> categories; // Categories this app belongs to
-};
-
 struct TagInfo {
     std::wstring name;
     int count;
 };
 
-// In-memory data cache for fast searching (declared after AppInfo)
-std::vector<AppInfo> g_allApps;  // All apps loaded into memory (metadata only, not icons)
-std::vector<std::wstring> g_allCategoryNames;  // All unique category names
-std::map<std::wstring, std::vector<int>> g_categoryToAppIds;  // Map category name to app IDs
+// In-memory data cache for fast searching (UTF-8 arena, see catalog.h).
+// App list rows store the catalog app index in lParam.
+Catalog g_catalog;
+
+// Convert catalog text (UTF-8, falling back to the ANSI code page) to UTF-16
+std::wstring Utf8ToWide(std::string_view utf8) {
+    if (utf8.empty()) return L"";
+    
+    int wsize = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, utf8.data(), (int)utf8.size(), nullptr, 0);
+    UINT codePage = CP_UTF8;
+    if (wsize == 0) {
+        codePage = CP_ACP;
+        wsize = MultiByteToWideChar(CP_ACP, 0, utf8.data(), (int)utf8.size(), nullptr, 0);
+        if (wsize == 0) return L"";
+    }
+    std::wstring result(wsize, 0);
+    MultiByteToWideChar(codePage, 0, utf8.data(), (int)utf8.size(), &result[0], wsize);
+    return result;
+}
+
+std::string WideToUtf8(const std::wstring& wide) {
+    if (wide.empty()) return "";
+    
+    int size = WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), (int)wide.size(), nullptr, 0, nullptr, nullptr);
+    std::string result(size > 0 ? size : 0, 0);
+    if (size > 0) {
+        WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), (int)wide.size(), &result[0], size, nullptr, nullptr);
+    }
+    return result;
+}
 
 // Forward declarations
 INT_PTR CALLBACK SearchDialogProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lParam);
@@ -231,10 +269,10 @@ void ResizeControls(HWND hwnd);
 bool OpenDatabase();
 void CloseDatabase();
 void LoadAllDataIntoMemory();  // Load all apps and categories into memory for fast search
-void LoadAllIcons();  // Load all app icons into ImageList (call after ImageList is created)
+void ApplyCatalogChanges();  // Apply what another program changed since the last poll
+void OnCatalogReloaded(Catalog* catalog);  // Swap in a catalog loaded by ApplyCatalogChanges
 void LoadInstalledPackageIds();  // Load installed package IDs from database
 HBITMAP LoadIconFromBlob(const std::vector<unsigned char>& data, const std::wstring& type);
-HICON LoadIconFromMemory(const unsigned char* data, int size);
 void OnTagSelectionChanged();
 void OnAppDoubleClick();
 void OnLanguageChanged();
@@ -243,7 +281,6 @@ void EndSearch();
 bool MatchString(const std::wstring& text, const std::wstring& pattern);
 bool LoadLocale(const std::wstring& lang);
 std::wstring FormatNumber(int num);
-std::wstring CapitalizeFirst(const std::wstring& str);
 
 // WinMain - Entry point
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow) {
@@ -452,51 +489,41 @@ bool MatchString(const std::wstring& text, const std::wstring& pattern) {
 
 // Execute search based on current criteria
 void ExecuteSearch() {
-    if (g_allApps.empty()) return;  // No data loaded
+    if (g_catalog.AppCount() == 0) return;  // No data loaded
     
     // Populate g_allCategories if empty (for potential future use)
     if (g_allCategories.empty()) {
-        g_allCategories = g_allCategoryNames;
+        for (uint32_t c = 0; c < g_catalog.CategoryCount(); c++) {
+            g_allCategories.push_back(Utf8ToWide(g_catalog.CategoryName(c)));
+        }
     }
     
     // Clear previous results
     g_filteredCategories.clear();
     ListView_DeleteAllItems(g_hTagTree);
     
-    // Determine which categories to search
-    std::vector<std::wstring> categoriesToSearch;
-    
-    if (!g_searchCategoryFilter.empty()) {
-        // Filter categories based on search criteria (in-memory)
-        for (const auto& category : g_allCategoryNames) {
-            if (MatchString(category, g_searchCategoryFilter)) {
-                categoriesToSearch.push_back(category);
-            }
+    // Match every app name once up front instead of once per category it belongs to
+    std::vector<char> appMatches;
+    if (!g_searchAppFilter.empty()) {
+        appMatches.resize(g_catalog.AppCount());
+        for (size_t i = 0; i < g_catalog.AppCount(); i++) {
+            appMatches[i] = MatchString(Utf8ToWide(g_catalog.Text(g_catalog.App(i).name)), g_searchAppFilter);
         }
-    } else {
-        // No category filter - use all categories
-        categoriesToSearch = g_allCategoryNames;
     }
     
-    // Now filter by app name if specified, and count matching apps per category
+    // Filter categories (in-memory) and count matching apps per category
     int displayIndex = 0;
-    for (const auto& category : categoriesToSearch) {
-        int matchingAppCount = 0;
+    for (uint32_t c = 0; c < g_catalog.CategoryCount(); c++) {
+        std::wstring category = Utf8ToWide(g_catalog.CategoryName(c));
+        if (!g_searchCategoryFilter.empty() && !MatchString(category, g_searchCategoryFilter)) {
+            continue;
+        }
         
-        // Get app IDs for this category
-        auto it = g_categoryToAppIds.find(category);
-        if (it != g_categoryToAppIds.end()) {
-            for (int appId : it->second) {
-                // Find the app in g_allApps
-                for (const auto& app : g_allApps) {
-                    if (app.id == appId) {
-                        // Check if app matches app filter (if any)
-                        if (g_searchAppFilter.empty() || MatchString(app.name, g_searchAppFilter)) {
-                            matchingAppCount++;
-                        }
-                        break;
-                    }
-                }
+        int matchingAppCount = 0;
+        for (uint32_t appIndex : g_catalog.CategoryApps(c)) {
+            // Check if app matches app filter (if any)
+            if (appMatches.empty() || appMatches[appIndex]) {
+                matchingAppCount++;
             }
         }
         
@@ -640,8 +667,9 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             // Database loaded - create controls and load data
             CreateControls(hwnd);
             
-            // Load all icons into ImageList (must happen after ImageList is created)
-            LoadAllIcons();
+            // Icons come from the pre-rendered atlas when it matches the database,
+            // otherwise they are decoded on demand (must happen after ImageList is created)
+            InitIconCache(g_hImageList, g_dbPath, GetContentVersion(g_db), hwnd);
             
             // Load data into controls
             LoadTags();
@@ -672,6 +700,9 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             // Set focus to category list for blue selection
             SetFocus(g_hTagTree);
             
+            // Pick up updater runs while the window is open
+            SetTimer(hwnd, CATALOG_POLL_TIMER_ID, CATALOG_POLL_INTERVAL_MS, NULL);
+            
             return 0;
         }
 
@@ -679,6 +710,38 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             ResizeControls(hwnd);
             return 0;
         }
+        
+        case WM_TIMER: {
+            if (wParam == CATALOG_POLL_TIMER_ID) {
+                ApplyCatalogChanges();
+            }
+            return 0;
+        }
+        
+        case WM_APP_CATALOG_RELOADED: {
+            OnCatalogReloaded((Catalog*)lParam);
+            return 0;
+        }
+        
+        case WM_APP_ICON_DECODED: {
+            // Background decode finished - repaint the visible rows showing this app
+            int appId = OnIconDecoded(wParam, lParam);
+            if (appId >= 0 && g_hAppList) {
+                int top = ListView_GetTopIndex(g_hAppList);
+                int last = std::min(top + ListView_GetCountPerPage(g_hAppList) + 1,
+                                    ListView_GetItemCount(g_hAppList));
+                for (int i = top; i < last; i++) {
+                    LVITEMW lvi = {};
+                    lvi.mask = LVIF_PARAM;
+                    lvi.iItem = i;
+                    if (ListView_GetItem(g_hAppList, &lvi) && (size_t)lvi.lParam < g_catalog.AppCount() &&
+                        g_catalog.App((size_t)lvi.lParam).id == appId) {
+                        ListView_RedrawItems(g_hAppList, i, i);
+                    }
+                }
+            }
+            return 0;
+        }
 
         case WM_COMMAND: {
             if (LOWORD(wParam) == ID_SEARCH_BTN) {
@@ -698,9 +761,9 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                 bool wasActive = IsInstalledFilterActive();
                 SetInstalledFilterActive(!wasActive);
                 
-                // Load installed package IDs if activating filter
+                // Refresh installed state if activating filter
                 if (IsInstalledFilterActive()) {
-                    LoadInstalledPackageIds(g_db);
+                    g_catalog.LoadInstalled(g_db);
                 }
                 
                 // Show spinner when deactivating (going back to all apps)
@@ -781,20 +844,30 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             }
             else if (nmhdr->idFrom == ID_APP_LIST && nmhdr->code == LVN_GETDISPINFOW) {
                 NMLVDISPINFOW* pDispInfo = (NMLVDISPINFOW*)lParam;
-                AppInfo* app = (AppInfo*)pDispInfo->item.lParam;
+                if ((size_t)pDispInfo->item.lParam >= g_catalog.AppCount()) return 0;
+                const CatalogApp& app = g_catalog.App((size_t)pDispInfo->item.lParam);
                 
-                if (pDispInfo->item.mask & LVIF_TEXT) {
+                if ((pDispInfo->item.mask & LVIF_TEXT) && pDispInfo->item.pszText && pDispInfo->item.cchTextMax > 0) {
+                    // UTF-16 is only produced here, for the rows being painted
+                    std::wstring text;
                     switch (pDispInfo->item.iSubItem) {
-                        case 0: // Name
-                            pDispInfo->item.pszText = (LPWSTR)app->name.c_str();
+                        case 0: // Name (spaces for spacing from icon)
+                            text = L"   " + Utf8ToWide(g_catalog.Text(app.name));
                             break;
                         case 1: // Version
-                            pDispInfo->item.pszText = (LPWSTR)app->version.c_str();
+                            text = Utf8ToWide(g_catalog.Text(app.version));
                             break;
                         case 2: // Publisher
-                            pDispInfo->item.pszText = (LPWSTR)app->publisher.c_str();
+                            text = Utf8ToWide(g_catalog.Publisher(app));
                             break;
                     }
+                    size_t count = std::min(text.size(), (size_t)pDispInfo->item.cchTextMax - 1);
+                    text.copy(pDispInfo->item.pszText, count);
+                    pDispInfo->item.pszText[count] = L'\0';
+                }
+                if (pDispInfo->item.mask & LVIF_IMAGE) {
+                    // Placeholder (index 0) until the background decoder delivers the icon
+                    pDispInfo->item.iImage = GetAppIconIndex(app.id, app.hasIcon);
                 }
             }
             return 0;
@@ -936,6 +1009,17 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
         }
 
         case WM_DESTROY:
+            KillTimer(hwnd, CATALOG_POLL_TIMER_ID);
+            if (g_snapshotWriter.joinable()) g_snapshotWriter.join();
+            if (g_catalogReloader.joinable()) {
+                // Free a reloaded catalog that was posted but never delivered
+                g_catalogReloader.join();
+                MSG msg;
+                while (PeekMessageW(&msg, hwnd, WM_APP_CATALOG_RELOADED, WM_APP_CATALOG_RELOADED, PM_REMOVE)) {
+                    delete (Catalog*)msg.lParam;
+                }
+            }
+            ShutdownIconCache();
             CloseDatabase();
             if (g_hFont) DeleteObject(g_hFont);
             if (g_hBoldFont) DeleteObject(g_hBoldFont);
@@ -1242,7 +1326,8 @@ void CreateControls(HWND hwnd) {
     ListView_SetExtendedListViewStyle(g_hAppList, LVS_EX_FULLROWSELECT | LVS_EX_DOUBLEBUFFER);
     
     // Create image list for icons and add a default application icon
-    g_hImageList = ImageList_Create(21, 19, ILC_COLOR32 | ILC_MASK, 100, 100);
+    // (slots 1..ICON_CACHE_CAPACITY are recycled by the icon cache)
+    g_hImageList = ImageList_Create(21, 19, ILC_COLOR32 | ILC_MASK, ICON_CACHE_CAPACITY + 1, 16);
     
     // Create a blue dot icon as default (for apps without icons)
     HDC hdc = GetDC(NULL);
@@ -1395,13 +1480,14 @@ bool OpenDatabase() {
         dbPath = dbPath.substr(0, lastSlash + 1);
     }
     dbPath += L"WinProgramManager.db";
+    g_dbPath = dbPath;
     
     // Convert to UTF-8
     int size = WideCharToMultiByte(CP_UTF8, 0, dbPath.c_str(), -1, nullptr, 0, nullptr, nullptr);
     std::string dbPathUtf8(size - 1, 0);
     WideCharToMultiByte(CP_UTF8, 0, dbPath.c_str(), -1, &dbPathUtf8[0], size, nullptr, nullptr);
     
-    int result = sqlite3_open(dbPathUtf8.c_str(), &g_db);
+    int result = OpenCatalogDatabase(dbPathUtf8, &g_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
     if (result != SQLITE_OK) {
         std::wstring msg = L"Failed to open database at:\n" + dbPath + L"\n\nError: " + 
                            std::wstring(sqlite3_errmsg(g_db), sqlite3_errmsg(g_db) + strlen(sqlite3_errmsg(g_db)));
@@ -1409,6 +1495,11 @@ bool OpenDatabase() {
         return false;
     }
     
+    // Bring older databases to the current schema. If the updater holds the write
+    // lock past the busy timeout this fails; the GUI only reads, so it carries on
+    // with the schema as is.
+    MigrateCatalogSchema(g_db);
+    
     // Test query to verify database has data
     sqlite3_stmt* stmt;
     if (sqlite3_prepare_v2(g_db, "SELECT COUNT(*) FROM apps;", -1, &stmt, nullptr) != SQLITE_OK) {
@@ -1438,98 +1529,190 @@ void CloseDatabase() {
 
 // Installed apps functionality now in installed_apps.cpp
 
+static int64_t QueryDataVersion() {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(g_db, "PRAGMA data_version;", -1, &stmt, nullptr) != SQLITE_OK) return -1;
+    int64_t version = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : -1;
+    sqlite3_finalize(stmt);
+    return version;
+}
+
 void LoadAllDataIntoMemory() {
     if (!g_db) return;
     
-    // Clear existing data
-    g_allApps.clear();
-    g_allCategoryNames.clear();
-    g_categoryToAppIds.clear();
+    g_allCategories.clear();
     
-    // Load all apps metadata (icons loaded separately after ImageList is created)
-    sqlite3_stmt* stmt;
-    const char* sql = "SELECT id, package_id, name, version, publisher, homepage FROM apps WHERE name IS NOT NULL AND TRIM(name) != '' ORDER BY name;";
+    // The fingerprint, the change log position and every catalog query see the
+    // same database state, even while the updater commits
+    CatalogReadSnapshot snapshot(g_db);
     
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            AppInfo app;
-            app.id = sqlite3_column_int(stmt, 0);
-            app.iconIndex = 0;  // Default to brown package icon (index 0)
-            
-            // Convert UTF-8 to wide strings
-            auto convert = [](const char* utf8) -> std::wstring {
-                if (!utf8 || !utf8[0]) return L"";
-                
-                int wsize = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, utf8, -1, nullptr, 0);
-                if (wsize == 0) {
-                    wsize = MultiByteToWideChar(CP_ACP, 0, utf8, -1, nullptr, 0);
-                    if (wsize == 0) return L"";
-                    std::wstring result(wsize - 1, 0);
-                    MultiByteToWideChar(CP_ACP, 0, utf8, -1, &result[0], wsize);
-                    return result;
+    // Changes logged from here on are applied by ApplyCatalogChanges
+    g_changeSeq = GetLastChangeSeq(g_db);
+    g_dataVersion = QueryDataVersion();
+    
+    // The snapshot lives next to the database
+    std::string snapshotPath = WideToUtf8(g_dbPath.substr(0, g_dbPath.find_last_of(L"\\/") + 1)) +
+                               CATALOG_SNAPSHOT_FILENAME;
+    
+    // Warm start: a snapshot written for this exact database state skips the full load
+    CatalogFingerprint fingerprint;
+    bool haveFingerprint = ReadCatalogFingerprint(g_db, fingerprint);
+    if (haveFingerprint && ReadCatalogSnapshot(g_catalog, snapshotPath, fingerprint)) {
+        return;
+    }
+    
+    // Cold start: apps, publishers and categories go into one UTF-8 arena
+    // (icons are decoded on demand by icon_cache). Apps, category links and
+    // installed ids are read at the same time on their own connections, so the
+    // load takes as long as the slowest query.
+    int64_t loadedSeq = 0;
+    if (!g_catalog.LoadConcurrent(WideToUtf8(g_dbPath), loadedSeq)) {
+        g_catalog.Load(g_db);
+        loadedSeq = g_changeSeq;
+    }
+    
+    // Rebuild the snapshot in the background from a private copy (unless the
+    // updater committed since the fingerprint was read)
+    bool fingerprintMatches = loadedSeq == g_changeSeq;
+    g_changeSeq = loadedSeq;
+    if (haveFingerprint && fingerprintMatches) {
+        if (g_snapshotWriter.joinable()) g_snapshotWriter.join();
+        g_snapshotWriter = std::thread([catalog = g_catalog, snapshotPath, fingerprint]() {
+            WriteCatalogSnapshot(catalog, snapshotPath, fingerprint);
+        });
+    }
+}
+
+// Rebuild the category and app lists from the catalog, keeping the selected
+// category (or the search results)
+static void RepopulateLists() {
+    if (g_searchActive) {
+        ExecuteSearch();
+        return;
+    }
+    
+    std::wstring selectedTag = g_selectedTag;
+    LoadTags();
+    int count = ListView_GetItemCount(g_hTagTree);
+    for (int i = 1; i < count; i++) {
+        LVITEMW item = {};
+        item.mask = LVIF_PARAM;
+        item.iItem = i;
+        if (ListView_GetItem(g_hTagTree, &item) && item.lParam &&
+            *(std::wstring*)item.lParam == L"   " + selectedTag) {
+            ListView_SetItemState(g_hTagTree, -1, 0, LVIS_SELECTED | LVIS_FOCUSED);
+            ListView_SetItemState(g_hTagTree, i, LVIS_SELECTED | LVIS_FOCUSED, LVIS_SELECTED | LVIS_FOCUSED);
+            ListView_EnsureVisible(g_hTagTree, i, FALSE);
+            break;
+        }
+    }
+    OnTagSelectionChanged();
+}
+
+// Poll for commits of other connections (the updater). Changed fields and
+// installed states are patched into the catalog and only the visible rows they
+// touch are redrawn; added, removed or renamed apps and changed categories
+// reload the catalog on a background thread (OnCatalogReloaded swaps it in and
+// repopulates the lists).
+void ApplyCatalogChanges() {
+    if (!g_db || g_hIconLoadingDialog || g_catalogReloading) return;
+    
+    int64_t dataVersion = QueryDataVersion();
+    if (dataVersion == g_dataVersion) return;
+    
+    // The changes and the rows they name are read from one snapshot
+    CatalogChanges changes;
+    std::vector<uint32_t> changedApps;
+    bool reload;
+    {
+        CatalogReadSnapshot snapshot(g_db);
+        if (!snapshot.Active() || !ReadCatalogChanges(g_db, g_changeSeq, changes)) return;
+        if (changes.complete && changes.Empty()) {
+            g_dataVersion = dataVersion;
+            return;
+        }
+        
+        reload = !changes.complete || !changes.linkAppIds.empty() || !g_catalog.UpdateApps(g_db, changes.appIds);
+        if (reload) {
+            // The lists keep showing the current catalog until the new one is in.
+            // g_dataVersion and g_changeSeq stay, so the changes logged while it
+            // loads are picked up by the first poll after the swap.
+            if (g_catalogReloader.joinable()) g_catalogReloader.join();
+            g_catalogReloading = true;
+            g_catalogReloader = std::thread([dbPath = WideToUtf8(g_dbPath), hwnd = g_mainWindow]() {
+                Catalog* catalog = new Catalog();
+                int64_t seq = 0;
+                if (!catalog->LoadConcurrent(dbPath, seq)) {
+                    delete catalog;
+                    catalog = nullptr;
                 }
-                std::wstring result(wsize - 1, 0);
-                MultiByteToWideChar(CP_UTF8, 0, utf8, -1, &result[0], wsize);
-                return result;
-            };
-            
-            app.packageId = convert((const char*)sqlite3_column_text(stmt, 1));
-            app.name = convert((const char*)sqlite3_column_text(stmt, 2));
-            app.version = convert((const char*)sqlite3_column_text(stmt, 3));
-            app.publisher = convert((const char*)sqlite3_column_text(stmt, 4));
-            app.homepage = convert((const char*)sqlite3_column_text(stmt, 5));
+                g_reloadedSeq = seq;
+                if (!PostMessageW(hwnd, WM_APP_CATALOG_RELOADED, 0, (LPARAM)catalog)) {
+                    delete catalog;
+                }
+            });
+            return;
+        } else {
+            for (int appId : changes.appIds) {
+                int index = g_catalog.FindApp(appId);
+                if (index >= 0) changedApps.push_back((uint32_t)index);
+            }
+            size_t fieldChanges = changedApps.size();
+            g_catalog.UpdateInstalled(g_db, changes.installedIds, changedApps);
             
-            g_allApps.push_back(app);
+            // The installed filter shows different apps (and category counts) now
+            reload = IsInstalledFilterActive() && changedApps.size() > fieldChanges;
         }
-        sqlite3_finalize(stmt);
     }
     
-    // Load all categories and build app-category associations
-    const char* catSql = "SELECT c.category_name, ac.app_id FROM categories c " 
-                         "JOIN app_categories ac ON c.id = ac.category_id " 
-                         "ORDER BY c.category_name;";
+    g_dataVersion = dataVersion;
+    g_changeSeq = changes.lastSeq;
+    InvalidateAppIcons(changes.appIds);
     
-    std::set<std::wstring> uniqueCategories;
+    if (reload) {
+        RepopulateLists();
+        return;
+    }
     
-    if (sqlite3_prepare_v2(g_db, catSql, -1, &stmt, nullptr) == SQLITE_OK) {
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            const char* catName = (const char*)sqlite3_column_text(stmt, 0);
-            int appId = sqlite3_column_int(stmt, 1);
-            
-            if (!catName || !catName[0]) continue;
-            
-            // Convert to wide string
-            int wsize = MultiByteToWideChar(CP_UTF8, 0, catName, -1, nullptr, 0);
-            if (wsize <= 1) continue;
-            std::wstring categoryName(wsize - 1, 0);
-            MultiByteToWideChar(CP_UTF8, 0, catName, -1, &categoryName[0], wsize);
-            
-            // Trim and capitalize
-            size_t first = categoryName.find_first_not_of(L" \t\r\n");
-            if (first == std::wstring::npos) continue;
-            size_t last = categoryName.find_last_not_of(L" \t\r\n");
-            categoryName = categoryName.substr(first, last - first + 1);
-            categoryName = CapitalizeFirst(categoryName);
-            
-            uniqueCategories.insert(categoryName);
-            g_categoryToAppIds[categoryName].push_back(appId);
-            
-            // Add category to the app's categories list
-            for (auto& app : g_allApps) {
-                if (app.id == appId) {
-                    app.categories.push_back(categoryName);
-                    break;
-                }
-            }
+    // Redraw the visible rows of the changed apps
+    std::sort(changedApps.begin(), changedApps.end());
+    int top = ListView_GetTopIndex(g_hAppList);
+    int last = std::min(top + ListView_GetCountPerPage(g_hAppList) + 1, ListView_GetItemCount(g_hAppList));
+    for (int i = top; i < last; i++) {
+        LVITEMW lvi = {};
+        lvi.mask = LVIF_PARAM;
+        lvi.iItem = i;
+        if (ListView_GetItem(g_hAppList, &lvi) &&
+            std::binary_search(changedApps.begin(), changedApps.end(), (uint32_t)lvi.lParam)) {
+            ListView_RedrawItems(g_hAppList, i, i);
         }
-        sqlite3_finalize(stmt);
+    }
+}
+
+void OnCatalogReloaded(Catalog* catalog) {
+    g_catalogReloading = false;
+    if (!catalog) return;  // Database kept changing or could not be read; the next poll retries
+    if (g_hIconLoadingDialog) {
+        // The lists are being rebuilt from the current catalog; the next poll reloads again
+        delete catalog;
+        return;
+    }
+    
+    // Icons of the apps changed up to the new catalog's position are stale. Reading
+    // a little past it only re-decodes a few extra icons.
+    CatalogChanges changes;
+    if (ReadCatalogChanges(g_db, g_changeSeq, changes)) {
+        InvalidateAppIcons(changes.appIds);
     }
     
-    // Convert set to vector for easier access
-    g_allCategoryNames.assign(uniqueCategories.begin(), uniqueCategories.end());
+    g_catalog = std::move(*catalog);
+    delete catalog;
+    g_allCategories.clear();
+    g_changeSeq = g_reloadedSeq;
+    g_dataVersion = -1;  // Poll again at the next tick, from the new position
+    RepopulateLists();
 }
 
-// Load all app icons into ImageList (must be called after ImageList is created)
 // Dialog procedure for icon loading dialog
 INT_PTR CALLBACK IconLoadingDialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
     static int spinnerFrame = 0;
@@ -1623,63 +1806,8 @@ INT_PTR CALLBACK IconLoadingDialogProc(HWND hDlg, UINT message, WPARAM wParam, L
     return FALSE;
 }
 
-void LoadAllIcons() {
-    if (!g_db || !g_hImageList) return;
-    
-    // NOTE: Index 0 in ImageList is the brown package icon (default for apps without icons)
-    // We must preserve this by starting custom icons at index 1+
-    
-    // Query all apps with their icons
-    sqlite3_stmt* stmt;
-    const char* sql = "SELECT id, icon_data FROM apps WHERE name IS NOT NULL AND TRIM(name) != '' ORDER BY name;";
-    
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            int appId = sqlite3_column_int(stmt, 0);
-            
-            // Find this app in g_allApps
-            for (auto& app : g_allApps) {
-                if (app.id == appId) {
-                    // Try to load icon from database
-                    if (sqlite3_column_type(stmt, 1) == SQLITE_BLOB) {
-                        const void* blobData = sqlite3_column_blob(stmt, 1);
-                        int blobSize = sqlite3_column_bytes(stmt, 1);
-                        
-                        if (blobData && blobSize > 0) {
-                            HICON hIcon = LoadIconFromMemory((const unsigned char*)blobData, blobSize);
-                            if (hIcon) {
-                                // Add icon to ImageList - this returns new index (1, 2, 3, ...)
-                                app.iconIndex = ImageList_AddIcon(g_hImageList, hIcon);
-                                DestroyIcon(hIcon);
-                            } else {
-                                // Icon data exists but failed to load - use brown package
-                                app.iconIndex = 0;
-                            }
-                        } else {
-                            // No icon data - use brown package icon (index 0)
-                            app.iconIndex = 0;
-                        }
-                    } else {
-                        // No icon in database - use brown package icon (index 0)
-                        app.iconIndex = 0;
-                    }
-                    break;
-                }
-            }
-        }
-        sqlite3_finalize(stmt);
-    }
-}
-
 // All old dialog code removed - new dialog is created in WinMain before main window
 
-std::wstring CapitalizeFirst(const std::wstring& str) {
-    if (str.empty()) return str;
-    std::wstring result = str;
-    result[0] = towupper(result[0]);
-    return result;
-}
-
 void LoadTags(const std::wstring& filter) {
     ListView_DeleteAllItems(g_hTagTree);
     
@@ -1689,7 +1817,7 @@ void LoadTags(const std::wstring& filter) {
     }
     g_tagTextBuffers.clear();
     
-    if (g_allCategoryNames.empty()) return;  // No data loaded
+    if (g_catalog.CategoryCount() == 0) return;  // No data loaded
     
     // Add "All" item - use persistent storage
     std::wstring* allText = new std::wstring(L"   " + g_locale.all);
@@ -1708,33 +1836,26 @@ void LoadTags(const std::wstring& filter) {
     // Load categories from in-memory cache
     int itemIndex = 1;
     int processedCount = 0;
-    for (const auto& categoryName : g_allCategoryNames) {
+    for (uint32_t c = 0; c < g_catalog.CategoryCount(); c++) {
         // Process messages every 10 items to keep dialog responsive
         if (g_hIconLoadingDialog && (++processedCount % 10 == 0)) {
             ProcessDialogMessages();
         }
         
         // Get app count for this category (show all with 4+ apps, or categories where apps would be orphaned)
-        auto it = g_categoryToAppIds.find(categoryName);
-        if (it == g_categoryToAppIds.end() || it->second.empty()) continue;
+        IndexRange apps = g_catalog.CategoryApps(c);
+        if (apps.empty()) continue;
         
-        int appCount = it->second.size();
+        int appCount = (int)apps.size();
         bool hasOrphanedApps = false;
         
         // Check if category has apps that would be orphaned (only in this one category)
         if (appCount < 4) {
-            for (int appId : it->second) {
-                // Find this app in g_allApps and check how many categories it belongs to
-                for (const auto& app : g_allApps) {
-                    if (app.id == appId) {
-                        if (app.categories.size() == 1) {
-                            hasOrphanedApps = true;
-                            break;
-                        }
-                        break;
-                    }
+            for (uint32_t appIndex : apps) {
+                if (g_catalog.App(appIndex).categoryCount == 1) {
+                    hasOrphanedApps = true;
+                    break;
                 }
-                if (hasOrphanedApps) break;
             }
         }
         
@@ -1744,22 +1865,17 @@ void LoadTags(const std::wstring& filter) {
         // If installed filter is active, check if category has any installed apps
         if (IsInstalledFilterActive()) {
             bool hasInstalledApp = false;
-            for (int appId : it->second) {
-                // Find this app in g_allApps
-                for (const auto& app : g_allApps) {
-                    if (app.id == appId) {
-                        if (IsPackageInstalled(app.packageId)) {
-                            hasInstalledApp = true;
-                            break;
-                        }
-                        break;
-                    }
+            for (uint32_t appIndex : apps) {
+                if (g_catalog.IsInstalled(appIndex)) {
+                    hasInstalledApp = true;
+                    break;
                 }
-                if (hasInstalledApp) break;
             }
             if (!hasInstalledApp) continue;  // Skip categories with no installed apps
         }
         
+        std::wstring categoryName = Utf8ToWide(g_catalog.CategoryName(c));
+        
         // Apply filter if specified
         if (!filter.empty()) {
             std::wstring lower_name = categoryName;
@@ -1799,46 +1915,46 @@ void LoadTags(const std::wstring& filter) {
 void LoadApps(const std::wstring& tag, const std::wstring& filter) {
     ListView_DeleteAllItems(g_hAppList);
     
-    if (g_allApps.empty()) return;  // No data loaded
+    if (g_catalog.AppCount() == 0) return;  // No data loaded
+    
+    // Apps of the selected category (catalog keeps them in name order)
+    std::vector<uint32_t> allApps;
+    IndexRange candidates;
+    if (tag == L"All") {
+        allApps.resize(g_catalog.AppCount());
+        for (size_t i = 0; i < allApps.size(); i++) allApps[i] = (uint32_t)i;
+        candidates.first = allApps.data();
+        candidates.last = allApps.data() + allApps.size();
+    } else {
+        int category = g_catalog.FindCategory(WideToUtf8(tag));
+        if (category >= 0) candidates = g_catalog.CategoryApps((uint32_t)category);
+    }
+    
+    std::wstring lower_filter = filter;
+    std::transform(lower_filter.begin(), lower_filter.end(), lower_filter.begin(), ::towlower);
     
     int appCount = 0;
     int index = 0;
     int processedCount = 0;
     
     // Filter apps from in-memory cache
-    for (const auto& app : g_allApps) {
+    for (uint32_t appIndex : candidates) {
         // Process messages every 50 items to keep dialog responsive
         if (g_hIconLoadingDialog && (++processedCount % 50 == 0)) {
             ProcessDialogMessages();
         }
         
-        // Check if app belongs to selected category
-        bool categoryMatch = false;
-        if (tag == L"All") {
-            categoryMatch = true;
-        } else {
-            // Check if app has this category
-            for (const auto& cat : app.categories) {
-                if (cat == tag) {
-                    categoryMatch = true;
-                    break;
-                }
-            }
-        }
-        
-        if (!categoryMatch) continue;
+        const CatalogApp& app = g_catalog.App(appIndex);
         
         // Apply filter if specified
         if (!filter.empty()) {
-            std::wstring lower_name = app.name;
-            std::wstring lower_publisher = app.publisher;
-            std::wstring lower_packageId = app.packageId;
-            std::wstring lower_filter = filter;
+            std::wstring lower_name = Utf8ToWide(g_catalog.Text(app.name));
+            std::wstring lower_publisher = Utf8ToWide(g_catalog.Publisher(app));
+            std::wstring lower_packageId = Utf8ToWide(g_catalog.Text(app.packageId));
             
             std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(), ::towlower);
             std::transform(lower_publisher.begin(), lower_publisher.end(), lower_publisher.begin(), ::towlower);
             std::transform(lower_packageId.begin(), lower_packageId.end(), lower_packageId.begin(), ::towlower);
-            std::transform(lower_filter.begin(), lower_filter.end(), lower_filter.begin(), ::towlower);
             
             if (lower_name.find(lower_filter) == std::wstring::npos &&
                 lower_publisher.find(lower_filter) == std::wstring::npos &&
@@ -1849,29 +1965,25 @@ void LoadApps(const std::wstring& tag, const std::wstring& filter) {
         
         // Apply installed filter if active
         if (IsInstalledFilterActive()) {
-            if (!IsPackageInstalled(app.packageId)) {
+            if (!g_catalog.IsInstalled(appIndex)) {
                 continue;  // Skip non-installed apps
             }
         }
         
-        // Create a copy of the app for ListView (using new to persist beyond this function)
-        AppInfo* appCopy = new AppInfo(app);
-        
-        // Add to list view
+        // Add to list view. Text and icon are supplied through LVN_GETDISPINFO,
+        // so the list only holds the catalog index.
         LVITEMW lvi = {};
         lvi.mask = LVIF_TEXT | LVIF_PARAM | LVIF_IMAGE;
         lvi.iItem = index++;
         lvi.iSubItem = 0;
-        // Add spaces before name for spacing from icon
-        std::wstring displayName = L"   " + appCopy->name;
-        lvi.pszText = (LPWSTR)displayName.c_str();
-        lvi.lParam = (LPARAM)appCopy;
-        // Use iconIndex if valid, otherwise use 0 (brown package icon)
-        lvi.iImage = (appCopy->iconIndex >= 0) ? appCopy->iconIndex : 0;
+        lvi.pszText = LPSTR_TEXTCALLBACKW;
+        lvi.lParam = (LPARAM)appIndex;
+        // Icon index is resolved through LVN_GETDISPINFO (brown package until decoded)
+        lvi.iImage = I_IMAGECALLBACK;
         ListView_InsertItem(g_hAppList, &lvi);
         
-        ListView_SetItemText(g_hAppList, lvi.iItem, 1, (LPWSTR)appCopy->version.c_str());
-        ListView_SetItemText(g_hAppList, lvi.iItem, 2, (LPWSTR)appCopy->publisher.c_str());
+        ListView_SetItemText(g_hAppList, lvi.iItem, 1, LPSTR_TEXTCALLBACKW);
+        ListView_SetItemText(g_hAppList, lvi.iItem, 2, LPSTR_TEXTCALLBACKW);
         
         appCount++;
     }
@@ -1938,9 +2050,10 @@ void OnAppDoubleClick() {
     lvi.iItem = index;
     ListView_GetItem(g_hAppList, &lvi);
     
-    AppInfo* app = (AppInfo*)lvi.lParam;
-    if (app && !app->homepage.empty()) {
-        ShellExecuteW(NULL, L"open", app->homepage.c_str(), NULL, NULL, SW_SHOWNORMAL);
+    if ((size_t)lvi.lParam >= g_catalog.AppCount()) return;
+    std::wstring homepage = Utf8ToWide(g_catalog.Text(g_catalog.App((size_t)lvi.lParam).homepage));
+    if (!homepage.empty()) {
+        ShellExecuteW(NULL, L"open", homepage.c_str(), NULL, NULL, SW_SHOWNORMAL);
     }
 }
 
@@ -1952,34 +2065,6 @@ HBITMAP LoadIconFromBlob(const std::vector<unsigned char>& data, const std::wstr
     return NULL;
 }
 
-HICON LoadIconFromMemory(const unsigned char* data, int size) {
-    if (!data || size <= 0) return NULL;
-    
-    // Check if it's an ICO file (starts with 0x00 0x00 0x01 0x00)
-    if (size >= 4 && data[0] == 0x00 && data[1] == 0x00 && data[2] == 0x01 && data[3] == 0x00) {
-        // Try to load as ICO
-        int offset = LookupIconIdFromDirectoryEx((PBYTE)data, TRUE, 16, 16, LR_DEFAULTCOLOR);
-        if (offset != 0 && offset < size) {
-            HICON hIcon = CreateIconFromResourceEx((PBYTE)data + offset, size - offset, 
-                                                   TRUE, 0x00030000, 16, 16, LR_DEFAULTCOLOR);
-            if (hIcon) return hIcon;
-        }
-    }
-    
-    // Check if it's a PNG file (starts with 0x89 'P' 'N' 'G')
-    if (size >= 8 && data[0] == 0x89 && data[1] == 0x50 && data[2] == 0x4E && data[3] == 0x47) {
-        // Try to load as PNG using IStream
-        IStream* pStream = SHCreateMemStream(data, size);
-        if (pStream) {
-            // For now, we'll skip PNG support and return NULL
-            // TODO: Implement PNG to HICON conversion using GDI+
-            pStream->Release();
-        }
-    }
-    
-    // Return NULL if format not supported
-    return NULL;
-}
 // Load locale from file
 bool LoadLocale(const std::wstring& lang) {
     // Build file path
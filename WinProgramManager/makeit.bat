@@ -76,9 +76,6 @@ if exist "%PACKAGE_DIR%" (
     if exist "%PACKAGE_DIR%\WinProgramManager.db" (
         copy /Y "%PACKAGE_DIR%\WinProgramManager.db" "%TEMP%\WinProgramManager_temp.db" >nul 2>&1
     )
-    if exist "%PACKAGE_DIR%\WinProgramsSearch.db" (
-        copy /Y "%PACKAGE_DIR%\WinProgramsSearch.db" "%TEMP%\WinProgramsSearch_temp.db" >nul 2>&1
-    )
     attrib -r -s -h "%PACKAGE_DIR%"\*.* /s >nul 2>&1
     rmdir /s /q "%PACKAGE_DIR%"
     mkdir "%PACKAGE_DIR%"
@@ -88,11 +85,6 @@ if exist "%PACKAGE_DIR%" (
         del "%TEMP%\WinProgramManager_temp.db" >nul 2>&1
         echo WinProgramManager.db preserved.
     )
-    if exist "%TEMP%\WinProgramsSearch_temp.db" (
-        copy /Y "%TEMP%\WinProgramsSearch_temp.db" "%PACKAGE_DIR%\WinProgramsSearch.db" >nul 2>&1
-        del "%TEMP%\WinProgramsSearch_temp.db" >nul 2>&1
-        echo WinProgramsSearch.db preserved.
-    )
 ) else (
     mkdir "%PACKAGE_DIR%"
 )
@@ -0,0 +1,477 @@
+#include "manifest_import.h"
+#include "winget_index.h"
+#include "fetch_pipeline.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+// ---------------------------------------------------------------------------
+// YAML subset
+// ---------------------------------------------------------------------------
+
+struct YamlLine {
+    std::string_view text;   // Without indentation and line ending
+    int indent;
+};
+
+static std::string_view TrimView(std::string_view s) {
+    size_t first = s.find_first_not_of(" \t");
+    if (first == std::string_view::npos) return std::string_view();
+    size_t last = s.find_last_not_of(" \t");
+    return s.substr(first, last - first + 1);
+}
+
+static std::vector<YamlLine> SplitLines(std::string_view text) {
+    if (text.size() >= 3 && text.substr(0, 3) == "\xEF\xBB\xBF") text.remove_prefix(3);
+
+    std::vector<YamlLine> lines;
+    while (!text.empty()) {
+        size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        size_t indent = line.find_first_not_of(' ');
+        if (indent == std::string_view::npos) indent = line.size();
+        lines.push_back({line.substr(indent), (int)indent});
+    }
+    return lines;
+}
+
+static bool IsBlankOrComment(const YamlLine& line) {
+    std::string_view t = TrimView(line.text);
+    return t.empty() || t[0] == '#';
+}
+
+static bool IsListItem(std::string_view text) {
+    return text == "-" || (text.size() >= 2 && text[0] == '-' && text[1] == ' ');
+}
+
+static void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x110000) {
+        out += (char)(0xF0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+// Position of the closing quote in s (which starts after the opening quote), or npos
+static size_t FindClosingQuote(std::string_view s, char quote) {
+    for (size_t i = 0; i < s.size(); i++) {
+        if (quote == '"' && s[i] == '\\') {
+            i++;
+        } else if (s[i] == quote) {
+            if (quote == '\'' && i + 1 < s.size() && s[i + 1] == '\'') {
+                i++;  // '' is an escaped quote
+            } else {
+                return i;
+            }
+        }
+    }
+    return std::string_view::npos;
+}
+
+static std::string DecodeQuoted(std::string_view s, char quote) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); i++) {
+        char c = s[i];
+        if (quote == '\'') {
+            out += c;
+            if (c == '\'' && i + 1 < s.size() && s[i + 1] == '\'') i++;
+            continue;
+        }
+        if (c != '\\' || i + 1 >= s.size()) {
+            out += c;
+            continue;
+        }
+
+        char e = s[++i];
+        int hexDigits = e == 'x' ? 2 : e == 'u' ? 4 : e == 'U' ? 8 : 0;
+        if (hexDigits && i + hexDigits < s.size()) {
+            uint32_t cp = 0;
+            bool valid = true;
+            for (int k = 1; k <= hexDigits; k++) {
+                char h = s[i + k];
+                int digit = (h >= '0' && h <= '9') ? h - '0' : (h >= 'a' && h <= 'f') ? h - 'a' + 10 :
+                            (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+                if (digit < 0) valid = false;
+                cp = cp * 16 + (uint32_t)(digit < 0 ? 0 : digit);
+            }
+            if (valid) {
+                AppendUtf8(out, cp);
+                i += hexDigits;
+                continue;
+            }
+        }
+        switch (e) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case '0': break;
+            case ' ': out += ' '; break;
+            default: out += e; break;   // \" \\ \/ and anything unknown
+        }
+    }
+    return out;
+}
+
+// Single-line scalar: quoted, or plain with an optional trailing comment
+static std::string ScalarValue(std::string_view text) {
+    text = TrimView(text);
+    if (!text.empty() && (text[0] == '"' || text[0] == '\'')) {
+        size_t close = FindClosingQuote(text.substr(1), text[0]);
+        return DecodeQuoted(text.substr(1, close), text[0]);
+    }
+    size_t comment = text.find(" #");
+    return std::string(TrimView(text.substr(0, comment)));
+}
+
+static std::vector<std::string> FlowSequence(std::string_view text) {
+    std::vector<std::string> items;
+    text = TrimView(text);
+    if (!text.empty() && text[0] == '[') text.remove_prefix(1);
+    size_t close = text.rfind(']');
+    if (close != std::string_view::npos) text = text.substr(0, close);
+
+    while (!text.empty()) {
+        std::string_view t = TrimView(text);
+        size_t end;
+        if (!t.empty() && (t[0] == '"' || t[0] == '\'')) {
+            size_t q = FindClosingQuote(t.substr(1), t[0]);
+            end = q == std::string_view::npos ? std::string_view::npos : t.find(',', q + 2);
+        } else {
+            end = t.find(',');
+        }
+        std::string item = ScalarValue(t.substr(0, end));
+        if (!item.empty()) items.push_back(std::move(item));
+        text = end == std::string_view::npos ? std::string_view() : t.substr(end + 1);
+    }
+    return items;
+}
+
+static std::string* FieldFor(std::string_view key, ManifestFields& f) {
+    if (key == "ManifestType") return &f.manifestType;
+    if (key == "DefaultLocale") return &f.defaultLocale;
+    if (key == "PackageIdentifier") return &f.packageIdentifier;
+    if (key == "PackageVersion") return &f.packageVersion;
+    if (key == "PackageName") return &f.packageName;
+    if (key == "Publisher") return &f.publisher;
+    if (key == "Moniker") return &f.moniker;
+    if (key == "ShortDescription") return &f.shortDescription;
+    if (key == "Description") return &f.description;
+    if (key == "PackageUrl") return &f.packageUrl;
+    if (key == "PublisherUrl") return &f.publisherUrl;
+    if (key == "License") return &f.license;
+    if (key == "LicenseUrl") return &f.licenseUrl;
+    if (key == "PrivacyUrl") return &f.privacyUrl;
+    if (key == "Author") return &f.author;
+    if (key == "Copyright") return &f.copyright;
+    return nullptr;
+}
+
+void ParseManifestYaml(std::string_view text, ManifestFields& fields) {
+    std::vector<YamlLine> lines = SplitLines(text);
+    size_t i = 0;
+
+    while (i < lines.size()) {
+        const YamlLine& line = lines[i++];
+        // Only top-level keys matter; nested maps and lists of maps are skipped
+        if (IsBlankOrComment(line) || line.indent > 0 || IsListItem(line.text)) continue;
+
+        size_t colon = line.text.find(':');
+        if (colon == std::string_view::npos || colon == 0) continue;
+        std::string_view key = line.text.substr(0, colon);
+        if (key.find(' ') != std::string_view::npos) continue;
+        std::string_view rest = TrimView(line.text.substr(colon + 1));
+
+        if (key == "Tags") {
+            fields.tags.clear();
+            if (!rest.empty() && rest[0] == '[') {
+                std::string flow(rest);
+                while (flow.find(']') == std::string::npos && i < lines.size()) {
+                    flow += ' ';
+                    flow += TrimView(lines[i++].text);
+                }
+                fields.tags = FlowSequence(flow);
+                continue;
+            }
+            while (i < lines.size() && (IsBlankOrComment(lines[i]) || lines[i].indent > 0 || IsListItem(lines[i].text))) {
+                std::string_view item = TrimView(lines[i++].text);
+                if (IsListItem(item)) {
+                    std::string tag = ScalarValue(item.substr(1));
+                    if (!tag.empty()) fields.tags.push_back(std::move(tag));
+                }
+            }
+            continue;
+        }
+
+        std::string* target = FieldFor(key, fields);
+        std::string value;
+
+        if (!rest.empty() && (rest[0] == '|' || rest[0] == '>')) {
+            // Block scalar: every following line that is blank or indented
+            bool folded = rest[0] == '>';
+            // Blank lines are kept as line breaks in both styles; between two
+            // text lines '|' adds one more, '>' a space when there was none
+            int baseIndent = -1;
+            int blankLines = 0;
+            while (i < lines.size() && (TrimView(lines[i].text).empty() || lines[i].indent > 0)) {
+                const YamlLine& body = lines[i++];
+                if (TrimView(body.text).empty()) {
+                    blankLines++;
+                    continue;
+                }
+                if (baseIndent < 0) baseIndent = body.indent;
+                std::string extra((size_t)std::max(0, body.indent - baseIndent), ' ');
+                if (!value.empty() && !folded) value += '\n';
+                else if (!value.empty() && blankLines == 0) value += ' ';
+                value.append((size_t)blankLines, '\n');
+                value += extra;
+                value += body.text;
+                blankLines = 0;
+            }
+        } else if (!rest.empty() && (rest[0] == '"' || rest[0] == '\'')) {
+            // Quoted scalar, possibly continued on the following lines
+            char quote = rest[0];
+            std::string raw(rest.substr(1));
+            while (FindClosingQuote(raw, quote) == std::string::npos && i < lines.size()) {
+                std::string_view next = TrimView(lines[i++].text);
+                raw += next.empty() ? "\n" : " ";
+                raw += next;
+            }
+            size_t close = FindClosingQuote(raw, quote);
+            value = DecodeQuoted(std::string_view(raw).substr(0, close), quote);
+        } else if (!rest.empty()) {
+            // Plain scalar, folded with indented continuation lines
+            value = ScalarValue(rest);
+            while (i < lines.size() && lines[i].indent > 0 && !IsBlankOrComment(lines[i])) {
+                value += ' ';
+                value += TrimView(lines[i++].text);
+            }
+        }
+
+        if (target) {
+            size_t end = value.find_last_not_of(" \n");
+            value.erase(end == std::string::npos ? 0 : end + 1);
+            *target = std::move(value);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Tree scan
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct VersionDir {
+    std::string id;        // File stem of the version (or singleton) manifest
+    std::string version;   // Directory name
+    fs::path dir;
+};
+
+} // namespace
+
+static std::string AsciiLower(std::string s) {
+    for (char& c : s) {
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    }
+    return s;
+}
+
+static bool EndsWith(const std::string& s, const char* suffix) {
+    size_t n = std::char_traits<char>::length(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static void ScanDirectory(const fs::path& root, std::vector<VersionDir>& out) {
+    std::error_code ec;
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec);
+    for (fs::recursive_directory_iterator end; !ec && it != end; it.increment(ec)) {
+        const fs::path& path = it->path();
+        if (path.extension() != ".yaml" || !it->is_regular_file(ec)) continue;
+
+        // <Id>.installer.yaml and <Id>.locale.<tag>.yaml belong to the version manifest next to them
+        std::string stem = path.stem().u8string();
+        if (EndsWith(stem, ".installer") || stem.find(".locale.") != std::string::npos) continue;
+
+        VersionDir v;
+        v.id = stem;
+        v.dir = path.parent_path();
+        v.version = v.dir.filename().u8string();
+        out.push_back(std::move(v));
+    }
+}
+
+static bool ReadTextFile(const fs::path& path, std::string& text) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static bool LoadManifest(const VersionDir& v, ManifestPackage& pkg) {
+    ManifestFields f;
+    std::string text;
+    if (!ReadTextFile(v.dir / fs::u8path(v.id + ".yaml"), text)) return false;
+    ParseManifestYaml(text, f);
+
+    // Multi-file manifests keep the display fields in the default locale file
+    if (f.manifestType != "singleton" && !f.defaultLocale.empty() &&
+        ReadTextFile(v.dir / fs::u8path(v.id + ".locale." + f.defaultLocale + ".yaml"), text)) {
+        ParseManifestYaml(text, f);
+    }
+
+    pkg.packageId = f.packageIdentifier.empty() ? v.id : f.packageIdentifier;
+    pkg.version = f.packageVersion.empty() ? v.version : f.packageVersion;
+    pkg.name = f.packageName;
+    pkg.publisher = f.publisher;
+    pkg.moniker = f.moniker;
+    pkg.description = f.description.empty() ? f.shortDescription : f.description;
+    pkg.homepage = f.packageUrl.empty() ? f.publisherUrl : f.packageUrl;
+    pkg.license = f.license;
+    pkg.licenseUrl = f.licenseUrl;
+    pkg.privacyUrl = f.privacyUrl;
+    pkg.author = f.author;
+    pkg.copyright = f.copyright;
+    pkg.tags = std::move(f.tags);
+    return !pkg.name.empty();
+}
+
+bool ScanManifestTree(const std::string& utf8Root, int threads,
+                      std::vector<ManifestPackage>& packages, ManifestScanStats& stats) {
+    packages.clear();
+    stats = ManifestScanStats();
+
+    std::error_code ec;
+    fs::path root = fs::u8path(utf8Root);
+    if (fs::is_directory(root / "manifests", ec)) root /= "manifests";
+    if (!fs::is_directory(root, ec)) return false;
+
+    // Work units are the publisher directories (manifests/<letter>/<Publisher>)
+    std::vector<fs::path> units;
+    for (const auto& letter : fs::directory_iterator(root, ec)) {
+        if (!letter.is_directory(ec)) continue;
+        for (const auto& publisher : fs::directory_iterator(letter.path(), ec)) {
+            if (publisher.is_directory(ec)) units.push_back(publisher.path());
+        }
+    }
+    if (units.empty()) units.push_back(root);
+
+    std::vector<std::vector<VersionDir>> found(units.size());
+    ParallelFor(units.size(), threads, [&](size_t i) { ScanDirectory(units[i], found[i]); });
+
+    // Latest version per package id
+    std::vector<VersionDir> latest;
+    std::unordered_map<std::string, size_t> byId;
+    for (auto& unit : found) {
+        for (auto& v : unit) {
+            stats.versionDirs++;
+            auto result = byId.emplace(AsciiLower(v.id), latest.size());
+            if (result.second) {
+                latest.push_back(std::move(v));
+            } else if (CompareWingetVersions(v.version, latest[result.first->second].version) > 0) {
+                latest[result.first->second] = std::move(v);
+            }
+        }
+        unit.clear();
+    }
+    stats.packages = latest.size();
+
+    std::vector<ManifestPackage> loaded(latest.size());
+    std::vector<char> ok(latest.size(), 0);
+    ParallelFor(latest.size(), threads, [&](size_t i) { ok[i] = LoadManifest(latest[i], loaded[i]) ? 1 : 0; });
+
+    packages.reserve(latest.size());
+    for (size_t i = 0; i < loaded.size(); i++) {
+        if (ok[i]) {
+            packages.push_back(std::move(loaded[i]));
+        } else {
+            stats.failed++;
+        }
+    }
+    stats.parsed = packages.size();
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Import
+// ---------------------------------------------------------------------------
+
+bool ImportManifestPackages(sqlite3* db, const std::vector<ManifestPackage>& packages, WingetIndexDiff& diff) {
+    if (!db || packages.empty()) return false;
+
+    std::vector<WingetIndexPackage> index;
+    index.reserve(packages.size());
+    for (const auto& pkg : packages) {
+        WingetIndexPackage entry;
+        entry.packageId = pkg.packageId;
+        entry.name = pkg.name;
+        entry.moniker = pkg.moniker;
+        entry.version = pkg.version;
+        entry.tags = pkg.tags;
+        index.push_back(std::move(entry));
+    }
+
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        return false;
+    }
+
+    // Ids, names, versions, monikers and tags
+    bool ok = ImportWingetIndex(db, index, diff);
+
+    // Details by row id (package_id lookups would need COLLATE NOCASE, which cannot use the index)
+    std::unordered_map<std::string, int64_t> idByPackage;
+    sqlite3_stmt* stmt;
+    if (ok && (ok = sqlite3_prepare_v2(db, "SELECT id, package_id FROM apps;", -1, &stmt, nullptr) == SQLITE_OK)) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char* packageId = (const char*)sqlite3_column_text(stmt, 1);
+            if (packageId) idByPackage.emplace(AsciiLower(packageId), sqlite3_column_int64(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    const char* updateSql =
+        "UPDATE apps SET publisher = ?, description = ?, homepage = ?, license = ?, "
+        "license_url = ?, privacy_url = ?, author = ?, copyright = ? WHERE id = ?;";
+    if (ok && (ok = sqlite3_prepare_v2(db, updateSql, -1, &stmt, nullptr) == SQLITE_OK)) {
+        for (const auto& pkg : packages) {
+            auto it = idByPackage.find(AsciiLower(pkg.packageId));
+            if (it == idByPackage.end()) continue;
+
+            const std::string* values[] = {&pkg.publisher, &pkg.description, &pkg.homepage, &pkg.license,
+                                           &pkg.licenseUrl, &pkg.privacyUrl, &pkg.author, &pkg.copyright};
+            for (int v = 0; v < 8; v++) {
+                sqlite3_bind_text(stmt, v + 1, values[v]->c_str(), (int)values[v]->size(), SQLITE_STATIC);
+            }
+            sqlite3_bind_int64(stmt, 9, it->second);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+            if (!ok) break;
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    if (!ok) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+}
@@ -0,0 +1,77 @@
+#ifndef MANIFEST_IMPORT_H
+#define MANIFEST_IMPORT_H
+
+// Offline importer for a local clone of the winget-pkgs manifest tree
+// (manifests/<letter>/<Publisher>/<Package>/<version>/*.yaml). Used on build
+// servers instead of build_everything.ps1: no winget, no network.
+// Only the latest version of each package is parsed, and only the YAML subset
+// winget manifests use (top-level scalars, block scalars and the Tags list).
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+struct WingetIndexDiff;
+
+struct ManifestPackage {
+    std::string packageId;
+    std::string version;
+    std::string name;
+    std::string publisher;
+    std::string moniker;
+    std::string description;
+    std::string homepage;
+    std::string license;
+    std::string licenseUrl;
+    std::string privacyUrl;
+    std::string author;
+    std::string copyright;
+    std::vector<std::string> tags;
+};
+
+// Top-level fields of one manifest file. Multi-file manifests fill it from the
+// version file and then the default locale file.
+struct ManifestFields {
+    std::string manifestType;
+    std::string defaultLocale;
+    std::string packageIdentifier;
+    std::string packageVersion;
+    std::string packageName;
+    std::string publisher;
+    std::string moniker;
+    std::string shortDescription;
+    std::string description;
+    std::string packageUrl;
+    std::string publisherUrl;
+    std::string license;
+    std::string licenseUrl;
+    std::string privacyUrl;
+    std::string author;
+    std::string copyright;
+    std::vector<std::string> tags;
+};
+
+struct ManifestScanStats {
+    size_t versionDirs = 0;      // Version directories found
+    size_t packages = 0;         // Distinct package ids
+    size_t parsed = 0;           // Latest versions parsed successfully
+    size_t failed = 0;           // Latest versions that could not be read
+};
+
+// Parse one manifest file's text into fields (fields already set are overwritten
+// only by keys present in this file)
+void ParseManifestYaml(std::string_view text, ManifestFields& fields);
+
+// Walk the tree (the winget-pkgs root or its manifests directory) on `threads`
+// threads (0 = all cores) and return the latest version of every package
+bool ScanManifestTree(const std::string& utf8Root, int threads,
+                      std::vector<ManifestPackage>& packages, ManifestScanStats& stats);
+
+// Bulk-load the packages in one transaction: the same diff as the winget index import
+// (insert, update in place, remove missing unless installed) plus the manifest details
+bool ImportManifestPackages(sqlite3* db, const std::vector<ManifestPackage>& packages, WingetIndexDiff& diff);
+
+#endif // MANIFEST_IMPORT_H
@@ -0,0 +1,35 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+// SHA-256 (FIPS 180-4), for content addressing. Portable, no Windows dependencies.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class Sha256 {
+public:
+    typedef std::array<uint8_t, 32> Digest;
+
+    Sha256() { Reset(); }
+
+    void Reset();
+    void Update(const void* data, size_t size);
+    Digest Finish();
+
+    static Digest Hash(const void* data, size_t size);
+
+    // Lowercase hex, 64 characters
+    static std::string ToHex(const Digest& digest);
+
+private:
+    void Transform(const uint8_t* block);
+
+    uint32_t state_[8];
+    uint64_t length_;          // Bytes hashed so far
+    uint8_t buffer_[64];
+    size_t buffered_;
+};
+
+#endif // SHA256_H
@@ -0,0 +1,89 @@
+#include "sql_batch.h"
+#include <sqlite3.h>
+
+StatementCache::~StatementCache() {
+    Reset(nullptr);
+}
+
+void StatementCache::Reset(sqlite3* db) {
+    for (auto& entry : statements_) {
+        sqlite3_finalize(entry.second);
+    }
+    statements_.clear();
+    db_ = db;
+}
+
+sqlite3_stmt* StatementCache::Get(const char* sql) {
+    if (!db_) return nullptr;
+
+    auto it = statements_.find(sql);
+    if (it != statements_.end()) {
+        sqlite3_reset(it->second);
+        sqlite3_clear_bindings(it->second);
+        return it->second;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v3(db_, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+    statements_.emplace(sql, stmt);
+    return stmt;
+}
+
+BatchWriter::BatchWriter(sqlite3* db, int batchSize, int maxOpenMs)
+    : db_(db), batchSize_(batchSize > 0 ? batchSize : 1), maxOpen_(maxOpenMs) {
+    // Only manage the transaction if nobody else already does
+    if (db_ && sqlite3_get_autocommit(db_)) {
+        active_ = open_ = Begin();
+    }
+}
+
+BatchWriter::~BatchWriter() {
+    Finish();
+}
+
+bool BatchWriter::Begin() {
+    pending_ = 0;
+    openedAt_ = std::chrono::steady_clock::now();
+    return sqlite3_exec(db_, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+bool BatchWriter::Commit() {
+    if (sqlite3_exec(db_, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        // Don't leave the connection stuck inside a failed transaction
+        sqlite3_exec(db_, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    batches_++;
+    pending_ = 0;
+    return true;
+}
+
+bool BatchWriter::Row() {
+    if (!active_) return true;
+    if (!open_) {
+        // After Idle(): this row committed on its own, the next ones are batched again
+        open_ = Begin();
+        return open_;
+    }
+    if (++pending_ < batchSize_ && std::chrono::steady_clock::now() - openedAt_ < maxOpen_) return true;
+
+    bool ok = Commit();
+    open_ = Begin();
+    return ok && open_;
+}
+
+bool BatchWriter::Idle() {
+    if (!open_) return true;
+    open_ = false;
+    return Commit();
+}
+
+bool BatchWriter::Finish() {
+    active_ = false;
+    if (!open_) return true;
+    open_ = false;
+    return Commit();
+}
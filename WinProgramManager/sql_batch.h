@@ -0,0 +1,79 @@
+#ifndef SQL_BATCH_H
+#define SQL_BATCH_H
+
+// Prepared-statement reuse and batched transactions for bulk writers (the updater).
+// Preparing a statement per row and committing per row (one journal sync each)
+// dominates the cost of inserting thousands of rows; these helpers remove both.
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
+// Forward declarations for SQLite
+typedef struct sqlite3 sqlite3;
+typedef struct sqlite3_stmt sqlite3_stmt;
+
+// Prepares each distinct SQL text once per connection and hands it out reset,
+// with bindings cleared. Statements stay owned by the cache.
+class StatementCache {
+public:
+    StatementCache() = default;
+    ~StatementCache();
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+
+    // Finalize everything and switch to another connection (nullptr to detach)
+    void Reset(sqlite3* db);
+    void Clear() { Reset(db_); }
+
+    // Returns nullptr if the statement does not prepare
+    sqlite3_stmt* Get(const char* sql);
+
+private:
+    sqlite3* db_ = nullptr;
+    std::unordered_map<std::string, sqlite3_stmt*> statements_;
+};
+
+// Longest a batch keeps the write lock before it commits, however few rows it
+// has (other programs wait up to CATALOG_BUSY_TIMEOUT_MS for the lock)
+#define BATCH_MAX_OPEN_MS 1000
+
+// Groups writes into transactions of at most batchSize rows or maxOpenMs. The
+// first transaction starts in the constructor; call Row() after each write and
+// Finish() (or let the destructor) commit the rest. Inside an already open
+// transaction it does nothing. While no rows come (a slow fetch), Idle() commits
+// and leaves the lock to other programs until the next Row().
+class BatchWriter {
+public:
+    BatchWriter(sqlite3* db, int batchSize, int maxOpenMs = BATCH_MAX_OPEN_MS);
+    ~BatchWriter();
+    BatchWriter(const BatchWriter&) = delete;
+    BatchWriter& operator=(const BatchWriter&) = delete;
+
+    // Count one written row, committing and starting a new transaction when full
+    // or old enough
+    bool Row();
+
+    // Commit pending rows; the next Row() starts a new transaction
+    bool Idle();
+
+    // Commit pending rows and stop batching
+    bool Finish();
+
+    int CommittedBatches() const { return batches_; }
+
+private:
+    bool Begin();
+    bool Commit();
+
+    sqlite3* db_;
+    int batchSize_;
+    std::chrono::milliseconds maxOpen_;
+    std::chrono::steady_clock::time_point openedAt_;
+    int pending_ = 0;
+    int batches_ = 0;
+    bool active_ = false;   // Batching (false once finished, or inside a caller's transaction)
+    bool open_ = false;     // A batch transaction is open
+};
+
+#endif // SQL_BATCH_H
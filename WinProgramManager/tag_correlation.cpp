@@ -0,0 +1,314 @@
+#include "tag_correlation.h"
+#include "fetch_pipeline.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <thread>
+
+bool CountTagCooccurrence(sqlite3* db, int threads, TagCooccurrence& counts) {
+    counts = TagCooccurrence();
+
+    // Links grouped by app; the (app_id, category_id) primary key delivers them in order
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT app_id, category_id FROM app_categories ORDER BY app_id;",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+
+    std::unordered_map<int, uint32_t> denseIds;
+    std::vector<uint32_t> tags;        // Dense tag indices of all multi-tag apps, app after app
+    std::vector<size_t> appStarts;     // Offset of each app in tags
+    int currentApp = 0;
+    size_t currentStart = 0;
+    bool haveApp = false;
+
+    auto closeApp = [&]() {
+        if (haveApp && tags.size() - currentStart > 1) {
+            appStarts.push_back(currentStart);
+        } else {
+            tags.resize(currentStart);
+        }
+    };
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int appId = sqlite3_column_int(stmt, 0);
+        int categoryId = sqlite3_column_int(stmt, 1);
+        if (!haveApp || appId != currentApp) {
+            closeApp();
+            currentApp = appId;
+            currentStart = tags.size();
+            haveApp = true;
+        }
+        auto dense = denseIds.emplace(categoryId, (uint32_t)counts.categoryIds.size());
+        if (dense.second) counts.categoryIds.push_back(categoryId);
+        tags.push_back(dense.first->second);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) return false;
+    closeApp();
+    appStarts.push_back(tags.size());
+
+    size_t appCount = appStarts.size() - 1;
+    counts.tagCounts.assign(counts.categoryIds.size(), 0);
+    for (uint32_t tag : tags) counts.tagCounts[tag]++;
+
+    // Per-thread partial pair counts over contiguous ranges of apps, merged at the end
+    size_t chunks = threads > 0 ? (size_t)threads : (size_t)std::max(1u, std::thread::hardware_concurrency());
+    chunks = std::max<size_t>(1, std::min(chunks, appCount));
+    std::vector<std::unordered_map<uint64_t, int>> partials(chunks);
+    ParallelFor(chunks, (int)chunks, [&](size_t chunk) {
+        auto& pairs = partials[chunk];
+        for (size_t app = appCount * chunk / chunks; app < appCount * (chunk + 1) / chunks; app++) {
+            for (size_t i = appStarts[app]; i < appStarts[app + 1]; i++) {
+                for (size_t j = i + 1; j < appStarts[app + 1]; j++) {
+                    uint32_t a = tags[i], b = tags[j];
+                    pairs[TagCooccurrence::PairKey(std::min(a, b), std::max(a, b))]++;
+                }
+            }
+        }
+    });
+
+    counts.pairCounts.swap(partials[0]);
+    for (size_t chunk = 1; chunk < chunks; chunk++) {
+        for (const auto& pair : partials[chunk]) counts.pairCounts[pair.first] += pair.second;
+    }
+    return true;
+}
+
+std::vector<CorrelationRule> SelectCorrelationRules(const TagCooccurrence& counts, const CorrelationOptions& options) {
+    std::vector<CorrelationRule> rules;
+    auto consider = [&](uint32_t source, uint32_t target, int together) {
+        int sourceCount = counts.tagCounts[source];
+        if (sourceCount >= options.minSamples && (double)together / sourceCount >= options.threshold) {
+            rules.push_back({counts.categoryIds[source], counts.categoryIds[target]});
+        }
+    };
+
+    for (const auto& pair : counts.pairCounts) {
+        uint32_t lo = (uint32_t)(pair.first >> 32);
+        uint32_t hi = (uint32_t)(pair.first & 0xFFFFFFFFu);
+        consider(lo, hi, pair.second);
+        consider(hi, lo, pair.second);
+    }
+
+    std::sort(rules.begin(), rules.end(), [](const CorrelationRule& a, const CorrelationRule& b) {
+        return a.sourceId != b.sourceId ? a.sourceId < b.sourceId : a.targetId < b.targetId;
+    });
+    return rules;
+}
+
+int ApplyCorrelationRules(sqlite3* db, const std::vector<CorrelationRule>& rules) {
+    if (rules.empty()) return 0;
+
+    const char* setupSql =
+        "CREATE TEMP TABLE IF NOT EXISTS correlation_rules ("
+        "source_id INTEGER NOT NULL, "
+        "target_id INTEGER NOT NULL, "
+        "PRIMARY KEY (source_id, target_id)"
+        ") WITHOUT ROWID;"
+        "DELETE FROM temp.correlation_rules;";
+    if (sqlite3_exec(db, "SAVEPOINT correlation;", nullptr, nullptr, nullptr) != SQLITE_OK) return -1;
+
+    bool ok = sqlite3_exec(db, setupSql, nullptr, nullptr, nullptr) == SQLITE_OK;
+
+    sqlite3_stmt* stmt;
+    if (ok && (ok = sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO temp.correlation_rules VALUES (?, ?);",
+                                       -1, &stmt, nullptr) == SQLITE_OK)) {
+        for (const auto& rule : rules) {
+            sqlite3_bind_int(stmt, 1, rule.sourceId);
+            sqlite3_bind_int(stmt, 2, rule.targetId);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+            if (!ok) break;
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    int added = 0;
+    const char* applySql =
+        "INSERT OR IGNORE INTO app_categories (app_id, category_id) "
+        "SELECT ac.app_id, r.target_id "
+        "FROM temp.correlation_rules r "
+        "JOIN app_categories ac ON ac.category_id = r.source_id;";
+    if (ok && (ok = sqlite3_exec(db, applySql, nullptr, nullptr, nullptr) == SQLITE_OK)) {
+        added = sqlite3_changes(db);
+    }
+
+    sqlite3_exec(db, "DELETE FROM temp.correlation_rules;", nullptr, nullptr, nullptr);
+    if (!ok) {
+        sqlite3_exec(db, "ROLLBACK TO correlation; RELEASE correlation;", nullptr, nullptr, nullptr);
+        return -1;
+    }
+    sqlite3_exec(db, "RELEASE correlation;", nullptr, nullptr, nullptr);
+    return added;
+}
+
+// Counts cover apps with at least two tags, like CountTagCooccurrence. The insert
+// trigger runs after the new link exists, the delete trigger after it is gone, so
+// "two links" means the app just became (or stopped being) a multi-tag app.
+static const char* TAG_STATS_SCHEMA =
+    "CREATE TABLE tag_stats ("
+    "category_id INTEGER PRIMARY KEY, "
+    "app_count INTEGER NOT NULL"
+    ");"
+    "CREATE TABLE tag_pair_stats ("
+    "tag_a INTEGER NOT NULL, "
+    "tag_b INTEGER NOT NULL, "
+    "app_count INTEGER NOT NULL, "
+    "PRIMARY KEY (tag_a, tag_b)"
+    ") WITHOUT ROWID;"
+    "CREATE INDEX idx_tag_pair_stats_b ON tag_pair_stats(tag_b);"
+    "CREATE TABLE tag_stats_dirty ("
+    "category_id INTEGER PRIMARY KEY"
+    ");"
+    "CREATE TRIGGER tag_stats_link_added AFTER INSERT ON app_categories "
+    "WHEN (SELECT COUNT(*) FROM app_categories WHERE app_id = NEW.app_id) >= 2 "
+    "BEGIN "
+    "  INSERT INTO tag_stats (category_id, app_count) "
+    "  SELECT category_id, 1 FROM app_categories "
+    "  WHERE app_id = NEW.app_id AND (category_id = NEW.category_id OR "
+    "        (SELECT COUNT(*) FROM app_categories WHERE app_id = NEW.app_id) = 2) "
+    "  ON CONFLICT(category_id) DO UPDATE SET app_count = app_count + 1;"
+    "  INSERT INTO tag_pair_stats (tag_a, tag_b, app_count) "
+    "  SELECT MIN(NEW.category_id, category_id), MAX(NEW.category_id, category_id), 1 "
+    "  FROM app_categories WHERE app_id = NEW.app_id AND category_id <> NEW.category_id "
+    "  ON CONFLICT(tag_a, tag_b) DO UPDATE SET app_count = app_count + 1;"
+    "  INSERT OR IGNORE INTO tag_stats_dirty (category_id) "
+    "  SELECT category_id FROM app_categories WHERE app_id = NEW.app_id;"
+    "END;"
+    "CREATE TRIGGER tag_stats_link_removed AFTER DELETE ON app_categories "
+    "WHEN EXISTS (SELECT 1 FROM app_categories WHERE app_id = OLD.app_id) "
+    "BEGIN "
+    "  UPDATE tag_stats SET app_count = app_count - 1 "
+    "  WHERE category_id = OLD.category_id OR "
+    "        ((SELECT COUNT(*) FROM app_categories WHERE app_id = OLD.app_id) = 1 AND "
+    "         category_id IN (SELECT category_id FROM app_categories WHERE app_id = OLD.app_id));"
+    "  UPDATE tag_pair_stats SET app_count = app_count - 1 "
+    "  WHERE (tag_a, tag_b) IN (SELECT MIN(OLD.category_id, category_id), MAX(OLD.category_id, category_id) "
+    "                           FROM app_categories WHERE app_id = OLD.app_id);"
+    "  DELETE FROM tag_pair_stats WHERE app_count <= 0 AND "
+    "  (tag_a, tag_b) IN (SELECT MIN(OLD.category_id, category_id), MAX(OLD.category_id, category_id) "
+    "                     FROM app_categories WHERE app_id = OLD.app_id);"
+    "  INSERT OR IGNORE INTO tag_stats_dirty (category_id) "
+    "  SELECT OLD.category_id UNION SELECT category_id FROM app_categories WHERE app_id = OLD.app_id;"
+    "END;";
+
+// Every new link dirties its tag, also an app's first one (which changes no
+// counts): the rules from that tag have to be applied to the new app
+static const char* TAG_STATS_MARK_TRIGGER =
+    "CREATE TRIGGER IF NOT EXISTS tag_stats_link_marked AFTER INSERT ON app_categories "
+    "BEGIN INSERT OR IGNORE INTO tag_stats_dirty (category_id) VALUES (NEW.category_id); END;";
+
+static bool TableExists(sqlite3* db, const char* name) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?;",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return exists;
+}
+
+static bool StoreCooccurrence(sqlite3* db, const TagCooccurrence& counts) {
+    sqlite3_stmt* tagStmt = nullptr;
+    sqlite3_stmt* pairStmt = nullptr;
+    bool ok = sqlite3_prepare_v2(db, "INSERT INTO tag_stats (category_id, app_count) VALUES (?, ?);",
+                                 -1, &tagStmt, nullptr) == SQLITE_OK &&
+              sqlite3_prepare_v2(db, "INSERT INTO tag_pair_stats (tag_a, tag_b, app_count) VALUES (?, ?, ?);",
+                                 -1, &pairStmt, nullptr) == SQLITE_OK;
+
+    for (size_t i = 0; ok && i < counts.categoryIds.size(); i++) {
+        sqlite3_bind_int(tagStmt, 1, counts.categoryIds[i]);
+        sqlite3_bind_int(tagStmt, 2, counts.tagCounts[i]);
+        ok = sqlite3_step(tagStmt) == SQLITE_DONE;
+        sqlite3_reset(tagStmt);
+    }
+    for (auto it = counts.pairCounts.begin(); ok && it != counts.pairCounts.end(); ++it) {
+        int a = counts.categoryIds[(uint32_t)(it->first >> 32)];
+        int b = counts.categoryIds[(uint32_t)(it->first & 0xFFFFFFFFu)];
+        sqlite3_bind_int(pairStmt, 1, std::min(a, b));
+        sqlite3_bind_int(pairStmt, 2, std::max(a, b));
+        sqlite3_bind_int(pairStmt, 3, it->second);
+        ok = sqlite3_step(pairStmt) == SQLITE_DONE;
+        sqlite3_reset(pairStmt);
+    }
+
+    sqlite3_finalize(tagStmt);
+    sqlite3_finalize(pairStmt);
+    return ok;
+}
+
+static bool TriggerExists(sqlite3* db, const char* name) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'trigger' AND name = ?;",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return exists;
+}
+
+bool EnsureTagStats(sqlite3* db, int threads) {
+    if (TableExists(db, "tag_stats")) {
+        if (TriggerExists(db, "tag_stats_link_marked")) return true;
+
+        // Stats kept without the trigger may have missed the first link of an
+        // app, so every tag is re-evaluated once
+        return sqlite3_exec(db, TAG_STATS_MARK_TRIGGER, nullptr, nullptr, nullptr) == SQLITE_OK &&
+               sqlite3_exec(db, "INSERT OR IGNORE INTO tag_stats_dirty (category_id) SELECT category_id FROM tag_stats;",
+                            nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+
+    if (sqlite3_exec(db, "SAVEPOINT tag_stats;", nullptr, nullptr, nullptr) != SQLITE_OK) return false;
+
+    TagCooccurrence counts;
+    bool ok = sqlite3_exec(db, TAG_STATS_SCHEMA, nullptr, nullptr, nullptr) == SQLITE_OK &&
+              sqlite3_exec(db, TAG_STATS_MARK_TRIGGER, nullptr, nullptr, nullptr) == SQLITE_OK &&
+              CountTagCooccurrence(db, threads, counts) &&
+              StoreCooccurrence(db, counts) &&
+              sqlite3_exec(db, "INSERT INTO tag_stats_dirty (category_id) SELECT category_id FROM tag_stats;",
+                           nullptr, nullptr, nullptr) == SQLITE_OK;
+
+    if (!ok) {
+        sqlite3_exec(db, "ROLLBACK TO tag_stats; RELEASE tag_stats;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return sqlite3_exec(db, "RELEASE tag_stats;", nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+std::vector<CorrelationRule> SelectDirtyCorrelationRules(sqlite3* db, const CorrelationOptions& options) {
+    std::vector<CorrelationRule> rules;
+    const char* sql =
+        "SELECT s.category_id, CASE WHEN p.tag_a = s.category_id THEN p.tag_b ELSE p.tag_a END, "
+        "       p.app_count, s.app_count "
+        "FROM tag_stats_dirty d "
+        "JOIN tag_stats s ON s.category_id = d.category_id "
+        "JOIN tag_pair_stats p ON p.tag_a = s.category_id OR p.tag_b = s.category_id "
+        "WHERE s.app_count >= ?;";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return rules;
+    sqlite3_bind_int(stmt, 1, options.minSamples);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int together = sqlite3_column_int(stmt, 2);
+        int sourceCount = sqlite3_column_int(stmt, 3);
+        if ((double)together / sourceCount >= options.threshold) {
+            rules.push_back({sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1)});
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    std::sort(rules.begin(), rules.end(), [](const CorrelationRule& a, const CorrelationRule& b) {
+        return a.sourceId != b.sourceId ? a.sourceId < b.sourceId : a.targetId < b.targetId;
+    });
+    return rules;
+}
+
+bool ClearTagStatsDirty(sqlite3* db) {
+    return sqlite3_exec(db, "DELETE FROM tag_stats_dirty;", nullptr, nullptr, nullptr) == SQLITE_OK;
+}
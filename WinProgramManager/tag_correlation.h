@@ -0,0 +1,62 @@
+#ifndef TAG_CORRELATION_H
+#define TAG_CORRELATION_H
+
+// Tag co-occurrence for the updater's correlation step: "most apps tagged A are
+// also tagged B, so tag the rest of them B too". Counting works on integer
+// category ids from one scan of app_categories, split across threads; the rules
+// that qualify are applied with a single INSERT ... SELECT.
+//
+// The counts are also kept in the database (tag_stats, tag_pair_stats), maintained
+// by triggers on app_categories, together with the set of tags whose counts moved
+// (tag_stats_dirty). Later runs only re-evaluate rules for those tags.
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+struct CorrelationOptions {
+    double threshold = 0.6667;   // Share of source-tagged apps that also carry the target
+    int minSamples = 6;          // Source tag must be on at least this many apps
+    int threads = 0;             // Counting threads (0 = all cores)
+};
+
+struct CorrelationRule {
+    int sourceId;                // categories.id
+    int targetId;
+};
+
+// Counts over apps with more than one tag (single-tag apps say nothing about pairs)
+struct TagCooccurrence {
+    std::vector<int> categoryIds;                  // Dense index -> categories.id
+    std::vector<int> tagCounts;                    // Apps per dense index
+    std::unordered_map<uint64_t, int> pairCounts;  // PairKey(lo, hi) of dense indices -> apps with both
+
+    static uint64_t PairKey(uint32_t lo, uint32_t hi) { return ((uint64_t)lo << 32) | hi; }
+};
+
+// One streamed scan of app_categories, counted on options.threads threads
+bool CountTagCooccurrence(sqlite3* db, int threads, TagCooccurrence& counts);
+
+// Rules source -> target with count(source) >= minSamples and
+// count(source and target) / count(source) >= threshold, sorted by ids
+std::vector<CorrelationRule> SelectCorrelationRules(const TagCooccurrence& counts, const CorrelationOptions& options);
+
+// Add every rule's target to the apps carrying its source, in one statement.
+// Rules see the links as they were before this call (they do not chain).
+// Returns the number of links added, or -1 on error.
+int ApplyCorrelationRules(sqlite3* db, const std::vector<CorrelationRule>& rules);
+
+// Create the statistics tables and their triggers if missing. A database without
+// them gets its counts rebuilt from app_categories and every tag marked dirty.
+bool EnsureTagStats(sqlite3* db, int threads);
+
+// Rules whose source tag is dirty, from the stored counts
+std::vector<CorrelationRule> SelectDirtyCorrelationRules(sqlite3* db, const CorrelationOptions& options);
+
+// Forget the dirty set (after its rules have been selected)
+bool ClearTagStatsDirty(sqlite3* db);
+
+#endif // TAG_CORRELATION_H
@@ -0,0 +1,194 @@
+#include "tag_matcher.h"
+#include <algorithm>
+#include <deque>
+
+static unsigned char FoldAscii(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c - 'A' + 'a') : c;
+}
+
+// One alternation branch -> every literal string it can match
+static bool ExpandBranch(std::string_view branch, std::vector<std::string>& out) {
+    std::vector<std::string> variants(1);
+    for (size_t i = 0; i < branch.size(); i++) {
+        char c = branch[i];
+        if (std::string_view("()[]{}*+^$").find(c) != std::string_view::npos || c == '?') return false;
+
+        std::vector<unsigned char> choices;
+        if (c == '.') {
+            for (int b = 1; b < 256; b++) {
+                if (b != '\n' && b != '\r' && FoldAscii((unsigned char)b) == b) choices.push_back((unsigned char)b);
+            }
+        } else {
+            if (c == '\\') {
+                if (++i >= branch.size()) return false;
+                c = branch[i];
+            }
+            choices.push_back(FoldAscii((unsigned char)c));
+        }
+        bool optional = i + 1 < branch.size() && branch[i + 1] == '?';
+        if (optional) i++;
+
+        std::vector<std::string> expanded;
+        expanded.reserve(variants.size() * (choices.size() + (optional ? 1 : 0)));
+        for (const auto& v : variants) {
+            if (optional) expanded.push_back(v);
+            for (unsigned char ch : choices) expanded.push_back(v + (char)ch);
+        }
+        variants.swap(expanded);
+    }
+    out.insert(out.end(), variants.begin(), variants.end());
+    return true;
+}
+
+bool TagMatcher::Add(const std::string& pattern, int value) {
+    std::vector<std::string> literals;
+    size_t start = 0;
+    for (;;) {
+        size_t bar = pattern.find('|', start);
+        std::string_view branch = std::string_view(pattern).substr(start, bar == std::string::npos ? std::string::npos : bar - start);
+        if (!ExpandBranch(branch, literals)) return false;
+        if (bar == std::string::npos) break;
+        start = bar + 1;
+    }
+
+    if (outputs_.empty()) {
+        outputs_.emplace_back();
+        next_.assign(256, -1);
+    }
+    for (const auto& literal : literals) {
+        if (literal.empty()) continue;   // Would match everything, like an empty regex branch
+        int state = 0;
+        for (unsigned char c : literal) {
+            size_t slot = (size_t)state * 256 + c;
+            if (next_[slot] < 0) {
+                next_[slot] = (int32_t)outputs_.size();
+                outputs_.emplace_back();
+                next_.resize(next_.size() + 256, -1);
+            }
+            state = next_[slot];
+        }
+        auto& out = outputs_[state];
+        if (std::find(out.begin(), out.end(), value) == out.end()) out.push_back(value);
+    }
+    maxValue_ = std::max(maxValue_, value);
+    return true;
+}
+
+void TagMatcher::Build() {
+    if (outputs_.empty()) {
+        outputs_.emplace_back();
+        next_.assign(256, -1);
+    }
+    fail_.assign(outputs_.size(), 0);
+
+    // Breadth-first: turn missing transitions into fail transitions (a full DFA)
+    std::deque<int> queue;
+    for (int c = 0; c < 256; c++) {
+        int32_t& slot = next_[c];
+        if (slot < 0) {
+            slot = 0;
+        } else {
+            fail_[slot] = 0;
+            queue.push_back(slot);
+        }
+    }
+    while (!queue.empty()) {
+        int state = queue.front();
+        queue.pop_front();
+
+        // Patterns ending in the fail state also end here
+        for (int value : outputs_[fail_[state]]) {
+            auto& out = outputs_[state];
+            if (std::find(out.begin(), out.end(), value) == out.end()) out.push_back(value);
+        }
+
+        for (int c = 0; c < 256; c++) {
+            int32_t& slot = next_[(size_t)state * 256 + c];
+            int32_t fallback = next_[(size_t)fail_[state] * 256 + c];
+            if (slot < 0) {
+                slot = fallback;
+            } else {
+                fail_[slot] = fallback;
+                queue.push_back(slot);
+            }
+        }
+    }
+}
+
+void TagMatcher::Match(std::string_view text, std::vector<char>& hits) const {
+    if (next_.empty()) return;
+    if ((int)hits.size() <= maxValue_) hits.resize((size_t)maxValue_ + 1, 0);
+
+    int32_t state = 0;
+    for (char ch : text) {
+        state = next_[(size_t)state * 256 + FoldAscii((unsigned char)ch)];
+        for (int value : outputs_[state]) hits[value] = 1;
+    }
+}
+
+const std::map<std::string, std::string>& NameTagPatterns() {
+    static const std::map<std::string, std::string> patterns = {
+        // Technology/Hardware
+        {"USB", "usb"},
+        {"Bluetooth", "bluetooth"},
+        {"WiFi|Wi-Fi", "wifi"},
+        {"HDMI", "hdmi"},
+        {"GPU", "gpu"},
+        {"CPU", "cpu"},
+
+        // Application types
+        {"Browser", "browser"},
+        {"Client", "client"},
+        {"Server", "server"},
+        {"Manager", "manager"},
+        {"Viewer", "viewer"},
+        {"Editor", "editor"},
+        {"Player", "player"},
+        {"Launcher", "launcher"},
+        {"Download", "download"},
+
+        // Functions
+        {"Emulator", "emulator"},
+        {"Driver", "driver"},
+        {"Manual", "manual"},
+        {"Toolkit", "toolkit"},
+        {"SDK", "development"},
+        {"CLI|Command.?Line", "cli"},
+        {"Mock", "testing"},
+        {"Test", "testing"},
+        {"Debug", "development"},
+        {"Simulator", "emulator"},
+
+        // File formats/protocols
+        {"INI", "configuration"},
+        {"JSON", "data"},
+        {"XML", "data"},
+        {"YAML", "configuration"},
+        {"CSV", "data"},
+        {"SQL", "database"},
+        {"HTML", "web"},
+        {"FTP", "network"},
+        {"HTTP", "web"},
+        {"ODBC", "database"},
+        {"API", "development"},
+
+        // Media
+        {"Video", "video"},
+        {"Audio", "audio"},
+        {"Image", "graphics"},
+        {"Photo", "graphics"},
+        {"Music", "audio"},
+        {"PDF", "document"},
+
+        // Categories
+        {"Game", "gaming"},
+        {"Utility", "utilities"},
+        {"Security", "security"},
+        {"Password", "security"},
+        {"Recovery", "utilities"},
+        {"Backup", "backup"},
+        {"Chocolatey", "package-manager"},
+        {"Winget", "winget"},
+    };
+    return patterns;
+}
@@ -0,0 +1,41 @@
+#ifndef TAG_MATCHER_H
+#define TAG_MATCHER_H
+
+// Multi-pattern matcher for the updater's name-based tag inference.
+// All patterns are compiled into one ASCII case-folded Aho-Corasick automaton, so
+// each string is scanned once no matter how many patterns there are.
+// Patterns use the small regex subset of the tag table: literals, '|' alternation,
+// '.' (any character except a line break) and '?' after a single character or '.'.
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class TagMatcher {
+public:
+    // Add a pattern reporting `value` (a small index chosen by the caller).
+    // Returns false if the pattern uses syntax outside the subset above.
+    bool Add(const std::string& pattern, int value);
+
+    // Build the automaton; call after the last Add()
+    void Build();
+
+    // Set hits[value] = 1 for every pattern found in text (hits is grown as needed)
+    void Match(std::string_view text, std::vector<char>& hits) const;
+
+    size_t StateCount() const { return outputs_.size(); }
+
+private:
+    std::vector<int32_t> next_;                // StateCount() x 256 transitions after Build()
+    std::vector<int32_t> fail_;
+    std::vector<std::vector<int>> outputs_;    // Values reported on entering each state
+    int maxValue_ = -1;
+};
+
+// The updater's name-based inference table: pattern (the subset above) -> tag.
+// Every entry must be accepted by TagMatcher::Add (tests/tag_matcher_test.cpp).
+const std::map<std::string, std::string>& NameTagPatterns();
+
+#endif // TAG_MATCHER_H
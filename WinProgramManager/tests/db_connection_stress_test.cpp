@@ -0,0 +1,167 @@
+// One writer process (the updater's pattern: small transactions, installed
+// sync, change log pruning, checkpoints) against reader processes (the GUI's
+// pattern: snapshot loads and change log polls), on one catalog file through
+// OpenCatalogDatabase. No connection may fail with SQLITE_BUSY, and every load
+// must see one consistent database state.
+// Usage: db_connection_stress_test <database path> [seconds]
+
+#include "test_check.h"
+#include "catalog.h"
+#include "catalog_changes.h"
+#include "db_connection.h"
+#include "db_meta.h"
+#include "db_schema.h"
+#include "installed_sync.h"
+#include <sqlite3.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#define STRESS_READERS 4
+#define STRESS_MAX_APPS 1500
+
+typedef std::chrono::steady_clock Clock;
+
+static int Writer(const std::string& path, int seconds) {
+    sqlite3* db = nullptr;
+    if (OpenCatalogDatabase(path, &db, SQLITE_OPEN_READWRITE) != SQLITE_OK) return 1;
+
+    auto end = Clock::now() + std::chrono::seconds(seconds);
+    long transactions = 0, errors = 0, checkpoints = 0, partial = 0;
+    int next = 1;
+    while (Clock::now() < end) {
+        PruneCatalogChanges(db);
+
+        // Add an app and its link, change one, drop the oldest, and record the
+        // count in the same transaction (readers compare it with what they load)
+        for (int i = 0; i < 200 && Clock::now() < end; i++, next++) {
+            std::string id = std::to_string(next);
+            std::string sql =
+                "BEGIN IMMEDIATE;"
+                "INSERT INTO apps (package_id, name, version) VALUES ('Stress." + id + "', 'App " + id + "', '1');"
+                "INSERT INTO app_categories (app_id, category_id) VALUES (last_insert_rowid(), 1);"
+                "UPDATE apps SET version = version + 1 WHERE id = (SELECT MIN(id) FROM apps);"
+                "DELETE FROM apps WHERE id = (SELECT MIN(id) FROM apps) AND (SELECT COUNT(*) FROM apps) > " +
+                std::to_string(STRESS_MAX_APPS) + ";"
+                "DELETE FROM app_categories WHERE NOT EXISTS (SELECT 1 FROM apps a WHERE a.id = app_categories.app_id);"
+                "INSERT OR REPLACE INTO catalog_meta (key, value) VALUES ('stress_apps', (SELECT COUNT(*) FROM apps));"
+                "COMMIT;";
+            char* error = nullptr;
+            if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+                std::fprintf(stderr, "writer: %s\n", error ? error : "?");
+                sqlite3_free(error);
+                sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+                errors++;
+            } else {
+                transactions++;
+            }
+        }
+
+        std::vector<InstalledPackage> packages;
+        for (int k = 0; k < 50; k++) packages.push_back({"Stress." + std::to_string(next - 1 - k * 3), "1", ""});
+        InstalledSyncResult result;
+        if (!ApplyInstalledPackages(db, packages, "stress", result)) {
+            std::fprintf(stderr, "writer: installed sync: %s\n", sqlite3_errmsg(db));
+            errors++;
+        }
+
+        if (CheckpointCatalog(db)) {
+            checkpoints++;
+        } else {
+            partial++;
+        }
+    }
+    std::printf("writer: %ld transactions, %ld errors, %ld checkpoints (%ld partial)\n", transactions, errors,
+                checkpoints, partial);
+    sqlite3_close(db);
+    return errors ? 1 : 0;
+}
+
+static int Reader(const std::string& path, int reader, int seconds) {
+    // Both kinds the GUI uses: its read-write connection and LoadConcurrent's read-only ones
+    sqlite3* db = nullptr;
+    if (OpenCatalogDatabase(path, &db, reader % 2 ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE) != SQLITE_OK) {
+        return 1;
+    }
+
+    auto end = Clock::now() + std::chrono::seconds(seconds);
+    long loads = 0, polls = 0, errors = 0, inconsistent = 0;
+    int64_t seq = 0;
+    while (Clock::now() < end) {
+        CatalogReadSnapshot snapshot(db);
+        if (!snapshot.Active()) {
+            std::fprintf(stderr, "reader %d: begin: %s\n", reader, sqlite3_errmsg(db));
+            errors++;
+            continue;
+        }
+        int64_t count = 0;
+        GetCatalogMeta(db, "stress_apps", count);
+        Catalog catalog;
+        if (!catalog.Load(db)) {
+            std::fprintf(stderr, "reader %d: load: %s\n", reader, sqlite3_errmsg(db));
+            errors++;
+            continue;
+        }
+        if ((int64_t)catalog.AppCount() != count ||
+            (catalog.CategoryCount() && (int64_t)catalog.CategoryApps(0).size() != count)) {
+            inconsistent++;
+        }
+        CatalogChanges changes;
+        if (ReadCatalogChanges(db, seq, changes)) {
+            seq = changes.lastSeq;
+            polls++;
+        } else {
+            errors++;
+        }
+        loads++;
+    }
+    std::printf("reader %d: %ld loads, %ld polls, %ld errors, %ld inconsistent\n", reader, loads, polls, errors,
+                inconsistent);
+    sqlite3_close(db);
+    return errors || inconsistent ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: db_connection_stress_test <database path> [seconds]\n");
+        return 2;
+    }
+    std::string path = argv[1];
+    int seconds = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    std::remove(path.c_str());
+    std::remove((path + "-wal").c_str());
+    std::remove((path + "-shm").c_str());
+    sqlite3* db = nullptr;
+    bool created = OpenCatalogDatabase(path, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE) == SQLITE_OK &&
+                   MigrateCatalogSchema(db) &&
+                   sqlite3_exec(db, "INSERT INTO categories (category_name) VALUES ('stress');", nullptr, nullptr,
+                                nullptr) == SQLITE_OK &&
+                   SetCatalogMeta(db, "stress_apps", 0);
+    sqlite3_close(db);
+    CHECK(created);
+    if (!created) return TestResult("db_connection_stress");
+
+    std::fflush(stdout);
+    std::vector<pid_t> children;
+    for (int i = 0; i <= STRESS_READERS; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            int rc = i == 0 ? Writer(path, seconds) : Reader(path, i, seconds);
+            std::fflush(stdout);
+            _exit(rc);
+        }
+        CHECK(pid > 0);
+        if (pid > 0) children.push_back(pid);
+    }
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    return TestResult("db_connection_stress");
+}
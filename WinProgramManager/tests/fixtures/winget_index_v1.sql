@@ -0,0 +1,30 @@
+-- winget source index, v1 schema (one manifest row per package version),
+-- trimmed to the tables ReadWingetIndex reads. The older of the two snapshots:
+-- Git.Git has three versions (2.45.1 is the latest, after 2.45.1-rc1 and 2.9.0),
+-- Old.Tool and Installed.Tool leave the source in winget_index_v2.sql.
+CREATE TABLE ids(rowid INTEGER PRIMARY KEY, id TEXT);
+CREATE TABLE names(rowid INTEGER PRIMARY KEY, name TEXT);
+CREATE TABLE monikers(rowid INTEGER PRIMARY KEY, moniker TEXT);
+CREATE TABLE versions(rowid INTEGER PRIMARY KEY, version TEXT);
+CREATE TABLE manifest(rowid INTEGER PRIMARY KEY, id INT, name INT, moniker INT, version INT, channel INT, pathpart INT);
+CREATE TABLE tags(rowid INTEGER PRIMARY KEY, tag TEXT);
+CREATE TABLE tags_map(manifest INT, tag INT);
+
+INSERT INTO ids VALUES (1, 'Mozilla.Firefox'), (2, 'Git.Git'), (3, 'Old.Tool'), (4, 'Installed.Tool'),
+    (5, 'Same.App'), (6, 'Video.Player');
+INSERT INTO names VALUES (1, 'Mozilla Firefox'), (2, 'Git'), (3, 'Git (old)'), (4, 'Old Tool'),
+    (5, 'Installed Tool'), (6, 'Same App'), (7, 'Player');
+INSERT INTO monikers VALUES (1, 'firefox'), (2, 'git');
+INSERT INTO versions VALUES (1, '128.0'), (2, '2.45.1'), (3, '2.9.0'), (4, '2.45.1-rc1'), (5, '1.0'),
+    (6, '3.0');
+INSERT INTO manifest VALUES
+    (1, 1, 1, 1, 1, 0, 0),
+    (2, 2, 3, 2, 3, 0, 0),
+    (3, 2, 2, 2, 2, 0, 0),
+    (4, 2, 2, 2, 4, 0, 0),
+    (5, 3, 4, NULL, 5, 0, 0),
+    (6, 4, 5, NULL, 6, 0, 0),
+    (7, 5, 6, NULL, 5, 0, 0),
+    (8, 6, 7, NULL, 5, 0, 0);
+INSERT INTO tags VALUES (1, 'browser'), (2, 'vcs'), (3, 'old'), (4, 'media');
+INSERT INTO tags_map VALUES (1, 1), (2, 3), (3, 2), (4, 3), (8, 4);
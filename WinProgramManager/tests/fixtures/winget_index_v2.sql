@@ -0,0 +1,17 @@
+-- winget source index, v2 schema (one packages row per package), trimmed to the
+-- tables ReadWingetIndex reads. The newer snapshot of winget_index_v1.sql:
+-- Mozilla.Firefox has a new version, Video.Player a new name, New.App is new,
+-- Git.Git only differs in the id's case, Old.Tool and Installed.Tool are gone.
+CREATE TABLE packages(rowid INTEGER PRIMARY KEY, id TEXT NOT NULL, name TEXT NOT NULL, moniker TEXT,
+    latest_version TEXT NOT NULL, arp_min_version TEXT, arp_max_version TEXT, hash BLOB);
+CREATE TABLE tags2_0(rowid INTEGER PRIMARY KEY, tag TEXT);
+CREATE TABLE tags2_0_map(package INT, tag INT);
+
+INSERT INTO packages VALUES
+    (1, 'Mozilla.Firefox', 'Mozilla Firefox', 'firefox', '129.0', NULL, NULL, NULL),
+    (2, 'git.git', 'Git', 'git', '2.45.1', NULL, NULL, NULL),
+    (3, 'Same.App', 'Same App', NULL, '1.0', NULL, NULL, NULL),
+    (4, 'Video.Player', 'Video Player', NULL, '1.0', NULL, NULL, NULL),
+    (5, 'New.App', 'New App', NULL, '1.0', NULL, NULL, NULL);
+INSERT INTO tags2_0 VALUES (1, 'browser'), (2, 'vcs'), (3, 'Utilities'), (4, 'Media');
+INSERT INTO tags2_0_map VALUES (1, 1), (2, 2), (4, 4), (5, 3);
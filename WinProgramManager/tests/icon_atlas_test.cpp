@@ -0,0 +1,165 @@
+// Builds an icon atlas from a catalog and maps it back: premultiplied BGRA
+// pixels at both sizes, the app id -> slot lookup, one slot per distinct icon,
+// the content version, and rejection of truncated or corrupted files.
+// Usage: icon_atlas_test <work directory>
+
+#include "test_check.h"
+#include "db_schema.h"
+#include "icon_atlas.h"
+#include "icon_image.h"
+#include "icon_store.h"
+#include <sqlite3.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#define TEST_CONTENT_VERSION 0x123456789ULL
+
+static std::vector<unsigned char> SolidPng(int size, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    DecodedImage image;
+    image.width = image.height = size;
+    for (int i = 0; i < size * size; i++) image.rgba.insert(image.rgba.end(), {r, g, b, a});
+    std::vector<uint8_t> png;
+    EncodePng(image, png);
+    return std::vector<unsigned char>(png.begin(), png.end());
+}
+
+static bool SetAppIcon(sqlite3* db, int appId, const std::vector<unsigned char>& hash) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "UPDATE apps SET icon_hash = ? WHERE id = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_blob(stmt, 1, hash.data(), (int)hash.size(), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, appId);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+// Every pixel of a slot is the given premultiplied BGRA colour, within rounding
+static bool AllPixels(const uint8_t* pixels, int size, const uint8_t (&bgra)[4]) {
+    if (!pixels) return false;
+    for (int i = 0; i < size * size * 4; i++) {
+        if (std::abs(pixels[i] - bgra[i % 4]) > 1) return false;
+    }
+    return true;
+}
+
+static std::vector<char> ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void WriteFile(const std::string& path, const std::vector<char>& data) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), (std::streamsize)data.size());
+}
+
+static bool Opens(const std::string& path, const std::vector<char>& data) {
+    WriteFile(path, data);
+    IconAtlas atlas;
+    return atlas.Open(path);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::fprintf(stderr, "Usage: icon_atlas_test <work directory>\n");
+        return 2;
+    }
+    std::string work = argv[1];
+    std::string dbPath = work + "/icon_atlas_test.db";
+    std::string atlasPath = work + "/icon_atlas_test.icons";
+    std::string brokenPath = work + "/icon_atlas_broken.icons";
+    std::remove(dbPath.c_str());
+
+    // Apps 1 and 3 share a blob, app 2 has its own, app 4 none, app 5 one that
+    // is not an image
+    sqlite3* db = nullptr;
+    CHECK(sqlite3_open(dbPath.c_str(), &db) == SQLITE_OK && MigrateCatalogSchema(db));
+    CHECK(sqlite3_exec(db,
+                       "INSERT INTO apps (id, package_id, name) VALUES (1, 'A', 'A'), (2, 'B', 'B'), "
+                       "(3, 'C', 'C'), (4, 'D', 'D'), (5, 'E', 'E');",
+                       nullptr, nullptr, nullptr) == SQLITE_OK);
+    std::vector<unsigned char> translucent = SolidPng(32, 200, 100, 50, 128);
+    std::vector<unsigned char> opaque = SolidPng(64, 10, 20, 30, 255);
+    std::vector<unsigned char> html(std::begin("<html>not found</html>"), std::end("<html>not found</html>"));
+    std::vector<unsigned char> hash1, hash2, hash3, hash5;
+    CHECK(StoreIcon(db, translucent, "png", hash1) && SetAppIcon(db, 1, hash1));
+    CHECK(StoreIcon(db, opaque, "png", hash2) && SetAppIcon(db, 2, hash2));
+    CHECK(StoreIcon(db, translucent, "png", hash3) && SetAppIcon(db, 3, hash3));
+    CHECK(StoreIcon(db, html, "ico", hash5) && SetAppIcon(db, 5, hash5));
+    CHECK(hash1 == hash3);
+
+    CHECK(BuildIconAtlas(db, atlasPath, TEST_CONTENT_VERSION) == 2);
+    sqlite3_close(db);
+
+    // Round trip
+    {
+        IconAtlas atlas;
+        CHECK(atlas.Open(atlasPath));
+        CHECK(atlas.ContentVersion() == TEST_CONTENT_VERSION);
+        CHECK(atlas.IconCount() == 2 && atlas.EntryCount() == 3);
+        CHECK(atlas.SmallSize() == ICON_ATLAS_SMALL_SIZE && atlas.LargeSize() == ICON_ATLAS_LARGE_SIZE);
+
+        int slot1 = atlas.FindSlot(1), slot2 = atlas.FindSlot(2);
+        CHECK(slot1 >= 0 && slot2 >= 0 && slot1 != slot2);
+        CHECK(atlas.FindSlot(3) == slot1);
+        CHECK(atlas.FindSlot(4) == -1 && atlas.FindSlot(5) == -1);
+        CHECK(atlas.FindSlot(0) == -1 && atlas.FindSlot(99) == -1);
+
+        const uint8_t translucentBgra[4] = {25, 50, 100, 128};
+        const uint8_t opaqueBgra[4] = {30, 20, 10, 255};
+        CHECK(AllPixels(atlas.SmallPixels((uint32_t)slot1), ICON_ATLAS_SMALL_SIZE, translucentBgra));
+        CHECK(AllPixels(atlas.LargePixels((uint32_t)slot1), ICON_ATLAS_LARGE_SIZE, translucentBgra));
+        CHECK(AllPixels(atlas.SmallPixels((uint32_t)slot2), ICON_ATLAS_SMALL_SIZE, opaqueBgra));
+        CHECK(AllPixels(atlas.LargePixels((uint32_t)slot2), ICON_ATLAS_LARGE_SIZE, opaqueBgra));
+        CHECK(atlas.SmallPixels(2) == nullptr && atlas.LargePixels(2) == nullptr);
+    }
+
+    // Corrupted copies are rejected
+    std::vector<char> good = ReadFile(atlasPath);
+    CHECK(good.size() > sizeof(IconAtlasHeader));
+    CHECK(Opens(brokenPath, good));
+
+    for (size_t length : {(size_t)0, (size_t)1, sizeof(IconAtlasHeader) - 1, sizeof(IconAtlasHeader),
+                          good.size() / 2, good.size() - 1}) {
+        CHECK(!Opens(brokenPath, std::vector<char>(good.begin(), good.begin() + length)));
+    }
+
+    std::vector<char> data = good;
+    data[0] = 'X';
+    CHECK(!Opens(brokenPath, data));
+
+    data = good;
+    data.push_back(0);
+    CHECK(!Opens(brokenPath, data));
+
+    IconAtlasHeader header;
+    std::memcpy(&header, good.data(), sizeof(header));
+    auto entry = [&](std::vector<char>& bytes, uint32_t index) {
+        return reinterpret_cast<IconAtlasEntry*>(bytes.data() + header.entriesOffset) + index;
+    };
+
+    data = good;
+    entry(data, 1)->slot = header.iconCount;
+    CHECK(!Opens(brokenPath, data));
+
+    data = good;
+    std::swap(*entry(data, 0), *entry(data, 2));
+    CHECK(!Opens(brokenPath, data));
+
+    data = good;
+    entry(data, 1)->appId = entry(data, 0)->appId;
+    CHECK(!Opens(brokenPath, data));
+
+    data = good;
+    reinterpret_cast<IconAtlasHeader*>(data.data())->iconCount = 1000;
+    CHECK(!Opens(brokenPath, data));
+
+    std::remove(brokenPath.c_str());
+    return TestResult("icon_atlas");
+}
@@ -0,0 +1,422 @@
+// Icon discovery against stand-in HTTP servers on 127.0.0.1 (the socket
+// transport): <link rel="icon"> scanning of a streamed page, the /favicon.ico
+// fallback, ETag and Last-Modified revalidation, HTML error pages served as
+// icons, and the negative cache of hosts that do not answer, both within a run
+// (IconFetcher) and across runs (FetchCatalogIcons, icon_host_failures).
+
+#include "test_check.h"
+#include "db_connection.h"
+#include "db_schema.h"
+#include "icon_fetch.h"
+#include "icon_image.h"
+#include "icon_store.h"
+#include <sqlite3.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Stand-in server: HTTP/1.1 with keep-alive, one thread per connection
+// ---------------------------------------------------------------------------
+
+struct Request {
+    std::string path;
+    std::map<std::string, std::string> headers;   // Lowercase names
+};
+
+struct Reply {
+    int status = 200;
+    std::string contentType = "text/html";
+    std::string body;
+    std::vector<std::pair<std::string, std::string>> headers;
+    bool chunked = false;
+};
+
+class StandInServer {
+public:
+    explicit StandInServer(std::function<Reply(const Request&)> handler) : handler_(handler) {
+        listener_ = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listener_, (sockaddr*)&address, sizeof(address));
+        socklen_t length = sizeof(address);
+        getsockname(listener_, (sockaddr*)&address, &length);
+        port_ = ntohs(address.sin_port);
+        listen(listener_, 16);
+        acceptThread_ = std::thread([this]() { AcceptLoop(); });
+    }
+
+    ~StandInServer() {
+        stopping_ = true;
+        shutdown(listener_, SHUT_RDWR);
+        close(listener_);
+        acceptThread_.join();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int fd : connections_) shutdown(fd, SHUT_RDWR);
+        for (std::thread& thread : threads_) thread.join();
+    }
+
+    std::string Url(const std::string& path) const { return "http://127.0.0.1:" + std::to_string(port_) + path; }
+    std::string Host() const { return "127.0.0.1:" + std::to_string(port_); }
+
+    int Hits(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hits_[path];
+    }
+
+    int TotalHits() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int total = 0;
+        for (const auto& hit : hits_) total += hit.second;
+        return total;
+    }
+
+private:
+    void AcceptLoop() {
+        while (!stopping_) {
+            int fd = accept(listener_, nullptr, nullptr);
+            if (fd < 0) return;
+            std::lock_guard<std::mutex> lock(mutex_);
+            connections_.push_back(fd);
+            threads_.emplace_back([this, fd]() { Serve(fd); });
+        }
+    }
+
+    void Serve(int fd) {
+        std::string buffer;
+        char chunk[4096];
+        for (;;) {
+            size_t end;
+            while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) {
+                    close(fd);
+                    return;
+                }
+                buffer.append(chunk, (size_t)n);
+            }
+            Request request;
+            std::string head = buffer.substr(0, end);
+            buffer.erase(0, end + 4);
+            size_t lineEnd = head.find("\r\n");
+            std::string requestLine = head.substr(0, lineEnd);
+            size_t pathStart = requestLine.find(' ') + 1;
+            request.path = requestLine.substr(pathStart, requestLine.find(' ', pathStart) - pathStart);
+            while (lineEnd != std::string::npos) {
+                size_t next = head.find("\r\n", lineEnd + 2);
+                std::string line = head.substr(lineEnd + 2, next == std::string::npos ? std::string::npos : next - lineEnd - 2);
+                size_t colon = line.find(':');
+                if (colon != std::string::npos) {
+                    std::string name = line.substr(0, colon);
+                    for (char& c : name) c = (char)tolower((unsigned char)c);
+                    request.headers[name] = line.substr(line.find_first_not_of(' ', colon + 1));
+                }
+                lineEnd = next;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                hits_[request.path]++;
+            }
+
+            Reply reply = handler_(request);
+            std::string out = "HTTP/1.1 " + std::to_string(reply.status) + " X\r\nContent-Type: " + reply.contentType +
+                              "\r\nConnection: keep-alive\r\n";
+            for (const auto& header : reply.headers) out += header.first + ": " + header.second + "\r\n";
+            if (reply.chunked) {
+                out += "Transfer-Encoding: chunked\r\n\r\n";
+                for (size_t i = 0; i < reply.body.size(); i += 1000) {
+                    std::string piece = reply.body.substr(i, 1000);
+                    char size[16];
+                    std::snprintf(size, sizeof(size), "%zx\r\n", piece.size());
+                    out += size + piece + "\r\n";
+                }
+                out += "0\r\n\r\n";
+            } else {
+                out += "Content-Length: " + std::to_string(reply.body.size()) + "\r\n\r\n" + reply.body;
+            }
+            // The client hangs up once it has seen </head>; that ends this connection
+            if (send(fd, out.data(), out.size(), MSG_NOSIGNAL) != (ssize_t)out.size()) {
+                close(fd);
+                return;
+            }
+        }
+    }
+
+    std::function<Reply(const Request&)> handler_;
+    int listener_ = -1;
+    int port_ = 0;
+    std::atomic<bool> stopping_{false};
+    std::thread acceptThread_;
+    std::mutex mutex_;
+    std::vector<int> connections_;
+    std::vector<std::thread> threads_;
+    std::map<std::string, int> hits_;
+};
+
+// A port nothing listens on
+static int ClosedPort() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, (sockaddr*)&address, sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(fd, (sockaddr*)&address, &length);
+    close(fd);
+    return ntohs(address.sin_port);
+}
+
+static std::string Png(int size) {
+    DecodedImage image;
+    image.width = image.height = size;
+    for (int i = 0; i < size * size; i++) {
+        image.rgba.insert(image.rgba.end(), {(uint8_t)(i * 7), 90, 200, 255});
+    }
+    std::vector<uint8_t> png;
+    EncodePng(image, png);
+    return std::string(png.begin(), png.end());
+}
+
+static const char* ICON_LAST_MODIFIED = "Wed, 01 Jan 2025 00:00:00 GMT";
+
+// Host A: pages with icon links, an icon with an ETag, one with only
+// Last-Modified, a page without links (favicon.ico fallback) and a redirect
+static Reply SiteA(const Request& request) {
+    static const std::string icon = Png(32);
+    static const std::string favicon = Png(16);
+    Reply reply;
+    const std::string& path = request.path;
+    auto header = [&](const char* name) {
+        auto it = request.headers.find(name);
+        return it != request.headers.end() ? it->second : std::string();
+    };
+    if (path == "/site1/") {
+        reply.chunked = true;
+        reply.body =
+            "<!DOCTYPE html><html><head><title>Site 1</title>\n"
+            "<!-- <link rel=\"icon\" href=\"/commented.png\"> -->\n"
+            "<script>var s = \"<link rel='icon' href='/scripted.png'>\";</script>\n"
+            "<link rel=\"stylesheet\" href=\"/a.css\">\n"
+            "<link href=\"img/icon.png?v=1&amp;x=2\" rel=\"shortcut icon\" sizes=\"32x32\" type=\"image/png\">\n"
+            "<link rel=\"icon\" type=\"image/svg+xml\" href=\"/i.svg\">\n"
+            "</head><body>";
+        for (int i = 0; i < 20000; i++) reply.body += "<p>filler</p>";
+        reply.body += "</body></html>";
+    } else if (path == "/site1/img/icon.png?v=1&x=2") {
+        reply.headers = {{"ETag", "\"v1\""}, {"Last-Modified", ICON_LAST_MODIFIED}};
+        if (header("if-none-match") == "\"v1\"") {
+            reply.status = 304;
+        } else {
+            reply.contentType = "image/png";
+            reply.body = icon;
+        }
+    } else if (path == "/lm/") {
+        reply.body = "<html><head><link rel=\"icon\" href=\"/lm.png\"></head><body></body></html>";
+    } else if (path == "/lm.png") {
+        reply.headers = {{"Last-Modified", ICON_LAST_MODIFIED}};
+        if (header("if-modified-since") == ICON_LAST_MODIFIED) {
+            reply.status = 304;
+        } else {
+            reply.contentType = "image/png";
+            reply.body = icon;
+        }
+    } else if (path == "/site2/") {
+        reply.body = "<html><head><title>No icon links</title></head><body></body></html>";
+    } else if (path == "/favicon.ico") {
+        reply.contentType = "image/x-icon";
+        reply.body = favicon;
+    } else if (path == "/moved") {
+        reply.status = 302;
+        reply.headers = {{"Location", "/site1/"}};
+    } else {
+        reply.status = 404;
+        reply.body = "<html>not found</html>";
+    }
+    return reply;
+}
+
+// Host B: no icon links, and favicon.ico is an HTML error page served with 200
+static Reply SiteB(const Request& request) {
+    Reply reply;
+    reply.body = request.path == "/favicon.ico" ? "<!DOCTYPE html><html><body>Page not found</body></html>"
+                                                : "<html><head></head><body>Welcome</body></html>";
+    return reply;
+}
+
+// Host C: every request is a server error
+static Reply SiteC(const Request&) {
+    Reply reply;
+    reply.status = 503;
+    reply.body = "busy";
+    return reply;
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+static void TestLinkScanner() {
+    const std::string page =
+        "<html><head><base href=\"https://cdn.example.com/assets/\">"
+        "<!-- <link rel=icon href=commented.png> -->"
+        "<style>a { background: url('<link rel=icon href=styled.png>'); }</style>"
+        "<link rel=\"icon\" href=\"small.png\" sizes=\"16x16\">"
+        "<LINK REL='apple-touch-icon' HREF='touch.png'>"
+        "<link rel=icon href=big.png sizes=32x32>"
+        "</head><body><link rel=icon href=body.png>";
+    // Fed a byte at a time: tags, comments and raw text span pieces
+    IconLinkScanner scanner;
+    for (char c : page) scanner.Feed(&c, 1);
+    CHECK(scanner.Done());
+    std::vector<std::string> urls = scanner.IconUrls("https://www.example.com/");
+    CHECK(!urls.empty() && urls[0] == "https://cdn.example.com/assets/big.png");
+    for (const std::string& url : urls) {
+        CHECK(url.find("commented") == std::string::npos);
+        CHECK(url.find("styled") == std::string::npos);
+        CHECK(url.find("body.png") == std::string::npos);
+    }
+}
+
+static void TestFetcher(StandInServer& a, StandInServer& b, StandInServer& c, const std::string& deadHost) {
+    std::unique_ptr<HttpTransport> transport = CreateHttpTransport(2000, ICON_FETCH_USER_AGENT);
+    IconFetcher fetcher(*transport);
+
+    // Link scanning: the page stops being read at </head>
+    IconFetchResult site1 = fetcher.Fetch(a.Url("/site1/"), nullptr);
+    CHECK(site1.status == IconFetchResult::Fetched);
+    CHECK(site1.source.iconUrl == a.Url("/site1/img/icon.png?v=1&x=2"));
+    CHECK(site1.source.etag == "\"v1\"");
+    CHECK(site1.source.lastModified == ICON_LAST_MODIFIED);
+    CHECK(!site1.icon.empty());
+    CHECK(a.Hits("/commented.png") == 0 && a.Hits("/scripted.png") == 0);
+
+    // Redirected homepage: the links resolve against the final URL, and the icon
+    // already downloaded this run is not fetched again
+    IconFetchResult moved = fetcher.Fetch(a.Url("/moved"), nullptr);
+    CHECK(moved.status == IconFetchResult::Fetched && moved.source.iconUrl == site1.source.iconUrl);
+    CHECK(a.Hits("/site1/img/icon.png?v=1&x=2") == 1);
+
+    // No icon links: /favicon.ico
+    IconFetchResult site2 = fetcher.Fetch(a.Url("/site2/"), nullptr);
+    CHECK(site2.status == IconFetchResult::Fetched && site2.source.iconUrl == a.Url("/favicon.ico"));
+
+    // Revalidation, by ETag and by Last-Modified
+    IconSource known = site1.source;
+    known.iconHash = {1, 2, 3};
+    IconFetchResult revalidated = fetcher.Fetch(a.Url("/site1/"), &known);
+    CHECK(revalidated.status == IconFetchResult::NotModified);
+    CHECK(revalidated.source.iconUrl == known.iconUrl && revalidated.icon.empty());
+
+    IconFetchResult lm = fetcher.Fetch(a.Url("/lm/"), nullptr);
+    CHECK(lm.status == IconFetchResult::Fetched && lm.source.etag.empty() && lm.source.lastModified == ICON_LAST_MODIFIED);
+    known = lm.source;
+    known.iconHash = {1};
+    int pageHits = a.Hits("/lm/");
+    CHECK(fetcher.Fetch(a.Url("/lm/"), &known).status == IconFetchResult::NotModified);
+    CHECK(a.Hits("/lm/") == pageHits);  // Revalidated without rediscovery
+
+    // A changed icon (validator no longer matches) is downloaded again
+    known = site1.source;
+    known.iconHash = {1};
+    known.etag = "\"v0\"";
+    IconFetchResult changed = fetcher.Fetch(a.Url("/site1/"), &known);
+    CHECK(changed.status == IconFetchResult::Fetched && !changed.icon.empty());
+
+    // An HTML page served as favicon.ico is no icon
+    CHECK(fetcher.Fetch(b.Url("/"), nullptr).status == IconFetchResult::NoIcon);
+    CHECK(b.Hits("/favicon.ico") == 1);
+
+    // A server error is retried another run, but the host is not skipped
+    CHECK(fetcher.Fetch(c.Url("/"), nullptr).status == IconFetchResult::HostFailed);
+    CHECK(fetcher.Fetch(c.Url("/other"), nullptr).status == IconFetchResult::HostFailed);
+    CHECK(c.TotalHits() == 2);
+
+    // A host that does not answer is skipped for the rest of the run
+    std::string dead = "http://" + deadHost;
+    CHECK(fetcher.Fetch(dead + "/", nullptr).status == IconFetchResult::HostFailed);
+    std::vector<std::string> failed = fetcher.FailedHosts();
+    CHECK(failed.size() == 1 && failed[0] == deadHost);
+    auto start = std::chrono::steady_clock::now();
+    CHECK(fetcher.Fetch(dead + "/again", nullptr).status == IconFetchResult::HostFailed);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(50));
+
+    // Hosts skipped from an earlier run are not contacted at all
+    IconFetcher later(*transport);
+    later.SkipHost(b.Host());
+    int hits = b.TotalHits();
+    CHECK(later.Fetch(b.Url("/"), nullptr).status == IconFetchResult::HostFailed);
+    CHECK(b.TotalHits() == hits);
+}
+
+static void TestCatalog(StandInServer& a, StandInServer& b, const std::string& deadHost, const std::string& dbPath) {
+    std::remove(dbPath.c_str());
+    sqlite3* db = nullptr;
+    CHECK(OpenCatalogDatabase(dbPath, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE) == SQLITE_OK);
+    CHECK(MigrateCatalogSchema(db));
+    std::string sql = "INSERT INTO apps (package_id, name, homepage) VALUES "
+                      "('Site.One', 'One', '" + a.Url("/site1/") + "'), "
+                      "('Site.OneToo', 'One too', '" + a.Url("/site1/") + "'), "
+                      "('Site.Two', 'Two', '" + a.Url("/site2/") + "'), "
+                      "('Site.B', 'B', '" + b.Url("/") + "'), "
+                      "('Site.Dead', 'Dead', 'http://" + deadHost + "/');";
+    CHECK(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    std::unique_ptr<HttpTransport> transport = CreateHttpTransport(2000, ICON_FETCH_USER_AGENT);
+    IconFetcherOptions options;
+    options.workers = 3;
+    IconFetchStats stats;
+    auto noProgress = [](const FetchProgress&) {};
+    CHECK(FetchCatalogIcons(db, *transport, std::vector<std::string>(), options, stats, noProgress));
+    CHECK(stats.homepages == 4 && stats.fetched == 2 && stats.noIcon == 1 && stats.hostFailed == 1);
+
+    auto count = [db](const char* query) {
+        sqlite3_stmt* stmt;
+        int value = -1;
+        if (sqlite3_prepare_v2(db, query, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+            value = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+        return value;
+    };
+    CHECK(count("SELECT COUNT(*) FROM apps WHERE icon_hash IS NOT NULL;") == 3);  // Both Site.One apps share it
+    CHECK(count("SELECT COUNT(*) FROM icon_host_failures;") == 1);
+
+    // Next run: the dead host is skipped, the homepage without an icon is not
+    // retried yet, and a refetched package's icon is revalidated
+    int site1Hits = a.Hits("/site1/");
+    int iconHits = a.Hits("/site1/img/icon.png?v=1&x=2");
+    int bHits = b.TotalHits();
+    CHECK(FetchCatalogIcons(db, *transport, {"Site.One"}, options, stats, noProgress));
+    CHECK(stats.skipped == 1 && stats.homepages == 1 && stats.notModified == 1 && stats.fetched == 0);
+    CHECK(a.Hits("/site1/") == site1Hits && a.Hits("/site1/img/icon.png?v=1&x=2") == iconHits + 1);
+    CHECK(b.TotalHits() == bHits);
+    sqlite3_close(db);
+}
+
+int main(int argc, char* argv[]) {
+    std::signal(SIGPIPE, SIG_IGN);
+    std::string dbPath = argc > 1 ? argv[1] : "icon_fetch_test.db";
+
+    StandInServer a(SiteA), b(SiteB), c(SiteC);
+    std::string deadHost = "127.0.0.1:" + std::to_string(ClosedPort());
+
+    TestLinkScanner();
+    TestFetcher(a, b, c, deadHost);
+    TestCatalog(a, b, deadHost, dbPath);
+    return TestResult("icon_fetch");
+}
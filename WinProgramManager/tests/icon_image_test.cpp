@@ -0,0 +1,237 @@
+// Icon decoding and normalization against what homepages actually serve:
+// multi-frame ICOs mixing DIB and PNG frames, truncated downloads, HTML error
+// pages served as favicon.ico, and images too large to decode. Also checks that
+// EncodePng round-trips and compresses.
+
+#include "test_check.h"
+#include "icon_image.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static void PutLE16(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back((uint8_t)value);
+    out.push_back((uint8_t)(value >> 8));
+}
+
+static void PutLE32(std::vector<uint8_t>& out, uint32_t value) {
+    PutLE16(out, value & 0xFFFF);
+    PutLE16(out, value >> 16);
+}
+
+// Opaque diagonal gradient, the kind of image icons are made of
+static DecodedImage Gradient(int width, int height) {
+    DecodedImage image;
+    image.width = width;
+    image.height = height;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            image.rgba.push_back((uint8_t)(x * 255 / width));
+            image.rgba.push_back((uint8_t)(y * 255 / height));
+            image.rgba.push_back(128);
+            image.rgba.push_back(255);
+        }
+    }
+    return image;
+}
+
+static DecodedImage Noise(int width, int height) {
+    DecodedImage image;
+    image.width = width;
+    image.height = height;
+    uint32_t state = 12345;
+    for (int i = 0; i < width * height * 4; i++) {
+        state = state * 1103515245 + 12345;
+        image.rgba.push_back((uint8_t)(state >> 16));
+    }
+    return image;
+}
+
+// 32-bit BGRA DIB frame (bottom-up, doubled height, empty AND mask) in one colour
+static std::vector<uint8_t> DibFrame(int size, uint8_t r, uint8_t g, uint8_t b) {
+    std::vector<uint8_t> dib;
+    PutLE32(dib, 40);
+    PutLE32(dib, (uint32_t)size);
+    PutLE32(dib, (uint32_t)size * 2);
+    PutLE16(dib, 1);
+    PutLE16(dib, 32);
+    for (int i = 0; i < 6; i++) PutLE32(dib, 0);
+    for (int i = 0; i < size * size; i++) {
+        dib.push_back(b);
+        dib.push_back(g);
+        dib.push_back(r);
+        dib.push_back(255);
+    }
+    dib.resize(dib.size() + (size_t)((size + 31) / 32) * 4 * size, 0);
+    return dib;
+}
+
+// ICO with the given frames (size, data)
+static std::vector<uint8_t> Ico(const std::vector<std::pair<int, std::vector<uint8_t>>>& frames) {
+    std::vector<uint8_t> ico;
+    PutLE16(ico, 0);
+    PutLE16(ico, 1);
+    PutLE16(ico, (uint32_t)frames.size());
+    uint32_t offset = (uint32_t)(6 + 16 * frames.size());
+    for (const auto& frame : frames) {
+        ico.push_back((uint8_t)(frame.first >= 256 ? 0 : frame.first));
+        ico.push_back((uint8_t)(frame.first >= 256 ? 0 : frame.first));
+        ico.push_back(0);
+        ico.push_back(0);
+        PutLE16(ico, 1);
+        PutLE16(ico, 32);
+        PutLE32(ico, (uint32_t)frame.second.size());
+        PutLE32(ico, offset);
+        offset += (uint32_t)frame.second.size();
+    }
+    for (const auto& frame : frames) ico.insert(ico.end(), frame.second.begin(), frame.second.end());
+    return ico;
+}
+
+static void TestEncodePng() {
+    // Round trip, with and without alpha
+    DecodedImage gradient = Gradient(32, 32);
+    std::vector<uint8_t> png;
+    CHECK(EncodePng(gradient, png));
+    DecodedImage decoded;
+    CHECK(DecodePng(png.data(), png.size(), decoded));
+    CHECK(decoded.width == 32 && decoded.height == 32 && decoded.rgba == gradient.rgba);
+
+    DecodedImage translucent = Gradient(16, 16);
+    for (size_t i = 3; i < translucent.rgba.size(); i += 4) translucent.rgba[i] = (uint8_t)(i % 256);
+    CHECK(EncodePng(translucent, png));
+    CHECK(DecodePng(png.data(), png.size(), decoded) && decoded.rgba == translucent.rgba);
+
+    // Smooth images compress well; noise costs at most the stored size plus the PNG chunks
+    CHECK(EncodePng(gradient, png));
+    CHECK(png.size() < gradient.rgba.size() / 8);
+    DecodedImage noise = Noise(16, 16);
+    CHECK(EncodePng(noise, png));
+    CHECK(png.size() <= 16 * (16 * 4 + 1) + 5 + 6 + 57);
+    CHECK(DecodePng(png.data(), png.size(), decoded) && decoded.rgba == noise.rgba);
+
+    DecodedImage empty;
+    CHECK(!EncodePng(empty, png));
+}
+
+static void TestMultiFrameIco() {
+    // A 16 px DIB frame, a 48 px PNG frame and a 256 px PNG frame, in that order
+    std::vector<uint8_t> png48, png256;
+    CHECK(EncodePng(Gradient(48, 48), png48));
+    CHECK(EncodePng(Gradient(256, 256), png256));
+    std::vector<uint8_t> ico = Ico({{16, DibFrame(16, 255, 0, 0)}, {48, png48}, {256, png256}});
+
+    CHECK(DetectImageFormat(ico.data(), ico.size()) == ImageFormat::Ico);
+    int width = 0, height = 0;
+    CHECK(ReadImageSize(ico.data(), ico.size(), width, height) && width == 256 && height == 256);
+
+    DecodedImage frame;
+    CHECK(DecodeIco(ico.data(), ico.size(), 16, frame) && frame.width == 16);
+    CHECK(frame.rgba.size() == 16 * 16 * 4 && frame.rgba[0] == 255 && frame.rgba[1] == 0 && frame.rgba[3] == 255);
+    CHECK(DecodeIco(ico.data(), ico.size(), 32, frame) && frame.width == 48);
+    CHECK(DecodeIco(ico.data(), ico.size(), 300, frame) && frame.width == 256);
+
+    // Normalized: one PNG frame per normalized size, 16 from the DIB, 32 from the 48 px PNG
+    std::vector<uint8_t> normalized;
+    CHECK(NormalizeIcon(ico.data(), ico.size(), normalized));
+    CHECK(DecodeIco(normalized.data(), normalized.size(), 16, frame) && frame.width == 16 && frame.rgba[0] == 255);
+    CHECK(DecodeIco(normalized.data(), normalized.size(), 32, frame) && frame.width == 32);
+    CHECK(normalized.size() > 6 && normalized[4] == 2);
+
+    // A broken frame falls back to the next best one
+    std::vector<uint8_t> broken = png48;
+    broken.resize(40);
+    std::vector<uint8_t> partly = Ico({{48, broken}, {16, DibFrame(16, 0, 0, 255)}});
+    CHECK(DecodeIco(partly.data(), partly.size(), 32, frame) && frame.width == 16 && frame.rgba[2] == 255);
+}
+
+static void TestTruncated() {
+    std::vector<uint8_t> png;
+    CHECK(EncodePng(Gradient(24, 24), png));
+    std::vector<uint8_t> ico = Ico({{24, png}});
+    std::vector<uint8_t> normalized;
+
+    // Every prefix short of the IEND chunk is rejected, without reading past the end
+    for (size_t length = 0; length + 12 < png.size(); length++) {
+        std::vector<uint8_t> prefix(png.begin(), png.begin() + length);
+        DecodedImage decoded;
+        if (DecodePng(prefix.data(), prefix.size(), decoded)) {
+            std::fprintf(stderr, "truncated PNG of %zu/%zu bytes decoded\n", length, png.size());
+            CHECK(false);
+        }
+        CHECK(!NormalizeIcon(prefix.data(), prefix.size(), normalized));
+    }
+    for (size_t length = 0; length < ico.size() - 12; length++) {
+        std::vector<uint8_t> prefix(ico.begin(), ico.begin() + length);
+        CHECK(!NormalizeIcon(prefix.data(), prefix.size(), normalized));
+    }
+}
+
+static void TestNotAnImage() {
+    const std::string pages[] = {
+        "<!DOCTYPE html>\n<html><head><title>404 Not Found</title></head><body>Not Found</body></html>\n",
+        "<html><body><h1>403 Forbidden</h1></body></html>",
+        "\xEF\xBB\xBF<!doctype html><title>Just a moment...</title>",
+        "",
+        "GIF89a\x01\x00\x01\x00",
+        "\xFF\xD8\xFF\xE0\x00\x10JFIF",
+    };
+    for (const std::string& page : pages) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(page.data());
+        CHECK(DetectImageFormat(data, page.size()) == ImageFormat::Unknown);
+        DecodedImage decoded;
+        CHECK(!DecodeImage(data, page.size(), 32, decoded));
+        std::vector<uint8_t> normalized;
+        CHECK(!NormalizeIcon(data, page.size(), normalized));
+    }
+
+    // Fully transparent icons are rejected as well
+    DecodedImage clear = Gradient(16, 16);
+    for (size_t i = 3; i < clear.rgba.size(); i += 4) clear.rgba[i] = 0;
+    std::vector<uint8_t> png, normalized;
+    CHECK(EncodePng(clear, png));
+    CHECK(!NormalizeIcon(png.data(), png.size(), normalized));
+}
+
+static void TestOversized() {
+    // A header-only PNG claiming more pixels than the decoder accepts
+    std::vector<uint8_t> png;
+    CHECK(EncodePng(Gradient(8, 8), png));
+    const uint32_t sizes[][2] = {{5000, 8}, {8, 5000}, {100000, 100000}, {0x7FFFFFFF, 1}};
+    for (const auto& size : sizes) {
+        std::vector<uint8_t> big = png;
+        for (int i = 0; i < 4; i++) {
+            big[16 + i] = (uint8_t)(size[0] >> (24 - 8 * i));
+            big[20 + i] = (uint8_t)(size[1] >> (24 - 8 * i));
+        }
+        DecodedImage decoded;
+        CHECK(!DecodePng(big.data(), big.size(), decoded));
+        std::vector<uint8_t> normalized;
+        CHECK(!NormalizeIcon(big.data(), big.size(), normalized));
+    }
+
+    // A DIB frame claiming a huge size, and an image too large to encode
+    std::vector<uint8_t> dib = DibFrame(16, 0, 255, 0);
+    dib[4] = 0x00;
+    dib[5] = 0x00;
+    dib[6] = 0x01;  // 65536 px wide
+    std::vector<uint8_t> ico = Ico({{0, dib}});
+    DecodedImage decoded;
+    CHECK(!DecodeIco(ico.data(), ico.size(), 32, decoded));
+
+    DecodedImage huge;
+    huge.width = 5000;
+    huge.height = 1;
+    huge.rgba.assign(5000 * 4, 255);
+    CHECK(!EncodePng(huge, png));
+}
+
+int main() {
+    TestEncodePng();
+    TestMultiFrameIco();
+    TestTruncated();
+    TestNotAnImage();
+    TestOversized();
+    return TestResult("icon_image");
+}
@@ -0,0 +1,152 @@
+// The offline manifest importer on a small winget-pkgs tree (fixtures/manifests):
+// a multi-file manifest read through its default locale file, a singleton
+// manifest, the latest of several versions, quoted and block scalars, both forms
+// of Tags, and a package whose latest version cannot be read. Also parses BOM and
+// CRLF text in memory, and imports the scan into a fresh catalog.
+// Usage: manifest_import_test <fixtures directory> <work directory>
+
+#include "test_check.h"
+#include "db_schema.h"
+#include "manifest_import.h"
+#include "winget_index.h"
+#include <sqlite3.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+typedef std::vector<std::string> Strings;
+
+static const ManifestPackage* Find(const std::vector<ManifestPackage>& packages, const char* id) {
+    for (const ManifestPackage& pkg : packages) {
+        if (pkg.packageId == id) return &pkg;
+    }
+    return nullptr;
+}
+
+static void TestParse() {
+    // BOM, CRLF, escapes, quoted scalars over several lines, nested keys
+    const std::string text =
+        "\xEF\xBB\xBFPackageIdentifier: Test.Pkg\r\n"
+        "PackageName: \"Caf\\u00e9 \\x41pp\\tone\"\r\n"
+        "Publisher: 'It''s me' # not a comment inside quotes\r\n"
+        "Author: \"first line\r\n"
+        "  second line\"\r\n"
+        "Moniker: plain value # comment\r\n"
+        "Copyright: plain\r\n"
+        "  continued\r\n"
+        "Agreements:\r\n"
+        "- AgreementLabel: License\r\n"
+        "  PackageName: nested, ignored\r\n"
+        "Description: |-\r\n"
+        "  one\r\n"
+        "\r\n"
+        "  two\r\n"
+        "Tags: []\r\n";
+    ManifestFields fields;
+    fields.tags = {"stale"};
+    ParseManifestYaml(text, fields);
+    CHECK(fields.packageIdentifier == "Test.Pkg");
+    CHECK(fields.packageName == "Caf\xC3\xA9 App\tone");
+    CHECK(fields.publisher == "It's me");
+    CHECK(fields.author == "first line second line");
+    CHECK(fields.moniker == "plain value");
+    CHECK(fields.copyright == "plain continued");
+    CHECK(fields.description == "one\n\ntwo");
+    CHECK(fields.tags.empty());
+
+    // A later file only overrides the keys it has
+    ParseManifestYaml("PackageName: Other\nTags:\n  - a\n  - b\n", fields);
+    CHECK(fields.packageName == "Other" && fields.publisher == "It's me");
+    CHECK(fields.tags == (Strings{"a", "b"}));
+}
+
+static void TestScan(const std::string& fixtures, std::vector<ManifestPackage>& packages) {
+    ManifestScanStats stats;
+    CHECK(ScanManifestTree(fixtures, 2, packages, stats));
+    CHECK(stats.versionDirs == 6 && stats.packages == 3 && stats.parsed == 2 && stats.failed == 1);
+    CHECK(packages.size() == 2);
+    CHECK(!Find(packages, "Broken.Pkg"));
+
+    // Multi-file: the default locale file, not the installer or another locale
+    const ManifestPackage* gh = Find(packages, "GitHub.cli");
+    CHECK(gh != nullptr);
+    if (gh) {
+        CHECK(gh->version == "2.45.1");
+        CHECK(gh->name == "GitHub CLI");
+        CHECK(gh->publisher == "GitHub, Inc.");
+        CHECK(gh->moniker == "gh");
+        CHECK(gh->homepage == "https://cli.github.com/");
+        CHECK(gh->license == "MIT");
+        CHECK(gh->licenseUrl == "https://github.com/cli/cli/blob/trunk/LICENSE");
+        CHECK(gh->copyright == "Copyright \xC2\xA9 GitHub, Inc. \"gh\"");
+        CHECK(gh->author == "The GitHub 'CLI' team");
+        CHECK(gh->description ==
+              "gh is GitHub on the command line.\n"
+              "  It brings pull requests, issues and other GitHub concepts\n"
+              "to the terminal.");
+        CHECK(gh->tags == (Strings{"cli", "command line", "git", "github"}));
+    }
+
+    // Singleton, 3.0.20 over 3.0.9, folded description, flow Tags over two lines
+    const ManifestPackage* vlc = Find(packages, "VideoLAN.VLC");
+    CHECK(vlc != nullptr);
+    if (vlc) {
+        CHECK(vlc->version == "3.0.20");
+        CHECK(vlc->name == "VLC media player");
+        CHECK(vlc->moniker == "vlc");
+        CHECK(vlc->homepage == "https://www.videolan.org/vlc/");
+        CHECK(vlc->description ==
+              "VLC is a free and open source cross-platform multimedia player.\n"
+              "It plays most multimedia files.");
+        CHECK(vlc->tags == (Strings{"media", "video player", "dvd", "streaming"}));
+    }
+
+    // The manifests directory itself works as the root too
+    std::vector<ManifestPackage> again;
+    CHECK(ScanManifestTree(fixtures + "/manifests", 1, again, stats) && again.size() == 2);
+    CHECK(!ScanManifestTree(fixtures + "/missing", 1, again, stats));
+}
+
+static std::string QueryText(sqlite3* db, const char* sql) {
+    sqlite3_stmt* stmt;
+    std::string value = "(none)";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* text = sqlite3_column_text(stmt, 0);
+        value = text ? reinterpret_cast<const char*>(text) : "";
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+static void TestImport(const std::vector<ManifestPackage>& packages, const std::string& dbPath) {
+    std::remove(dbPath.c_str());
+    sqlite3* db = nullptr;
+    CHECK(sqlite3_open(dbPath.c_str(), &db) == SQLITE_OK && MigrateCatalogSchema(db));
+
+    WingetIndexDiff diff;
+    CHECK(ImportManifestPackages(db, packages, diff));
+    CHECK(diff.added.size() == 2 && diff.changed.empty() && diff.removed.empty() && diff.tagsAdded == 8);
+    CHECK(QueryText(db, "SELECT version FROM apps WHERE package_id = 'GitHub.cli';") == "2.45.1");
+    CHECK(QueryText(db, "SELECT publisher FROM apps WHERE package_id = 'GitHub.cli';") == "GitHub, Inc.");
+    CHECK(QueryText(db, "SELECT homepage FROM apps WHERE package_id = 'VideoLAN.VLC';") ==
+          "https://www.videolan.org/vlc/");
+    CHECK(QueryText(db, "SELECT COUNT(*) FROM app_categories ac JOIN apps a ON a.id = ac.app_id "
+                        "WHERE a.package_id = 'VideoLAN.VLC';") == "4");
+
+    // Scanning the same tree again changes nothing
+    CHECK(ImportManifestPackages(db, packages, diff));
+    CHECK(diff.added.empty() && diff.changed.empty() && diff.removed.empty() && diff.tagsAdded == 0);
+    sqlite3_close(db);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::fprintf(stderr, "Usage: manifest_import_test <fixtures directory> <work directory>\n");
+        return 2;
+    }
+    std::vector<ManifestPackage> packages;
+    TestParse();
+    TestScan(argv[1], packages);
+    TestImport(packages, std::string(argv[2]) + "/manifest_import_test.db");
+    return TestResult("manifest_import");
+}
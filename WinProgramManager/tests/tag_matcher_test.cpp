@@ -0,0 +1,113 @@
+// Compares TagMatcher with the case-insensitive std::regex search the updater's
+// name-based inference used before it, over the current NameTagPatterns() table:
+// every entry must compile, and random strings built from pattern fragments,
+// mixed case and separators must hit exactly the patterns std::regex finds.
+// Usage: tag_matcher_test [random strings]
+
+#include "test_check.h"
+#include "tag_matcher.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+struct Pattern {
+    std::string text;
+    std::regex re;
+};
+
+static void TestSubset() {
+    TagMatcher matcher;
+    CHECK(matcher.Add("CLI|Command.?Line", 0));
+    CHECK(matcher.Add("Wi-?Fi", 1));
+    CHECK(matcher.Add("a\\.b", 2));
+    CHECK(!matcher.Add("(ab)", 3));
+    CHECK(!matcher.Add("a*", 3));
+    CHECK(!matcher.Add("[ab]", 3));
+    CHECK(!matcher.Add("^ab", 3));
+    CHECK(!matcher.Add("?a", 3));
+    matcher.Build();
+
+    std::vector<char> hits;
+    matcher.Match("my command-line tool", hits);
+    CHECK(hits.size() >= 3 && hits[0] && !hits[1] && !hits[2]);
+    hits.assign(3, 0);
+    matcher.Match("COMMAND\nLINE wifi", hits);
+    CHECK(!hits[0] && hits[1]);
+    hits.assign(3, 0);
+    matcher.Match("axb a.b", hits);
+    CHECK(hits[2]);
+}
+
+static void TestAgainstRegex(int count) {
+    const auto& table = NameTagPatterns();
+    std::vector<Pattern> patterns;
+    TagMatcher matcher;
+    for (const auto& entry : table) {
+        bool added = matcher.Add(entry.first, (int)patterns.size());
+        if (!added) std::fprintf(stderr, "pattern not accepted: %s\n", entry.first.c_str());
+        CHECK(added);
+        patterns.push_back({entry.first, std::regex(entry.first, std::regex_constants::icase)});
+    }
+    matcher.Build();
+
+    // Fragments of the patterns themselves, so that matches and near misses are common
+    std::vector<std::string> fragments = {" ", "-", ".", "_", "\n", "\r", "\t", "0", "9", "x", "\xC3\xA9"};
+    for (const auto& entry : table) {
+        std::string literal;
+        for (char c : entry.first) {
+            if (c == '|') {
+                fragments.push_back(literal);
+                literal.clear();
+            } else if (c != '.' && c != '?' && c != '\\') {
+                literal += c;
+            }
+        }
+        fragments.push_back(literal);
+        for (size_t i = 1; i < literal.size(); i++) {
+            fragments.push_back(literal.substr(0, i));
+            fragments.push_back(literal.substr(i));
+        }
+    }
+
+    std::mt19937 random(20240601);
+    std::vector<char> hits;
+    long mismatches = 0, matched = 0;
+    for (int n = 0; n < count; n++) {
+        std::string text;
+        int pieces = (int)(random() % 6);
+        for (int p = 0; p < pieces; p++) {
+            std::string piece = fragments[random() % fragments.size()];
+            for (char& c : piece) {
+                if (random() % 3 == 0 && c >= 'a' && c <= 'z') c = (char)(c - 'a' + 'A');
+                else if (random() % 3 == 0 && c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+            }
+            text += piece;
+        }
+
+        hits.assign(patterns.size(), 0);
+        matcher.Match(text, hits);
+        for (size_t i = 0; i < patterns.size(); i++) {
+            bool expected = std::regex_search(text, patterns[i].re);
+            if (expected) matched++;
+            if ((hits[i] != 0) != expected) {
+                if (mismatches++ < 10) {
+                    std::fprintf(stderr, "\"%s\" on \"%s\": matcher %d, regex %d\n", patterns[i].text.c_str(),
+                                 text.c_str(), hits[i], expected);
+                }
+            }
+        }
+    }
+    std::printf("%d strings, %ld pattern hits, %ld mismatches\n", count, matched, mismatches);
+    CHECK(mismatches == 0);
+    CHECK(matched > count / 10);  // The corpus does exercise the patterns
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::atoi(argv[1]) : 200000;
+    TestSubset();
+    TestAgainstRegex(count);
+    return TestResult("tag_matcher");
+}
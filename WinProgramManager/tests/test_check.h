@@ -0,0 +1,29 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+// Checks for the tests in this directory (one executable per test, no
+// framework): CHECK reports a failed condition and carries on, TestResult
+// prints the summary and is main's exit code.
+
+#include <cstdio>
+
+static int g_testFailures = 0;
+
+#define CHECK(cond)                                                                   \
+    do {                                                                              \
+        if (!(cond)) {                                                                \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_testFailures++;                                                         \
+        }                                                                             \
+    } while (0)
+
+static int TestResult(const char* name) {
+    if (g_testFailures) {
+        std::fprintf(stderr, "%s: %d check(s) failed\n", name, g_testFailures);
+        return 1;
+    }
+    std::printf("%s: all checks passed\n", name);
+    return 0;
+}
+
+#endif // TEST_CHECK_H
@@ -0,0 +1,167 @@
+// Reads the two fixture indexes (fixtures/winget_index_v1.sql and _v2.sql, one per
+// index schema) and imports them in turn into a fresh catalog, checking the
+// package list of each and the import diff: added, changed in place, removed, and
+// installed packages kept after they leave the source.
+// Usage: winget_index_test <fixtures directory> <work directory>
+
+#include "test_check.h"
+#include "db_schema.h"
+#include "winget_index.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Build an index database from a fixture's SQL
+static bool LoadFixture(const std::string& sqlPath, const std::string& dbPath) {
+    std::ifstream file(sqlPath);
+    if (!file) {
+        std::fprintf(stderr, "cannot read %s\n", sqlPath.c_str());
+        return false;
+    }
+    std::stringstream sql;
+    sql << file.rdbuf();
+
+    std::remove(dbPath.c_str());
+    sqlite3* db = nullptr;
+    bool ok = sqlite3_open(dbPath.c_str(), &db) == SQLITE_OK &&
+              sqlite3_exec(db, sql.str().c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+    if (!ok) std::fprintf(stderr, "%s: %s\n", sqlPath.c_str(), sqlite3_errmsg(db));
+    sqlite3_close(db);
+    return ok;
+}
+
+static const WingetIndexPackage* Find(const std::vector<WingetIndexPackage>& packages, const char* id) {
+    for (const WingetIndexPackage& pkg : packages) {
+        if (pkg.packageId == id) return &pkg;
+    }
+    return nullptr;
+}
+
+static std::vector<std::string> Sorted(std::vector<std::string> ids) {
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+static std::string QueryText(sqlite3* db, const std::string& sql) {
+    sqlite3_stmt* stmt;
+    std::string value = "(none)";
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* text = sqlite3_column_text(stmt, 0);
+        value = text ? reinterpret_cast<const char*>(text) : "";
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+static std::string Tags(sqlite3* db, const char* packageId) {
+    return QueryText(db, std::string("SELECT group_concat(category_name, ',') FROM (SELECT c.category_name FROM apps a "
+                                     "JOIN app_categories ac ON ac.app_id = a.id "
+                                     "JOIN categories c ON c.id = ac.category_id "
+                                     "WHERE a.package_id = '") + packageId + "' ORDER BY c.category_name);");
+}
+
+static void TestVersionOrder() {
+    CHECK(CompareWingetVersions("1.10", "1.9") > 0);
+    CHECK(CompareWingetVersions("1.0", "1.0.0") == 0);
+    CHECK(CompareWingetVersions("1.0-beta", "1.0") < 0);
+    CHECK(CompareWingetVersions("2.45.1-rc1", "2.45.1") < 0);
+}
+
+static void TestRead(const std::string& v1, const std::string& v2, const std::string& catalogPath) {
+    std::vector<WingetIndexPackage> packages;
+
+    // v1: the latest of several manifest versions, with that version's name and tags
+    CHECK(ReadWingetIndex(v1, packages));
+    CHECK(packages.size() == 6);
+    const WingetIndexPackage* git = Find(packages, "Git.Git");
+    CHECK(git && git->version == "2.45.1" && git->name == "Git" && git->moniker == "git");
+    CHECK(git && git->tags == std::vector<std::string>{"vcs"});
+    const WingetIndexPackage* same = Find(packages, "Same.App");
+    CHECK(same && same->moniker.empty() && same->version == "1.0" && same->tags.empty());
+
+    CHECK(ReadWingetIndex(v2, packages));
+    CHECK(packages.size() == 5);
+    const WingetIndexPackage* firefox = Find(packages, "Mozilla.Firefox");
+    CHECK(firefox && firefox->version == "129.0" && firefox->tags == std::vector<std::string>{"browser"});
+    const WingetIndexPackage* added = Find(packages, "New.App");
+    CHECK(added && added->name == "New App" && added->tags == std::vector<std::string>{"Utilities"});
+
+    // A catalog database is not an index
+    CHECK(!ReadWingetIndex(catalogPath, packages) && packages.empty());
+}
+
+static void TestImportDiff(const std::string& v1, const std::string& v2, const std::string& catalogPath) {
+    std::remove(catalogPath.c_str());
+    sqlite3* db = nullptr;
+    CHECK(sqlite3_open(catalogPath.c_str(), &db) == SQLITE_OK && MigrateCatalogSchema(db));
+
+    // v1 into an empty catalog: everything is added
+    std::vector<WingetIndexPackage> packages;
+    WingetIndexDiff diff;
+    CHECK(ReadWingetIndex(v1, packages) && ImportWingetIndex(db, packages, diff));
+    CHECK(Sorted(diff.added) == (std::vector<std::string>{"Git.Git", "Installed.Tool", "Mozilla.Firefox",
+                                                          "Old.Tool", "Same.App", "Video.Player"}));
+    CHECK(diff.changed.empty() && diff.removed.empty() && diff.tagsAdded == 3);
+    CHECK(Tags(db, "Git.Git") == "vcs");
+
+    // Same index again: nothing to do
+    CHECK(ImportWingetIndex(db, packages, diff));
+    CHECK(diff.added.empty() && diff.changed.empty() && diff.removed.empty() && diff.tagsAdded == 0);
+
+    CHECK(sqlite3_exec(db,
+                       "INSERT INTO installed_apps (package_id, installed_version, source) "
+                       "VALUES ('Installed.Tool', '3.0', 'winget');",
+                       nullptr, nullptr, nullptr) == SQLITE_OK);
+    std::string firefoxId = QueryText(db, "SELECT id FROM apps WHERE package_id = 'Mozilla.Firefox';");
+    std::string playerId = QueryText(db, "SELECT id FROM apps WHERE package_id = 'Video.Player';");
+
+    // v2 over it: one added, two changed in place, one removed, the installed one kept.
+    // Git.Git's id only differs in case and Video.Player's tag only in case: no change.
+    CHECK(ReadWingetIndex(v2, packages) && ImportWingetIndex(db, packages, diff));
+    CHECK(diff.added == std::vector<std::string>{"New.App"});
+    CHECK(Sorted(diff.changed) == (std::vector<std::string>{"Mozilla.Firefox", "Video.Player"}));
+    CHECK(diff.removed == std::vector<std::string>{"Old.Tool"});
+    CHECK(diff.tagsAdded == 1);
+
+    CHECK(QueryText(db, "SELECT COUNT(*) FROM apps;") == "6");
+    CHECK(QueryText(db, "SELECT version FROM apps WHERE package_id = 'Mozilla.Firefox';") == "129.0");
+    CHECK(QueryText(db, "SELECT id FROM apps WHERE package_id = 'Mozilla.Firefox';") == firefoxId);
+    CHECK(QueryText(db, "SELECT name FROM apps WHERE package_id = 'Video.Player';") == "Video Player");
+    CHECK(QueryText(db, "SELECT id FROM apps WHERE package_id = 'Video.Player';") == playerId);
+    CHECK(Tags(db, "Video.Player") == "media");
+    CHECK(Tags(db, "New.App") == "Utilities");
+    CHECK(QueryText(db, "SELECT COUNT(*) FROM apps WHERE package_id = 'Installed.Tool';") == "1");
+    CHECK(QueryText(db, "SELECT COUNT(*) FROM apps WHERE package_id = 'Old.Tool';") == "0");
+    CHECK(QueryText(db, "SELECT COUNT(*) FROM app_categories "
+                        "WHERE app_id NOT IN (SELECT id FROM apps);") == "0");
+
+    // An index holding less than half the catalog adds and changes, but removes nothing
+    packages.resize(2);
+    CHECK(ImportWingetIndex(db, packages, diff));
+    CHECK(diff.removed.empty());
+    CHECK(QueryText(db, "SELECT COUNT(*) FROM apps;") == "6");
+    sqlite3_close(db);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::fprintf(stderr, "Usage: winget_index_test <fixtures directory> <work directory>\n");
+        return 2;
+    }
+    std::string fixtures = argv[1], work = argv[2];
+    std::string v1 = work + "/winget_index_v1.db", v2 = work + "/winget_index_v2.db";
+    std::string catalog = work + "/winget_index_catalog.db";
+    bool loaded = LoadFixture(fixtures + "/winget_index_v1.sql", v1) &&
+                  LoadFixture(fixtures + "/winget_index_v2.sql", v2);
+    CHECK(loaded);
+    if (!loaded) return TestResult("winget_index");
+
+    TestVersionOrder();
+    TestImportDiff(v1, v2, catalog);
+    TestRead(v1, v2, catalog);
+    return TestResult("winget_index");
+}
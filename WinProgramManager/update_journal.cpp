@@ -0,0 +1,124 @@
+#include "update_journal.h"
+#include <sqlite3.h>
+
+bool UpdateJournal::Open(sqlite3* db) {
+    const char* sql =
+        "CREATE TABLE IF NOT EXISTS update_stages ("
+        "stage TEXT PRIMARY KEY, "
+        "input_key TEXT NOT NULL, "
+        "finished_at DATETIME DEFAULT CURRENT_TIMESTAMP"
+        ");"
+        "CREATE TABLE IF NOT EXISTS update_journal ("
+        "stage TEXT NOT NULL, "
+        "package_id TEXT NOT NULL, "
+        "status TEXT NOT NULL DEFAULT 'pending', "
+        "attempts INTEGER NOT NULL DEFAULT 0, "
+        "updated_at DATETIME DEFAULT CURRENT_TIMESTAMP, "
+        "PRIMARY KEY (stage, package_id)"
+        ") WITHOUT ROWID;";
+
+    db_ = db;
+    statements_.Reset(db);
+    return db && sqlite3_exec(db, sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+void UpdateJournal::Close() {
+    statements_.Reset(nullptr);
+    db_ = nullptr;
+}
+
+bool UpdateJournal::StageDone(const char* stage, const std::string& inputKey) {
+    sqlite3_stmt* stmt = statements_.Get("SELECT input_key FROM update_stages WHERE stage = ?;");
+    if (!stmt) return false;
+    sqlite3_bind_text(stmt, 1, stage, -1, SQLITE_STATIC);
+
+    bool done = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* key = sqlite3_column_text(stmt, 0);
+        done = key && inputKey == reinterpret_cast<const char*>(key);
+    }
+    sqlite3_reset(stmt);
+    return done;
+}
+
+bool UpdateJournal::MarkStageDone(const char* stage, const std::string& inputKey) {
+    sqlite3_stmt* stmt = statements_.Get(
+        "INSERT OR REPLACE INTO update_stages (stage, input_key, finished_at) VALUES (?, ?, CURRENT_TIMESTAMP);");
+    if (!stmt) return false;
+    sqlite3_bind_text(stmt, 1, stage, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, inputKey.c_str(), -1, SQLITE_STATIC);
+    return sqlite3_step(stmt) == SQLITE_DONE;
+}
+
+int UpdateJournal::AddItems(const char* stage, const std::vector<std::string>& ids) {
+    sqlite3_stmt* stmt = statements_.Get("INSERT OR IGNORE INTO update_journal (stage, package_id) VALUES (?, ?);");
+    if (!stmt) return -1;
+
+    int added = 0;
+    for (const auto& id : ids) {
+        sqlite3_bind_text(stmt, 1, stage, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, id.c_str(), -1, SQLITE_STATIC);
+        int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) return -1;
+        added += sqlite3_changes(db_);
+    }
+    return added;
+}
+
+std::vector<std::string> UpdateJournal::StartItems(const char* stage, int maxAttempts) {
+    std::vector<std::string> ids;
+    sqlite3_stmt* stmt = statements_.Get(
+        "UPDATE update_journal SET status = 'in_progress', attempts = attempts + 1, updated_at = CURRENT_TIMESTAMP "
+        "WHERE stage = ? AND status <> 'done' AND attempts < ? "
+        "RETURNING package_id;");
+    if (!stmt) return ids;
+    sqlite3_bind_text(stmt, 1, stage, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, maxAttempts);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        ids.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+    }
+    sqlite3_reset(stmt);
+    return ids;
+}
+
+void UpdateJournal::FinishItem(const char* stage, const std::string& id, bool ok) {
+    sqlite3_stmt* stmt = statements_.Get(
+        "UPDATE update_journal SET status = ?, updated_at = CURRENT_TIMESTAMP "
+        "WHERE stage = ? AND package_id = ?;");
+    if (!stmt) return;
+    sqlite3_bind_text(stmt, 1, ok ? "done" : "failed", -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, stage, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, id.c_str(), -1, SQLITE_STATIC);
+    sqlite3_step(stmt);
+}
+
+int UpdateJournal::UnfinishedItems(const char* stage, int maxAttempts) {
+    sqlite3_stmt* stmt = statements_.Get(
+        "SELECT COUNT(*) FROM update_journal "
+        "WHERE stage = ? AND status <> 'done' AND attempts < ?;");
+    if (!stmt) return 0;
+    sqlite3_bind_text(stmt, 1, stage, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, maxAttempts);
+
+    int count = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+    sqlite3_reset(stmt);
+    return count;
+}
+
+int UpdateJournal::ReleaseItems(const char* stage) {
+    sqlite3_stmt* stmt = statements_.Get(
+        "UPDATE update_journal SET status = 'pending', attempts = MAX(attempts - 1, 0), "
+        "updated_at = CURRENT_TIMESTAMP WHERE stage = ? AND status = 'in_progress';");
+    if (!stmt) return -1;
+    sqlite3_bind_text(stmt, 1, stage, -1, SQLITE_STATIC);
+    return sqlite3_step(stmt) == SQLITE_DONE ? sqlite3_changes(db_) : -1;
+}
+
+bool UpdateJournal::PurgeDoneItems(const char* stage) {
+    sqlite3_stmt* stmt = statements_.Get("DELETE FROM update_journal WHERE stage = ? AND status = 'done';");
+    if (!stmt) return false;
+    sqlite3_bind_text(stmt, 1, stage, -1, SQLITE_STATIC);
+    return sqlite3_step(stmt) == SQLITE_DONE;
+}
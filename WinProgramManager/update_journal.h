@@ -0,0 +1,66 @@
+#ifndef UPDATE_JOURNAL_H
+#define UPDATE_JOURNAL_H
+
+// Progress of updater runs, kept in the database so that a run that is killed
+// (reboot, Task Scheduler time limit) or stopped by its time budget continues
+// where it stopped instead of starting over.
+//
+// update_stages   one row per stage: the input it last completed with. A stage
+//                 whose input key is unchanged can be skipped.
+// update_journal  per-package work items of the fetch stages: pending,
+//                 in_progress, done or failed, with the number of attempts.
+//
+// Item updates go through the caller's connection, so they commit together with
+// the writes they describe.
+
+#include <string>
+#include <vector>
+#include "sql_batch.h"
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+class UpdateJournal {
+public:
+    UpdateJournal() = default;
+    UpdateJournal(const UpdateJournal&) = delete;
+    UpdateJournal& operator=(const UpdateJournal&) = delete;
+
+    // Create the tables if needed and use this connection
+    bool Open(sqlite3* db);
+
+    // Finalize the statements (before the connection closes)
+    void Close();
+
+    // Stage level
+    bool StageDone(const char* stage, const std::string& inputKey);
+    bool MarkStageDone(const char* stage, const std::string& inputKey);
+
+    // Queue ids as pending. Ids already in the journal keep their state and attempts.
+    // Returns the number queued, or -1 on failure.
+    int AddItems(const char* stage, const std::vector<std::string>& ids);
+
+    // Ids still to do (pending, interrupted, or failed) with fewer than maxAttempts
+    // attempts, marked in_progress with the attempt counted. Counting at the start
+    // means a package whose fetch hangs or kills the run still runs out of attempts.
+    std::vector<std::string> StartItems(const char* stage, int maxAttempts);
+
+    // Record the outcome of a started item: done or failed
+    void FinishItem(const char* stage, const std::string& id, bool ok);
+
+    // Started items that were never attempted (the run stopped at its deadline) go
+    // back to pending with their attempt taken back. Returns the number, or -1.
+    int ReleaseItems(const char* stage);
+
+    // Ids StartItems would return
+    int UnfinishedItems(const char* stage, int maxAttempts);
+
+    // Drop the done items of a stage; failed items stay so they are not retried forever
+    bool PurgeDoneItems(const char* stage);
+
+private:
+    sqlite3* db_ = nullptr;
+    StatementCache statements_;
+};
+
+#endif // UPDATE_JOURNAL_H
@@ -6,7 +6,38 @@
 
 #include "WinProgramUpdater.h"
 #include <windows.h>
+#include <shellapi.h>
 #include <iostream>
+#include <cwchar>
+
+// Command line options shared by both entry points:
+//   --batch-size N   rows written per database transaction
+//   --workers N      concurrent winget show / icon fetches
+//   --rate R         fetches started per second across all workers (0 = unlimited)
+//   --winget-index P winget source index.db to import instead of running winget search
+//   --time-budget M  stop starting new work after M minutes; the next run continues
+static void ApplyCommandLineOptions(WinProgramUpdater& updater) {
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (!argv) return;
+    
+    FetchPipelineOptions fetchOptions;
+    for (int i = 1; i < argc; i++) {
+        if (wcscmp(argv[i], L"--batch-size") == 0 && i + 1 < argc) {
+            updater.SetBatchSize(_wtoi(argv[++i]));
+        } else if (wcscmp(argv[i], L"--workers") == 0 && i + 1 < argc) {
+            fetchOptions.workers = _wtoi(argv[++i]);
+        } else if (wcscmp(argv[i], L"--rate") == 0 && i + 1 < argc) {
+            fetchOptions.requestsPerSecond = wcstod(argv[++i], nullptr);
+        } else if (wcscmp(argv[i], L"--winget-index") == 0 && i + 1 < argc) {
+            updater.SetWingetIndexPath(argv[++i]);
+        } else if (wcscmp(argv[i], L"--time-budget") == 0 && i + 1 < argc) {
+            updater.SetTimeBudget(_wtoi(argv[++i]));
+        }
+    }
+    updater.SetFetchOptions(fetchOptions);
+    LocalFree(argv);
+}
 
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow) {
     (void)hInstance;
@@ -35,6 +66,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
     
     // Run updater
     WinProgramUpdater updater(dbPath);
+    ApplyCommandLineOptions(updater);
     UpdateStats stats;
     
     bool success = updater.UpdateDatabase(stats);
@@ -71,6 +103,7 @@ int main(int argc, char* argv[]) {
     std::wcout << L"Database: " << dbPath << std::endl;
     
     WinProgramUpdater updater(dbPath);
+    ApplyCommandLineOptions(updater);
     UpdateStats stats;
     
     std::wcout << L"\nUpdating database..." << std::endl;
@@ -80,10 +113,20 @@ int main(int argc, char* argv[]) {
         std::wcout << L"\n✓ Update complete!" << std::endl;
         std::wcout << L"  Packages added: " << stats.packagesAdded << std::endl;
         std::wcout << L"  Packages removed: " << stats.packagesRemoved << std::endl;
+        std::wcout << L"  Packages updated: " << stats.packagesUpdated << std::endl;
         std::wcout << L"  Tags from winget: " << stats.tagsFromWinget << std::endl;
         std::wcout << L"  Tags from inference: " << stats.tagsFromInference << std::endl;
         std::wcout << L"  Tags from correlation: " << stats.tagsFromCorrelation << std::endl;
         std::wcout << L"  Uncategorized: " << stats.uncategorized << std::endl;
+        std::wcout << L"  Failed fetches: " << stats.fetchFailures << std::endl;
+        std::wcout << L"  Installed: +" << stats.installedAdded << L" -" << stats.installedRemoved << std::endl;
+        std::wcout << L"  Icons fetched: " << stats.iconsFetched << L" (" << stats.iconsRevalidated << L" unchanged)" << std::endl;
+        if (stats.backlog > 0) {
+            std::wcout << L"  Left for the next run: " << stats.backlog << std::endl;
+        }
+        if (!stats.skippedStages.empty()) {
+            std::wcout << L"  Source unchanged: only installed apps were synced" << std::endl;
+        }
         
         std::wcout << L"\nLog written to %APPDATA%\\WinProgramManager\\log\\WinProgramUpdater.log" << std::endl;
     } else {
@@ -0,0 +1,433 @@
+#include "winget_index.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+static std::string ColumnString(sqlite3_stmt* stmt, int column) {
+    const char* text = (const char*)sqlite3_column_text(stmt, column);
+    return text ? std::string(text, (size_t)sqlite3_column_bytes(stmt, column)) : std::string();
+}
+
+// Package ids and category names compare with COLLATE NOCASE, which only folds ASCII
+static std::string AsciiLower(std::string_view text) {
+    std::string result(text);
+    for (char& c : result) {
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    }
+    return result;
+}
+
+static bool HasTable(sqlite3* db, const char* table) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// ---------------------------------------------------------------------------
+// Version ordering
+// ---------------------------------------------------------------------------
+
+static void SplitVersionPart(std::string_view part, uint64_t& number, std::string_view& rest) {
+    size_t digits = 0;
+    number = 0;
+    while (digits < part.size() && part[digits] >= '0' && part[digits] <= '9') {
+        if (number < UINT64_MAX / 10) number = number * 10 + (uint64_t)(part[digits] - '0');
+        digits++;
+    }
+    rest = part.substr(digits);
+}
+
+static std::string_view NextVersionPart(std::string_view& version) {
+    size_t dot = version.find('.');
+    std::string_view part = version.substr(0, dot);
+    version = dot == std::string_view::npos ? std::string_view() : version.substr(dot + 1);
+    return part;
+}
+
+int CompareWingetVersions(const std::string& a, const std::string& b) {
+    // "Unknown" sorts below and "latest" above every real version
+    std::string lowerA = AsciiLower(a);
+    std::string lowerB = AsciiLower(b);
+    auto rank = [](const std::string& v) { return v == "latest" ? 1 : (v.empty() || v == "unknown") ? -1 : 0; };
+    int rankA = rank(lowerA);
+    int rankB = rank(lowerB);
+    if (rankA != rankB) return rankA < rankB ? -1 : 1;
+    if (rankA != 0) return 0;
+
+    std::string_view restA = lowerA;
+    std::string_view restB = lowerB;
+    while (!restA.empty() || !restB.empty()) {
+        // Missing trailing parts count as 0, so 1.2 == 1.2.0
+        std::string_view partA = restA.empty() ? std::string_view("0") : NextVersionPart(restA);
+        std::string_view partB = restB.empty() ? std::string_view("0") : NextVersionPart(restB);
+
+        uint64_t numberA, numberB;
+        std::string_view suffixA, suffixB;
+        SplitVersionPart(partA, numberA, suffixA);
+        SplitVersionPart(partB, numberB, suffixB);
+
+        if (numberA != numberB) return numberA < numberB ? -1 : 1;
+        if (suffixA.empty() != suffixB.empty()) return suffixA.empty() ? 1 : -1;  // 1.0-beta < 1.0
+        int cmp = suffixA.compare(suffixB);
+        if (cmp != 0) return cmp < 0 ? -1 : 1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Reading the index
+// ---------------------------------------------------------------------------
+
+// Attach tags to packages. ownerToPackage maps the map table's owner rowid
+// (manifest in v1, package in v2) to an index in packages.
+static void ReadIndexTags(sqlite3* index, const char* sql,
+                          const std::unordered_map<int64_t, size_t>& ownerToPackage,
+                          std::vector<WingetIndexPackage>& packages) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(index, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return;  // Tags are optional
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        auto it = ownerToPackage.find(sqlite3_column_int64(stmt, 0));
+        if (it == ownerToPackage.end()) continue;
+        std::string tag = ColumnString(stmt, 1);
+        if (!tag.empty()) packages[it->second].tags.push_back(std::move(tag));
+    }
+    sqlite3_finalize(stmt);
+}
+
+static bool ReadIndexV2(sqlite3* index, std::vector<WingetIndexPackage>& packages) {
+    sqlite3_stmt* stmt;
+    const char* sql = "SELECT rowid, id, name, moniker, latest_version FROM packages;";
+    if (sqlite3_prepare_v2(index, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+
+    std::unordered_map<int64_t, size_t> rowToPackage;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        WingetIndexPackage pkg;
+        pkg.packageId = ColumnString(stmt, 1);
+        if (pkg.packageId.empty()) continue;
+        pkg.name = ColumnString(stmt, 2);
+        pkg.moniker = ColumnString(stmt, 3);
+        pkg.version = ColumnString(stmt, 4);
+        rowToPackage.emplace(sqlite3_column_int64(stmt, 0), packages.size());
+        packages.push_back(std::move(pkg));
+    }
+    sqlite3_finalize(stmt);
+
+    ReadIndexTags(index, "SELECT m.package, t.tag FROM tags2_0_map m JOIN tags2_0 t ON t.rowid = m.tag;",
+                  rowToPackage, packages);
+    return true;
+}
+
+static bool ReadIndexV1(sqlite3* index, std::vector<WingetIndexPackage>& packages) {
+    // One manifest row per package version; keep the latest per id
+    sqlite3_stmt* stmt;
+    const char* sql =
+        "SELECT m.rowid, i.id, n.name, mo.moniker, v.version FROM manifest m "
+        "JOIN ids i ON i.rowid = m.id "
+        "JOIN names n ON n.rowid = m.name "
+        "JOIN versions v ON v.rowid = m.version "
+        "LEFT JOIN monikers mo ON mo.rowid = m.moniker;";
+    if (sqlite3_prepare_v2(index, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+
+    std::unordered_map<std::string, size_t> packageById;
+    std::vector<int64_t> latestManifest;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        WingetIndexPackage pkg;
+        pkg.packageId = ColumnString(stmt, 1);
+        if (pkg.packageId.empty()) continue;
+        pkg.name = ColumnString(stmt, 2);
+        pkg.moniker = ColumnString(stmt, 3);
+        pkg.version = ColumnString(stmt, 4);
+        int64_t manifest = sqlite3_column_int64(stmt, 0);
+
+        auto result = packageById.emplace(pkg.packageId, packages.size());
+        if (result.second) {
+            packages.push_back(std::move(pkg));
+            latestManifest.push_back(manifest);
+        } else if (CompareWingetVersions(pkg.version, packages[result.first->second].version) > 0) {
+            packages[result.first->second] = std::move(pkg);
+            latestManifest[result.first->second] = manifest;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    std::unordered_map<int64_t, size_t> manifestToPackage;
+    manifestToPackage.reserve(latestManifest.size());
+    for (size_t i = 0; i < latestManifest.size(); i++) manifestToPackage.emplace(latestManifest[i], i);
+
+    ReadIndexTags(index, "SELECT m.manifest, t.tag FROM tags_map m JOIN tags t ON t.rowid = m.tag;",
+                  manifestToPackage, packages);
+    return true;
+}
+
+bool ReadWingetIndex(const std::string& indexPath, std::vector<WingetIndexPackage>& packages) {
+    packages.clear();
+
+    sqlite3* index = nullptr;
+    if (sqlite3_open_v2(indexPath.c_str(), &index, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        sqlite3_close(index);
+        return false;
+    }
+
+    bool ok = false;
+    if (HasTable(index, "packages")) {
+        ok = ReadIndexV2(index, packages);
+    } else if (HasTable(index, "manifest")) {
+        ok = ReadIndexV1(index, packages);
+    }
+    sqlite3_close(index);
+
+    if (!ok) packages.clear();
+    return ok && !packages.empty();
+}
+
+// ---------------------------------------------------------------------------
+// Importing into the catalog
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct ExistingApp {
+    int64_t id;
+    std::string key;        // Lowercased package_id
+    std::string packageId;
+    std::string name;
+    std::string version;
+    std::string moniker;
+};
+
+// Statements and category cache for one import, all on the target connection
+class IndexImporter {
+public:
+    explicit IndexImporter(sqlite3* db) : db_(db) {}
+
+    ~IndexImporter() {
+        sqlite3_finalize(insertApp_);
+        sqlite3_finalize(updateApp_);
+        sqlite3_finalize(deleteLinks_);
+        sqlite3_finalize(deleteApp_);
+        sqlite3_finalize(insertLink_);
+        sqlite3_finalize(insertCategory_);
+        sqlite3_finalize(findCategory_);
+    }
+
+    bool Prepare() {
+        return Prep("INSERT INTO apps (package_id, name, version, moniker) VALUES (?, ?, ?, ?);", insertApp_) &&
+               Prep("UPDATE apps SET name = ?, version = ?, moniker = ? WHERE id = ?;", updateApp_) &&
+               Prep("DELETE FROM app_categories WHERE app_id = ?;", deleteLinks_) &&
+               Prep("DELETE FROM apps WHERE id = ?;", deleteApp_) &&
+               Prep("INSERT OR IGNORE INTO app_categories (app_id, category_id) VALUES (?, ?);", insertLink_) &&
+               Prep("INSERT INTO categories (category_name) VALUES (?);", insertCategory_) &&
+               Prep("SELECT id FROM categories WHERE category_name = ? COLLATE NOCASE;", findCategory_) &&
+               LoadCategories();
+    }
+
+    bool Insert(const WingetIndexPackage& pkg, int64_t& appId) {
+        BindText(insertApp_, 1, pkg.packageId);
+        BindText(insertApp_, 2, pkg.name);
+        BindText(insertApp_, 3, pkg.version);
+        BindText(insertApp_, 4, pkg.moniker);
+        if (!Run(insertApp_)) return false;
+        appId = sqlite3_last_insert_rowid(db_);
+        return true;
+    }
+
+    bool Update(int64_t appId, const WingetIndexPackage& pkg) {
+        BindText(updateApp_, 1, pkg.name);
+        BindText(updateApp_, 2, pkg.version);
+        BindText(updateApp_, 3, pkg.moniker);
+        sqlite3_bind_int64(updateApp_, 4, appId);
+        return Run(updateApp_);
+    }
+
+    bool Remove(int64_t appId) {
+        sqlite3_bind_int64(deleteLinks_, 1, appId);
+        if (!Run(deleteLinks_)) return false;
+        sqlite3_bind_int64(deleteApp_, 1, appId);
+        return Run(deleteApp_);
+    }
+
+    // Returns the number of links actually added, or -1 on error
+    int AddTags(int64_t appId, const std::vector<std::string>& tags) {
+        int added = 0;
+        for (const auto& tag : tags) {
+            int64_t categoryId = CategoryId(tag);
+            if (categoryId <= 0) return -1;
+            sqlite3_bind_int64(insertLink_, 1, appId);
+            sqlite3_bind_int64(insertLink_, 2, categoryId);
+            if (!Run(insertLink_)) return -1;
+            added += sqlite3_changes(db_);
+        }
+        return added;
+    }
+
+private:
+    bool Prep(const char* sql, sqlite3_stmt*& stmt) {
+        return sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) == SQLITE_OK;
+    }
+
+    static void BindText(sqlite3_stmt* stmt, int index, const std::string& value) {
+        sqlite3_bind_text(stmt, index, value.c_str(), (int)value.size(), SQLITE_STATIC);
+    }
+
+    static bool Run(sqlite3_stmt* stmt) {
+        bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        return ok;
+    }
+
+    bool LoadCategories() {
+        sqlite3_stmt* stmt;
+        if (!Prep("SELECT id, category_name FROM categories ORDER BY id;", stmt)) return false;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            categoryIds_.emplace(AsciiLower(ColumnString(stmt, 1)), sqlite3_column_int64(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+        return true;
+    }
+
+    int64_t CategoryId(const std::string& tag) {
+        std::string key = AsciiLower(tag);
+        auto it = categoryIds_.find(key);
+        if (it != categoryIds_.end()) return it->second;
+
+        int64_t id = -1;
+        BindText(insertCategory_, 1, tag);
+        if (Run(insertCategory_)) {
+            id = sqlite3_last_insert_rowid(db_);
+        } else {
+            BindText(findCategory_, 1, tag);
+            if (sqlite3_step(findCategory_) == SQLITE_ROW) id = sqlite3_column_int64(findCategory_, 0);
+            sqlite3_reset(findCategory_);
+            sqlite3_clear_bindings(findCategory_);
+        }
+        if (id > 0) categoryIds_.emplace(key, id);
+        return id;
+    }
+
+    sqlite3* db_;
+    sqlite3_stmt* insertApp_ = nullptr;
+    sqlite3_stmt* updateApp_ = nullptr;
+    sqlite3_stmt* deleteLinks_ = nullptr;
+    sqlite3_stmt* deleteApp_ = nullptr;
+    sqlite3_stmt* insertLink_ = nullptr;
+    sqlite3_stmt* insertCategory_ = nullptr;
+    sqlite3_stmt* findCategory_ = nullptr;
+    std::unordered_map<std::string, int64_t> categoryIds_;
+};
+
+} // namespace
+
+bool ImportWingetIndex(sqlite3* db, const std::vector<WingetIndexPackage>& packages, WingetIndexDiff& diff) {
+    diff = WingetIndexDiff();
+    if (!db || packages.empty()) return false;
+
+    // Both sides sorted by lowercased id, so the diff is a single merge
+    std::vector<std::pair<std::string, size_t>> incoming;
+    incoming.reserve(packages.size());
+    for (size_t i = 0; i < packages.size(); i++) incoming.emplace_back(AsciiLower(packages[i].packageId), i);
+    std::sort(incoming.begin(), incoming.end());
+    incoming.erase(std::unique(incoming.begin(), incoming.end(),
+                               [](const auto& a, const auto& b) { return a.first == b.first; }),
+                   incoming.end());
+
+    std::vector<ExistingApp> existing;
+    sqlite3_stmt* stmt;
+    const char* sql = "SELECT id, package_id, IFNULL(name, ''), IFNULL(version, ''), IFNULL(moniker, '') FROM apps;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        ExistingApp app;
+        app.id = sqlite3_column_int64(stmt, 0);
+        app.packageId = ColumnString(stmt, 1);
+        app.key = AsciiLower(app.packageId);
+        app.name = ColumnString(stmt, 2);
+        app.version = ColumnString(stmt, 3);
+        app.moniker = ColumnString(stmt, 4);
+        existing.push_back(std::move(app));
+    }
+    sqlite3_finalize(stmt);
+    std::sort(existing.begin(), existing.end(),
+              [](const ExistingApp& a, const ExistingApp& b) { return a.key < b.key; });
+
+    // Installed packages stay even when they leave the source
+    std::unordered_set<std::string> installed;
+    if (HasTable(db, "installed_apps") &&
+        sqlite3_prepare_v2(db, "SELECT package_id FROM installed_apps;", -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) installed.insert(AsciiLower(ColumnString(stmt, 0)));
+        sqlite3_finalize(stmt);
+    }
+    bool allowRemoval = incoming.size() * 2 >= existing.size();
+
+    // A savepoint works both inside and outside a caller's transaction
+    if (sqlite3_exec(db, "SAVEPOINT winget_index_import;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        return false;
+    }
+
+    bool ok;
+    {
+        IndexImporter importer(db);
+        ok = importer.Prepare();
+
+        size_t i = 0, j = 0;
+        while (ok && (i < incoming.size() || j < existing.size())) {
+            int order = i == incoming.size() ? 1 : j == existing.size() ? -1 : incoming[i].first.compare(existing[j].key);
+
+            if (order < 0) {
+                const WingetIndexPackage& pkg = packages[incoming[i].second];
+                int64_t appId = 0;
+                ok = importer.Insert(pkg, appId);
+                int tags = ok ? importer.AddTags(appId, pkg.tags) : -1;
+                ok = tags >= 0;
+                if (ok) {
+                    diff.added.push_back(pkg.packageId);
+                    diff.tagsAdded += tags;
+                }
+                i++;
+            } else if (order > 0) {
+                const ExistingApp& app = existing[j];
+                if (allowRemoval && installed.find(app.key) == installed.end()) {
+                    ok = importer.Remove(app.id);
+                    if (ok) diff.removed.push_back(app.packageId);
+                }
+                j++;
+            } else {
+                const WingetIndexPackage& pkg = packages[incoming[i].second];
+                const ExistingApp& app = existing[j];
+                if (pkg.name != app.name || pkg.version != app.version || pkg.moniker != app.moniker) {
+                    ok = importer.Update(app.id, pkg);
+                    if (ok) diff.changed.push_back(app.packageId);
+                }
+                int tags = ok ? importer.AddTags(app.id, pkg.tags) : -1;
+                ok = ok && tags >= 0;
+                if (ok) diff.tagsAdded += tags;
+                i++;
+                j++;
+            }
+        }
+    }
+
+    if (!ok) {
+        sqlite3_exec(db, "ROLLBACK TO winget_index_import;", nullptr, nullptr, nullptr);
+        sqlite3_exec(db, "RELEASE winget_index_import;", nullptr, nullptr, nullptr);
+        diff = WingetIndexDiff();
+        return false;
+    }
+    return sqlite3_exec(db, "RELEASE winget_index_import;", nullptr, nullptr, nullptr) == SQLITE_OK;
+}
@@ -0,0 +1,48 @@
+#ifndef WINGET_INDEX_H
+#define WINGET_INDEX_H
+
+// Importer for the winget source index (the index.db inside source.msix).
+// The index already holds every package id, name, moniker, version and tag, so one
+// read replaces parsing `winget search` output and running `winget show` for tags.
+// Both the v1 schema (manifest/ids/names/... tables) and v2 (packages table) are read.
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Forward declaration for SQLite
+typedef struct sqlite3 sqlite3;
+
+#define WINGET_INDEX_FILENAME "winget_index.db"
+
+struct WingetIndexPackage {
+    std::string packageId;
+    std::string name;
+    std::string moniker;
+    std::string version;              // Latest version in the index
+    std::vector<std::string> tags;
+};
+
+struct WingetIndexDiff {
+    std::vector<std::string> added;      // Inserted into apps
+    std::vector<std::string> changed;    // Name, version or moniker updated in place
+    std::vector<std::string> removed;    // Not in the index and not installed, deleted
+    int tagsAdded = 0;                   // New app_categories links
+};
+
+// Read the latest version of every package from an index file (opened read-only).
+// Returns false if the file is not a winget index.
+bool ReadWingetIndex(const std::string& indexPath, std::vector<WingetIndexPackage>& packages);
+
+// Apply the index to the catalog in one transaction: insert new packages, update
+// changed ones in place (ids, and so category links, are kept), add index tags as
+// categories and delete packages that left the source unless they are installed.
+// Removal is skipped if the index holds less than half as many packages as the
+// catalog, which protects against truncated or wrong index files.
+bool ImportWingetIndex(sqlite3* db, const std::vector<WingetIndexPackage>& packages, WingetIndexDiff& diff);
+
+// winget version ordering: dot-separated parts, numeric prefix first, then the rest
+// (a part with a suffix sorts before the bare number). Returns <0, 0 or >0.
+int CompareWingetVersions(const std::string& a, const std::string& b);
+
+#endif // WINGET_INDEX_H
@@ -954,7 +954,10 @@ bool ShowInstallDialog(HWND hParent, const std::vector<std::string>& packageIds,
         
         // Read output from pipe progressively while process runs
         int timeoutCounter = 0;
-        const int TIMEOUT_LIMIT = 600; // 5 minutes (600 * 500ms)
+        // 5 minutes without output (3000 * 100ms). The helper writes a "Still
+        // installing" line after every UPGRADE_HEARTBEAT_SECONDS of silence while a
+        // package downloads or installs, so only a helper that hangs is stopped.
+        const int TIMEOUT_LIMIT = 3000;
         int completedPackages = 0;
         std::wstring currentPackageId;
         std::wstring lineBuffer;  // Accumulate partial lines
@@ -976,6 +979,7 @@ bool ShowInstallDialog(HWND hParent, const std::vector<std::string>& packageIds,
             DWORD bytesRead;
             while (ReadFile(hPipe, buffer, sizeof(buffer)-1, &bytesRead, NULL) && bytesRead > 0) {
                 buffer[bytesRead] = '\0';
+                timeoutCounter = 0;  // The helper is still making progress (it reports every download and install)
                 
                 // Convert UTF-8 to wide string and add to buffer
                 std::wstring wtext = Utf8ToWide(std::string(buffer, bytesRead));
@@ -0,0 +1,609 @@
+#include "upgrade_pipeline.h"
+#include "sha256.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// WingetErrors::INSTALL_CANCELLED_BY_USER (winget_errors.h needs windows.h)
+static const uint32_t WINGET_INSTALL_CANCELLED = 0x8A15010C;
+
+// ExpectedReturnCodes responses and the install errors winget reports for them
+// (0 for the reboot responses winget counts as success)
+static const struct {
+    const char* response;
+    uint32_t exitCode;
+} RETURN_RESPONSES[] = {
+    {"packageInUse", 0x8A150101},
+    {"installInProgress", 0x8A150102},
+    {"fileInUse", 0x8A150103},
+    {"missingDependency", 0x8A150104},
+    {"diskFull", 0x8A150105},
+    {"insufficientMemory", 0x8A150106},
+    {"noNetwork", 0x8A150107},
+    {"contactSupport", 0x8A150108},
+    {"rebootRequiredToFinish", 0},
+    {"rebootRequiredForInstall", 0x8A15010A},
+    {"rebootInitiated", 0},
+    {"cancelledByUser", WINGET_INSTALL_CANCELLED},
+    {"alreadyInstalled", 0x8A15010D},
+    {"downgrade", 0x8A15010E},
+    {"blockedByPolicy", 0x8A15010F},
+    {"packageInUseByApplication", 0x8A150111},
+    {"invalidParameter", 0x8A150112},
+    {"systemNotSupported", 0x8A150113},
+};
+
+// ---------------------------------------------------------------------------
+// Process runner
+// ---------------------------------------------------------------------------
+
+#ifdef _WIN32
+
+uint32_t RunUpgradeCommand(const std::string& commandLine, const std::function<void(const char*, size_t)>& onOutput) {
+    int needed = MultiByteToWideChar(CP_UTF8, 0, commandLine.c_str(), -1, NULL, 0);
+    if (needed <= 0) return UPGRADE_START_FAILED;
+    std::wstring cmd(needed, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, commandLine.c_str(), -1, &cmd[0], needed);
+
+    HANDLE hReadPipe, hWritePipe;
+    SECURITY_ATTRIBUTES sa{};
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.bInheritHandle = TRUE;
+    sa.lpSecurityDescriptor = NULL;
+    if (!CreatePipe(&hReadPipe, &hWritePipe, &sa, 0)) return UPGRADE_START_FAILED;
+
+    SetHandleInformation(hReadPipe, HANDLE_FLAG_INHERIT, 0);
+
+    STARTUPINFOW si{};
+    si.cb = sizeof(STARTUPINFOW);
+    si.hStdOutput = hWritePipe;
+    si.hStdError = hWritePipe;
+    si.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+    si.wShowWindow = SW_HIDE;
+
+    PROCESS_INFORMATION pi{};
+
+    // CREATE_NO_WINDOW | DETACHED_PROCESS keeps any console window from appearing, even briefly
+    DWORD creationFlags = CREATE_NO_WINDOW | DETACHED_PROCESS;
+    if (!CreateProcessW(NULL, &cmd[0], NULL, NULL, TRUE, creationFlags, NULL, NULL, &si, &pi)) {
+        CloseHandle(hWritePipe);
+        CloseHandle(hReadPipe);
+        return UPGRADE_START_FAILED;
+    }
+    CloseHandle(hWritePipe);
+
+    // Forward output until the process ends and the pipe is drained
+    char buffer[4096];
+    DWORD bytesRead;
+    DWORD totalBytesAvail = 0;
+    bool processRunning = true;
+    while (processRunning) {
+        if (PeekNamedPipe(hReadPipe, NULL, 0, NULL, &totalBytesAvail, NULL) && totalBytesAvail > 0) {
+            if (ReadFile(hReadPipe, buffer, sizeof(buffer), &bytesRead, NULL) && bytesRead > 0) {
+                onOutput(buffer, bytesRead);
+            }
+        }
+
+        DWORD waitResult = WaitForSingleObject(pi.hProcess, 100);
+        if (waitResult == WAIT_OBJECT_0) {
+            processRunning = false;
+            while (PeekNamedPipe(hReadPipe, NULL, 0, NULL, &totalBytesAvail, NULL) && totalBytesAvail > 0) {
+                if (!ReadFile(hReadPipe, buffer, sizeof(buffer), &bytesRead, NULL) || bytesRead == 0) break;
+                onOutput(buffer, bytesRead);
+            }
+        } else if (waitResult == WAIT_FAILED) {
+            processRunning = false;
+        }
+        // Sleep briefly when there was nothing to read to avoid busy-waiting
+        if (processRunning && totalBytesAvail == 0) {
+            Sleep(50);
+        }
+    }
+
+    DWORD exitCode = 0;
+    GetExitCodeProcess(pi.hProcess, &exitCode);
+
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    CloseHandle(hReadPipe);
+    return exitCode;
+}
+
+#else
+
+// Through /bin/sh; exit codes are limited to 0-255 here, which is all a
+// stand-in winget needs
+uint32_t RunUpgradeCommand(const std::string& commandLine, const std::function<void(const char*, size_t)>& onOutput) {
+    std::string cmd = commandLine + " 2>&1";
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (!pipe) return UPGRADE_START_FAILED;
+
+    char buffer[4096];
+    ssize_t bytesRead;
+    while ((bytesRead = read(fileno(pipe), buffer, sizeof(buffer))) > 0) {
+        onOutput(buffer, (size_t)bytesRead);
+    }
+
+    int status = pclose(pipe);
+    return status != -1 && WIFEXITED(status) ? (uint32_t)WEXITSTATUS(status) : UPGRADE_START_FAILED;
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Cached installers
+// ---------------------------------------------------------------------------
+
+static std::string Trim(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) return std::string();
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+static std::string Quote(const std::string& text) {
+    return "\"" + text + "\"";
+}
+
+static std::string FormatSeconds(double seconds) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.1f s", seconds);
+    return buffer;
+}
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct CachedInstaller {
+    std::string commandLine;
+    std::string name;
+    std::string version;
+    fs::path path;                                          // The installer file
+    std::string sha256;                                     // InstallerSha256, lowercase
+    std::vector<uint32_t> successCodes;                     // InstallerSuccessCodes
+    std::vector<std::pair<uint32_t, uint32_t>> returnCodes; // ExpectedReturnCodes -> winget exit code
+};
+
+// Value of a "Key: value" manifest line, unquoted
+static bool ManifestValue(const std::string& line, const char* key, std::string& value) {
+    size_t keyLength = strlen(key);
+    if (line.compare(0, keyLength, key) != 0 || line.size() <= keyLength || line[keyLength] != ':') return false;
+    value = Trim(line.substr(keyLength + 1));
+    if (value.size() >= 2 && (value.front() == '"' || value.front() == '\'') && value.back() == value.front()) {
+        value = value.substr(1, value.size() - 2);
+    }
+    return true;
+}
+
+// Manifest integers are decimal (installer exit codes may be negative) or hex
+static bool ParseExitCode(const std::string& text, uint32_t& code) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    long long value = strtoll(text.c_str(), &end, 0);
+    if (*end != '\0') return false;
+    code = (uint32_t)value;
+    return true;
+}
+
+static std::string Lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return text;
+}
+
+// "winget download" leaves the installer and its merged manifest (.yaml) in the
+// directory. Builds the silent install command the way winget would: the
+// manifest's Silent switch, or the installer type's default one, plus Custom
+// and Upgrade, plus the all-users switch for machine scope. False, with the
+// reason, if there is no single installer or winget has to do more than run it
+// silently: msix, zip, portable, an exe without a Silent switch, dependencies,
+// an UpgradeBehavior other than install, a per-user scope (the helper is
+// elevated, the package would go to the administrator's profile), or no
+// InstallerSha256 to check the file against.
+static bool FindCachedInstaller(const fs::path& dir, CachedInstaller& installer, std::string& reason) {
+    reason = "The downloaded installer cannot be run silently";
+    std::error_code ec;
+    fs::path manifestPath;
+    int installerFiles = 0;
+    for (const fs::directory_entry& entry : fs::directory_iterator(dir, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        if (entry.path().extension() == ".yaml") {
+            manifestPath = entry.path();
+        } else {
+            installer.path = entry.path();
+            installerFiles++;
+        }
+    }
+    if (ec || manifestPath.empty() || installerFiles != 1) return false;
+
+    std::ifstream manifest(manifestPath);
+    if (!manifest) return false;
+
+    // Installer entries override the root-level defaults
+    std::string type[2], silent[2], custom[2], upgrade[2], scope[2], behavior[2], sha256[2];
+    std::vector<uint32_t> successCodes[2];
+    std::vector<std::pair<uint32_t, uint32_t>> returnCodes[2];
+    bool inInstallers = false;
+    bool inSuccessCodes = false;
+    uint32_t returnCode = 0;
+    bool haveReturnCode = false;
+    std::string line, value;
+    while (std::getline(manifest, line)) {
+        std::string trimmed = Trim(line);
+        bool listItem = !trimmed.empty() && trimmed[0] == '-';
+        if (listItem) trimmed = Trim(trimmed.substr(1));
+        int level = inInstallers ? 1 : 0;
+
+        // InstallerSuccessCodes is a list of plain integers
+        if (inSuccessCodes) {
+            uint32_t code;
+            if (listItem && trimmed.find(':') == std::string::npos && ParseExitCode(trimmed, code)) {
+                successCodes[level].push_back(code);
+                continue;
+            }
+            if (!trimmed.empty()) inSuccessCodes = false;
+        }
+
+        if (ManifestValue(trimmed, "Installers", value)) {
+            inInstallers = true;
+        } else if (ManifestValue(trimmed, "Dependencies", value) || ManifestValue(trimmed, "NestedInstallerType", value)) {
+            return false;
+        } else if (ManifestValue(trimmed, "InstallerType", value)) {
+            type[level] = value;
+        } else if (ManifestValue(trimmed, "Silent", value)) {
+            silent[level] = value;
+        } else if (ManifestValue(trimmed, "Custom", value)) {
+            custom[level] = value;
+        } else if (ManifestValue(trimmed, "Upgrade", value)) {
+            upgrade[level] = value;
+        } else if (ManifestValue(trimmed, "Scope", value)) {
+            scope[level] = Lowercase(value);
+        } else if (ManifestValue(trimmed, "UpgradeBehavior", value)) {
+            behavior[level] = value;
+        } else if (ManifestValue(trimmed, "InstallerSha256", value)) {
+            sha256[level] = Lowercase(value);
+        } else if (ManifestValue(trimmed, "InstallerSuccessCodes", value)) {
+            inSuccessCodes = true;
+        } else if (ManifestValue(trimmed, "InstallerReturnCode", value)) {
+            haveReturnCode = ParseExitCode(value, returnCode);
+        } else if (ManifestValue(trimmed, "ReturnResponse", value)) {
+            for (const auto& response : RETURN_RESPONSES) {
+                if (haveReturnCode && value == response.response) {
+                    returnCodes[level].push_back({returnCode, response.exitCode});
+                }
+            }
+            haveReturnCode = false;
+        } else if (!inInstallers && ManifestValue(trimmed, "PackageName", value)) {
+            installer.name = value;
+        } else if (!inInstallers && ManifestValue(trimmed, "PackageVersion", value)) {
+            installer.version = value;
+        }
+    }
+    std::string installerType = Lowercase(!type[1].empty() ? type[1] : type[0]);
+    std::string switches = !silent[1].empty() ? silent[1] : silent[0];
+    std::string customSwitches = !custom[1].empty() ? custom[1] : custom[0];
+    std::string upgradeSwitches = !upgrade[1].empty() ? upgrade[1] : upgrade[0];
+    std::string installScope = !scope[1].empty() ? scope[1] : scope[0];
+    std::string upgradeBehavior = !behavior[1].empty() ? behavior[1] : behavior[0];
+    installer.sha256 = !sha256[1].empty() ? sha256[1] : sha256[0];
+    installer.successCodes = !successCodes[1].empty() ? successCodes[1] : successCodes[0];
+    installer.returnCodes = !returnCodes[1].empty() ? returnCodes[1] : returnCodes[0];
+
+    bool msi = installerType == "msi" || installerType == "wix";
+    if (switches.empty()) {
+        if (msi || installerType == "burn") {
+            switches = "/quiet /norestart";
+        } else if (installerType == "inno") {
+            switches = "/SP- /VERYSILENT /SUPPRESSMSGBOXES /NORESTART";
+        } else if (installerType == "nullsoft") {
+            switches = "/S";
+        } else {
+            return false;
+        }
+    } else if (!msi && installerType != "burn" && installerType != "inno" && installerType != "nullsoft" &&
+               installerType != "exe") {
+        return false;
+    }
+
+    if (!upgradeBehavior.empty() && Lowercase(upgradeBehavior) != "install") {
+        reason = "The manifest's UpgradeBehavior is " + upgradeBehavior;
+        return false;
+    }
+    if (installScope == "user") {
+        reason = "The package installs per user";
+        return false;
+    }
+    if (installer.sha256.empty()) {
+        reason = "The manifest has no InstallerSha256";
+        return false;
+    }
+
+    std::string file = Quote(installer.path.u8string());
+    installer.commandLine = (msi ? "msiexec.exe /i " + file : file) + " " + switches;
+    if (installScope == "machine") {
+        if (msi) {
+            installer.commandLine += " ALLUSERS=1";
+        } else if (installerType == "inno") {
+            installer.commandLine += " /ALLUSERS";
+        }
+    }
+    if (!customSwitches.empty()) installer.commandLine += " " + customSwitches;
+    if (!upgradeSwitches.empty()) installer.commandLine += " " + upgradeSwitches;
+    return true;
+}
+
+// Hash the installer right before it runs, against the manifest's InstallerSha256
+static bool VerifyInstallerHash(const CachedInstaller& installer) {
+    std::ifstream file(installer.path, std::ios::binary);
+    if (!file) return false;
+    Sha256 hash;
+    char buffer[65536];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        hash.Update(buffer, (size_t)file.gcount());
+    }
+    return Sha256::ToHex(hash.Finish()) == installer.sha256;
+}
+
+// Installer exit codes the manifest declares (InstallerSuccessCodes,
+// ExpectedReturnCodes), then the usual ones: 3010 and 1641 (reboot required or
+// started) are success, 1602 is MSI's user cancel, as winget reports them
+static uint32_t MapInstallerExitCode(const CachedInstaller& installer, uint32_t exitCode) {
+    if (exitCode == 0) return 0;
+    for (uint32_t code : installer.successCodes) {
+        if (code == exitCode) return 0;
+    }
+    for (const auto& expected : installer.returnCodes) {
+        if (expected.first == exitCode) return expected.second;
+    }
+    if (exitCode == 3010 || exitCode == 1641) return 0;
+    if (exitCode == 1602) return WINGET_INSTALL_CANCELLED;
+    return exitCode;
+}
+
+// App name from winget's "Found App Name [Package.Id]" line
+static void ParseFoundName(const std::string& text, std::string& appName) {
+    if (!appName.empty()) return;
+    size_t foundPos = text.find("Found ");
+    if (foundPos == std::string::npos) return;
+    size_t nameStart = foundPos + 6;
+    size_t bracketPos = text.find('[', nameStart);
+    if (bracketPos != std::string::npos) appName = Trim(text.substr(nameStart, bracketPos - nameStart));
+}
+
+// ---------------------------------------------------------------------------
+// Pipeline
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct DownloadSlot {
+    bool done = false;
+    bool ok = false;
+    double seconds = 0;
+};
+
+class UpgradeBatch {
+public:
+    UpgradeBatch(const std::vector<std::string>& packageIds, const UpgradeOptions& options,
+                 const UpgradeOutputFn& output, const UpgradeDoneFn& packageDone)
+        : packageIds_(packageIds), options_(options), output_(output), packageDone_(packageDone),
+          slots_(packageIds.size()) {}
+
+    std::vector<UpgradeResult> Run() {
+        std::error_code ec;
+        bool useCache = !options_.cacheDir.empty();
+        if (useCache) {
+            fs::create_directories(fs::u8path(options_.cacheDir), ec);
+            useCache = !ec;
+        }
+
+        std::vector<std::thread> workers;
+        if (useCache) {
+            size_t count = std::min(packageIds_.size(), (size_t)std::max(options_.downloadConcurrency, 1));
+            for (size_t i = 0; i < count; i++) workers.emplace_back(&UpgradeBatch::DownloadWorker, this);
+        }
+        std::thread heartbeat;
+        if (options_.heartbeatSeconds > 0) heartbeat = std::thread(&UpgradeBatch::Heartbeat, this);
+
+        std::vector<UpgradeResult> results;
+        for (size_t i = 0; i < packageIds_.size(); i++) {
+            results.push_back(Install(i, useCache));
+            std::lock_guard<std::mutex> lock(outputMutex_);
+            packageDone_(i, results.back());
+            atLineStart_ = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(outputMutex_);
+            stopping_ = true;
+            heartbeatWake_.notify_all();
+        }
+        if (heartbeat.joinable()) heartbeat.join();
+        for (std::thread& worker : workers) worker.join();
+        if (useCache) fs::remove_all(fs::u8path(options_.cacheDir), ec);
+        return results;
+    }
+
+private:
+    fs::path PackageDir(size_t index) const {
+        return fs::u8path(options_.cacheDir) / fs::u8path(std::to_string(index + 1) + "_" + packageIds_[index]);
+    }
+
+    void Write(const char* data, size_t size) {
+        if (size == 0) return;
+        std::lock_guard<std::mutex> lock(outputMutex_);
+        output_(std::string(data, size));
+        atLineStart_ = data[size - 1] == '\n';
+        lastOutput_ = std::chrono::steady_clock::now();
+    }
+
+    // A whole line, on a line of its own even if a download finishes while
+    // winget is in the middle of one
+    void WriteLine(const std::string& line) {
+        std::lock_guard<std::mutex> lock(outputMutex_);
+        WriteLineLocked(line);
+    }
+
+    void WriteLineLocked(const std::string& line) {
+        output_((atLineStart_ ? "" : "\r\n") + line + "\r\n");
+        atLineStart_ = true;
+        lastOutput_ = std::chrono::steady_clock::now();
+    }
+
+    // What the install thread is waiting for ("installing X"), empty between packages
+    void SetActivity(const std::string& activity) {
+        std::lock_guard<std::mutex> lock(outputMutex_);
+        activity_ = activity;
+        activityStart_ = std::chrono::steady_clock::now();
+        heartbeatWake_.notify_all();
+    }
+
+    // Installers and downloads can be silent for a long time. Reports what is
+    // running whenever there was no output for heartbeatSeconds, so the dialog
+    // (which gives up on a helper that stays silent) knows the helper is alive.
+    void Heartbeat() {
+        const auto interval = std::chrono::seconds(options_.heartbeatSeconds);
+        std::unique_lock<std::mutex> lock(outputMutex_);
+        while (!stopping_) {
+            auto now = std::chrono::steady_clock::now();
+            if (!activity_.empty() && now - lastOutput_ >= interval) {
+                WriteLineLocked("Still " + activity_ + " (" + FormatSeconds(SecondsSince(activityStart_)) + ")");
+            }
+            heartbeatWake_.wait_until(lock, activity_.empty() ? now + interval : lastOutput_ + interval);
+        }
+    }
+
+    void DownloadWorker() {
+        for (;;) {
+            size_t index = nextDownload_++;
+            if (index >= packageIds_.size()) return;
+
+            fs::path dir = PackageDir(index);
+            std::string cmd = Quote(options_.wingetPath) + " download --id " + Quote(packageIds_[index]) +
+                              " --exact --download-directory " + Quote(dir.u8string()) +
+                              " --accept-package-agreements --accept-source-agreements";
+            auto start = std::chrono::steady_clock::now();
+            uint32_t exitCode = RunUpgradeCommand(cmd, [](const char*, size_t) {});
+            double seconds = SecondsSince(start);
+
+            if (exitCode == 0) {
+                WriteLine("Downloaded " + packageIds_[index] + " in " + FormatSeconds(seconds));
+            } else {
+                char code[16];
+                snprintf(code, sizeof(code), "0x%08X", exitCode);
+                WriteLine("Download of " + packageIds_[index] + " failed after " + FormatSeconds(seconds) + " (" +
+                          code + "), winget upgrade will download it again");
+            }
+
+            std::lock_guard<std::mutex> lock(slotMutex_);
+            slots_[index].done = true;
+            slots_[index].ok = exitCode == 0;
+            slots_[index].seconds = seconds;
+            slotReady_.notify_all();
+        }
+    }
+
+    UpgradeResult Install(size_t index, bool useCache) {
+        UpgradeResult result;
+        result.packageId = packageIds_[index];
+        WriteLine("[" + std::to_string(index + 1) + "/" + std::to_string(packageIds_.size()) + "] " + result.packageId);
+
+        DownloadSlot slot;
+        if (useCache) {
+            std::unique_lock<std::mutex> lock(slotMutex_);
+            if (!slots_[index].done) {
+                lock.unlock();
+                WriteLine("Downloading " + result.packageId + "...");
+                SetActivity("downloading " + result.packageId);
+                lock.lock();
+                slotReady_.wait(lock, [&] { return slots_[index].done; });
+            }
+            slot = slots_[index];
+        }
+
+        // The cache is only writable by administrators, and the installer is
+        // checked against the manifest's hash right before it runs elevated
+        CachedInstaller cached;
+        std::string reason;
+        bool fromCache = slot.ok && FindCachedInstaller(PackageDir(index), cached, reason);
+        if (fromCache && !VerifyInstallerHash(cached)) {
+            reason = "The downloaded installer does not match the manifest's InstallerSha256";
+            fromCache = false;
+        }
+        if (slot.ok && !fromCache) {
+            WriteLine(reason + ", installing with winget upgrade");
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        SetActivity("installing " + result.packageId);
+        if (fromCache) {
+            result.fromCache = true;
+            result.downloadSeconds = slot.seconds;
+            result.appName = cached.name;
+            std::string label = cached.name.empty() ? result.packageId : cached.name;
+            if (!cached.version.empty()) label += " " + cached.version;
+            WriteLine("Installing " + label + " from the download cache");
+            result.exitCode = MapInstallerExitCode(
+                cached, RunUpgradeCommand(cached.commandLine, [this](const char* data, size_t size) { Write(data, size); }));
+        } else {
+            std::string cmd = Quote(options_.wingetPath) + " upgrade --id " + Quote(result.packageId) +
+                              " --accept-package-agreements --accept-source-agreements";
+            result.exitCode = RunUpgradeCommand(cmd, [this, &result](const char* data, size_t size) {
+                ParseFoundName(std::string(data, size), result.appName);
+                Write(data, size);
+            });
+        }
+        result.installSeconds = SecondsSince(start);
+        SetActivity(std::string());
+        WriteLine("Install time: " + FormatSeconds(result.installSeconds));
+
+        std::error_code ec;
+        if (useCache) fs::remove_all(PackageDir(index), ec);
+        return result;
+    }
+
+    const std::vector<std::string>& packageIds_;
+    const UpgradeOptions& options_;
+    const UpgradeOutputFn& output_;
+    const UpgradeDoneFn& packageDone_;
+
+    std::mutex outputMutex_;
+    bool atLineStart_ = true;
+    std::chrono::steady_clock::time_point lastOutput_ = std::chrono::steady_clock::now();
+    std::string activity_;
+    std::chrono::steady_clock::time_point activityStart_;
+    std::condition_variable heartbeatWake_;
+    bool stopping_ = false;
+
+    std::atomic<size_t> nextDownload_{0};
+    std::mutex slotMutex_;
+    std::condition_variable slotReady_;
+    std::vector<DownloadSlot> slots_;
+};
+
+} // namespace
+
+std::vector<UpgradeResult> RunUpgradeBatch(const std::vector<std::string>& packageIds, const UpgradeOptions& options,
+                                           const UpgradeOutputFn& output, const UpgradeDoneFn& packageDone) {
+    UpgradeBatch batch(packageIds, options, output, packageDone);
+    return batch.Run();
+}
@@ -0,0 +1,61 @@
+#ifndef UPGRADE_PIPELINE_H
+#define UPGRADE_PIPELINE_H
+
+// Batch upgrade pipeline used by winget_helper.exe. Downloads ("winget download"
+// into a per-batch cache directory) run a few at a time ahead of the installs,
+// which run one at a time in the order the packages were given, so network time
+// overlaps installer time. A cached installer is run only if it matches the
+// manifest's InstallerSha256 and winget would just run it silently; a package
+// whose download failed, or that needs more than that (see FindCachedInstaller),
+// is installed with "winget upgrade --id" as before. Portable (no Win32 outside
+// the process runner), so the pipeline can be driven by a stand-in winget script
+// on Linux (tests/).
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Downloads running at the same time
+#define UPGRADE_DOWNLOAD_CONCURRENCY 3
+
+// Longest silence while a package downloads or installs; a "Still installing"
+// line is written after it
+#define UPGRADE_HEARTBEAT_SECONDS 60
+
+struct UpgradeOptions {
+    std::string wingetPath = "winget.exe";
+    // Per-batch download cache (UTF-8), removed afterwards. The installers run
+    // with the caller's rights, so it must not be writable by anyone less
+    // privileged (winget_helper creates it with an Administrators-only ACL).
+    // Empty: every package is installed with winget upgrade.
+    std::string cacheDir;
+    int downloadConcurrency = UPGRADE_DOWNLOAD_CONCURRENCY;
+    int heartbeatSeconds = UPGRADE_HEARTBEAT_SECONDS;      // 0: no heartbeat
+};
+
+struct UpgradeResult {
+    std::string packageId;
+    std::string appName;          // From winget's "Found" line or the cached manifest; may be empty
+    uint32_t exitCode = 0;        // winget exit code (cached installers are mapped onto it)
+    bool fromCache = false;       // Installed from the downloaded installer
+    double downloadSeconds = 0;   // 0 if the download was not used
+    double installSeconds = 0;
+};
+
+// Called with UTF-8 output for the dialog: winget's install output, download
+// and install timing. packageDone is called on the install thread after each
+// package, in order. The two are never called at the same time.
+typedef std::function<void(const std::string& text)> UpgradeOutputFn;
+typedef std::function<void(size_t index, const UpgradeResult& result)> UpgradeDoneFn;
+
+// Upgrade the packages; returns one result per package, in order
+std::vector<UpgradeResult> RunUpgradeBatch(const std::vector<std::string>& packageIds, const UpgradeOptions& options,
+                                           const UpgradeOutputFn& output, const UpgradeDoneFn& packageDone);
+
+// Run a command line, passing its combined stdout/stderr to onOutput as it
+// arrives. Returns the exit code, or UPGRADE_START_FAILED if it could not start.
+#define UPGRADE_START_FAILED 0xFFFFFFFFu
+uint32_t RunUpgradeCommand(const std::string& commandLine, const std::function<void(const char*, size_t)>& onOutput);
+
+#endif // UPGRADE_PIPELINE_H
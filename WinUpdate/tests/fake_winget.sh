@@ -0,0 +1,62 @@
+#!/bin/sh
+# Stand-in for winget: "download" writes an installer script and its manifest,
+# "upgrade" prints what winget would. The package id picks the case under test.
+cmd=$1; shift
+while [ $# -gt 0 ]; do
+  case $1 in
+    --id) id=$2; shift;;
+    --download-directory) dir=$2; shift;;
+  esac
+  shift
+done
+
+if [ "$cmd" = download ]; then
+  [ "$id" = Fail.Download ] && { echo "network error"; exit 8; }
+  mkdir -p "$dir"
+  installer="$dir/${id}_1.0_x64.exe"
+  code=0; delay=0; type=exe; silent='Silent: "--silent"'; extra=
+  case $id in
+    Msix.Pkg) type=msix;;
+    Exe.NoSilent) silent=;;
+    Success.Code) code=5; extra='  InstallerSuccessCodes:
+  - 5';;
+    Expected.Code) code=7; extra='  ExpectedReturnCodes:
+  - InstallerReturnCode: 7
+    ReturnResponse: packageInUse
+    ReturnResponseUrl: https://example.com';;
+    User.Scope) extra='  Scope: user';;
+    Machine.Inno) type=inno; silent=; extra='  Scope: machine';;
+    Uninstall.Previous) extra='  UpgradeBehavior: uninstallPrevious';;
+    Slow.Install) delay=3;;
+  esac
+  printf '#!/bin/sh\nsleep %s\necho "ran $0 $*"\nexit %s\n' "$delay" "$code" > "$installer"
+  chmod +x "$installer"
+  hash=$(sha256sum "$installer" | cut -d' ' -f1)
+  [ "$id" = Bad.Hash ] && hash=0000000000000000000000000000000000000000000000000000000000000000
+  cat > "$dir/${id}_1.0_x64.yaml" <<YAML
+PackageIdentifier: $id
+PackageVersion: 1.0
+PackageName: Name of $id
+InstallerType: inno
+Installers:
+- Architecture: x64
+  InstallerType: $type
+  InstallerUrl: https://example.com/${id}.exe
+  InstallerSha256: $hash
+  InstallerSwitches:
+    $silent
+    Custom: /custom
+$extra
+ManifestType: singleton
+ManifestVersion: 1.6.0
+YAML
+  echo "Downloaded"
+  exit 0
+fi
+
+if [ "$cmd" = upgrade ]; then
+  echo "Found Upgraded $id [$id] Version 2.0"
+  echo "Successfully installed"
+  exit 0
+fi
+exit 1
@@ -0,0 +1,109 @@
+// Runs a batch through the upgrade pipeline with fake_winget.sh standing in for
+// winget, and checks which packages came from the download cache, the mapped
+// exit codes, the heartbeat and that the cache is removed afterwards.
+// Usage: upgrade_pipeline_test <fake_winget.sh> <cache directory>
+
+#include "upgrade_pipeline.h"
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: upgrade_pipeline_test <fake_winget.sh> <cache directory>\n");
+        return 2;
+    }
+    std::filesystem::remove_all(argv[2]);
+
+    const std::vector<std::string> ids = {
+        "Plain.Pkg",          // Installed from the cache
+        "Fail.Download",      // winget upgrade
+        "Msix.Pkg",           // Cannot run silently: winget upgrade
+        "Exe.NoSilent",       // Same
+        "Bad.Hash",           // Installer does not match InstallerSha256: winget upgrade
+        "Success.Code",       // Exit code 5 is in InstallerSuccessCodes
+        "Expected.Code",      // Exit code 7 is packageInUse in ExpectedReturnCodes
+        "User.Scope",         // Per-user package: winget upgrade
+        "Machine.Inno",       // Machine scope: /ALLUSERS
+        "Uninstall.Previous", // UpgradeBehavior uninstallPrevious: winget upgrade
+        "Slow.Install",       // Silent for 3 s: heartbeat
+    };
+
+    UpgradeOptions options;
+    options.wingetPath = argv[1];
+    options.cacheDir = argv[2];
+    options.heartbeatSeconds = 1;
+
+    std::mutex outputMutex;
+    std::string output;
+    std::vector<size_t> doneOrder;
+    std::vector<UpgradeResult> results = RunUpgradeBatch(
+        ids, options,
+        [&](const std::string& text) {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            output += text;
+        },
+        [&](size_t index, const UpgradeResult&) { doneOrder.push_back(index); });
+    fputs(output.c_str(), stdout);
+
+    CHECK(results.size() == ids.size());
+    CHECK(doneOrder.size() == ids.size());
+    for (size_t i = 0; i < doneOrder.size(); i++) CHECK(doneOrder[i] == i);
+    if (results.size() != ids.size()) return 1;
+
+    auto fromCache = [&](const char* id) {
+        for (const UpgradeResult& result : results) {
+            if (result.packageId == id) return result.fromCache;
+        }
+        return false;
+    };
+    auto exitCode = [&](const char* id) {
+        for (const UpgradeResult& result : results) {
+            if (result.packageId == id) return result.exitCode;
+        }
+        return UPGRADE_START_FAILED;
+    };
+
+    CHECK(fromCache("Plain.Pkg"));
+    CHECK(results[0].appName == "Name of Plain.Pkg");
+    CHECK(!fromCache("Fail.Download"));
+    CHECK(results[1].appName == "Upgraded Fail.Download");
+    CHECK(!fromCache("Msix.Pkg"));
+    CHECK(!fromCache("Exe.NoSilent"));
+    CHECK(!fromCache("Bad.Hash"));
+    CHECK(output.find("does not match the manifest's InstallerSha256") != std::string::npos);
+    CHECK(fromCache("Success.Code"));
+    CHECK(exitCode("Success.Code") == 0);
+    CHECK(fromCache("Expected.Code"));
+    CHECK(exitCode("Expected.Code") == 0x8A150101);
+    CHECK(!fromCache("User.Scope"));
+    CHECK(fromCache("Machine.Inno"));
+    CHECK(output.find("/VERYSILENT /SUPPRESSMSGBOXES /NORESTART /ALLUSERS /custom") != std::string::npos);
+    CHECK(!fromCache("Uninstall.Previous"));
+    CHECK(fromCache("Slow.Install"));
+    CHECK(output.find("Still installing Slow.Install") != std::string::npos);
+
+    for (const UpgradeResult& result : results) {
+        if (result.packageId != "Expected.Code") CHECK(result.exitCode == 0);
+    }
+    CHECK(!std::filesystem::exists(argv[2]));
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("upgrade pipeline: all checks passed\n");
+    return 0;
+}
@@ -1,11 +1,16 @@
 // Helper to run winget commands with elevation (single UAC prompt)
 // Outputs via named pipe for in-memory IPC with parent process
+// Downloads are prefetched in parallel while installs run one at a time (src/upgrade_pipeline.h)
 #include <windows.h>
+#include <sddl.h>
+#include <chrono>
+#include <random>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <unordered_map>
 #include "src/winget_errors.h"
+#include "src/upgrade_pipeline.h"
 
 // Write to pipe helper
 void WriteToPipe(HANDLE hPipe, const std::wstring& text) {
@@ -22,6 +27,76 @@ void WriteToPipe(HANDLE hPipe, const std::wstring& text) {
     WriteFile(hPipe, utf8.c_str(), (DWORD)utf8.length(), &written, NULL);
 }
 
+// Write UTF-8 text (winget's output) to pipe as is
+void WriteUtf8ToPipe(HANDLE hPipe, const std::string& text) {
+    if (!hPipe || hPipe == INVALID_HANDLE_VALUE || text.empty()) return;
+    
+    DWORD written;
+    WriteFile(hPipe, text.c_str(), (DWORD)text.length(), &written, NULL);
+}
+
+static std::string WideToUtf8(const std::wstring& text) {
+    if (text.empty()) return std::string();
+    int needed = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), NULL, 0, NULL, NULL);
+    if (needed <= 0) return std::string();
+    std::string utf8(needed, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), &utf8[0], needed, NULL, NULL);
+    return utf8;
+}
+
+static std::wstring Utf8ToWide(const std::string& text) {
+    if (text.empty()) return std::wstring();
+    int needed = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), (int)text.size(), NULL, 0);
+    if (needed <= 0) return std::wstring();
+    std::wstring wide(needed, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, text.c_str(), (int)text.size(), &wide[0], needed);
+    return wide;
+}
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::wstring FormatSeconds(double seconds) {
+    wchar_t buffer[32];
+    swprintf(buffer, 32, L"%.1f s", seconds);
+    return buffer;
+}
+
+// The installers in the download cache run elevated, so the cache must not be
+// writable by the user who started WinUpdate: a new directory with a random name
+// under %SystemRoot%\Temp (users cannot delete or rename other users' entries
+// there) and a protected DACL that grants SYSTEM and Administrators only.
+// CreateDirectoryW fails if the name exists, so a directory planted in advance
+// is never used. Returns "" if it cannot be created; every package is then
+// installed with winget upgrade.
+static std::wstring CreateProtectedCacheDir() {
+    wchar_t windowsDir[MAX_PATH];
+    UINT length = GetWindowsDirectoryW(windowsDir, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) return L"";
+
+    PSECURITY_DESCRIPTOR descriptor = NULL;
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(L"D:P(A;OICI;FA;;;SY)(A;OICI;FA;;;BA)",
+                                                              SDDL_REVISION_1, &descriptor, NULL)) {
+        return L"";
+    }
+    SECURITY_ATTRIBUTES sa{};
+    sa.nLength = sizeof(sa);
+    sa.lpSecurityDescriptor = descriptor;
+    sa.bInheritHandle = FALSE;
+
+    std::random_device random;
+    std::wstring cacheDir;
+    for (int attempt = 0; attempt < 4 && cacheDir.empty(); attempt++) {
+        wchar_t name[64];
+        swprintf(name, 64, L"\\Temp\\WinUpdate_batch_%08X%08X", random(), random());
+        std::wstring path = std::wstring(windowsDir) + name;
+        if (CreateDirectoryW(path.c_str(), &sa)) cacheDir = path;
+    }
+    LocalFree(descriptor);
+    return cacheDir;
+}
+
 int WINAPI wWinMain(HINSTANCE, HINSTANCE, LPWSTR lpCmdLine, int) {
     // Load package ID->Name map from file
     std::unordered_map<std::wstring, std::wstring> packageNameMap;
@@ -94,140 +169,32 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, LPWSTR lpCmdLine, int) {
     // Store packageId, appName, exitCode
     std::vector<std::tuple<std::wstring, std::wstring, DWORD>> results;
 
-    for (size_t i = 0; i < packageIds.size(); i++) {
-        std::wstring currentAppName = L""; // Track app name from "Found" lines
-        WriteToPipe(hPipe, L"[" + std::to_wstring(i+1) + L"/" + std::to_wstring(packageIds.size()) + L"] " + packageIds[i] + L"\r\n");
-        
-        // Build winget command
-        std::wstring cmd = L"winget.exe upgrade --id \"" + packageIds[i] + 
-                          L"\" --accept-package-agreements --accept-source-agreements";
-        
-        // Run winget and capture output
-        HANDLE hReadPipe, hWritePipe;
-        SECURITY_ATTRIBUTES sa{};
-        sa.nLength = sizeof(SECURITY_ATTRIBUTES);
-        sa.bInheritHandle = TRUE;
-        sa.lpSecurityDescriptor = NULL;
-        
-        if (!CreatePipe(&hReadPipe, &hWritePipe, &sa, 0)) {
-            WriteToPipe(hPipe, L"Failed to create pipe\r\n");
-            failCount++;
-            continue;
-        }
-        
-        SetHandleInformation(hReadPipe, HANDLE_FLAG_INHERIT, 0);
-        
-        STARTUPINFOW si{};
-        si.cb = sizeof(STARTUPINFOW);
-        si.hStdOutput = hWritePipe;
-        si.hStdError = hWritePipe;
-        si.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
-        si.wShowWindow = SW_HIDE;
-        
-        PROCESS_INFORMATION pi{};
-        
-        // Use CREATE_NO_WINDOW | DETACHED_PROCESS to completely hide console windows
-        // DETACHED_PROCESS prevents any console window from appearing, even briefly
-        DWORD creationFlags = CREATE_NO_WINDOW | DETACHED_PROCESS;
-        
-        if (!CreateProcessW(NULL, (LPWSTR)cmd.c_str(), NULL, NULL, TRUE, creationFlags, NULL, NULL, &si, &pi)) {
-            WriteToPipe(hPipe, L"Failed to start winget\r\n");
-            CloseHandle(hWritePipe);
-            CloseHandle(hReadPipe);
-            failCount++;
-            continue;
-        }
-        
-        CloseHandle(hWritePipe);
-        
-        // Read and forward output to pipe with non-blocking check
-        char buffer[4096];
-        DWORD bytesRead;
-        DWORD totalBytesAvail;
-        
-        // Keep reading until process ends AND no more data available
-        bool processRunning = true;
-        while (processRunning) {
-            // Check if data is available without blocking
-            if (PeekNamedPipe(hReadPipe, NULL, 0, NULL, &totalBytesAvail, NULL) && totalBytesAvail > 0) {
-                if (ReadFile(hReadPipe, buffer, sizeof(buffer)-1, &bytesRead, NULL) && bytesRead > 0) {
-                    buffer[bytesRead] = '\0';
-                    // Convert UTF-8 to wide and write to pipe
-                    int needed = MultiByteToWideChar(CP_UTF8, 0, buffer, bytesRead, NULL, 0);
-                    if (needed > 0) {
-                        std::wstring wbuffer(needed, L'\0');
-                        MultiByteToWideChar(CP_UTF8, 0, buffer, bytesRead, &wbuffer[0], needed);
-                        
-                        // Parse app name from "Found AppName [PackageID]" lines
-                        if (currentAppName.empty()) {
-                            size_t foundPos = wbuffer.find(L"Found ");
-                            if (foundPos != std::wstring::npos) {
-                                size_t nameStart = foundPos + 6;
-                                size_t bracketPos = wbuffer.find(L"[", nameStart);
-                                if (bracketPos != std::wstring::npos) {
-                                    currentAppName = wbuffer.substr(nameStart, bracketPos - nameStart);
-                                    // Trim leading whitespace
-                                    while (!currentAppName.empty() && iswspace(currentAppName.front())) {
-                                        currentAppName.erase(0, 1);
-                                    }
-                                    // Trim trailing whitespace
-                                    while (!currentAppName.empty() && iswspace(currentAppName.back())) {
-                                        currentAppName.pop_back();
-                                    }
-                                }
-                            }
-                        }
-                        
-                        WriteToPipe(hPipe, wbuffer);
-                    }
-                }
-            }
-            
-            // Check if process is still running
-            DWORD waitResult = WaitForSingleObject(pi.hProcess, 100); // 100ms timeout
-            if (waitResult == WAIT_OBJECT_0) {
-                processRunning = false;
-                // Process ended, do one final read to get any remaining data
-                while (PeekNamedPipe(hReadPipe, NULL, 0, NULL, &totalBytesAvail, NULL) && totalBytesAvail > 0) {
-                    if (ReadFile(hReadPipe, buffer, sizeof(buffer)-1, &bytesRead, NULL) && bytesRead > 0) {
-                        buffer[bytesRead] = '\0';
-                        int needed = MultiByteToWideChar(CP_UTF8, 0, buffer, bytesRead, NULL, 0);
-                        if (needed > 0) {
-                            std::wstring wbuffer(needed, L'\0');
-                            MultiByteToWideChar(CP_UTF8, 0, buffer, bytesRead, &wbuffer[0], needed);
-                            WriteToPipe(hPipe, wbuffer);
-                        }
-                    } else {
-                        break;
-                    }
-                }
-            } else if (waitResult == WAIT_FAILED) {
-                processRunning = false;
-            }
-            // If still running and no data, sleep briefly to avoid busy-waiting
-            if (processRunning && totalBytesAvail == 0) {
-                Sleep(50);
-            }
-        }
-        
-        DWORD exitCode = 0;
-        GetExitCodeProcess(pi.hProcess, &exitCode);
-        
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
-        CloseHandle(hReadPipe);
-        
-        // Store result for summary
-        if (currentAppName.empty()) {
-            currentAppName = packageIds[i]; // Fallback to ID if name not found
-        }
-        
-        // Try to get display name from map first
+    // Downloads go to a per-batch cache only administrators can write, ahead of the installs
+    UpgradeOptions options;
+    options.cacheDir = WideToUtf8(CreateProtectedCacheDir());
+
+    std::vector<std::string> batchIds;
+    for (const auto& id : packageIds) {
+        batchIds.push_back(WideToUtf8(id));
+    }
+
+    auto batchStart = std::chrono::steady_clock::now();
+    double downloadSeconds = 0;
+    double installSeconds = 0;
+
+    RunUpgradeBatch(batchIds, options, [hPipe](const std::string& text) {
+        WriteUtf8ToPipe(hPipe, text);
+    }, [&](size_t i, const UpgradeResult& result) {
+        DWORD exitCode = result.exitCode;
+        downloadSeconds += result.downloadSeconds;
+        installSeconds += result.installSeconds;
+
+        // Try to get display name from map first, then from winget's output
         std::wstring displayName;
         if (packageNameMap.count(packageIds[i])) {
             displayName = packageNameMap[packageIds[i]];
-        } else if (!currentAppName.empty()) {
-            displayName = currentAppName;
+        } else if (!result.appName.empty()) {
+            displayName = Utf8ToWide(result.appName);
         } else {
             displayName = packageIds[i];
         }
@@ -262,7 +229,7 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, LPWSTR lpCmdLine, int) {
         }
         
         WriteToPipe(hPipe, L"\r\n");
-    }
+    });
 
     WriteToPipe(hPipe, L"========================================\r\n");
     WriteToPipe(hPipe, L"=== Installation Complete ===\r\n");
@@ -324,6 +291,8 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, LPWSTR lpCmdLine, int) {
     }
     
     WriteToPipe(hPipe, L"\r\n" + std::to_wstring(results.size()) + L" package(s) processed.\r\n");
+    WriteToPipe(hPipe, L"Total time: " + FormatSeconds(SecondsSince(batchStart)) + L" (downloads " +
+                       FormatSeconds(downloadSeconds) + L", installs " + FormatSeconds(installSeconds) + L")\r\n");
     
     // Detailed error summary at the very end (for ALL non-success results)
     if (!results.empty() && (skipCount > 0 || warningCount > 0 || failCount > 0)) {